@@ -10,6 +10,9 @@ static const int ALVR_REFRESH_RATE_LIST_SIZE = 4;
 
 static const char *ALVR_HELLO_PACKET_SIGNATURE = "ALVR";
 
+// Capacity of stages in LatencyReport. New stages can be added without changing the layout.
+static const int ALVR_LATENCY_REPORT_STAGE_MAX = 16;
+
 enum ALVR_PACKET_TYPE {
 	ALVR_PACKET_TYPE_HELLO_MESSAGE = 1,
 	ALVR_PACKET_TYPE_CONNECTION_MESSAGE = 2,
@@ -24,15 +27,21 @@ enum ALVR_PACKET_TYPE {
 	ALVR_PACKET_TYPE_AUDIO_FRAME = 11,
 	ALVR_PACKET_TYPE_VIDEO_FRAME_ACK = 12,
 	ALVR_PACKET_TYPE_HAPTICS = 13,
+	ALVR_PACKET_TYPE_FEC_FEEDBACK = 14,
+	ALVR_PACKET_TYPE_VIDEO_INTERLEAVED_PARITY = 15,
+	ALVR_PACKET_TYPE_VIDEO_SLICE_LOSS = 16,
+	ALVR_PACKET_TYPE_LATENCY_REPORT = 17,
 };
 
 enum {
-	ALVR_PROTOCOL_VERSION = 21
+	ALVR_PROTOCOL_VERSION = 27
 };
 
 enum ALVR_CODEC {
 	ALVR_CODEC_H264 = 0,
 	ALVR_CODEC_H265 = 1,
+	// Low overhead bitstream format (OBUs with obu_size). Sequence header is sent with key frames.
+	ALVR_CODEC_AV1 = 2,
 };
 
 enum ALVR_LOST_FRAME_TYPE {
@@ -68,6 +77,68 @@ enum ALVR_CONTROLLER_CAPABILITY_FLAG {
 	ALVR_CONTROLLER_CAPABILITY_FLAG_6DOF = 1 << 2,
 };
 
+// Optional stream features.
+// Client sends supported features in HelloMessage and server sends enabled ones in ConnectionMessage.
+enum ALVR_STREAM_FLAG {
+	ALVR_STREAM_FLAG_INTERLEAVED_FEC = 1 << 0,
+	// Server uses different fecPercentage per frame type.
+	ALVR_STREAM_FLAG_UNEQUAL_ERROR_PROTECTION = 1 << 1,
+	// Each encoder slice has its own FEC group. Client decodes slices as soon as they are recovered.
+	ALVR_STREAM_FLAG_SLICED_FEC = 1 << 2,
+	// Client keeps intact slices of partially lost frame and reports lost slices by VideoSliceLoss
+	// instead of NACK. Requires ALVR_STREAM_FLAG_SLICED_FEC.
+	ALVR_STREAM_FLAG_SLICE_LOSS_REPORT = 1 << 3,
+	// Client sends latency percentiles by LatencyReport every second.
+	ALVR_STREAM_FLAG_LATENCY_REPORT = 1 << 4,
+};
+
+// Pipeline stages of which client measures latency distribution.
+enum ALVR_LATENCY_STAGE {
+	// Tracking sampled to frame submitted.
+	ALVR_LATENCY_STAGE_TOTAL = 0,
+	// Estimated sent time to last packet received.
+	ALVR_LATENCY_STAGE_TRANSPORT = 1,
+	// Decoder input to output.
+	ALVR_LATENCY_STAGE_DECODE = 2,
+	// Stages below are consecutive hops of the frame timeline.
+	// Tracking sampled to estimated sent time. Includes uplink, rendering and encoding on server.
+	ALVR_LATENCY_STAGE_SERVER = 3,
+	// Estimated sent time to first packet received.
+	ALVR_LATENCY_STAGE_NETWORK = 4,
+	// First packet received to the packet which completed the frame received.
+	ALVR_LATENCY_STAGE_RECEIVE = 5,
+	// Reconstruction of the frame by FEC.
+	ALVR_LATENCY_STAGE_FEC = 6,
+	// FEC done to NALs handed over to decode queue.
+	ALVR_LATENCY_STAGE_NAL = 7,
+	// Waiting in decode queue.
+	ALVR_LATENCY_STAGE_DECODE_QUEUE = 8,
+	// Decoder output to render started.
+	ALVR_LATENCY_STAGE_RENDER_WAIT = 9,
+	// Rendering of eye images.
+	ALVR_LATENCY_STAGE_RENDER = 10,
+	// Rendered to frame submitted.
+	ALVR_LATENCY_STAGE_SUBMIT = 11,
+	// Submitted to predicted display time (vsync).
+	ALVR_LATENCY_STAGE_DISPLAY = 12,
+	// Tracking sampled to display time of the frame rendered with it.
+	ALVR_LATENCY_STAGE_MOTION_TO_PHOTON = 13,
+	// Dequeued from decode queue to decoder input. Hands the frame to the decoder over JNI and
+	// includes waiting in NalQueue of the Java decoder thread.
+	ALVR_LATENCY_STAGE_DECODER_HANDOFF = 14,
+	ALVR_LATENCY_STAGE_COUNT,
+};
+
+enum ALVR_LATENCY_WINDOW {
+	// Last completed second.
+	ALVR_LATENCY_WINDOW_SECOND = 0,
+	// Last 10 completed seconds.
+	ALVR_LATENCY_WINDOW_TEN_SECONDS = 1,
+	// Since connection.
+	ALVR_LATENCY_WINDOW_SESSION = 2,
+	ALVR_LATENCY_WINDOW_COUNT,
+};
+
 enum ALVR_INPUT {
 	ALVR_INPUT_SYSTEM_CLICK,
 	ALVR_INPUT_APPLICATION_MENU_CLICK,
@@ -116,6 +187,18 @@ enum ALVR_INPUT {
 };
 #define ALVR_BUTTON_FLAG(input) (1ULL << input)
 
+enum ALVR_VIDEO_FRAME_TYPE {
+	ALVR_VIDEO_FRAME_TYPE_UNKNOWN = 0,
+	// IDR frame including parameter sets.
+	ALVR_VIDEO_FRAME_TYPE_IDR = 1,
+	ALVR_VIDEO_FRAME_TYPE_P = 2,
+	// P frame which refers only to frames ACKed by client, sent after NACK (reference invalidation).
+	// Client can resume decoding from it.
+	ALVR_VIDEO_FRAME_TYPE_RECOVERY = 3,
+
+	ALVR_VIDEO_FRAME_TYPE_COUNT
+};
+
 enum ALVR_FRAME_ACK_TYPE {
 	ALVR_FRAME_ACK_TYPE_ACK,
 	ALVR_FRAME_ACK_TYPE_NACK
@@ -126,6 +209,14 @@ enum ALVR_FRAME_ACK_VIDEO_FRAME_TYPE {
 	ALVR_FRAME_ACK_VIDEO_FRAME_TYPE_P
 };
 
+// Slice type parsed from slice header by client.
+enum ALVR_SLICE_TYPE {
+	ALVR_SLICE_TYPE_UNKNOWN = 0,
+	ALVR_SLICE_TYPE_P = 1,
+	ALVR_SLICE_TYPE_B = 2,
+	ALVR_SLICE_TYPE_I = 3,
+};
+
 #pragma pack(push, 1)
 // Represent FOV for each eye in degree.
 struct EyeFov {
@@ -158,6 +249,7 @@ struct HelloMessage {
 
 	uint32_t controllerCapabilityFlags; // enum ALVR_CONTROLLER_CAPABILITY_FLAG
 
+	uint32_t streamCapabilityFlags; // enum ALVR_STREAM_FLAG
 };
 struct ConnectionMessage {
 	uint32_t type; // ALVR_PACKET_TYPE_CONNECTION_MESSAGE
@@ -168,6 +260,10 @@ struct ConnectionMessage {
 	uint32_t bufferSize; // in bytes
 	uint32_t frameQueueSize;
 	uint8_t refreshRate;
+	uint32_t streamFlags; // enum ALVR_STREAM_FLAG
+	// Number of consecutive video frames covered by one interleaved parity group.
+	// Valid when ALVR_STREAM_FLAG_INTERLEAVED_FEC is set.
+	uint8_t interleavedFecDepth;
 };
 struct RecoverConnection {
 	uint32_t type; // ALVR_PACKET_TYPE_RECOVER_CONNECTION
@@ -266,6 +362,12 @@ struct TimeSync {
 	uint64_t fecFailureTotal;
 
 	uint32_t fps;
+
+	// Frames dropped by client decode queue because decoder could not keep up.
+	uint64_t decodeQueueDropTotal;
+	uint64_t decodeQueueDropInSecond;
+	// Maximum frames waiting for decoder in last second.
+	uint32_t decodeQueueMaxFrames;
 };
 struct ChangeSettings {
 	uint32_t type; // 8
@@ -284,6 +386,11 @@ struct VideoFrame {
 	uint32_t frameByteSize;
 	uint32_t fecIndex;
 	uint16_t fecPercentage;
+	uint8_t frameType; // enum ALVR_VIDEO_FRAME_TYPE
+	// With ALVR_STREAM_FLAG_SLICED_FEC, frameByteSize and fecIndex are relative to the slice
+	// and FEC group is built per slice. Otherwise sliceIndex=0 and sliceCount=1.
+	uint8_t sliceIndex;
+	uint8_t sliceCount;
 	// char frameBuffer[];
 };
 struct AudioFrameStart {
@@ -298,6 +405,24 @@ struct AudioFrame {
 	uint32_t packetCounter;
 	// char frameBuffer[];
 };
+static const int ALVR_INTERLEAVED_FEC_FRAMES_MAX = 4;
+// Parity shards protecting data of multiple consecutive video frames.
+// Groups cover videoFrameIndex [k * interleavedFecDepth, (k + 1) * interleavedFecDepth - 1] and
+// parity packets of a group are sent after the last video packet of the group.
+// Data shards are frame buffers of each frame in order of videoFrameIndex,
+// split into ALVR_INTERLEAVED_FEC_SHARD_SIZE bytes and zero padded at the end of each frame.
+struct VideoInterleavedParity {
+	uint32_t type; // ALVR_PACKET_TYPE_VIDEO_INTERLEAVED_PARITY
+	uint32_t packetCounter; // Shared with VideoFrame
+	uint64_t startVideoFrameIndex;
+	// Needed to rebuild frames whose packets were all lost.
+	uint64_t trackingFrameIndex[ALVR_INTERLEAVED_FEC_FRAMES_MAX];
+	uint32_t frameByteSize[ALVR_INTERLEAVED_FEC_FRAMES_MAX];
+	uint8_t frameCount;
+	uint8_t parityShards;
+	uint8_t parityIndex;
+	// char parity[ALVR_INTERLEAVED_FEC_SHARD_SIZE];
+};
 // Acknowledgement for video frame arrival from client to server.
 struct VideoFrameAck {
 	uint32_t type; // ALVR_PACKET_TYPE_VIDEO_FRAME_ACK
@@ -306,6 +431,25 @@ struct VideoFrameAck {
 	// Used for reference frame invalidation.
 	uint64_t startFrame;
 	uint64_t endFrame;
+	// Parsed from slice header of endFrame on ACK. isReference=1 and others are zero on NACK
+	// or when the slice header could not be parsed.
+	uint8_t sliceType; // enum ALVR_SLICE_TYPE
+	uint8_t isReference;
+	// Frame has recovery point SEI. Decoder output is correct from recoveryFrameCount frames later.
+	uint8_t recoveryPoint;
+	int32_t recoveryFrameCount;
+	// frame_num (H.264) and pic_order_cnt_lsb of endFrame.
+	uint32_t frameNum;
+	int32_t pictureOrderCount;
+};
+// Slices which could not be recovered. Server re-encodes regions of lost slices
+// without referencing them.
+struct VideoSliceLoss {
+	uint32_t type; // ALVR_PACKET_TYPE_VIDEO_SLICE_LOSS
+	uint64_t videoFrameIndex;
+	uint8_t sliceCount;
+	// Bit n is set when slice n was lost.
+	uint64_t lostSlices;
 };
 // Send haptics feedback from server to client.
 struct HapticsFeedback {
@@ -316,11 +460,66 @@ struct HapticsFeedback {
 	float frequency;
 	uint8_t hand; // 0:Right, 1:Left
 };
+// Latency distribution of one stage over one window.
+// In microseconds. Percentiles are upper bounds of histogram buckets (at most 3% above).
+struct LatencyPercentiles {
+	uint32_t count;
+	uint32_t p50;
+	uint32_t p90;
+	uint32_t p99;
+	uint32_t p999;
+	uint32_t max;
+};
+// Send per-stage latency percentiles from client to server. Sent every second when
+// ALVR_STREAM_FLAG_LATENCY_REPORT is negotiated.
+struct LatencyReport {
+	uint32_t type; // ALVR_PACKET_TYPE_LATENCY_REPORT
+	uint64_t sequence;
+	// Valid entries of percentiles. Indexed by ALVR_LATENCY_STAGE.
+	uint8_t stageCount;
+	LatencyPercentiles percentiles[ALVR_LATENCY_REPORT_STAGE_MAX][ALVR_LATENCY_WINDOW_COUNT];
+	// Statistics events the client lost in each window. Percentiles of a window with losses miss
+	// samples and should not be compared as exact values.
+	uint64_t droppedEvents[ALVR_LATENCY_WINDOW_COUNT];
+};
+// Send FEC statistics and recommended FEC percentage from client to server. Sent every second.
+struct FecFeedback {
+	uint32_t type; // ALVR_PACKET_TYPE_FEC_FEEDBACK
+	// FEC percentage which achieves target residual frame loss rate with minimal parity.
+	uint16_t recommendedFecPercentage;
+	// fecPercentage of the last received video frame.
+	uint16_t currentFecPercentage;
+
+	// Following values are counted since previous feedback.
+	uint32_t frames;
+	uint32_t framesLost;
+	// Frames which could not be rebuilt without parity shards.
+	uint32_t framesRecovered;
+	uint32_t parityShardsReceived;
+	uint32_t parityShardsConsumed;
+	// Longest loss burst in single FEC column. (in shards)
+	uint32_t maxMissingShards;
+
+	// Recommendation for IDR frames. Same as recommendedFecPercentage
+	// unless ALVR_STREAM_FLAG_UNEQUAL_ERROR_PROTECTION is enabled.
+	uint16_t recommendedIdrFecPercentage;
+	uint32_t idrFrames;
+	uint32_t idrFramesLost;
+	uint32_t idrFramesRecovered;
+
+	// Frames lost as a whole or with a whole FEC column missing, which no FEC percentage could
+	// have recovered. Part of framesLost. They are a congestion signal and do not raise
+	// recommendedFecPercentage.
+	uint32_t burstFramesLost;
+};
 #pragma pack(pop)
 
 static const int ALVR_MAX_VIDEO_BUFFER_SIZE = ALVR_MAX_PACKET_SIZE - sizeof(VideoFrame);
+static const int ALVR_INTERLEAVED_FEC_SHARD_SIZE = ALVR_MAX_PACKET_SIZE - sizeof(VideoInterleavedParity);
 
 static const int ALVR_FEC_SHARDS_MAX = 20;
+// Number of slices which can be reported by VideoSliceLoss.
+static const int ALVR_SLICE_LOSS_REPORT_MAX = 64;
 
 inline int CalculateParityShards(int dataShards, int fecPercentage) {
 	int totalParityShards = (dataShards * fecPercentage + 99) / 100;
@@ -131,6 +131,7 @@ public class GvrRenderer implements GLSurfaceView.Renderer {
     public void onSurfaceCreated(GL10 gl, EGLConfig config) {
         // Called from GLThread
         Utils.logi(TAG, "onSurfaceCreated");
+        LatencyCollector.RegisterThread();
 
         initializeGlObjects();
 
@@ -15,6 +15,12 @@ import java.util.concurrent.TimeUnit;
 class OvrThread {
     private static final String TAG = "OvrThread";
 
+    // Intent extras to replay a packet capture before waiting for server. e.g.
+    // am start -n <applicationId>/com.polygraphene.alvr.OvrActivity
+    //     --es replayCapture <path> --ez replayRealtime false
+    private static final String EXTRA_REPLAY_CAPTURE = "replayCapture";
+    private static final String EXTRA_REPLAY_REALTIME = "replayRealtime";
+
     private Activity mActivity;
 
     private OvrContext mOvrContext = new OvrContext();
@@ -28,6 +34,8 @@ class OvrThread {
 
     // Worker threads
     private DecoderThread mDecoderThread;
+    // Used instead of mDecoderThread when DEBUG_FLAGS_ENABLE_NATIVE_DECODER is set.
+    private NativeDecoder mNativeDecoder;
     private UdpReceiverThread mReceiverThread;
     private LauncherSocket mLauncherSocket;
 
@@ -82,20 +90,37 @@ class OvrThread {
                 mReceiverThread.recoverConnectionState(connectionState.serverAddr, connectionState.serverPort);
             }
 
+            String replayCapture = mActivity.getIntent().getStringExtra(EXTRA_REPLAY_CAPTURE);
+            if (replayCapture != null) {
+                Utils.logi(TAG, () -> "Replay capture: " + replayCapture);
+                mReceiverThread.setReplayCapture(replayCapture,
+                        mActivity.getIntent().getBooleanExtra(EXTRA_REPLAY_REALTIME, true));
+            }
+
             // Sometimes previous decoder output remains not updated (when previous call of waitFrame() didn't call updateTexImage())
             // and onFrameAvailable won't be called after next output.
             // To avoid deadlock caused by it, we need to flush last output.
             mSurfaceTexture.updateTexImage();
 
-            mDecoderThread = new DecoderThread(mSurface, mActivity, mDecoderCallback);
+            if (NativeDecoder.isEnabled()) {
+                Utils.logi(TAG, () -> "Decoding on native MediaCodec.");
+                mNativeDecoder = new NativeDecoder(mSurface);
+                mDecoderThread = null;
+            } else {
+                mNativeDecoder = null;
+                mDecoderThread = new DecoderThread(mSurface, mActivity, mDecoderCallback);
+            }
 
             try {
-                mDecoderThread.start();
+                if (mDecoderThread != null) {
+                    mDecoderThread.start();
+                }
 
                 DeviceDescriptor deviceDescriptor = new DeviceDescriptor();
                 mOvrContext.getDeviceDescriptor(deviceDescriptor);
                 mRefreshRate = deviceDescriptor.mRefreshRates[0];
-                if (!mReceiverThread.start(mEGLContext, mActivity, deviceDescriptor, mOvrContext.getCameraTexture(), mDecoderThread)) {
+                if (!mReceiverThread.start(mEGLContext, mActivity, deviceDescriptor, mOvrContext.getCameraTexture(),
+                        mNativeDecoder != null ? mNativeDecoder : mDecoderThread)) {
                     Utils.loge(TAG, () -> "FATAL: Initialization of ReceiverThread failed.");
                     return;
                 }
@@ -122,6 +147,11 @@ class OvrThread {
                 Utils.log(TAG, () -> "OvrThread.onPause: Stopping DecoderThread.");
                 mDecoderThread.stopAndWait();
             }
+            if (mNativeDecoder != null) {
+                Utils.log(TAG, () -> "OvrThread.onPause: Releasing NativeDecoder.");
+                mNativeDecoder.release(mReceiverThread);
+                mDecoderPrepared = false;
+            }
             if (mReceiverThread != null) {
                 Utils.log(TAG, () -> "OvrThread.onPause: Stopping ReceiverThread.");
                 mReceiverThread.stopAndWait();
@@ -152,7 +182,11 @@ class OvrThread {
         mSurfaceTexture = new SurfaceTexture(mOvrContext.getSurfaceTextureID());
         mSurfaceTexture.setOnFrameAvailableListener(surfaceTexture -> {
             Utils.log(TAG, () -> "OvrThread: waitFrame: onFrameAvailable is called.");
-            mDecoderThread.onFrameAvailable();
+            if (mNativeDecoder != null) {
+                mNativeDecoder.onFrameAvailable();
+            } else {
+                mDecoderThread.onFrameAvailable();
+            }
             mHandler.removeCallbacks(mIdleRenderRunnable);
             mHandler.post(mRenderRunnable);
         }, new Handler(Looper.getMainLooper()));
@@ -177,7 +211,9 @@ class OvrThread {
                 mHandler.postDelayed(mRenderRunnable, next);
                 return;
             }
-            long renderedFrameIndex = mDecoderThread.clearAvailable(mSurfaceTexture);
+            long renderedFrameIndex = mNativeDecoder != null ?
+                    mNativeDecoder.clearAvailable(mSurfaceTexture) :
+                    mDecoderThread.clearAvailable(mSurfaceTexture);
             if (renderedFrameIndex != -1) {
                 mOvrContext.render(renderedFrameIndex);
                 mPreviousRender = System.nanoTime();
@@ -236,7 +272,13 @@ class OvrThread {
             mHandler.post(() -> {
                 mOvrContext.setRefreshRate(refreshRate);
                 mOvrContext.setFrameGeometry(width, height);
-                mDecoderThread.onConnect(codec, frameQueueSize);
+                if (mNativeDecoder != null) {
+                    // Native decoder has no thread, so it is prepared as soon as it is created.
+                    mDecoderPrepared = mNativeDecoder.onConnect(mReceiverThread, codec, width, height);
+                    mReceiverThread.setSinkPrepared(mVrMode && mDecoderPrepared);
+                } else {
+                    mDecoderThread.onConnect(codec, frameQueueSize);
+                }
             });
         }
 
@@ -253,7 +295,9 @@ class OvrThread {
 
         @Override
         public void onDisconnect() {
-            mDecoderThread.onDisconnect();
+            if (mDecoderThread != null) {
+                mDecoderThread.onDisconnect();
+            }
         }
 
         @Override
@@ -0,0 +1,100 @@
+#ifndef ALVRCLIENT_ANDROID_UTILS_H
+#define ALVRCLIENT_ANDROID_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <jni.h>
+#include <VrApi_Types.h>
+#include <GLES3/gl3.h>
+#include "utils.h"
+
+// Helpers for code which runs only on the headset. Helpers which the video pipeline also uses on
+// host are in utils.h.
+
+//
+// GL Logging
+//
+
+#define CHECK_GL_ERRORS 1
+#ifdef CHECK_GL_ERRORS
+
+static const char *GlErrorString(GLenum error) {
+    switch (error) {
+        case GL_NO_ERROR:
+            return "GL_NO_ERROR";
+        case GL_INVALID_ENUM:
+            return "GL_INVALID_ENUM";
+        case GL_INVALID_VALUE:
+            return "GL_INVALID_VALUE";
+        case GL_INVALID_OPERATION:
+            return "GL_INVALID_OPERATION";
+        case GL_INVALID_FRAMEBUFFER_OPERATION:
+            return "GL_INVALID_FRAMEBUFFER_OPERATION";
+        case GL_OUT_OF_MEMORY:
+            return "GL_OUT_OF_MEMORY";
+        default:
+            return "unknown";
+    }
+}
+
+static void GLCheckErrors(const char* file, int line) {
+    for (int i = 0; i < 10; i++) {
+        const GLenum error = glGetError();
+        if (error == GL_NO_ERROR) {
+            break;
+        }
+        LOGE("GL error on %s : %d: %s", file, line, GlErrorString(error));
+        abort();
+    }
+}
+
+#define GL(func)        func; GLCheckErrors(__FILE__, __LINE__ );
+#else // CHECK_GL_ERRORS
+#define GL(func)        func;
+#endif // CHECK_GL_ERRORS
+
+//
+// Utility
+//
+
+/// Integer version of ovrRectf
+typedef struct Recti_
+{
+    int x;
+    int y;
+    int width;
+    int height;
+} Recti;
+
+inline std::string GetStringFromJNIString(JNIEnv *env, jstring string){
+    const char *buf = env->GetStringUTFChars(string, 0);
+    std::string ret = buf;
+    env->ReleaseStringUTFChars(string, buf);
+
+    return ret;
+}
+
+inline std::string DumpMatrix(const ovrMatrix4f *matrix) {
+    char buf[1000];
+    sprintf(buf, "%.5f, %.5f, %.5f, %.5f\n"
+                    "%.5f, %.5f, %.5f, %.5f\n"
+                    "%.5f, %.5f, %.5f, %.5f\n"
+                    "%.5f, %.5f, %.5f, %.5f\n", matrix->M[0][0], matrix->M[0][1], matrix->M[0][2],
+            matrix->M[0][3], matrix->M[1][0], matrix->M[1][1], matrix->M[1][2], matrix->M[1][3],
+            matrix->M[2][0], matrix->M[2][1], matrix->M[2][2], matrix->M[2][3], matrix->M[3][0],
+            matrix->M[3][1], matrix->M[3][2], matrix->M[3][3]
+    );
+    return std::string(buf);
+}
+
+inline ovrQuatf quatMultipy(const ovrQuatf *a, const ovrQuatf *b){
+    ovrQuatf dest;
+    dest.x = a->x * b->w + a->w * b->x + a->y * b->z - a->z * b->y;
+    dest.y = a->y * b->w + a->w * b->y + a->z * b->x - a->x * b->z;
+    dest.z = a->z * b->w + a->w * b->z + a->x * b->y - a->y * b->x;
+    dest.w = a->w * b->w - a->x * b->x - a->y * b->y - a->z * b->z;
+    return dest;
+}
+
+#endif //ALVRCLIENT_ANDROID_UTILS_H
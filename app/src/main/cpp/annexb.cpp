@@ -0,0 +1,269 @@
+/// Annex-B byte stream scanner
+// Start code is "00 00 01" or "00 00 00 01". Emulation prevention guarantees that "00 00" followed
+// by 00, 01 or 02 never appears inside NAL unit, so every "00 00 01" is a start code.
+// AV1 has no start code. Each OBU has obu_size field in low overhead bitstream format.
+////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include "annexb.h"
+#include "packet_types.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const int H264_NAL_TYPE_IDR = 5;
+static const int H264_NAL_TYPE_SPS = 7;
+static const int H264_NAL_TYPE_PPS = 8;
+
+static const int H265_NAL_TYPE_IDR_W_RADL = 19;
+static const int H265_NAL_TYPE_IDR_N_LP = 20;
+static const int H265_NAL_TYPE_VPS = 32;
+static const int H265_NAL_TYPE_PPS = 34;
+
+static const int AV1_OBU_SEQUENCE_HEADER = 1;
+static const int AV1_OBU_TEMPORAL_DELIMITER = 2;
+static const int AV1_OBU_FRAME_HEADER = 3;
+static const int AV1_OBU_FRAME = 6;
+static const int AV1_OBU_PADDING = 15;
+
+static const int AV1_FRAME_TYPE_KEY_FRAME = 0;
+
+const uint8_t *findZeroPairScalar(const uint8_t *p, const uint8_t *end) {
+    for (; p + 1 < end; p++) {
+        if (p[1] != 0) {
+            // Neither p nor p + 1 can start a pair.
+            p++;
+        } else if (p[0] == 0) {
+            return p;
+        }
+    }
+    return end;
+}
+
+const uint8_t *findZeroPair(const uint8_t *p, const uint8_t *end) {
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    // 17 bytes are read for each 16 candidates.
+    while (p + 17 <= end) {
+        uint8x16_t zero = vandq_u8(vceqq_u8(vld1q_u8(p), vdupq_n_u8(0)),
+                                   vceqq_u8(vld1q_u8(p + 1), vdupq_n_u8(0)));
+        uint64x2_t lanes = vreinterpretq_u64_u8(zero);
+        if ((vgetq_lane_u64(lanes, 0) | vgetq_lane_u64(lanes, 1)) != 0) {
+            return findZeroPairScalar(p, p + 17);
+        }
+        p += 16;
+    }
+#elif defined(__SSE2__)
+    while (p + 17 <= end) {
+        __m128i zero = _mm_setzero_si128();
+        __m128i pair = _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), zero),
+                _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1)), zero));
+        int mask = _mm_movemask_epi8(pair);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    return findZeroPairScalar(p, end);
+}
+
+// Read leb128() of AV1. Returns false if it runs past end or exceeds 32 bits.
+static bool readLeb128(const uint8_t *data, int size, int *position, uint32_t *value) {
+    uint64_t result = 0;
+    for (int i = 0; i < 8; i++) {
+        if (*position >= size) {
+            return false;
+        }
+        uint8_t byte = data[(*position)++];
+        result |= static_cast<uint64_t>(byte & 0x7F) << (i * 7);
+        if (!(byte & 0x80)) {
+            if (result > UINT32_MAX) {
+                return false;
+            }
+            *value = static_cast<uint32_t>(result);
+            return true;
+        }
+    }
+    return false;
+}
+
+void AnnexBScanner::setCodec(int codec) {
+    if (m_codec != codec) {
+        m_reducedStillPictureHeader = false;
+    }
+    m_codec = codec;
+}
+
+int AnnexBScanner::scan(const char *frameBuffer, int frameByteSize) {
+    m_nals.clear();
+
+    if (m_codec == ALVR_CODEC_AV1) {
+        return scanOBUs(reinterpret_cast<const uint8_t *>(frameBuffer), frameByteSize);
+    }
+
+    const uint8_t *begin = reinterpret_cast<const uint8_t *>(frameBuffer);
+    const uint8_t *end = begin + frameByteSize;
+    // Zeroes before start code are not taken back beyond NAL header of previous NAL.
+    const uint8_t *searchStart = begin;
+    const uint8_t *p = begin;
+    while (true) {
+        p = findZeroPair(p, end);
+        if (end - p < 3) {
+            break;
+        }
+        if (p[2] > 1) {
+            // Next pair starts after p[2] at least.
+            p += 3;
+            continue;
+        }
+        if (p[2] == 0) {
+            p++;
+            continue;
+        }
+        // Start code. Zeroes before it are leading zero of 4 bytes start code or trailing zero of
+        // previous NAL.
+        const uint8_t *start = p;
+        while (start > searchStart && start[-1] == 0) {
+            start--;
+        }
+        if (!m_nals.empty()) {
+            NALUnit &prev = m_nals.back();
+            prev.length = static_cast<int>(start - begin) - prev.offset;
+        }
+        p += 3;
+        if (p >= end) {
+            break;
+        }
+        NALUnit nal;
+        nal.start = static_cast<int>(start - begin);
+        nal.offset = static_cast<int>(p - begin);
+        nal.length = static_cast<int>(end - p);
+        if (m_codec == ALVR_CODEC_H264) {
+            nal.type = p[0] & 0x1F;
+        } else {
+            nal.type = (p[0] >> 1) & 0x3F;
+        }
+        m_nals.push_back(nal);
+        searchStart = ++p;
+    }
+    return static_cast<int>(m_nals.size());
+}
+
+int AnnexBScanner::scanOBUs(const uint8_t *data, int size) {
+    m_keyFrame = false;
+    bool frameHeaderFound = false;
+    int position = 0;
+    while (position < size) {
+        int start = position;
+        uint8_t header = data[position++];
+        if (header & 0x80) {
+            // obu_forbidden_bit
+            break;
+        }
+        int type = (header >> 3) & 0xF;
+        bool hasExtension = (header & 0x04) != 0;
+        bool hasSizeField = (header & 0x02) != 0;
+        if (hasExtension) {
+            position++;
+        }
+        uint32_t payloadSize;
+        if (hasSizeField) {
+            if (!readLeb128(data, size, &position, &payloadSize)) {
+                break;
+            }
+        } else {
+            // Last OBU of the frame may omit obu_size.
+            payloadSize = static_cast<uint32_t>(std::max(size - position, 0));
+        }
+        if (position > size || payloadSize > static_cast<uint32_t>(size - position)) {
+            break;
+        }
+        const uint8_t *payload = data + position;
+        position += payloadSize;
+
+        if (type == AV1_OBU_TEMPORAL_DELIMITER || type == AV1_OBU_PADDING) {
+            continue;
+        }
+        NALUnit nal;
+        nal.start = start;
+        nal.offset = start;
+        nal.length = position - start;
+        nal.type = type;
+        m_nals.push_back(nal);
+
+        if (type == AV1_OBU_SEQUENCE_HEADER && payloadSize > 0) {
+            // seq_profile(3) still_picture(1) reduced_still_picture_header(1)
+            m_reducedStillPictureHeader = (payload[0] & 0x08) != 0;
+        } else if ((type == AV1_OBU_FRAME || type == AV1_OBU_FRAME_HEADER) && !frameHeaderFound &&
+                   payloadSize > 0) {
+            frameHeaderFound = true;
+            if (m_reducedStillPictureHeader) {
+                m_keyFrame = true;
+            } else {
+                // show_existing_frame(1) frame_type(2)
+                bool showExistingFrame = (payload[0] & 0x80) != 0;
+                m_keyFrame = !showExistingFrame &&
+                             ((payload[0] >> 5) & 3) == AV1_FRAME_TYPE_KEY_FRAME;
+            }
+        }
+    }
+    return static_cast<int>(m_nals.size());
+}
+
+int AnnexBScanner::getConfigLength() const {
+    if (m_nals.empty() || !isParameterSet(m_nals[0].type)) {
+        return 0;
+    }
+    for (const NALUnit &nal : m_nals) {
+        if (!isParameterSet(nal.type)) {
+            return nal.start;
+        }
+    }
+    return -1;
+}
+
+bool AnnexBScanner::hasParameterSet() const {
+    for (const NALUnit &nal : m_nals) {
+        if (isParameterSet(nal.type)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t AnnexBScanner::getFrameType() const {
+    if (m_codec == ALVR_CODEC_AV1) {
+        return m_keyFrame ? ALVR_VIDEO_FRAME_TYPE_IDR : ALVR_VIDEO_FRAME_TYPE_P;
+    }
+    for (const NALUnit &nal : m_nals) {
+        if (isIDR(nal.type)) {
+            return ALVR_VIDEO_FRAME_TYPE_IDR;
+        }
+    }
+    return ALVR_VIDEO_FRAME_TYPE_P;
+}
+
+bool AnnexBScanner::isParameterSet(int type) const {
+    if (m_codec == ALVR_CODEC_H264) {
+        return type == H264_NAL_TYPE_SPS || type == H264_NAL_TYPE_PPS;
+    }
+    if (m_codec == ALVR_CODEC_AV1) {
+        return type == AV1_OBU_SEQUENCE_HEADER;
+    }
+    return type >= H265_NAL_TYPE_VPS && type <= H265_NAL_TYPE_PPS;
+}
+
+bool AnnexBScanner::isIDR(int type) const {
+    if (m_codec == ALVR_CODEC_H264) {
+        return type == H264_NAL_TYPE_IDR;
+    }
+    if (m_codec == ALVR_CODEC_AV1) {
+        // Key frame is told by frame header, not by obu_type.
+        return false;
+    }
+    return type == H265_NAL_TYPE_IDR_W_RADL || type == H265_NAL_TYPE_IDR_N_LP;
+}
@@ -0,0 +1,59 @@
+#ifndef ALVRCLIENT_ANNEXB_H
+#define ALVRCLIENT_ANNEXB_H
+
+#include <stdint.h>
+#include <vector>
+
+// NAL unit in Annex-B byte stream, or OBU of AV1 stream.
+struct NALUnit {
+    // Position of start code. Leading zero of 4 bytes start code is included.
+    // Same as offset on AV1.
+    int start;
+    // Position of NAL (OBU) header.
+    int offset;
+    // Bytes from NAL header to next start code. Whole OBU on AV1.
+    int length;
+    // nal_unit_type, or obu_type on AV1.
+    int type;
+};
+
+// Index NAL units of a frame in one pass. Start codes are searched by SIMD zero byte comparison.
+// On AV1, OBU headers are walked by obu_size instead. Sequence header is taken as parameter set
+// and key frame as IDR. Temporal delimiters and padding are not indexed.
+class AnnexBScanner {
+public:
+    void setCodec(int codec);
+
+    // Returns number of NAL units found. Index is kept until next scan.
+    int scan(const char *frameBuffer, int frameByteSize);
+
+    const std::vector<NALUnit> &getNALs() const {
+        return m_nals;
+    }
+    // Length of leading (VPS + )SPS + PPS. 0 if frame does not start with parameter sets and
+    // -1 if frame has only parameter sets.
+    int getConfigLength() const;
+    bool hasParameterSet() const;
+    // ALVR_VIDEO_FRAME_TYPE_IDR if frame contains IDR slice. ALVR_VIDEO_FRAME_TYPE_P otherwise.
+    uint8_t getFrameType() const;
+
+    bool isParameterSet(int type) const;
+    bool isIDR(int type) const;
+private:
+    int scanOBUs(const uint8_t *data, int size);
+
+    int m_codec = 1;
+    std::vector<NALUnit> m_nals;
+
+    // AV1 frame header of the scanned frame has frame_type KEY_FRAME.
+    bool m_keyFrame = false;
+    // reduced_still_picture_header of last AV1 sequence header. Every frame is a key frame.
+    bool m_reducedStillPictureHeader = false;
+};
+
+// Find first "00 00" in [begin, end). Returns end if not found.
+const uint8_t *findZeroPair(const uint8_t *begin, const uint8_t *end);
+// Same without SIMD. findZeroPair falls back to it for the tail of the buffer.
+const uint8_t *findZeroPairScalar(const uint8_t *begin, const uint8_t *end);
+
+#endif //ALVRCLIENT_ANNEXB_H
@@ -0,0 +1,257 @@
+/// Asynchronous logging
+// Per-thread rings of formatted lines written to logcat by one writer thread.
+////////////////////////////////////////////////////////////////////
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include "async_log.h"
+
+namespace {
+    uint64_t getCurrentSecond() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+        return static_cast<uint64_t>(ts.tv_sec);
+    }
+}
+
+// Lines of one thread. Owner thread is the only producer and the writer (under m_writeMutex) is
+// the only consumer.
+struct AsyncLogger::Shard {
+    // Power of 2.
+    static const uint32_t CAPACITY = 128;
+
+    Line lines[CAPACITY];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<bool> owned;
+    Shard *next;
+};
+
+// Releases the shard on thread exit. Remaining lines are still written.
+struct AsyncLogger::ShardOwner {
+    Shard *shard = nullptr;
+
+    ~ShardOwner() {
+        if (shard != nullptr) {
+            shard->owned.store(false, std::memory_order_release);
+        }
+    }
+};
+
+AsyncLogger AsyncLogger::m_Instance;
+thread_local AsyncLogger::ShardOwner AsyncLogger::m_shardOwner;
+
+LogRateLimiter::LogRateLimiter(int priority, const char *tag, const char *file, int line,
+                               uint32_t perSecond)
+        : m_priority(priority), m_tag(tag), m_file(file), m_line(line), m_perSecond(perSecond),
+          m_second(0), m_count(0), m_suppressed(0) {
+}
+
+bool LogRateLimiter::allow() {
+    uint64_t current = getCurrentSecond();
+    uint64_t second = m_second.load(std::memory_order_relaxed);
+    if (second != current &&
+        m_second.compare_exchange_strong(second, current, std::memory_order_relaxed)) {
+        m_count.store(0, std::memory_order_relaxed);
+        uint32_t suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+        if (suppressed > 0) {
+            AsyncLogger::Instance().log(m_priority, m_tag, "Suppressed %u lines. %s:%d",
+                                        suppressed, m_file, m_line);
+        }
+    }
+    if (m_count.fetch_add(1, std::memory_order_relaxed) < m_perSecond) {
+        return true;
+    }
+    m_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+AsyncLogger::AsyncLogger() : m_shards(nullptr), m_sequence(0), m_dropped(0), m_running(false),
+                             m_stopRequested(false), m_writerWaiting(false) {
+    pthread_mutex_init(&m_waitMutex, nullptr);
+    pthread_cond_init(&m_writerCond, nullptr);
+    pthread_mutex_init(&m_writeMutex, nullptr);
+}
+
+AsyncLogger::~AsyncLogger() {
+    if (m_running.load(std::memory_order_acquire)) {
+        pthread_mutex_lock(&m_waitMutex);
+        m_stopRequested.store(true, std::memory_order_release);
+        pthread_cond_signal(&m_writerCond);
+        pthread_mutex_unlock(&m_waitMutex);
+        pthread_join(m_writer, nullptr);
+        m_running.store(false, std::memory_order_release);
+    }
+    write();
+    pthread_mutex_destroy(&m_writeMutex);
+    pthread_cond_destroy(&m_writerCond);
+    pthread_mutex_destroy(&m_waitMutex);
+}
+
+AsyncLogger &AsyncLogger::Instance() {
+    return m_Instance;
+}
+
+void AsyncLogger::start() {
+    pthread_mutex_lock(&m_waitMutex);
+    if (!m_running.load(std::memory_order_relaxed) &&
+        pthread_create(&m_writer, nullptr, writerThread, this) == 0) {
+        m_running.store(true, std::memory_order_release);
+    }
+    pthread_mutex_unlock(&m_waitMutex);
+}
+
+AsyncLogger::Shard *AsyncLogger::getShard() {
+    if (m_shardOwner.shard != nullptr) {
+        return m_shardOwner.shard;
+    }
+    for (Shard *shard = m_shards.load(std::memory_order_acquire); shard != nullptr;
+         shard = shard->next) {
+        bool owned = false;
+        if (shard->owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) {
+            m_shardOwner.shard = shard;
+            return shard;
+        }
+    }
+    Shard *shard = new Shard();
+    shard->head.store(0, std::memory_order_relaxed);
+    shard->tail.store(0, std::memory_order_relaxed);
+    shard->owned.store(true, std::memory_order_relaxed);
+    shard->next = m_shards.load(std::memory_order_relaxed);
+    while (!m_shards.compare_exchange_weak(shard->next, shard, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+    }
+    m_shardOwner.shard = shard;
+    return shard;
+}
+
+void AsyncLogger::log(int priority, const char *tag, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    if (!m_running.load(std::memory_order_acquire)) {
+        char message[sizeof(Line::message)];
+        vsnprintf(message, sizeof(message), format, args);
+        va_end(args);
+        writeLine(priority, tag, message);
+        return;
+    }
+
+    Shard *shard = getShard();
+    uint32_t head = shard->head.load(std::memory_order_relaxed);
+    if (head - shard->tail.load(std::memory_order_acquire) >= Shard::CAPACITY) {
+        va_end(args);
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Line &line = shard->lines[head & (Shard::CAPACITY - 1)];
+    vsnprintf(line.message, sizeof(line.message), format, args);
+    va_end(args);
+    line.priority = priority;
+    line.tag = tag;
+    line.sequence = m_sequence.fetch_add(1, std::memory_order_relaxed);
+    shard->head.store(head + 1, std::memory_order_release);
+
+    // Pairs with the fence in writerLoop. Either the writer sees the line before it waits, or
+    // this sees the writer waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_writerWaiting.load(std::memory_order_relaxed)) {
+        pthread_mutex_lock(&m_waitMutex);
+        pthread_cond_signal(&m_writerCond);
+        pthread_mutex_unlock(&m_waitMutex);
+    }
+}
+
+void AsyncLogger::flush() {
+    write();
+}
+
+uint64_t AsyncLogger::getDroppedLines() {
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+void AsyncLogger::writeLine(int priority, const char *tag, const char *message) {
+#ifdef __ANDROID__
+    __android_log_write(priority, tag, message);
+#else
+    static const char PRIORITY_CHARS[] = "??VDIWEFS";
+    fprintf(stderr, "%c/%s: %s\n",
+            priority >= 0 && priority < static_cast<int>(sizeof(PRIORITY_CHARS)) - 1 ?
+            PRIORITY_CHARS[priority] : '?', tag, message);
+#endif
+}
+
+bool AsyncLogger::hasPendingLines() {
+    for (Shard *shard = m_shards.load(std::memory_order_acquire); shard != nullptr;
+         shard = shard->next) {
+        if (shard->head.load(std::memory_order_relaxed) !=
+            shard->tail.load(std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Lines of all threads are written in the order they were logged.
+void AsyncLogger::write() {
+    pthread_mutex_lock(&m_writeMutex);
+    std::vector<const Line *> lines;
+    std::vector<std::pair<Shard *, uint32_t>> heads;
+    for (Shard *shard = m_shards.load(std::memory_order_acquire); shard != nullptr;
+         shard = shard->next) {
+        uint32_t tail = shard->tail.load(std::memory_order_relaxed);
+        uint32_t head = shard->head.load(std::memory_order_acquire);
+        for (uint32_t i = tail; i != head; i++) {
+            lines.push_back(&shard->lines[i & (Shard::CAPACITY - 1)]);
+        }
+        heads.emplace_back(shard, head);
+    }
+    std::sort(lines.begin(), lines.end(), [](const Line *a, const Line *b) {
+        return a->sequence < b->sequence;
+    });
+    for (const Line *line : lines) {
+        writeLine(line->priority, line->tag, line->message);
+    }
+    for (auto &head : heads) {
+        head.first->tail.store(head.second, std::memory_order_release);
+    }
+    pthread_mutex_unlock(&m_writeMutex);
+}
+
+void *AsyncLogger::writerThread(void *arg) {
+    pthread_setname_np(pthread_self(), "AsyncLog");
+    static_cast<AsyncLogger *>(arg)->writerLoop();
+    return nullptr;
+}
+
+void AsyncLogger::writerLoop() {
+    uint64_t dropped = 0;
+    while (true) {
+        pthread_mutex_lock(&m_waitMutex);
+        m_writerWaiting.store(true, std::memory_order_relaxed);
+        // Pairs with the fence in log().
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!m_stopRequested.load(std::memory_order_relaxed) && !hasPendingLines()) {
+            pthread_cond_wait(&m_writerCond, &m_waitMutex);
+        }
+        m_writerWaiting.store(false, std::memory_order_relaxed);
+        bool stop = m_stopRequested.load(std::memory_order_relaxed);
+        pthread_mutex_unlock(&m_waitMutex);
+        if (stop) {
+            break;
+        }
+        write();
+
+        uint64_t current = m_dropped.load(std::memory_order_relaxed);
+        if (current != dropped) {
+            char message[64];
+            snprintf(message, sizeof(message), "Dropped %llu log lines.",
+                     (unsigned long long) (current - dropped));
+            writeLine(ANDROID_LOG_WARN, "ALVR Native", message);
+            dropped = current;
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef ALVRCLIENT_ASYNC_LOG_H
+#define ALVRCLIENT_ASYNC_LOG_H
+
+#include <stdint.h>
+#include <atomic>
+#include <pthread.h>
+#ifdef __ANDROID__
+#include <android/log.h>
+#else
+// Same values as android_LogPriority, so that the video pipeline builds on host.
+enum android_LogPriority {
+    ANDROID_LOG_UNKNOWN = 0,
+    ANDROID_LOG_DEFAULT,
+    ANDROID_LOG_VERBOSE,
+    ANDROID_LOG_DEBUG,
+    ANDROID_LOG_INFO,
+    ANDROID_LOG_WARN,
+    ANDROID_LOG_ERROR,
+    ANDROID_LOG_FATAL,
+    ANDROID_LOG_SILENT,
+};
+#endif
+
+// Log levels below this are removed at compile time. Release builds can pass
+// -DALVR_LOG_MIN_LEVEL=ANDROID_LOG_INFO to drop verbose logs from the binary.
+#ifndef ALVR_LOG_MIN_LEVEL
+#define ALVR_LOG_MIN_LEVEL ANDROID_LOG_VERBOSE
+#endif
+
+// Limits output of one call site to a number of lines per second. Lines over the limit are
+// counted, and the count is queued as a line of its own by the first call after the second has
+// passed.
+class LogRateLimiter {
+public:
+    LogRateLimiter(int priority, const char *tag, const char *file, int line, uint32_t perSecond);
+
+    bool allow();
+private:
+    int m_priority;
+    const char *m_tag;
+    const char *m_file;
+    int m_line;
+    uint32_t m_perSecond;
+    std::atomic<uint64_t> m_second;
+    std::atomic<uint32_t> m_count;
+    std::atomic<uint32_t> m_suppressed;
+};
+
+// Log lines are formatted on the calling thread into a ring of that thread and written to logcat
+// by a background thread, so callers never wait for logd. If the ring of a thread is full, the
+// line is dropped and counted. On host, lines are written to stderr.
+class AsyncLogger {
+public:
+    static AsyncLogger &Instance();
+
+    // Start the writer thread. Lines are written synchronously until this is called.
+    void start();
+
+    void log(int priority, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+    // Write all lines queued so far. Called before the process may die.
+    void flush();
+    // Write one line synchronously, bypassing the rings.
+    static void writeLine(int priority, const char *tag, const char *message);
+
+    uint64_t getDroppedLines();
+private:
+    AsyncLogger();
+    ~AsyncLogger();
+
+    struct Line {
+        // Global order of lines among threads.
+        uint64_t sequence;
+        int priority;
+        const char *tag;
+        char message[256];
+    };
+    // Defined in async_log.cpp.
+    struct Shard;
+    struct ShardOwner;
+
+    Shard *getShard();
+    bool hasPendingLines();
+    void write();
+    static void *writerThread(void *arg);
+    void writerLoop();
+
+    static AsyncLogger m_Instance;
+    static thread_local ShardOwner m_shardOwner;
+
+    std::atomic<Shard *> m_shards;
+    std::atomic<uint64_t> m_sequence;
+    std::atomic<uint64_t> m_dropped;
+    // Lines are written synchronously before the writer starts and after it stops.
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_stopRequested;
+    // Set while the writer waits on m_writerCond, so producers take m_waitMutex to signal only
+    // when the writer is idle.
+    std::atomic<bool> m_writerWaiting;
+    pthread_mutex_t m_waitMutex;
+    pthread_cond_t m_writerCond;
+    pthread_mutex_t m_writeMutex;
+    pthread_t m_writer;
+};
+
+#define ALVR_LOG(priority, tag, runtimeLevel, ...) do { \
+        if ((priority) >= ALVR_LOG_MIN_LEVEL && (runtimeLevel) <= (priority)) { \
+            AsyncLogger::Instance().log(priority, tag, __VA_ARGS__); \
+        } \
+    } while (0)
+
+// At most perSecond lines per second from this call site.
+#define ALVR_LOG_LIMITED(priority, tag, runtimeLevel, perSecond, ...) do { \
+        if ((priority) >= ALVR_LOG_MIN_LEVEL && (runtimeLevel) <= (priority)) { \
+            static LogRateLimiter alvrLogLimiter(priority, tag, __FILE__, __LINE__, perSecond); \
+            if (alvrLogLimiter.allow()) { \
+                AsyncLogger::Instance().log(priority, tag, __VA_ARGS__); \
+            } \
+        } \
+    } while (0)
+
+#endif //ALVRCLIENT_ASYNC_LOG_H
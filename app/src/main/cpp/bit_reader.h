@@ -0,0 +1,97 @@
+#ifndef ALVRCLIENT_BIT_READER_H
+#define ALVRCLIENT_BIT_READER_H
+
+#include <stdint.h>
+
+// MSB first bit reader for H.264/H.265 RBSP. Emulation prevention bytes (00 00 03) are skipped
+// while reading, so NAL unit payload can be read in place.
+// Reading past the end returns zero bits and sets error flag.
+class BitReader {
+public:
+    BitReader(const uint8_t *data, int length, bool emulationPrevention = true)
+            : m_data(data), m_length(length), m_emulationPrevention(emulationPrevention) {
+    }
+
+    uint32_t readBit() {
+        if (m_bit == 0) {
+            if (!nextByte()) {
+                m_error = true;
+                return 0;
+            }
+        }
+        m_bit--;
+        return (m_current >> m_bit) & 1;
+    }
+
+    uint32_t readBits(int n) {
+        uint32_t value = 0;
+        for (int i = 0; i < n; i++) {
+            value = (value << 1) | readBit();
+        }
+        return value;
+    }
+
+    void skipBits(int n) {
+        for (int i = 0; i < n; i++) {
+            readBit();
+        }
+    }
+
+    // ue(v)
+    uint32_t readUE() {
+        int leadingZeros = 0;
+        while (readBit() == 0) {
+            if (m_error || ++leadingZeros > 31) {
+                m_error = true;
+                return 0;
+            }
+        }
+        return ((1u << leadingZeros) - 1) + readBits(leadingZeros);
+    }
+
+    // se(v)
+    int32_t readSE() {
+        uint32_t value = readUE();
+        if (value & 1) {
+            return static_cast<int32_t>((value + 1) / 2);
+        }
+        return -static_cast<int32_t>(value / 2);
+    }
+
+    bool hasError() const {
+        return m_error;
+    }
+    // More payload remains before rbsp trailing bits.
+    bool hasMoreData() const {
+        return !m_error && (m_position < m_length || m_bit > 0);
+    }
+private:
+    bool nextByte() {
+        if (m_position >= m_length) {
+            return false;
+        }
+        uint8_t byte = m_data[m_position++];
+        if (m_emulationPrevention && m_zeros >= 2 && byte == 3) {
+            m_zeros = 0;
+            if (m_position >= m_length) {
+                return false;
+            }
+            byte = m_data[m_position++];
+        }
+        m_zeros = byte == 0 ? m_zeros + 1 : 0;
+        m_current = byte;
+        m_bit = 8;
+        return true;
+    }
+
+    const uint8_t *m_data;
+    int m_length;
+    bool m_emulationPrevention;
+    int m_position = 0;
+    int m_zeros = 0;
+    uint8_t m_current = 0;
+    int m_bit = 0;
+    bool m_error = false;
+};
+
+#endif //ALVRCLIENT_BIT_READER_H
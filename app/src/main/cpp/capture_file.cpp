@@ -0,0 +1,276 @@
+/// Capture file
+// Memory mapped recorder of datagrams or elementary stream, and its reader.
+////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "capture_file.h"
+#include "utils.h"
+#include "exception.h"
+
+static const uint32_t CAPTURE_FILE_MAGIC = 0x50434C41; // "ALCP"
+static const uint32_t CAPTURE_RECORD_MAGIC = 0x43455241; // "AREC"
+static const uint32_t CAPTURE_TRAILER_MAGIC = 0x58444E49; // "INDX"
+static const uint32_t CAPTURE_FILE_VERSION = 1;
+
+// File is extended and mapped by this size.
+static const uint64_t CAPTURE_WINDOW_SIZE = 8 * 1024 * 1024;
+
+static uint64_t alignRecord(uint64_t length) {
+    return (length + 7) & ~static_cast<uint64_t>(7);
+}
+
+CaptureWriter::CaptureWriter(const std::string &path, uint32_t kind)
+        : m_path(path) {
+    m_fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        throw FormatException("Failed to create capture file. path=%s errno=%d %s", path.c_str(),
+                              errno, strerror(errno));
+    }
+    m_startTime = getTimestampUs();
+
+    CaptureFileHeader header = {};
+    header.magic = CAPTURE_FILE_MAGIC;
+    header.version = CAPTURE_FILE_VERSION;
+    header.kind = kind;
+    header.protocolVersion = ALVR_PROTOCOL_VERSION;
+    header.startTime = m_startTime;
+    if (!reserve(sizeof(header))) {
+        close(m_fd);
+        throw FormatException("Failed to map capture file. path=%s", path.c_str());
+    }
+    memcpy(m_window + (m_position - m_windowOffset), &header, sizeof(header));
+    m_position += sizeof(header);
+    LOGI("Capture started. path=%s kind=%d", path.c_str(), kind);
+}
+
+CaptureWriter::~CaptureWriter() {
+    unmap();
+
+    CaptureFileTrailer trailer = {};
+    trailer.indexOffset = m_position;
+    trailer.indexCount = m_index.size();
+    trailer.magic = CAPTURE_TRAILER_MAGIC;
+
+    size_t indexSize = m_index.size() * sizeof(CaptureIndexEntry);
+    bool written = pwrite(m_fd, m_index.data(), indexSize, m_position) ==
+                   static_cast<ssize_t>(indexSize) &&
+                   pwrite(m_fd, &trailer, sizeof(trailer), m_position + indexSize) ==
+                   static_cast<ssize_t>(sizeof(trailer));
+    // Unused tail of the last window.
+    ftruncate(m_fd, m_position + (written ? indexSize + sizeof(trailer) : 0));
+    close(m_fd);
+
+    LOGI("Capture finished. path=%s size=%llu frames=%zu failed=%d", m_path.c_str(),
+         (unsigned long long) m_position, m_index.size(), m_failed);
+}
+
+void CaptureWriter::writeConnection(const ConnectionMessage &connectionMessage) {
+    write(CAPTURE_RECORD_CONNECTION, UINT64_MAX, 0, 0,
+          reinterpret_cast<const char *>(&connectionMessage), sizeof(connectionMessage));
+}
+
+void CaptureWriter::writePacket(const char *packet, int length) {
+    uint64_t frameIndex = UINT64_MAX;
+    if (length >= static_cast<int>(sizeof(VideoFrame)) &&
+        *reinterpret_cast<const uint32_t *>(packet) == ALVR_PACKET_TYPE_VIDEO_FRAME) {
+        frameIndex = reinterpret_cast<const VideoFrame *>(packet)->videoFrameIndex;
+    }
+    write(CAPTURE_RECORD_PACKET, frameIndex, 0, 0, packet, length);
+}
+
+void CaptureWriter::writeFrame(const char *data, int length, int configLength,
+                               uint64_t frameIndex, uint8_t frameType, bool partial) {
+    uint32_t flags = frameType | (partial ? CAPTURE_FRAME_FLAG_PARTIAL : 0);
+    write(CAPTURE_RECORD_FRAME, frameIndex, flags, static_cast<uint32_t>(configLength), data,
+          length);
+}
+
+void CaptureWriter::writeEndOfFrame(uint64_t frameIndex) {
+    write(CAPTURE_RECORD_FRAME, frameIndex, CAPTURE_FRAME_FLAG_END_OF_FRAME, 0, nullptr, 0);
+}
+
+void CaptureWriter::write(uint16_t type, uint64_t frameIndex, uint32_t flags,
+                          uint32_t configLength, const char *data, int length) {
+    uint64_t recordSize = sizeof(CaptureRecordHeader) + alignRecord(static_cast<uint64_t>(length));
+    if (m_failed || !reserve(recordSize)) {
+        return;
+    }
+
+    // UINT64_MAX is not a frame (e.g. audio packet or parameter sets alone).
+    if (frameIndex != UINT64_MAX && frameIndex != m_lastFrameIndex) {
+        m_index.push_back({frameIndex, m_position});
+        m_lastFrameIndex = frameIndex;
+    }
+
+    CaptureRecordHeader header = {};
+    header.magic = CAPTURE_RECORD_MAGIC;
+    header.type = type;
+    header.timestamp = getTimestampUs() - m_startTime;
+    header.frameIndex = frameIndex;
+    header.flags = flags;
+    header.configLength = configLength;
+    header.length = static_cast<uint32_t>(length);
+
+    char *p = m_window + (m_position - m_windowOffset);
+    memcpy(p, &header, sizeof(header));
+    if (length > 0) {
+        // Padding is already zero because the file is extended by ftruncate.
+        memcpy(p + sizeof(header), data, static_cast<size_t>(length));
+    }
+    m_position += recordSize;
+}
+
+bool CaptureWriter::reserve(uint64_t length) {
+    if (m_window != nullptr && m_position + length <= m_windowOffset + m_windowSize) {
+        return true;
+    }
+    unmap();
+
+    uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    m_windowOffset = m_position & ~(pageSize - 1);
+    m_windowSize = CAPTURE_WINDOW_SIZE;
+    while (m_windowOffset + m_windowSize < m_position + length) {
+        m_windowSize += CAPTURE_WINDOW_SIZE;
+    }
+    if (m_fileSize < m_windowOffset + m_windowSize) {
+        if (ftruncate(m_fd, m_windowOffset + m_windowSize) != 0) {
+            LOGE("Failed to extend capture file. Recording is stopped. errno=%d %s", errno,
+                 strerror(errno));
+            m_failed = true;
+            return false;
+        }
+        m_fileSize = m_windowOffset + m_windowSize;
+    }
+    void *window = mmap(nullptr, m_windowSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd,
+                        m_windowOffset);
+    if (window == MAP_FAILED) {
+        LOGE("Failed to map capture file. Recording is stopped. errno=%d %s", errno,
+             strerror(errno));
+        m_failed = true;
+        return false;
+    }
+    m_window = static_cast<char *>(window);
+    return true;
+}
+
+void CaptureWriter::unmap() {
+    if (m_window != nullptr) {
+        munmap(m_window, m_windowSize);
+        m_window = nullptr;
+    }
+}
+
+CaptureReader::CaptureReader(const std::string &path) {
+    m_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (m_fd < 0) {
+        throw FormatException("Failed to open capture file. path=%s errno=%d %s", path.c_str(),
+                              errno, strerror(errno));
+    }
+    struct stat st;
+    if (fstat(m_fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(CaptureFileHeader))) {
+        close(m_fd);
+        throw FormatException("Capture file is too short. path=%s", path.c_str());
+    }
+    m_size = static_cast<uint64_t>(st.st_size);
+    void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (data == MAP_FAILED) {
+        close(m_fd);
+        throw FormatException("Failed to map capture file. path=%s errno=%d %s", path.c_str(),
+                              errno, strerror(errno));
+    }
+    m_data = static_cast<const char *>(data);
+
+    m_header = reinterpret_cast<const CaptureFileHeader *>(m_data);
+    if (m_header->magic != CAPTURE_FILE_MAGIC || m_header->version != CAPTURE_FILE_VERSION) {
+        munmap(data, m_size);
+        close(m_fd);
+        throw FormatException("Not a capture file. path=%s", path.c_str());
+    }
+    if (m_header->protocolVersion != ALVR_PROTOCOL_VERSION) {
+        LOGE("Capture was recorded with other protocol version. Recorded=%d Our=%d",
+             m_header->protocolVersion, ALVR_PROTOCOL_VERSION);
+    }
+
+    m_recordEnd = m_size;
+    bool hasIndex = false;
+    if (m_size >= sizeof(CaptureFileHeader) + sizeof(CaptureFileTrailer)) {
+        auto trailer = reinterpret_cast<const CaptureFileTrailer *>(
+                m_data + m_size - sizeof(CaptureFileTrailer));
+        hasIndex = trailer->magic == CAPTURE_TRAILER_MAGIC &&
+                   trailer->indexOffset >= sizeof(CaptureFileHeader) &&
+                   trailer->indexOffset + trailer->indexCount * sizeof(CaptureIndexEntry) +
+                   sizeof(CaptureFileTrailer) == m_size;
+        if (hasIndex) {
+            auto index = reinterpret_cast<const CaptureIndexEntry *>(m_data + trailer->indexOffset);
+            m_index.assign(index, index + trailer->indexCount);
+            m_recordEnd = trailer->indexOffset;
+        }
+    }
+    if (!hasIndex) {
+        LOGI("Capture file has no index. Scanning records. path=%s", path.c_str());
+        rebuildIndex();
+    }
+
+    uint64_t offset = getFirstRecordOffset();
+    CaptureRecord record;
+    if (next(&offset, &record) && record.type == CAPTURE_RECORD_CONNECTION &&
+        record.length >= sizeof(ConnectionMessage)) {
+        m_connectionMessage = reinterpret_cast<const ConnectionMessage *>(record.data);
+    }
+}
+
+CaptureReader::~CaptureReader() {
+    munmap(const_cast<char *>(m_data), m_size);
+    close(m_fd);
+}
+
+bool CaptureReader::findFrame(uint64_t frameIndex, uint64_t *offset) const {
+    for (auto &entry : m_index) {
+        if (entry.frameIndex == frameIndex) {
+            *offset = entry.offset;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CaptureReader::next(uint64_t *offset, CaptureRecord *record) const {
+    if (*offset + sizeof(CaptureRecordHeader) > m_recordEnd) {
+        return false;
+    }
+    auto header = reinterpret_cast<const CaptureRecordHeader *>(m_data + *offset);
+    // Zero filled tail of unfinished capture ends here.
+    if (header->magic != CAPTURE_RECORD_MAGIC ||
+        *offset + sizeof(CaptureRecordHeader) + header->length > m_recordEnd) {
+        return false;
+    }
+    record->type = header->type;
+    record->timestamp = header->timestamp;
+    record->frameIndex = header->frameIndex;
+    record->flags = header->flags;
+    record->configLength = header->configLength;
+    record->data = m_data + *offset + sizeof(CaptureRecordHeader);
+    record->length = header->length;
+    *offset += sizeof(CaptureRecordHeader) + alignRecord(header->length);
+    return true;
+}
+
+void CaptureReader::rebuildIndex() {
+    uint64_t lastFrameIndex = UINT64_MAX;
+    uint64_t offset = getFirstRecordOffset();
+    uint64_t recordOffset = offset;
+    CaptureRecord record;
+    while (next(&offset, &record)) {
+        if (record.frameIndex != UINT64_MAX && record.frameIndex != lastFrameIndex) {
+            m_index.push_back({record.frameIndex, recordOffset});
+            lastFrameIndex = record.frameIndex;
+        }
+        recordOffset = offset;
+    }
+    m_recordEnd = offset;
+}
@@ -0,0 +1,163 @@
+#ifndef ALVRCLIENT_CAPTURE_FILE_H
+#define ALVRCLIENT_CAPTURE_FILE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "packet_types.h"
+
+// Capture of received datagrams or reassembled elementary stream for offline reproduction.
+//
+// File layout (little endian, 8 bytes aligned):
+//   CaptureFileHeader
+//   CaptureRecordHeader + payload (padded to 8 bytes) ...
+//   CaptureIndexEntry[indexCount]
+//   CaptureFileTrailer
+// Records are written through a memory mapped window, so recording costs a memcpy per packet.
+// Index and trailer are written on close. A capture without them (e.g. the app was killed) is
+// still readable by scanning records, and the index is rebuilt on open.
+
+enum CAPTURE_KIND {
+    // Raw datagrams passed to Socket::parse. Indexed by videoFrameIndex.
+    CAPTURE_KIND_PACKETS = 0,
+    // Frames (or slices) pushed by NALParser. Indexed by tracking frame index. Not replayable.
+    CAPTURE_KIND_ELEMENTARY_STREAM = 1,
+};
+
+enum CAPTURE_RECORD_TYPE {
+    // ConnectionMessage of the session. Replay starts from it.
+    CAPTURE_RECORD_CONNECTION = 1,
+    CAPTURE_RECORD_PACKET = 2,
+    CAPTURE_RECORD_FRAME = 3,
+};
+
+// Flags of CAPTURE_RECORD_FRAME. Low 8 bits are ALVR_VIDEO_FRAME_TYPE.
+static const uint32_t CAPTURE_FRAME_FLAG_PARTIAL = 1 << 8;
+// Terminates partially pushed frame. Record has no payload.
+static const uint32_t CAPTURE_FRAME_FLAG_END_OF_FRAME = 1 << 9;
+
+#pragma pack(push, 1)
+struct CaptureFileHeader {
+    uint32_t magic; // CAPTURE_FILE_MAGIC
+    uint32_t version;
+    uint32_t kind; // enum CAPTURE_KIND
+    uint32_t protocolVersion; // ALVR_PROTOCOL_VERSION of the recorder
+    // Wall clock of capture start in microseconds.
+    uint64_t startTime;
+};
+struct CaptureRecordHeader {
+    uint32_t magic; // CAPTURE_RECORD_MAGIC
+    uint16_t type; // enum CAPTURE_RECORD_TYPE
+    uint16_t reserved;
+    // Microseconds since capture start.
+    uint64_t timestamp;
+    // videoFrameIndex of packet, or tracking frame index of frame.
+    uint64_t frameIndex;
+    uint32_t flags;
+    // Leading parameter set bytes of frame payload.
+    uint32_t configLength;
+    uint32_t length;
+    uint32_t padding;
+};
+struct CaptureIndexEntry {
+    uint64_t frameIndex;
+    // File offset of the first record of the frame.
+    uint64_t offset;
+};
+struct CaptureFileTrailer {
+    uint64_t indexOffset;
+    uint64_t indexCount;
+    uint32_t magic; // CAPTURE_TRAILER_MAGIC
+    uint32_t padding;
+};
+#pragma pack(pop)
+
+struct CaptureRecord {
+    uint16_t type;
+    uint64_t timestamp;
+    uint64_t frameIndex;
+    uint32_t flags;
+    uint32_t configLength;
+    const char *data;
+    uint32_t length;
+};
+
+class CaptureWriter {
+public:
+    // Throws FormatException when the file cannot be created.
+    CaptureWriter(const std::string &path, uint32_t kind);
+    // Index and trailer are written and the file is truncated to its size.
+    ~CaptureWriter();
+
+    void writeConnection(const ConnectionMessage &connectionMessage);
+    // Datagram as received. A new index entry is made on each new video frame.
+    void writePacket(const char *packet, int length);
+    void writeFrame(const char *data, int length, int configLength, uint64_t frameIndex,
+                    uint8_t frameType, bool partial);
+    void writeEndOfFrame(uint64_t frameIndex);
+
+    const std::string &getPath() const {
+        return m_path;
+    }
+private:
+    void write(uint16_t type, uint64_t frameIndex, uint32_t flags, uint32_t configLength,
+               const char *data, int length);
+    // Make [m_position, m_position + length) writable. Returns false on failure.
+    bool reserve(uint64_t length);
+    void unmap();
+
+    std::string m_path;
+    int m_fd = -1;
+    bool m_failed = false;
+    uint64_t m_startTime = 0;
+
+    // Mapped window of the file.
+    char *m_window = nullptr;
+    uint64_t m_windowOffset = 0;
+    uint64_t m_windowSize = 0;
+    // Write position and current file size.
+    uint64_t m_position = 0;
+    uint64_t m_fileSize = 0;
+
+    std::vector<CaptureIndexEntry> m_index;
+    uint64_t m_lastFrameIndex = UINT64_MAX;
+};
+
+class CaptureReader {
+public:
+    // Throws FormatException when the file is not a capture.
+    CaptureReader(const std::string &path);
+    ~CaptureReader();
+
+    uint32_t getKind() const {
+        return m_header->kind;
+    }
+    // nullptr if the capture has no connection record.
+    const ConnectionMessage *getConnectionMessage() const {
+        return m_connectionMessage;
+    }
+    const std::vector<CaptureIndexEntry> &getIndex() const {
+        return m_index;
+    }
+    uint64_t getFirstRecordOffset() const {
+        return sizeof(CaptureFileHeader);
+    }
+    // Offset of the first record of the frame. Returns false if the frame is not in the capture.
+    bool findFrame(uint64_t frameIndex, uint64_t *offset) const;
+
+    // Read the record at *offset and advance it. Returns false at the end of records.
+    bool next(uint64_t *offset, CaptureRecord *record) const;
+private:
+    void rebuildIndex();
+
+    int m_fd = -1;
+    const char *m_data = nullptr;
+    uint64_t m_size = 0;
+    // End of records.
+    uint64_t m_recordEnd = 0;
+    const CaptureFileHeader *m_header = nullptr;
+    const ConnectionMessage *m_connectionMessage = nullptr;
+    std::vector<CaptureIndexEntry> m_index;
+};
+
+#endif //ALVRCLIENT_CAPTURE_FILE_H
@@ -0,0 +1,67 @@
+/// Capture replay
+// Feed recorded datagrams again with original or maximum speed.
+////////////////////////////////////////////////////////////////////
+
+#include <unistd.h>
+#include "capture_replay.h"
+#include "utils.h"
+#include "exception.h"
+
+CaptureReplayer::CaptureReplayer(const std::string &path)
+        : m_reader(path) {
+    // Elementary stream captures hold frames after NALParser, so there is nothing to feed the
+    // receive pipeline with.
+    if (m_reader.getKind() != CAPTURE_KIND_PACKETS) {
+        throw FormatException("Only packet captures can be replayed. path=%s kind=%u",
+                              path.c_str(), m_reader.getKind());
+    }
+}
+
+CaptureReplayer::Statistics CaptureReplayer::replay(
+        bool realtime, uint64_t startFrameIndex,
+        const std::function<bool(const CaptureRecord &record)> &onRecord) {
+    Statistics statistics = {};
+
+    uint64_t offset = m_reader.getFirstRecordOffset();
+    if (startFrameIndex != UINT64_MAX && !m_reader.findFrame(startFrameIndex, &offset)) {
+        LOGE("Frame is not in capture. Replaying from the beginning. frame=%llu",
+             (unsigned long long) startFrameIndex);
+    }
+
+    uint64_t replayStart = getTimestampUs();
+    uint64_t firstTimestamp = UINT64_MAX;
+    CaptureRecord record;
+    while (m_reader.next(&offset, &record)) {
+        if (record.type == CAPTURE_RECORD_CONNECTION) {
+            continue;
+        }
+        if (firstTimestamp == UINT64_MAX) {
+            firstTimestamp = record.timestamp;
+        }
+        uint64_t due = record.timestamp - firstTimestamp;
+        if (realtime) {
+            uint64_t current = getTimestampUs() - replayStart;
+            if (current < due) {
+                usleep(static_cast<useconds_t>(due - current));
+            } else if (current - due > LATE_THRESHOLD_US) {
+                statistics.lateRecords++;
+            }
+        }
+
+        if (!onRecord(record)) {
+            break;
+        }
+        statistics.records++;
+        statistics.bytes += record.length;
+        statistics.capturedUs = due;
+    }
+    statistics.elapsedUs = getTimestampUs() - replayStart;
+
+    LOGI("Replay finished. realtime=%d records=%llu bytes=%llu elapsed=%llu us captured=%llu us "
+         "throughput=%.1f Mbps late=%llu", realtime, (unsigned long long) statistics.records,
+         (unsigned long long) statistics.bytes, (unsigned long long) statistics.elapsedUs,
+         (unsigned long long) statistics.capturedUs,
+         statistics.elapsedUs > 0 ? statistics.bytes * 8.0 / statistics.elapsedUs : 0.0,
+         (unsigned long long) statistics.lateRecords);
+    return statistics;
+}
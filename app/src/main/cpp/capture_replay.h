@@ -0,0 +1,40 @@
+#ifndef ALVRCLIENT_CAPTURE_REPLAY_H
+#define ALVRCLIENT_CAPTURE_REPLAY_H
+
+#include <functional>
+#include <string>
+#include "capture_file.h"
+
+// Feeds records of a packet capture to a callback, either paced by recorded timestamps or as fast as
+// the callback returns. Used to benchmark the receive pipeline with the same input every run.
+class CaptureReplayer {
+public:
+    struct Statistics {
+        uint64_t records;
+        uint64_t bytes;
+        // Wall time spent in replay.
+        uint64_t elapsedUs;
+        // Time span covered by the replayed records.
+        uint64_t capturedUs;
+        // Records which were fed later than recorded timing by more than LATE_THRESHOLD_US.
+        uint64_t lateRecords;
+    };
+
+    // Throws FormatException when the file is not a packet capture.
+    CaptureReplayer(const std::string &path);
+
+    const CaptureReader &getReader() const {
+        return m_reader;
+    }
+
+    // Replay from the first record of the frame, or from the beginning if it is UINT64_MAX or not
+    // in the capture. Connection record is not fed. Replay stops when onRecord returns false.
+    Statistics replay(bool realtime, uint64_t startFrameIndex,
+                      const std::function<bool(const CaptureRecord &record)> &onRecord);
+private:
+    static const uint64_t LATE_THRESHOLD_US = 2 * 1000;
+
+    CaptureReader m_reader;
+};
+
+#endif //ALVRCLIENT_CAPTURE_REPLAY_H
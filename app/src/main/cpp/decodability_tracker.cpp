@@ -0,0 +1,70 @@
+/// Reference dependency tracking
+// Decides whether a frame can be decoded correctly from the frames which have arrived before it.
+////////////////////////////////////////////////////////////////////
+
+#include "decodability_tracker.h"
+#include "latency_collector.h"
+#include "utils.h"
+
+void DecodabilityTracker::reset() {
+    m_broken = true;
+    m_lastVideoFrame = UINT64_MAX;
+    m_lastDecodable = false;
+    m_frameNumValid = false;
+    m_expectedFrameNum = 0;
+}
+
+bool DecodabilityTracker::onFrame(uint64_t videoFrameIndex, uint64_t trackingFrameIndex,
+                                  bool recovery, const FrameInfo &info) {
+    if (videoFrameIndex == m_lastVideoFrame) {
+        // Following slice of the same frame.
+        return m_lastDecodable;
+    }
+
+    bool lost = m_lastVideoFrame != UINT64_MAX && videoFrameIndex != m_lastVideoFrame + 1;
+    if (lost && m_frameNumValid && info.valid && info.maxFrameNum != 0) {
+        // Only non-reference frames were lost if frame_num continues.
+        lost = info.frameNum != m_expectedFrameNum;
+    }
+
+    if (recovery) {
+        if (m_broken) {
+            FrameLog(trackingFrameIndex, "References recovered. videoFrame=%llu idr=%d",
+                     (unsigned long long) videoFrameIndex, info.idr);
+        }
+        m_broken = false;
+    } else if (lost && !m_broken) {
+        FrameLog(trackingFrameIndex, "References broken. videoFrame=%llu last=%llu frameNum=%u expected=%u",
+                 (unsigned long long) videoFrameIndex, (unsigned long long) m_lastVideoFrame,
+                 info.frameNum, m_expectedFrameNum);
+        m_broken = true;
+    }
+
+    if (info.valid && info.maxFrameNum != 0) {
+        m_expectedFrameNum = info.reference ? (info.frameNum + 1) % info.maxFrameNum : info.frameNum;
+        m_frameNumValid = true;
+    } else {
+        m_frameNumValid = false;
+    }
+    m_lastVideoFrame = videoFrameIndex;
+    m_lastDecodable = !m_broken;
+
+    if (m_broken) {
+        FrameLog(trackingFrameIndex, "Dropping undecodable frame. videoFrame=%llu",
+                 (unsigned long long) videoFrameIndex);
+        LatencyCollector::Instance().undecodableFrame();
+    }
+    return m_lastDecodable;
+}
+
+void DecodabilityTracker::onConcealedFrame(uint64_t videoFrameIndex) {
+    m_lastVideoFrame = videoFrameIndex;
+    m_lastDecodable = !m_broken;
+    // frame_num of the concealed frame is not known.
+    m_frameNumValid = false;
+}
+
+void DecodabilityTracker::invalidate() {
+    m_broken = true;
+    m_lastDecodable = false;
+}
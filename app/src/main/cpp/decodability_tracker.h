@@ -0,0 +1,42 @@
+#ifndef ALVRCLIENT_DECODABILITY_TRACKER_H
+#define ALVRCLIENT_DECODABILITY_TRACKER_H
+
+#include <stdint.h>
+#include "slice_header.h"
+
+// Follows the reference chain of the stream to find frames which cannot be decoded correctly
+// because a frame they may refer to was lost. Such frames are not worth decoder time until a
+// recovery frame (IDR, recovery point SEI or server signalled recovery frame) arrives.
+//
+// On H.264, frame_num is incremented after each reference frame, so a lost non-reference frame
+// does not break the chain. On H.265 any lost frame is assumed to be referenced.
+class DecodabilityTracker {
+public:
+    // Nothing is decodable before the first recovery frame.
+    void reset();
+
+    // Called for each frame (or slice) handed from FEC queue in decode order.
+    // recovery: Frame does not refer to frames before it, or refers only to ACKed frames.
+    // Returns false if the frame should be dropped.
+    bool onFrame(uint64_t videoFrameIndex, uint64_t trackingFrameIndex, bool recovery,
+                 const FrameInfo &info);
+    // Intact prefix of unrecoverable frame was handed to decoder. References are corrupted but
+    // usable, so the chain is kept.
+    void onConcealedFrame(uint64_t videoFrameIndex);
+    // Frames which passed were dropped later. Following frames wait for recovery.
+    void invalidate();
+
+    bool isBroken() const {
+        return m_broken;
+    }
+private:
+    bool m_broken = true;
+    // Last frame seen. UINT64_MAX if none.
+    uint64_t m_lastVideoFrame = UINT64_MAX;
+    bool m_lastDecodable = false;
+    // frame_num expected on next frame on H.264.
+    bool m_frameNumValid = false;
+    uint32_t m_expectedFrameNum = 0;
+};
+
+#endif //ALVRCLIENT_DECODABILITY_TRACKER_H
@@ -0,0 +1,370 @@
+/// Decode input queue
+// Frames wait here until decoder can take them. Drop policy keeps latency bounded when decoder
+// falls behind, without handing undecodable frames to it.
+////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <algorithm>
+#include "decode_queue.h"
+#include "packet_types.h"
+#include "latency_collector.h"
+#include "frame_trace.h"
+
+// Free buffers kept for reuse.
+static const size_t MAX_FREE_BUFFERS = 16;
+
+DecodeQueue::DecodeQueue(Clock clock) : m_clock(clock) {
+    pthread_cond_init(&m_cond, nullptr);
+}
+
+DecodeQueue::~DecodeQueue() {
+    stopWorker();
+    pthread_cond_destroy(&m_cond);
+}
+
+void DecodeQueue::setSink(const std::shared_ptr<DecoderSink> &sink) {
+    stopWorker();
+    // New decoder is not in the middle of a frame.
+    m_feedingVideoFrame = UINT64_MAX;
+    clear();
+    m_sink = sink;
+    if (m_sink) {
+        startWorker();
+    }
+}
+
+void DecodeQueue::configure(int depth, int refreshRate) {
+    MutexLock lock(m_mutex);
+    m_depth = depth > 0 ? depth : 1;
+    m_latencyBudget = refreshRate > 0 ?
+                      static_cast<uint64_t>(LATENCY_BUDGET_FRAMES * m_depth) * 1000000 / refreshRate : 0;
+    LOGI("Decode queue configured. depth=%d latencyBudget=%llu us", m_depth,
+         (unsigned long long) m_latencyBudget);
+}
+
+void DecodeQueue::clear() {
+    MutexLock lock(m_mutex);
+    for (auto &entry : m_entries) {
+        recycle(entry.buffer);
+    }
+    m_entries.clear();
+    if (m_feedingVideoFrame != UINT64_MAX) {
+        // Decoder must not wait for remaining slices.
+        Entry entry = {};
+        entry.videoFrameIndex = m_feedingVideoFrame;
+        entry.endOfFrame = true;
+        m_entries.push_back(std::move(entry));
+        pthread_cond_signal(&m_cond);
+    }
+    m_droppedVideoFrame = UINT64_MAX;
+    m_droppedReferenceStart = UINT64_MAX;
+    m_droppedReferenceEnd = 0;
+}
+
+void DecodeQueue::push(std::vector<char> &frameBuffer, int offset, int configLength, int length,
+                       uint64_t videoFrameIndex, uint64_t frameIndex, uint8_t frameType,
+                       bool reference, bool partial, bool copy) {
+    MutexLock lock(m_mutex);
+    if (!m_sink) {
+        return;
+    }
+
+    bool hasSlices = length - offset > configLength;
+    if (hasSlices && videoFrameIndex == m_droppedVideoFrame) {
+        // Remaining slice of dropped frame.
+        if (configLength <= 0) {
+            return;
+        }
+        length = offset + configLength;
+        partial = false;
+        hasSlices = false;
+    }
+
+    Entry entry;
+    if (copy) {
+        if (!m_free.empty()) {
+            entry.buffer.swap(m_free.back());
+            m_free.pop_back();
+        }
+        if (entry.buffer.size() < static_cast<size_t>(length)) {
+            entry.buffer.resize(static_cast<size_t>(length));
+        }
+        memcpy(entry.buffer.data(), frameBuffer.data(), static_cast<size_t>(length));
+    } else {
+        entry.buffer.swap(frameBuffer);
+        if (!m_free.empty()) {
+            frameBuffer.swap(m_free.back());
+            m_free.pop_back();
+        }
+    }
+    entry.offset = offset;
+    entry.configLength = configLength;
+    entry.length = length;
+    // Parameter sets alone do not belong to a frame.
+    entry.videoFrameIndex = hasSlices ? videoFrameIndex : UINT64_MAX;
+    entry.frameIndex = frameIndex;
+    entry.frameType = frameType;
+    entry.reference = reference;
+    entry.partial = partial;
+    entry.endOfFrame = false;
+    entry.firstOfFrame = hasSlices && videoFrameIndex != m_feedingVideoFrame &&
+                         (m_entries.empty() || m_entries.back().videoFrameIndex != videoFrameIndex);
+    entry.queuedTime = m_clock();
+    m_entries.push_back(std::move(entry));
+    if (hasSlices) {
+        FrameTrace::Instance().record(TRACE_STAGE_DECODE_QUEUE, TRACE_PHASE_ASYNC_BEGIN, frameIndex,
+                                      videoFrameIndex);
+    }
+
+    if (m_entries.back().firstOfFrame) {
+        makeRoom();
+        LatencyCollector::Instance().decodeQueueFrames(static_cast<uint32_t>(countFrames()));
+    }
+    pthread_cond_signal(&m_cond);
+}
+
+void DecodeQueue::pushEndOfFrame(uint64_t videoFrameIndex, uint64_t frameIndex) {
+    MutexLock lock(m_mutex);
+    if (!m_sink || videoFrameIndex == m_droppedVideoFrame) {
+        return;
+    }
+    Entry entry = {};
+    entry.videoFrameIndex = videoFrameIndex;
+    entry.frameIndex = frameIndex;
+    entry.endOfFrame = true;
+    entry.queuedTime = m_clock();
+    m_entries.push_back(std::move(entry));
+    pthread_cond_signal(&m_cond);
+}
+
+bool DecodeQueue::takeDroppedReferences(uint64_t *startVideoFrame, uint64_t *endVideoFrame) {
+    MutexLock lock(m_mutex);
+    if (m_droppedReferenceStart == UINT64_MAX) {
+        return false;
+    }
+    *startVideoFrame = m_droppedReferenceStart;
+    *endVideoFrame = m_droppedReferenceEnd;
+    m_droppedReferenceStart = UINT64_MAX;
+    m_droppedReferenceEnd = 0;
+    return true;
+}
+
+void DecodeQueue::startWorker() {
+    {
+        MutexLock lock(m_mutex);
+        m_stopped = false;
+    }
+    pthread_create(&m_worker, nullptr, workerThread, this);
+    m_workerRunning = true;
+}
+
+void DecodeQueue::stopWorker() {
+    if (!m_workerRunning) {
+        return;
+    }
+    {
+        MutexLock lock(m_mutex);
+        m_stopped = true;
+        pthread_cond_signal(&m_cond);
+    }
+    pthread_join(m_worker, nullptr);
+    m_workerRunning = false;
+}
+
+void *DecodeQueue::workerThread(void *arg) {
+    pthread_setname_np(pthread_self(), "DecodeQueue");
+    LatencyCollector::Instance().registerThread();
+    static_cast<DecodeQueue *>(arg)->workerLoop();
+    return nullptr;
+}
+
+void DecodeQueue::workerLoop() {
+    m_sink->attachThread();
+    while (true) {
+        {
+            MutexLock lock(m_mutex);
+            while (!m_stopped && m_entries.empty()) {
+                m_mutex.CondWait(&m_cond);
+            }
+            if (m_stopped) {
+                break;
+            }
+        }
+
+        bool ready = m_sink->waitReady(READY_TIMEOUT_US);
+
+        Entry entry;
+        {
+            MutexLock lock(m_mutex);
+            if (m_stopped) {
+                break;
+            }
+            enforceLatencyBudget(m_clock());
+            if (!ready || m_entries.empty()) {
+                continue;
+            }
+            entry = std::move(m_entries.front());
+            m_entries.pop_front();
+            if (entry.videoFrameIndex != UINT64_MAX) {
+                m_feedingVideoFrame = entry.partial && !entry.endOfFrame ? entry.videoFrameIndex :
+                                      UINT64_MAX;
+            }
+        }
+
+        if (entry.endOfFrame) {
+            m_sink->pushEndOfFrame(entry.frameIndex);
+        } else {
+            if (entry.videoFrameIndex != UINT64_MAX) {
+                LatencyCollector::Instance().decodeQueueDequeued(entry.frameIndex);
+                FrameTrace::Instance().record(TRACE_STAGE_DECODE_QUEUE, TRACE_PHASE_ASYNC_END,
+                                              entry.frameIndex, entry.videoFrameIndex);
+            }
+            TraceScope trace(TRACE_STAGE_DECODER_FEED, entry.frameIndex, entry.videoFrameIndex);
+            m_sink->pushFrame(entry.buffer, entry.offset, entry.configLength, entry.length,
+                              entry.frameIndex, entry.frameType, entry.partial, false);
+        }
+
+        MutexLock lock(m_mutex);
+        recycle(entry.buffer);
+    }
+    m_sink->detachThread();
+}
+
+int DecodeQueue::countFrames() const {
+    int frames = 0;
+    for (auto &entry : m_entries) {
+        if (entry.firstOfFrame) {
+            frames++;
+        }
+    }
+    return frames;
+}
+
+bool DecodeQueue::isDroppable(const Entry &entry) const {
+    return entry.firstOfFrame && entry.frameType != ALVR_VIDEO_FRAME_TYPE_IDR;
+}
+
+void DecodeQueue::makeRoom() {
+    while (countFrames() > m_depth) {
+        // Nothing refers to non-reference frames.
+        uint64_t victim = UINT64_MAX;
+        for (auto &entry : m_entries) {
+            if (isDroppable(entry) && !entry.reference) {
+                victim = entry.videoFrameIndex;
+                break;
+            }
+        }
+        if (victim != UINT64_MAX) {
+            dropFrame(victim, false);
+            continue;
+        }
+        if (!jumpToRecovery()) {
+            dropAll();
+            break;
+        }
+    }
+}
+
+void DecodeQueue::enforceLatencyBudget(uint64_t current) {
+    if (m_latencyBudget == 0) {
+        return;
+    }
+    // IDR frame waiting for stalled decoder is kept.
+    auto oldest = std::find_if(m_entries.begin(), m_entries.end(),
+                               [this](const Entry &entry) { return isDroppable(entry); });
+    if (oldest == m_entries.end() || current - oldest->queuedTime <= m_latencyBudget) {
+        return;
+    }
+    FrameLog(oldest->frameIndex, "Decode queue exceeded latency budget. wait=%llu us frames=%d",
+             (unsigned long long) (current - oldest->queuedTime), countFrames());
+    if (!jumpToRecovery()) {
+        dropAll();
+    }
+}
+
+// Drop frames before the newest IDR frame. Returns false if there is nothing to drop.
+bool DecodeQueue::jumpToRecovery() {
+    auto recovery = std::find_if(m_entries.rbegin(), m_entries.rend(), [](const Entry &entry) {
+        return entry.firstOfFrame && entry.frameType == ALVR_VIDEO_FRAME_TYPE_IDR;
+    });
+    if (recovery == m_entries.rend()) {
+        return false;
+    }
+    uint64_t recoveryVideoFrame = recovery->videoFrameIndex;
+
+    std::vector<uint64_t> victims;
+    for (auto &entry : m_entries) {
+        if (entry.videoFrameIndex == recoveryVideoFrame) {
+            break;
+        }
+        if (entry.firstOfFrame) {
+            victims.push_back(entry.videoFrameIndex);
+        }
+    }
+    // IDR frame does not refer to frames before it, so dropped references need no report.
+    for (uint64_t victim : victims) {
+        dropFrame(victim, false);
+    }
+    return !victims.empty();
+}
+
+// Drop all frames except IDR. Later frames may refer to them, so the range is reported.
+void DecodeQueue::dropAll() {
+    std::vector<uint64_t> victims;
+    for (auto &entry : m_entries) {
+        if (isDroppable(entry)) {
+            victims.push_back(entry.videoFrameIndex);
+        }
+    }
+    for (uint64_t victim : victims) {
+        dropFrame(victim, true);
+    }
+}
+
+// Remove slices of the frame. Parameter sets carried by the frame are kept in place.
+void DecodeQueue::dropFrame(uint64_t videoFrameIndex, bool report) {
+    bool reference = false;
+    uint64_t frameIndex = 0;
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->videoFrameIndex != videoFrameIndex) {
+            ++it;
+            continue;
+        }
+        if (it->firstOfFrame) {
+            reference = it->reference;
+            frameIndex = it->frameIndex;
+        }
+        if (!it->endOfFrame) {
+            // arg 1: Dropped.
+            FrameTrace::Instance().record(TRACE_STAGE_DECODE_QUEUE, TRACE_PHASE_ASYNC_END,
+                                          it->frameIndex, videoFrameIndex, 1);
+        }
+        if (!it->endOfFrame && it->configLength > 0) {
+            it->length = it->offset + it->configLength;
+            it->partial = false;
+            it->firstOfFrame = false;
+            it->videoFrameIndex = UINT64_MAX;
+            ++it;
+        } else {
+            recycle(it->buffer);
+            it = m_entries.erase(it);
+        }
+    }
+    m_droppedVideoFrame = videoFrameIndex;
+
+    FrameLog(frameIndex, "Dropped frame from decode queue. videoFrame=%llu reference=%d",
+             (unsigned long long) videoFrameIndex, reference);
+    LatencyCollector::Instance().decodeQueueDrop();
+
+    if (report && reference) {
+        m_droppedReferenceStart = std::min(m_droppedReferenceStart, videoFrameIndex);
+        m_droppedReferenceEnd = std::max(m_droppedReferenceEnd, videoFrameIndex);
+    }
+}
+
+void DecodeQueue::recycle(std::vector<char> &buffer) {
+    if (buffer.capacity() > 0 && m_free.size() < MAX_FREE_BUFFERS) {
+        m_free.emplace_back();
+        m_free.back().swap(buffer);
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef ALVRCLIENT_DECODE_QUEUE_H
+#define ALVRCLIENT_DECODE_QUEUE_H
+
+#include <pthread.h>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "decoder_sink.h"
+#include "utils.h"
+
+// Bounded queue between NALParser and decoder. Frames are fed to the sink from a worker thread
+// only when the decoder can take them, so frames wait here and the drop policy decides which
+// ones are lost when the decoder falls behind:
+// - Parameter sets are never dropped. IDR frames are dropped only when a newer IDR is queued.
+// - Oldest non-reference frame is dropped first when more than depth frames are queued.
+// - Otherwise queue jumps to the newest IDR frame.
+// - If there is none, all queued frames are dropped. Later frames refer to them, so the
+//   dropped range is reported to be NACKed and later frames wait for recovery.
+// The jump also happens when the oldest frame has waited longer than the latency budget.
+class DecodeQueue {
+public:
+    // Time of queueing and of latency budget checks in microseconds.
+    typedef uint64_t (*Clock)();
+
+    explicit DecodeQueue(Clock clock = getTimestampUs);
+    ~DecodeQueue();
+
+    // Worker thread is restarted for new sink. Frames are dropped while no sink is set.
+    void setSink(const std::shared_ptr<DecoderSink> &sink);
+    // depth: frameQueueSize of ConnectionMessage/ChangeSettings. Latency budget is derived from
+    // depth and refresh rate.
+    void configure(int depth, int refreshRate);
+    void clear();
+
+    // Same as DecoderSink::pushFrame. Frame buffer is taken by swap unless copy is set.
+    // reference: Later frames may refer to this frame.
+    void push(std::vector<char> &frameBuffer, int offset, int configLength, int length,
+              uint64_t videoFrameIndex, uint64_t frameIndex, uint8_t frameType, bool reference,
+              bool partial, bool copy);
+    void pushEndOfFrame(uint64_t videoFrameIndex, uint64_t frameIndex);
+
+    // Range of frames dropped with references since last call. Returns false if none.
+    bool takeDroppedReferences(uint64_t *startVideoFrame, uint64_t *endVideoFrame);
+private:
+    struct Entry {
+        std::vector<char> buffer;
+        int offset;
+        int configLength;
+        int length;
+        uint64_t videoFrameIndex;
+        uint64_t frameIndex;
+        uint8_t frameType;
+        bool reference;
+        bool partial;
+        // pushEndOfFrame
+        bool endOfFrame;
+        // First slice of the frame. Frames are counted by it.
+        bool firstOfFrame;
+        uint64_t queuedTime;
+    };
+
+    // Timeout of DecoderSink::waitReady. Stop request is checked at this interval.
+    static const int64_t READY_TIMEOUT_US = 10 * 1000;
+    // Latency budget is this many times of the frame interval per queued frame.
+    static const int LATENCY_BUDGET_FRAMES = 2;
+
+    void startWorker();
+    void stopWorker();
+    static void *workerThread(void *arg);
+    void workerLoop();
+
+    int countFrames() const;
+    bool isDroppable(const Entry &entry) const;
+    void makeRoom();
+    void enforceLatencyBudget(uint64_t current);
+    bool jumpToRecovery();
+    void dropFrame(uint64_t videoFrameIndex, bool report);
+    void dropAll();
+    void recycle(std::vector<char> &buffer);
+
+    Clock m_clock;
+    Mutex m_mutex;
+    pthread_cond_t m_cond;
+    pthread_t m_worker;
+    bool m_workerRunning = false;
+    bool m_stopped = false;
+
+    std::shared_ptr<DecoderSink> m_sink;
+    std::deque<Entry> m_entries;
+    std::vector<std::vector<char>> m_free;
+
+    int m_depth = 1;
+    uint64_t m_latencyBudget = 0;
+
+    // Frame whose leading slices have been fed to decoder. It is not dropped. UINT64_MAX if none.
+    uint64_t m_feedingVideoFrame = UINT64_MAX;
+    // Last dropped frame. Remaining slices of it are dropped on push.
+    uint64_t m_droppedVideoFrame = UINT64_MAX;
+    // Range of dropped frames which were referenced. UINT64_MAX if none.
+    uint64_t m_droppedReferenceStart = UINT64_MAX;
+    uint64_t m_droppedReferenceEnd = 0;
+};
+
+#endif //ALVRCLIENT_DECODE_QUEUE_H
@@ -0,0 +1,57 @@
+#include <errno.h>
+#include <string.h>
+#include <inttypes.h>
+#include "decoder_sink.h"
+#include "utils.h"
+#include "exception.h"
+
+void NullDecoderSink::pushFrame(std::vector<char> &/*frameBuffer*/, int offset, int /*configLength*/,
+                                int length, uint64_t /*frameIndex*/, uint8_t /*frameType*/,
+                                bool partial, bool /*keepBuffer*/) {
+    if (!partial) {
+        m_frames++;
+        m_intervalFrames++;
+    }
+    m_bytes += length - offset;
+    m_intervalBytes += length - offset;
+
+    uint64_t current = getTimestampUs();
+    if (m_intervalStart == 0) {
+        m_intervalStart = current;
+    } else if (current - m_intervalStart >= USECS_IN_SEC) {
+        double elapsed = (current - m_intervalStart) / (double) USECS_IN_SEC;
+        LOGI("NullDecoderSink: %.1f frames/s %.2f Mbps. Total frames=%" PRIu64 " bytes=%" PRIu64,
+             m_intervalFrames / elapsed, m_intervalBytes * 8 / elapsed / 1000 / 1000, m_frames,
+             m_bytes);
+        m_intervalStart = current;
+        m_intervalFrames = 0;
+        m_intervalBytes = 0;
+    }
+}
+
+void NullDecoderSink::pushEndOfFrame(uint64_t /*frameIndex*/) {
+    m_frames++;
+    m_intervalFrames++;
+}
+
+FileDecoderSink::FileDecoderSink(const char *path) {
+    m_file = fopen(path, "wb");
+    if (m_file == nullptr) {
+        throw FormatException("Failed to open elementary stream file %s : %d %s", path, errno,
+                              strerror(errno));
+    }
+}
+
+FileDecoderSink::~FileDecoderSink() {
+    fclose(m_file);
+}
+
+void FileDecoderSink::pushFrame(std::vector<char> &frameBuffer, int offset, int /*configLength*/,
+                                int length, uint64_t /*frameIndex*/, uint8_t /*frameType*/,
+                                bool /*partial*/, bool /*keepBuffer*/) {
+    fwrite(frameBuffer.data() + offset, 1, static_cast<size_t>(length - offset), m_file);
+}
+
+void FileDecoderSink::pushEndOfFrame(uint64_t /*frameIndex*/) {
+    fflush(m_file);
+}
@@ -0,0 +1,70 @@
+#ifndef ALVRCLIENT_DECODER_SINK_H
+#define ALVRCLIENT_DECODER_SINK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+// Destination of frames assembled by NALParser.
+class DecoderSink {
+public:
+    virtual ~DecoderSink() {}
+
+    // Data is [offset, length) of frameBuffer. Leading configLength bytes of the data are
+    // (VPS + )SPS + PPS. Data may consist only of parameter sets to prepare decoder.
+    // frameType: ALVR_VIDEO_FRAME_TYPE of the slices.
+    // Sink may take frameBuffer by swapping with another buffer unless keepBuffer is set.
+    // partial: Following slices of the same frame will be pushed separately.
+    virtual void pushFrame(std::vector<char> &frameBuffer, int offset, int configLength, int length,
+                           uint64_t frameIndex, uint8_t frameType, bool partial, bool keepBuffer) = 0;
+    // Terminate partially pushed frame.
+    virtual void pushEndOfFrame(uint64_t frameIndex) = 0;
+
+    // Frames are pushed from DecodeQueue worker thread. Called on the thread before the first
+    // push and after the last one.
+    virtual void attachThread() {}
+    virtual void detachThread() {}
+    // Wait until decoder can take next input without queueing it on its side. Frames wait in
+    // DecodeQueue meanwhile, where they can be dropped by policy. Returns false on timeout.
+    virtual bool waitReady(int64_t /*timeoutUs*/) {
+        return true;
+    }
+};
+
+// Discard frames and measure throughput. For profiling receive path without decoder.
+class NullDecoderSink : public DecoderSink {
+public:
+    void pushFrame(std::vector<char> &frameBuffer, int offset, int configLength, int length,
+                   uint64_t frameIndex, uint8_t frameType, bool partial, bool keepBuffer) override;
+    void pushEndOfFrame(uint64_t frameIndex) override;
+
+    uint64_t getFrames() const {
+        return m_frames;
+    }
+    uint64_t getBytes() const {
+        return m_bytes;
+    }
+private:
+    uint64_t m_frames = 0;
+    uint64_t m_bytes = 0;
+
+    uint64_t m_intervalStart = 0;
+    uint64_t m_intervalFrames = 0;
+    uint64_t m_intervalBytes = 0;
+};
+
+// Write Annex-B elementary stream to file. Output can be played by ffplay etc.
+class FileDecoderSink : public DecoderSink {
+public:
+    // Throws FormatException when the file cannot be opened.
+    FileDecoderSink(const char *path);
+    ~FileDecoderSink() override;
+
+    void pushFrame(std::vector<char> &frameBuffer, int offset, int configLength, int length,
+                   uint64_t frameIndex, uint8_t frameType, bool partial, bool keepBuffer) override;
+    void pushEndOfFrame(uint64_t frameIndex) override;
+private:
+    FILE *m_file;
+};
+
+#endif //ALVRCLIENT_DECODER_SINK_H
@@ -5,12 +5,12 @@
 #include "fec.h"
 #include "packet_types.h"
 #include "utils.h"
-#include "udp.h"
+#include "video_feedback.h"
 #include "latency_collector.h"
 
 bool FECQueue::reed_solomon_initialized = false;
 
-FECQueue::FECQueue(UdpManager *udpManager) : mUdpManager(udpManager) {
+FECQueue::FECQueue(VideoFeedback *feedback) : mFeedback(feedback) {
     reset();
 
     if (!reed_solomon_initialized) {
@@ -28,27 +28,83 @@ FECQueue::~FECQueue() {
 void FECQueue::reset() {
     LOG("FECQueue: Reset.");
     m_currentFrame.videoFrameIndex = UINT64_MAX;
+    m_currentFrame.sliceIndex = 0;
+    m_currentFrame.sliceCount = 1;
     m_recovered = true;
+    m_frameBroken = false;
+    m_lostSlices = 0;
+    m_sliceLossReported = false;
+    m_parityConsumed = 0;
+    m_concealedFrameByteSize = 0;
+    m_corruptedSince = UINT64_MAX;
 
     mLastSuccessfulVideoFrame = -1;
     mIDRProcessed = false;
+    m_ackPending = false;
 }
 
 // Add packet to queue. packet must point to buffer whose size=ALVR_MAX_PACKET_SIZE.
 void FECQueue::addVideoPacket(const VideoFrame *packet, int packetSize) {
-    if (m_recovered && m_currentFrame.videoFrameIndex == packet->videoFrameIndex) {
-        // Ignore unused parity packets.
+    if (m_currentFrame.videoFrameIndex == packet->videoFrameIndex &&
+        packet->sliceIndex < m_currentFrame.sliceIndex) {
+        // Late packet of previous slice. The slice has already been resolved.
         return;
     }
     //
-    // Check new frame.
+    // Check new frame (or new slice).
     //
-    if (m_currentFrame.videoFrameIndex != packet->videoFrameIndex) {
-        if (!m_recovered) {
-            frameLost(packet->videoFrameIndex, false);
+    if (m_currentFrame.videoFrameIndex != packet->videoFrameIndex ||
+        m_currentFrame.sliceIndex != packet->sliceIndex) {
+        if (m_currentFrame.videoFrameIndex != UINT64_MAX) {
+            accumulateSliceStatistics();
+            if (m_currentFrame.videoFrameIndex != packet->videoFrameIndex) {
+                reportFrameStatistics();
+            }
+        }
+        if (m_ackPending) {
+            // Frame was not handed to NALParser.
+            FrameInfo info = {};
+            ackFrame(info);
         }
-        if(m_currentFrame.videoFrameIndex != UINT64_MAX && m_currentFrame.videoFrameIndex + 1 != packet->videoFrameIndex) {
-            frameLost(packet->videoFrameIndex, true);
+        if (m_currentFrame.videoFrameIndex == packet->videoFrameIndex) {
+            // Next slice of the same frame.
+            if (!m_recovered) {
+                markSliceLost(m_currentFrame.sliceIndex, m_currentFrame.sliceIndex);
+            }
+            if (packet->sliceIndex != m_currentFrame.sliceIndex + 1) {
+                markSliceLost(m_currentFrame.sliceIndex + 1u, packet->sliceIndex - 1u);
+            }
+        } else {
+            if (m_currentFrame.videoFrameIndex != UINT64_MAX) {
+                finishFrameSlices();
+            }
+            if (m_lostSlices != 0 && !m_frameBroken) {
+                if (!m_sliceLossReported) {
+                    reportLostSlices();
+                }
+            } else if (!isFrameComplete()) {
+                if (m_interleavedQueue != nullptr) {
+                    handOverFrame();
+                } else {
+                    if (gEnableErrorConcealment) {
+                        concealFrame();
+                    }
+                    frameLost(packet->videoFrameIndex, false);
+                }
+            }
+            if (m_currentFrame.videoFrameIndex != UINT64_MAX &&
+                m_currentFrame.videoFrameIndex + 1 != packet->videoFrameIndex) {
+                if (m_currentFrame.videoFrameIndex < packet->videoFrameIndex) {
+                    mFeedback->getFecController().onFramesLost(
+                            packet->videoFrameIndex - m_currentFrame.videoFrameIndex - 1);
+                }
+                if (m_interleavedQueue != nullptr && m_currentFrame.videoFrameIndex < packet->videoFrameIndex) {
+                    m_interleavedQueue->addMissingFrames(m_currentFrame.videoFrameIndex + 1,
+                                                         packet->videoFrameIndex - 1);
+                } else {
+                    frameLost(packet->videoFrameIndex, true);
+                }
+            }
         }
         // Prepare FEC related variables.
         newFrame(packet);
@@ -74,6 +130,11 @@ void FECQueue::addVideoPacket(const VideoFrame *packet, int packetSize) {
         m_receivedParityShards[packetIndex]++;
     }
 
+    if (m_recovered) {
+        // Ignore unused parity packets. They are only counted for FEC statistics.
+        return;
+    }
+
     //
     // Copy packet buffer.
     //
@@ -129,6 +190,7 @@ bool FECQueue::reconstruct() {
                                               &m_marks[packet][0],
                                               m_totalShards, ALVR_MAX_VIDEO_BUFFER_SIZE);
         m_recoveredPacket[packet] = true;
+        m_parityConsumed += m_totalDataShards - m_receivedDataShards[packet];
         // We should always provide enough parity to recover the missing data successfully.
         // If this fails, something is probably wrong with our FEC state.
         if (result != 0) {
@@ -143,17 +205,44 @@ bool FECQueue::reconstruct() {
     }
     if (ret) {
         m_recovered = true;
-        bool isIDR = !mIDRProcessed;
-        mUdpManager->sendVideoFrameAck(true, isIDR,
-                                       m_currentFrame.videoFrameIndex, m_currentFrame.videoFrameIndex);
+        if (m_interleavedQueue != nullptr) {
+            handOverFrame();
+        }
+        if (m_lostSlices != 0 && !m_frameBroken &&
+            m_currentFrame.sliceIndex + 1 >= m_currentFrame.sliceCount) {
+            // Last slice was recovered. Report lost slices without waiting for next frame.
+            reportLostSlices();
+            return true;
+        }
+        if (!isFrameComplete()) {
+            // Slice was recovered but some slices are remaining or lost.
+            FrameLog(m_currentFrame.trackingFrameIndex, "[FEC] Slice was recovered. VideoFrameIndex=%llu slice=%d/%d broken=%d",
+                     m_currentFrame.videoFrameIndex, m_currentFrame.sliceIndex, m_currentFrame.sliceCount, m_frameBroken);
+            return true;
+        }
+        if (m_corruptedSince != UINT64_MAX) {
+            LatencyCollector::Instance().corruptReferenceFrame();
+        }
+        // Interleaved FEC queue sends ACK when the frame is released in order.
+        m_ackPending = m_interleavedQueue == nullptr;
         mLastSuccessfulVideoFrame = m_currentFrame.videoFrameIndex;
         FrameLog(m_currentFrame.trackingFrameIndex, "[FEC] Frame was successfully recovered by FEC. VideoFrameIndex=%llu", m_currentFrame.videoFrameIndex);
     }
     return ret;
 }
 
-const char *FECQueue::getFrameBuffer() {
-    return &m_frameBuffer[0];
+void FECQueue::ackFrame(const FrameInfo &info, bool decodable) {
+    if (!m_ackPending) {
+        return;
+    }
+    m_ackPending = false;
+    bool isIDR = info.valid ? info.idr : !mIDRProcessed;
+    mFeedback->sendVideoFrameAck(decodable, isIDR, m_currentFrame.videoFrameIndex,
+                                   m_currentFrame.videoFrameIndex, decodable ? &info : nullptr);
+}
+
+std::vector<char> &FECQueue::getFrameBuffer() {
+    return m_frameBuffer;
 }
 
 int FECQueue::getFrameByteSize() {
@@ -162,6 +251,74 @@ int FECQueue::getFrameByteSize() {
 
 void FECQueue::OnIDRProcessed() {
     mIDRProcessed = true;
+    m_corruptedSince = UINT64_MAX;
+}
+
+bool FECQueue::popConcealedFrame(int *frameByteSize, uint64_t *videoFrameIndex,
+                                 uint64_t *trackingFrameIndex) {
+    if (m_concealedFrameByteSize == 0) {
+        return false;
+    }
+    *frameByteSize = m_concealedFrameByteSize;
+    *videoFrameIndex = m_concealedVideoFrameIndex;
+    *trackingFrameIndex = m_concealedTrackingFrameIndex;
+    m_concealedFrameByteSize = 0;
+    return true;
+}
+
+// Keep leading packets of current frame which have been received or recovered.
+// NALParser cuts it at NAL boundary and hands to decoder.
+void FECQueue::concealFrame() {
+    m_concealedFrameByteSize = 0;
+    if (m_rs == nullptr || !mIDRProcessed || m_currentFrame.sliceCount > 1) {
+        // Sliced frames are already delivered slice by slice.
+        return;
+    }
+    size_t dataPackets = (m_currentFrame.frameByteSize + ALVR_MAX_VIDEO_BUFFER_SIZE - 1) /
+                         ALVR_MAX_VIDEO_BUFFER_SIZE;
+    size_t intactPackets = 0;
+    for (; intactPackets < dataPackets; intactPackets++) {
+        size_t packet = intactPackets % m_shardPackets;
+        if (!m_recoveredPacket[packet] && m_marks[packet][intactPackets / m_shardPackets] != 0) {
+            break;
+        }
+    }
+    if (intactPackets == 0) {
+        return;
+    }
+    m_concealedFrameByteSize = static_cast<int>(std::min<size_t>(
+            intactPackets * ALVR_MAX_VIDEO_BUFFER_SIZE, m_currentFrame.frameByteSize));
+    m_concealedVideoFrameIndex = m_currentFrame.videoFrameIndex;
+    m_concealedTrackingFrameIndex = m_currentFrame.trackingFrameIndex;
+    m_concealedFrameBuffer.swap(m_frameBuffer);
+
+    if (m_corruptedSince == UINT64_MAX) {
+        m_corruptedSince = m_currentFrame.videoFrameIndex;
+    }
+    FrameLog(m_currentFrame.trackingFrameIndex, "[FEC] Concealing frame. videoFrame=%llu intact=%d/%d bytes corruptedSince=%llu",
+             m_currentFrame.videoFrameIndex, m_concealedFrameByteSize, m_currentFrame.frameByteSize,
+             (unsigned long long) m_corruptedSince);
+}
+
+void FECQueue::setSliceLossReport(bool enabled) {
+    m_sliceLossReport = enabled;
+}
+
+void FECQueue::setInterleavedQueue(InterleavedFECQueue *interleavedQueue) {
+    m_interleavedQueue = interleavedQueue;
+}
+
+// Move current frame to interleaved FEC queue. Frame buffer is swapped with pooled one.
+void FECQueue::handOverFrame() {
+    size_t dataPackets = (m_currentFrame.frameByteSize + ALVR_MAX_VIDEO_BUFFER_SIZE - 1) /
+                         ALVR_MAX_VIDEO_BUFFER_SIZE;
+    std::vector<bool> availablePackets(dataPackets);
+    for (size_t i = 0; i < dataPackets; i++) {
+        size_t packet = i % m_shardPackets;
+        availablePackets[i] = m_recovered || m_recoveredPacket[packet] ||
+                              m_marks[packet][i / m_shardPackets] == 0;
+    }
+    m_interleavedQueue->addFrame(m_currentFrame, m_frameBuffer, availablePackets, m_recovered);
 }
 
 void FECQueue::frameLost(uint64_t currentVideoFrame, bool wholeLost) {
@@ -183,7 +340,7 @@ void FECQueue::frameLost(uint64_t currentVideoFrame, bool wholeLost) {
     LatencyCollector::Instance().fecFailure();
 
     bool isIDR = !mIDRProcessed;
-    mUdpManager->sendVideoFrameAck(false, isIDR,
+    mFeedback->sendVideoFrameAck(false, isIDR,
                                    static_cast<uint64_t>(mLastSuccessfulVideoFrame + 1), currentVideoFrame - 1);
     LOG("[FEC] VideoFrameFailed (%s lost): %" PRId64 " - %" PRId64 " IDR=%d Previous=%" PRId64 " Current=%" PRId64,
         wholeLost ? "Whole" : "Partial", mLastSuccessfulVideoFrame + 1, currentVideoFrame - 1, isIDR, currentVideoFrame,
@@ -192,9 +349,109 @@ void FECQueue::frameLost(uint64_t currentVideoFrame, bool wholeLost) {
     mLastSuccessfulVideoFrame = currentVideoFrame - 1;
 }
 
+// Add loss pattern of current slice to the frame. Called when next slice has arrived, so late
+// parity packets are also counted.
+void FECQueue::accumulateSliceStatistics() {
+    if (m_rs == nullptr) {
+        return;
+    }
+    size_t maxMissingShards = 0;
+    size_t parityShardsReceived = 0;
+    for (size_t packet = 0; packet < m_shardPackets; packet++) {
+        size_t received = m_receivedDataShards[packet] + m_receivedParityShards[packet];
+        maxMissingShards = std::max(maxMissingShards, m_totalShards - std::min(received, m_totalShards));
+        parityShardsReceived += m_receivedParityShards[packet];
+    }
+
+    FrameStatistics &statistics = m_frameStatistics;
+    if (statistics.slices == 0 ||
+        maxMissingShards * statistics.totalShards > statistics.maxMissingShards * m_totalShards) {
+        statistics.dataShards = m_totalDataShards;
+        statistics.totalShards = m_totalShards;
+        statistics.maxMissingShards = maxMissingShards;
+    }
+    if (statistics.slices == 0) {
+        statistics.recovered = true;
+    }
+    statistics.slices++;
+    statistics.parityShardsReceived += parityShardsReceived;
+    statistics.parityConsumed += m_parityConsumed;
+    statistics.recovered = statistics.recovered && m_recovered;
+}
+
+// Report loss pattern of current frame to FECController. Called when next frame has arrived.
+void FECQueue::reportFrameStatistics() {
+    const FrameStatistics &statistics = m_frameStatistics;
+    if (statistics.slices > 0) {
+        mFeedback->getFecController().onFrameFinished(
+                static_cast<uint32_t>(statistics.dataShards),
+                static_cast<uint32_t>(statistics.totalShards),
+                static_cast<uint32_t>(statistics.maxMissingShards),
+                static_cast<uint32_t>(statistics.parityShardsReceived),
+                static_cast<uint32_t>(statistics.parityConsumed), statistics.recovered,
+                m_currentFrame.fecPercentage, m_currentFrame.frameType);
+        LatencyCollector::Instance().fecResult(m_currentFrame.frameType, statistics.recovered,
+                                               statistics.parityConsumed > 0);
+    }
+    m_frameStatistics = {};
+}
+
+// All slices of current frame have been recovered.
+bool FECQueue::isFrameComplete() const {
+    return m_recovered && !m_frameBroken && m_lostSlices == 0 &&
+           m_currentFrame.sliceIndex + 1 >= m_currentFrame.sliceCount;
+}
+
+void FECQueue::markSliceLost(uint32_t firstSlice, uint32_t lastSlice) {
+    // Parameter sets and IDR should be delivered in whole, so slice loss before first IDR breaks frame.
+    if (!m_sliceLossReport || !mIDRProcessed || lastSlice >= ALVR_SLICE_LOSS_REPORT_MAX) {
+        m_frameBroken = true;
+        return;
+    }
+    for (uint32_t slice = firstSlice; slice <= lastSlice; slice++) {
+        m_lostSlices |= 1ULL << slice;
+    }
+}
+
+// Mark slices of current frame which have not been recovered as lost. Called on switching to next frame.
+void FECQueue::finishFrameSlices() {
+    if (!m_recovered) {
+        markSliceLost(m_currentFrame.sliceIndex, m_currentFrame.sliceIndex);
+    }
+    if (m_currentFrame.sliceIndex + 1 < m_currentFrame.sliceCount) {
+        markSliceLost(m_currentFrame.sliceIndex + 1u, m_currentFrame.sliceCount - 1u);
+    }
+}
+
+// Intact slices have been handed to decoder. Server repairs lost regions, so the frame is not NACKed.
+void FECQueue::reportLostSlices() {
+    FrameLog(m_currentFrame.trackingFrameIndex, "[FEC] Slices were lost. videoFrame=%llu sliceCount=%d lostSlices=%016llx",
+             m_currentFrame.videoFrameIndex, m_currentFrame.sliceCount,
+             (unsigned long long) m_lostSlices);
+
+    LatencyCollector::Instance().sliceLoss(static_cast<uint32_t>(__builtin_popcountll(m_lostSlices)));
+
+    mFeedback->sendVideoSliceLoss(m_currentFrame.videoFrameIndex, m_currentFrame.sliceCount,
+                                    m_lostSlices);
+    mLastSuccessfulVideoFrame = m_currentFrame.videoFrameIndex;
+    m_sliceLossReported = true;
+}
+
 void FECQueue::newFrame(const VideoFrame *packet) {
+    bool leadingSlicesLost = false;
+    if (m_currentFrame.videoFrameIndex != packet->videoFrameIndex) {
+        m_frameBroken = false;
+        m_lostSlices = 0;
+        m_sliceLossReported = false;
+        // Leading slices were lost when the frame starts from middle.
+        leadingSlicesLost = packet->sliceIndex != 0;
+    }
     m_currentFrame = *packet;
+    if (leadingSlicesLost) {
+        markSliceLost(0, m_currentFrame.sliceIndex - 1u);
+    }
     m_recovered = false;
+    m_parityConsumed = 0;
     if (m_rs != nullptr) {
         reed_solomon_release(m_rs);
     }
@@ -246,8 +503,9 @@ void FECQueue::newFrame(const VideoFrame *packet) {
     }
 
     FrameLog(m_currentFrame.trackingFrameIndex,
-             "Start new frame. videoFrame=%llu frameByteSize=%d fecPercentage=%d m_totalDataShards=%u m_totalParityShards=%u"
+             "Start new frame. videoFrame=%llu slice=%d/%d frameType=%d frameByteSize=%d fecPercentage=%d m_totalDataShards=%u m_totalParityShards=%u"
              " m_totalShards=%u m_shardPackets=%u m_blockSize=%u",
-             m_currentFrame.videoFrameIndex, m_currentFrame.frameByteSize, m_currentFrame.fecPercentage, m_totalDataShards,
+             m_currentFrame.videoFrameIndex, m_currentFrame.sliceIndex, m_currentFrame.sliceCount,
+             m_currentFrame.frameType, m_currentFrame.frameByteSize, m_currentFrame.fecPercentage, m_totalDataShards,
              m_totalParityShards, m_totalShards, m_shardPackets, m_blockSize);
 }
@@ -5,24 +5,57 @@
 #include <vector>
 #include "packet_types.h"
 #include "reedsolomon/rs.h"
+#include "fec_interleave.h"
+#include "slice_header.h"
 
-class UdpManager;
+class VideoFeedback;
 
 class FECQueue {
 public:
-    FECQueue(UdpManager *udpManager);
+    FECQueue(VideoFeedback *feedback);
     ~FECQueue();
 
     void reset();
 
     void addVideoPacket(const VideoFrame *packet, int packetSize);
     bool reconstruct();
-    const char *getFrameBuffer();
+    // ACK of completed frame is deferred until NALParser has parsed its slice header.
+    // Does nothing if no ACK is pending.
+    // Frame which is not decodable is NACKed, so that the server does not refer to it.
+    void ackFrame(const FrameInfo &info, bool decodable = true);
+    // Buffer can be taken by swap after the frame (or slice) has been recovered.
+    std::vector<char> &getFrameBuffer();
     int getFrameByteSize();
+    // Header of current FEC group. It is a slice of frame when sliceCount > 1.
+    const VideoFrame &getCurrentFrame() const {
+        return m_currentFrame;
+    }
+    // Some slice of current frame has been lost. Following slices are not decodable.
+    bool isFrameBroken() const {
+        return m_frameBroken;
+    }
+
+    // Intact prefix of the last unrecoverable frame when error concealment is enabled.
+    // Returns false if there is no such frame. Buffer is valid until next addVideoPacket.
+    bool popConcealedFrame(int *frameByteSize, uint64_t *videoFrameIndex,
+                           uint64_t *trackingFrameIndex);
+    std::vector<char> &getConcealedFrameBuffer() {
+        return m_concealedFrameBuffer;
+    }
+    // Some reference frame has been concealed and no IDR has been decoded since then.
+    bool isReferenceCorrupt() const {
+        return m_corruptedSince != UINT64_MAX;
+    }
 
     void OnIDRProcessed();
+
+    // Keep intact slices of partially lost frame and report lost slices instead of NACK.
+    void setSliceLossReport(bool enabled);
+
+    // Hand over finished frames to interleaved FEC instead of reporting loss immediately.
+    void setInterleavedQueue(InterleavedFECQueue *interleavedQueue);
 private:
-    UdpManager *mUdpManager;
+    VideoFeedback *mFeedback;
 
     VideoFrame m_currentFrame;
     size_t m_shardPackets;
@@ -37,14 +70,52 @@ private:
     std::vector<bool> m_recoveredPacket;
     std::vector<char *> m_shards;
     bool m_recovered;
+    bool m_frameBroken;
+    bool m_sliceLossReport = false;
+    // Bitmap of lost slices of current frame. Only used with slice loss report.
+    uint64_t m_lostSlices;
+    bool m_sliceLossReported;
+    // Number of data shards rebuilt from parity in current frame.
+    size_t m_parityConsumed;
+    // Shard statistics of finished slices of current frame. Reported once per frame.
+    // Each slice is its own FEC group, so the loss rate is taken from the slice which lost the
+    // largest part of a column.
+    struct FrameStatistics {
+        size_t slices;
+        size_t dataShards;
+        size_t totalShards;
+        size_t maxMissingShards;
+        size_t parityShardsReceived;
+        size_t parityConsumed;
+        bool recovered;
+    };
+    FrameStatistics m_frameStatistics = {};
     reed_solomon *m_rs = nullptr;
     int64_t mLastSuccessfulVideoFrame;
     bool mIDRProcessed;
+    bool m_ackPending;
+    InterleavedFECQueue *m_interleavedQueue = nullptr;
+
+    // Swapped with m_frameBuffer on concealment to avoid copy.
+    std::vector<char> m_concealedFrameBuffer;
+    int m_concealedFrameByteSize;
+    uint64_t m_concealedVideoFrameIndex;
+    uint64_t m_concealedTrackingFrameIndex;
+    // First concealed video frame since last IDR. UINT64_MAX if references are intact.
+    uint64_t m_corruptedSince;
 
     static bool reed_solomon_initialized;
 
+    bool isFrameComplete() const;
+    void markSliceLost(uint32_t firstSlice, uint32_t lastSlice);
+    void finishFrameSlices();
+    void reportLostSlices();
+    void concealFrame();
     void newFrame(const VideoFrame *packet);
     void frameLost(uint64_t currentVideoFrame, bool wholeLost);
+    void accumulateSliceStatistics();
+    void reportFrameStatistics();
+    void handOverFrame();
 };
 
 #endif //ALVRCLIENT_FEC_H
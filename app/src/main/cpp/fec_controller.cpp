@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <math.h>
+#include "fec_controller.h"
+#include "utils.h"
+
+const size_t FECController::WINDOW_FRAMES;
+const size_t FECController::MIN_WINDOW_FRAMES;
+const uint16_t FECController::DECREASE_STEP;
+const uint16_t FECController::MIN_FEC_PERCENTAGE;
+const uint16_t FECController::MAX_FEC_PERCENTAGE;
+
+FECController::FECController() : m_required(WINDOW_FRAMES) {
+    reset();
+}
+
+void FECController::reset() {
+    m_requiredHead = 0;
+    m_requiredCount = 0;
+
+    m_currentFecPercentage = 0;
+    m_recommended = 0;
+    m_recommendedIdr = 0;
+
+    m_frames = 0;
+    m_framesLost = 0;
+    m_framesRecovered = 0;
+    m_parityShardsReceived = 0;
+    m_parityShardsConsumed = 0;
+    m_maxMissingShards = 0;
+    m_idrFrames = 0;
+    m_idrFramesLost = 0;
+    m_idrFramesRecovered = 0;
+    m_burstFramesLost = 0;
+}
+
+void FECController::setUnequalErrorProtection(bool enabled) {
+    m_unequalErrorProtection = enabled;
+}
+
+void FECController::onFrameFinished(uint32_t dataShards, uint32_t totalShards,
+                                    uint32_t maxMissingShards, uint32_t parityShardsReceived,
+                                    uint32_t parityShardsConsumed, bool recovered,
+                                    uint16_t fecPercentage, uint8_t frameType) {
+    if (frameType == ALVR_VIDEO_FRAME_TYPE_IDR) {
+        m_idrFrames++;
+        if (!recovered) {
+            m_idrFramesLost++;
+        } else if (parityShardsConsumed > 0) {
+            m_idrFramesRecovered++;
+        }
+    } else {
+        // Under UEP, fecPercentage of IDR frame is not what we recommend for normal frames.
+        m_currentFecPercentage = fecPercentage;
+    }
+
+    m_frames++;
+    if (!recovered) {
+        m_framesLost++;
+    } else if (parityShardsConsumed > 0) {
+        m_framesRecovered++;
+    }
+    m_parityShardsReceived += parityShardsReceived;
+    m_parityShardsConsumed += parityShardsConsumed;
+    m_maxMissingShards = std::max(m_maxMissingShards, maxMissingShards);
+
+    if (maxMissingShards == 0 || dataShards == 0) {
+        pushRequired(0);
+        return;
+    }
+    if (maxMissingShards >= totalShards) {
+        m_burstFramesLost++;
+        return;
+    }
+    // Parity shards are lost at the same rate as data shards.
+    // So we need P parity shards to satisfy P >= lossRate * (D + P).
+    double lossRate = (double) maxMissingShards / totalShards;
+    double parityShards = ceil(lossRate * dataShards / (1.0 - lossRate));
+    double required = ceil(parityShards * 100.0 / dataShards);
+    pushRequired(static_cast<uint16_t>(std::min<double>(required, MAX_FEC_PERCENTAGE)));
+}
+
+void FECController::onFramesLost(uint64_t count) {
+    uint32_t frames = static_cast<uint32_t>(std::min<uint64_t>(count, UINT32_MAX));
+    m_frames += frames;
+    m_framesLost += frames;
+    m_burstFramesLost += frames;
+}
+
+void FECController::fillFeedback(FecFeedback *feedback) {
+    // Loss pattern is property of network, so IDR frames share the same samples with stricter target.
+    m_recommended = calculateRecommendation(TARGET_RESIDUAL_LOSS, m_recommended);
+    if (m_unequalErrorProtection) {
+        m_recommendedIdr = calculateRecommendation(TARGET_IDR_RESIDUAL_LOSS, m_recommendedIdr);
+    } else {
+        m_recommendedIdr = m_recommended;
+    }
+
+    feedback->type = ALVR_PACKET_TYPE_FEC_FEEDBACK;
+    feedback->recommendedFecPercentage = m_recommended;
+    feedback->currentFecPercentage = m_currentFecPercentage;
+    feedback->frames = m_frames;
+    feedback->framesLost = m_framesLost;
+    feedback->framesRecovered = m_framesRecovered;
+    feedback->parityShardsReceived = m_parityShardsReceived;
+    feedback->parityShardsConsumed = m_parityShardsConsumed;
+    feedback->maxMissingShards = m_maxMissingShards;
+    feedback->recommendedIdrFecPercentage = m_recommendedIdr;
+    feedback->idrFrames = m_idrFrames;
+    feedback->idrFramesLost = m_idrFramesLost;
+    feedback->idrFramesRecovered = m_idrFramesRecovered;
+    feedback->burstFramesLost = m_burstFramesLost;
+
+    LOG("FEC feedback. recommended=%d(IDR %d) current=%d frames=%d lost=%d recovered=%d parity=%d/%d maxMissing=%d"
+        " IDR frames=%d lost=%d recovered=%d burstLost=%d",
+        m_recommended, m_recommendedIdr, m_currentFecPercentage, m_frames, m_framesLost,
+        m_framesRecovered, m_parityShardsConsumed, m_parityShardsReceived, m_maxMissingShards,
+        m_idrFrames, m_idrFramesLost, m_idrFramesRecovered, m_burstFramesLost);
+
+    m_frames = 0;
+    m_framesLost = 0;
+    m_framesRecovered = 0;
+    m_parityShardsReceived = 0;
+    m_parityShardsConsumed = 0;
+    m_maxMissingShards = 0;
+    m_idrFrames = 0;
+    m_idrFramesLost = 0;
+    m_idrFramesRecovered = 0;
+    m_burstFramesLost = 0;
+}
+
+void FECController::pushRequired(uint16_t fecPercentage) {
+    m_required[m_requiredHead] = fecPercentage;
+    m_requiredHead = (m_requiredHead + 1) % WINDOW_FRAMES;
+    m_requiredCount = std::min(m_requiredCount + 1, WINDOW_FRAMES);
+}
+
+uint16_t FECController::calculateRecommendation(double targetResidualLoss, uint16_t previous) {
+    if (m_requiredCount < MIN_WINDOW_FRAMES) {
+        // Not enough samples. Keep server setting.
+        return m_currentFecPercentage;
+    }
+    std::vector<uint16_t> sorted(m_required.begin(), m_required.begin() + m_requiredCount);
+    // Frames requiring more than the percentile are allowed to be lost.
+    size_t index = std::min(m_requiredCount - 1,
+                            static_cast<size_t>(m_requiredCount * (1.0 - targetResidualLoss)));
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    uint16_t target = std::max(sorted[index], MIN_FEC_PERCENTAGE);
+
+    if (previous == 0 || target >= previous) {
+        return target;
+    }
+    // Lower slowly to avoid oscillation on bursty links.
+    return std::max<uint16_t>(target, previous - std::min(previous, DECREASE_STEP));
+}
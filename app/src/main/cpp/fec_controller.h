@@ -0,0 +1,79 @@
+#ifndef ALVRCLIENT_FEC_CONTROLLER_H
+#define ALVRCLIENT_FEC_CONTROLLER_H
+
+#include <stdint.h>
+#include <vector>
+#include "packet_types.h"
+
+// Estimate loss burst statistics from FECQueue outcomes and recommend FEC percentage to server.
+// For each frame, we calculate minimum FEC percentage which could have recovered the frame
+// and recommend the percentile of it which corresponds to target residual frame loss rate.
+// Frames lost as a whole or with a whole column missing can not be recovered by any FEC
+// percentage, so they are reported as burst losses and kept out of the percentile. Otherwise a
+// few of them would pin the recommendation at 100% and add load to a congested link.
+class FECController {
+public:
+    FECController();
+
+    void reset();
+
+    // Called by FECQueue when all packets of a frame have been processed.
+    // maxMissingShards: largest number of shards missing in one column (totalShards = data + parity).
+    void onFrameFinished(uint32_t dataShards, uint32_t totalShards, uint32_t maxMissingShards,
+                         uint32_t parityShardsReceived, uint32_t parityShardsConsumed,
+                         bool recovered, uint16_t fecPercentage, uint8_t frameType);
+    // Called by FECQueue when no packet of the frames has arrived.
+    void onFramesLost(uint64_t count);
+
+    // Recommend stronger protection for IDR frames. (Unequal error protection)
+    void setUnequalErrorProtection(bool enabled);
+
+    // Fill feedback packet and start new statistics period.
+    void fillFeedback(FecFeedback *feedback);
+
+    uint16_t getRecommendedFecPercentage() const {
+        return m_recommended;
+    }
+private:
+    // Residual frame loss rate which we try to achieve.
+    static constexpr double TARGET_RESIDUAL_LOSS = 0.005;
+    // Losing IDR frame results in another IDR frame. So we try to avoid it at all.
+    static constexpr double TARGET_IDR_RESIDUAL_LOSS = 0.0005;
+    // Number of frames used for percentile calculation. (About 8 seconds on 72Hz)
+    static const size_t WINDOW_FRAMES = 600;
+    // Don't recommend anything until we have observed enough frames.
+    static const size_t MIN_WINDOW_FRAMES = 60;
+    // Recommendation is raised immediately but lowered gradually on each feedback.
+    static const uint16_t DECREASE_STEP = 2;
+
+    // 1% always gives one parity shard per column, because parity shards are rounded up.
+    static const uint16_t MIN_FEC_PERCENTAGE = 1;
+    static const uint16_t MAX_FEC_PERCENTAGE = 100;
+
+    // Required FEC percentage of recent frames. (ring buffer)
+    std::vector<uint16_t> m_required;
+    size_t m_requiredHead;
+    size_t m_requiredCount;
+
+    uint16_t m_currentFecPercentage;
+    uint16_t m_recommended;
+    uint16_t m_recommendedIdr;
+    bool m_unequalErrorProtection = false;
+
+    // Statistics since previous feedback.
+    uint32_t m_frames;
+    uint32_t m_framesLost;
+    uint32_t m_framesRecovered;
+    uint32_t m_parityShardsReceived;
+    uint32_t m_parityShardsConsumed;
+    uint32_t m_maxMissingShards;
+    uint32_t m_idrFrames;
+    uint32_t m_idrFramesLost;
+    uint32_t m_idrFramesRecovered;
+    uint32_t m_burstFramesLost;
+
+    void pushRequired(uint16_t fecPercentage);
+    uint16_t calculateRecommendation(double targetResidualLoss, uint16_t previous);
+};
+
+#endif //ALVRCLIENT_FEC_CONTROLLER_H
@@ -0,0 +1,361 @@
+#include <algorithm>
+#include <inttypes.h>
+#include "fec_interleave.h"
+#include "utils.h"
+#include "video_feedback.h"
+#include "latency_collector.h"
+
+InterleavedFECQueue::InterleavedFECQueue(VideoFeedback *feedback) : mFeedback(feedback),
+                                                                    m_pool(POOL_FRAMES) {
+    reset();
+}
+
+void InterleavedFECQueue::reset() {
+    for (auto &frame : m_pool) {
+        frame.state = Frame::STATE_UNUSED;
+        frame.released = true;
+    }
+    m_nextReleaseFrame = UINT64_MAX;
+    m_newestFrame = UINT64_MAX;
+
+    m_group.startVideoFrameIndex = UINT64_MAX;
+    m_group.receivedParityShards = 0;
+    m_group.resolved = true;
+
+    mIDRProcessed = false;
+}
+
+void InterleavedFECQueue::setDepth(int depth) {
+    m_depth = std::min(depth, ALVR_INTERLEAVED_FEC_FRAMES_MAX);
+    LOGI("Interleaved FEC depth=%d", m_depth);
+    reset();
+}
+
+void InterleavedFECQueue::OnIDRProcessed() {
+    mIDRProcessed = true;
+}
+
+void InterleavedFECQueue::addFrame(const VideoFrame &frame, std::vector<char> &frameBuffer,
+                                   const std::vector<bool> &availablePackets, bool complete) {
+    Frame *slot = findFrame(frame.videoFrameIndex);
+    if (slot == nullptr) {
+        slot = allocateFrame(frame.videoFrameIndex);
+    }
+    slot->trackingFrameIndex = frame.trackingFrameIndex;
+    slot->frameType = frame.frameType;
+    slot->frameByteSize = frame.frameByteSize;
+    slot->frameBuffer.swap(frameBuffer);
+    slot->availablePackets = availablePackets;
+
+    // Parity is calculated on zero padded shards.
+    size_t paddedSize = (frame.frameByteSize + ALVR_INTERLEAVED_FEC_SHARD_SIZE - 1) /
+                        ALVR_INTERLEAVED_FEC_SHARD_SIZE * ALVR_INTERLEAVED_FEC_SHARD_SIZE;
+    if (slot->frameBuffer.size() < paddedSize) {
+        slot->frameBuffer.resize(paddedSize);
+    }
+    memset(slot->frameBuffer.data() + frame.frameByteSize, 0, paddedSize - frame.frameByteSize);
+
+    slot->state = complete ? Frame::STATE_COMPLETE : Frame::STATE_PENDING;
+    slot->ackPending = complete;
+
+    onNewFrame(frame.videoFrameIndex);
+    tryRecover();
+}
+
+void InterleavedFECQueue::addMissingFrames(uint64_t startVideoFrame, uint64_t endVideoFrame) {
+    if (endVideoFrame - startVideoFrame + 1 > POOL_FRAMES) {
+        // Too long burst. We can't keep track of all frames.
+        uint64_t skipEnd = endVideoFrame - POOL_FRAMES;
+        LatencyCollector::Instance().fecFailure();
+        mFeedback->sendVideoFrameAck(false, !mIDRProcessed, startVideoFrame, skipEnd);
+        startVideoFrame = skipEnd + 1;
+    }
+    for (uint64_t videoFrameIndex = startVideoFrame; videoFrameIndex <= endVideoFrame; videoFrameIndex++) {
+        if (findFrame(videoFrameIndex) == nullptr) {
+            allocateFrame(videoFrameIndex);
+        }
+        onNewFrame(videoFrameIndex);
+    }
+    tryRecover();
+}
+
+void InterleavedFECQueue::addParityPacket(const VideoInterleavedParity *packet,
+                                          size_t packetSize) {
+    if (!isEnabled() || packetSize < sizeof(VideoInterleavedParity)) {
+        return;
+    }
+    if (packet->frameCount == 0 || packet->frameCount > ALVR_INTERLEAVED_FEC_FRAMES_MAX ||
+        packet->parityIndex >= packet->parityShards) {
+        LOGE("Invalid interleaved parity packet. frameCount=%d parityIndex=%d parityShards=%d",
+             packet->frameCount, packet->parityIndex, packet->parityShards);
+        return;
+    }
+
+    if (m_group.startVideoFrameIndex != packet->startVideoFrameIndex) {
+        // Parity of new group. Unresolved frames of previous group will expire.
+        m_group.startVideoFrameIndex = packet->startVideoFrameIndex;
+        m_group.header = *packet;
+        m_group.parity.resize(packet->parityShards * ALVR_INTERLEAVED_FEC_SHARD_SIZE);
+        m_group.parityMarks.assign(packet->parityShards, 1);
+        m_group.receivedParityShards = 0;
+        m_group.resolved = false;
+    }
+    if (m_group.resolved || packet->parityShards != m_group.header.parityShards ||
+        m_group.parityMarks[packet->parityIndex] == 0) {
+        return;
+    }
+
+    char *p = &m_group.parity[packet->parityIndex * ALVR_INTERLEAVED_FEC_SHARD_SIZE];
+    int payloadSize = std::min(static_cast<int>(packetSize - sizeof(VideoInterleavedParity)),
+                               ALVR_INTERLEAVED_FEC_SHARD_SIZE);
+    memcpy(p, reinterpret_cast<const char *>(packet) + sizeof(VideoInterleavedParity), payloadSize);
+    memset(p + payloadSize, 0, ALVR_INTERLEAVED_FEC_SHARD_SIZE - payloadSize);
+
+    m_group.parityMarks[packet->parityIndex] = 0;
+    m_group.receivedParityShards++;
+
+    tryRecover();
+}
+
+InterleavedFECQueue::Frame *InterleavedFECQueue::peekReadyFrame() {
+    while (m_nextReleaseFrame != UINT64_MAX) {
+        Frame *frame = findFrame(m_nextReleaseFrame);
+        if (frame == nullptr) {
+            // Frame was evicted from pool. Continue from oldest unreleased frame.
+            Frame *oldest = nullptr;
+            for (auto &f : m_pool) {
+                if (f.state != Frame::STATE_UNUSED && !f.released &&
+                    f.videoFrameIndex > m_nextReleaseFrame &&
+                    (oldest == nullptr || f.videoFrameIndex < oldest->videoFrameIndex)) {
+                    oldest = &f;
+                }
+            }
+            if (oldest == nullptr) {
+                return nullptr;
+            }
+            m_nextReleaseFrame = oldest->videoFrameIndex;
+            continue;
+        }
+        if (frame->state == Frame::STATE_PENDING) {
+            // Wait for interleaved parity.
+            return nullptr;
+        }
+        if (frame->released || frame->state == Frame::STATE_LOST) {
+            frame->released = true;
+            m_nextReleaseFrame++;
+            continue;
+        }
+        return frame;
+    }
+    return nullptr;
+}
+
+void InterleavedFECQueue::popReadyFrame() {
+    Frame *frame = findFrame(m_nextReleaseFrame);
+    if (frame != nullptr) {
+        frame->released = true;
+    }
+    m_nextReleaseFrame++;
+}
+
+void InterleavedFECQueue::ackFrame(Frame *frame, const FrameInfo &info, bool decodable) {
+    if (!frame->ackPending) {
+        return;
+    }
+    frame->ackPending = false;
+    bool isIDR = info.valid ? info.idr : !mIDRProcessed;
+    mFeedback->sendVideoFrameAck(decodable, isIDR, frame->videoFrameIndex,
+                                   frame->videoFrameIndex, decodable ? &info : nullptr);
+}
+
+InterleavedFECQueue::Frame *InterleavedFECQueue::findFrame(uint64_t videoFrameIndex) {
+    for (auto &frame : m_pool) {
+        if (frame.state != Frame::STATE_UNUSED && frame.videoFrameIndex == videoFrameIndex) {
+            return &frame;
+        }
+    }
+    return nullptr;
+}
+
+InterleavedFECQueue::Frame *InterleavedFECQueue::allocateFrame(uint64_t videoFrameIndex) {
+    // Reuse unused or oldest frame. Buffers are kept for next frames.
+    Frame *victim = nullptr;
+    for (auto &frame : m_pool) {
+        if (frame.state == Frame::STATE_UNUSED) {
+            victim = &frame;
+            break;
+        }
+        if (victim == nullptr || frame.videoFrameIndex < victim->videoFrameIndex) {
+            victim = &frame;
+        }
+    }
+    if (victim->state == Frame::STATE_PENDING) {
+        frameLost(victim);
+    }
+    victim->videoFrameIndex = videoFrameIndex;
+    victim->trackingFrameIndex = 0;
+    victim->frameType = ALVR_VIDEO_FRAME_TYPE_UNKNOWN;
+    victim->frameByteSize = 0;
+    victim->availablePackets.clear();
+    victim->state = Frame::STATE_PENDING;
+    victim->released = false;
+    victim->ackPending = false;
+    return victim;
+}
+
+void InterleavedFECQueue::onNewFrame(uint64_t videoFrameIndex) {
+    if (m_nextReleaseFrame == UINT64_MAX) {
+        m_nextReleaseFrame = videoFrameIndex;
+    }
+    if (m_newestFrame == UINT64_MAX || m_newestFrame < videoFrameIndex) {
+        m_newestFrame = videoFrameIndex;
+    }
+    expirePendingFrames();
+}
+
+// Parity of a group is sent just after the last frame of the group.
+// So if FECQueue has finished a frame of next group, the parity is lost or insufficient.
+void InterleavedFECQueue::expirePendingFrames() {
+    for (auto &frame : m_pool) {
+        if (frame.state != Frame::STATE_PENDING) {
+            continue;
+        }
+        uint64_t groupEnd = (frame.videoFrameIndex / m_depth + 1) * m_depth - 1;
+        if (m_newestFrame > groupEnd) {
+            frameLost(&frame);
+        }
+    }
+}
+
+void InterleavedFECQueue::frameLost(Frame *frame) {
+    FrameLog(frame->trackingFrameIndex,
+             "[FEC] Frame cannot be recovered by interleaved parity. videoFrame=%" PRIu64,
+             frame->videoFrameIndex);
+    frame->state = Frame::STATE_LOST;
+
+    LatencyCollector::Instance().fecFailure();
+    mFeedback->sendVideoFrameAck(false, !mIDRProcessed, frame->videoFrameIndex,
+                                   frame->videoFrameIndex);
+}
+
+bool InterleavedFECQueue::isShardAvailable(const Frame *frame, size_t shard) {
+    if (frame->state == Frame::STATE_COMPLETE) {
+        return true;
+    }
+    size_t begin = shard * ALVR_INTERLEAVED_FEC_SHARD_SIZE;
+    size_t end = std::min<size_t>(begin + ALVR_INTERLEAVED_FEC_SHARD_SIZE, frame->frameByteSize);
+    for (size_t packet = begin / ALVR_MAX_VIDEO_BUFFER_SIZE;
+         packet <= (end - 1) / ALVR_MAX_VIDEO_BUFFER_SIZE; packet++) {
+        if (packet >= frame->availablePackets.size() || !frame->availablePackets[packet]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void InterleavedFECQueue::tryRecover() {
+    if (m_group.resolved) {
+        return;
+    }
+    const VideoInterleavedParity &header = m_group.header;
+
+    Frame *frames[ALVR_INTERLEAVED_FEC_FRAMES_MAX];
+    size_t frameShards[ALVR_INTERLEAVED_FEC_FRAMES_MAX];
+    size_t dataShards = 0;
+    size_t missingShards = 0;
+    for (int i = 0; i < header.frameCount; i++) {
+        frames[i] = findFrame(m_group.startVideoFrameIndex + i);
+        if (frames[i] == nullptr) {
+            // FECQueue has not finished this frame yet.
+            return;
+        }
+        if (frames[i]->state != Frame::STATE_COMPLETE && frames[i]->frameByteSize == 0) {
+            // Whole frame was lost. Parity header tells us what it was.
+            frames[i]->frameByteSize = header.frameByteSize[i];
+            frames[i]->trackingFrameIndex = header.trackingFrameIndex[i];
+            frames[i]->frameBuffer.assign(
+                    (header.frameByteSize[i] + ALVR_INTERLEAVED_FEC_SHARD_SIZE - 1) /
+                    ALVR_INTERLEAVED_FEC_SHARD_SIZE * ALVR_INTERLEAVED_FEC_SHARD_SIZE, 0);
+            frames[i]->availablePackets.clear();
+        }
+        if (frames[i]->frameByteSize != header.frameByteSize[i]) {
+            LOGE("Interleaved parity does not match frame. videoFrame=%" PRIu64 " size=%d expected=%d",
+                 frames[i]->videoFrameIndex, frames[i]->frameByteSize, header.frameByteSize[i]);
+            m_group.resolved = true;
+            return;
+        }
+        frameShards[i] = (frames[i]->frameByteSize + ALVR_INTERLEAVED_FEC_SHARD_SIZE - 1) /
+                         ALVR_INTERLEAVED_FEC_SHARD_SIZE;
+        dataShards += frameShards[i];
+        for (size_t shard = 0; shard < frameShards[i]; shard++) {
+            if (!isShardAvailable(frames[i], shard)) {
+                missingShards++;
+            }
+        }
+    }
+
+    if (missingShards == 0) {
+        m_group.resolved = true;
+        return;
+    }
+    if (dataShards == 0 || dataShards + header.parityShards > DATA_SHARDS_MAX) {
+        LOGE("Invalid interleaved parity group. dataShards=%zu parityShards=%d", dataShards,
+             header.parityShards);
+        m_group.resolved = true;
+        return;
+    }
+    if (m_group.receivedParityShards < missingShards) {
+        // Wait for more parity.
+        return;
+    }
+
+    size_t totalShards = dataShards + header.parityShards;
+    std::vector<unsigned char *> shards(totalShards);
+    std::vector<unsigned char> marks(totalShards);
+    size_t index = 0;
+    for (int i = 0; i < header.frameCount; i++) {
+        for (size_t shard = 0; shard < frameShards[i]; shard++) {
+            shards[index] = reinterpret_cast<unsigned char *>(
+                    &frames[i]->frameBuffer[shard * ALVR_INTERLEAVED_FEC_SHARD_SIZE]);
+            marks[index] = static_cast<unsigned char>(isShardAvailable(frames[i], shard) ? 0 : 1);
+            index++;
+        }
+    }
+    for (int i = 0; i < header.parityShards; i++) {
+        shards[index] = reinterpret_cast<unsigned char *>(
+                &m_group.parity[i * ALVR_INTERLEAVED_FEC_SHARD_SIZE]);
+        marks[index] = m_group.parityMarks[i];
+        index++;
+    }
+
+    reed_solomon *rs = reed_solomon_new(static_cast<int>(dataShards), header.parityShards);
+    if (rs == nullptr) {
+        m_group.resolved = true;
+        return;
+    }
+    int result = reed_solomon_reconstruct(rs, &shards[0], &marks[0], static_cast<int>(totalShards),
+                                          ALVR_INTERLEAVED_FEC_SHARD_SIZE);
+    reed_solomon_release(rs);
+    m_group.resolved = true;
+
+    if (result != 0) {
+        LOGE("reed_solomon_reconstruct failed on interleaved parity.");
+        return;
+    }
+
+    for (int i = 0; i < header.frameCount; i++) {
+        if (frames[i]->state != Frame::STATE_PENDING) {
+            continue;
+        }
+        frames[i]->state = Frame::STATE_COMPLETE;
+        frames[i]->availablePackets.assign(
+                (frames[i]->frameByteSize + ALVR_MAX_VIDEO_BUFFER_SIZE - 1) / ALVR_MAX_VIDEO_BUFFER_SIZE,
+                true);
+
+        LatencyCollector::Instance().receivedLast(frames[i]->trackingFrameIndex);
+        frames[i]->ackPending = true;
+        FrameLog(frames[i]->trackingFrameIndex,
+                 "[FEC] Frame was recovered by interleaved parity. videoFrame=%" PRIu64,
+                 frames[i]->videoFrameIndex);
+    }
+}
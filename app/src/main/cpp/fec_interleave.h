@@ -0,0 +1,94 @@
+#ifndef ALVRCLIENT_FEC_INTERLEAVE_H
+#define ALVRCLIENT_FEC_INTERLEAVE_H
+
+#include <vector>
+#include "packet_types.h"
+#include "reedsolomon/rs.h"
+#include "slice_header.h"
+
+class VideoFeedback;
+
+// Recover frames which could not be recovered by FECQueue, using parity shards which cover
+// multiple consecutive frames (VideoInterleavedParity).
+// Frames are kept in bounded pool until their group is resolved, and handed to decoder in order
+// of videoFrameIndex. Frames following unresolved frame are held until recovery or timeout.
+class InterleavedFECQueue {
+public:
+    struct Frame {
+        uint64_t videoFrameIndex;
+        uint64_t trackingFrameIndex;
+        // enum ALVR_VIDEO_FRAME_TYPE signalled by server. UNKNOWN when no packet of the frame has
+        // arrived.
+        uint8_t frameType;
+        // 0 when no packet of the frame has arrived.
+        uint32_t frameByteSize;
+        std::vector<char> frameBuffer;
+        // Availability of each ALVR_MAX_VIDEO_BUFFER_SIZE bytes chunk of frameBuffer.
+        std::vector<bool> availablePackets;
+
+        enum State {
+            STATE_UNUSED,
+            STATE_PENDING,
+            STATE_COMPLETE,
+            STATE_LOST
+        };
+        State state;
+        // Already handed to decoder or skipped.
+        bool released;
+        // Arrived or recovered. ACK is sent after slice header is parsed on release.
+        bool ackPending;
+    };
+
+    InterleavedFECQueue(VideoFeedback *feedback);
+
+    void reset();
+    void setDepth(int depth);
+    bool isEnabled() const {
+        return m_depth > 1;
+    }
+
+    void OnIDRProcessed();
+
+    // Take ownership of frameBuffer by swapping with a buffer from pool.
+    void addFrame(const VideoFrame &frame, std::vector<char> &frameBuffer,
+                  const std::vector<bool> &availablePackets, bool complete);
+    void addMissingFrames(uint64_t startVideoFrame, uint64_t endVideoFrame);
+    void addParityPacket(const VideoInterleavedParity *packet, size_t packetSize);
+
+    // Next frame to decode in order. Returns nullptr if no frame is ready.
+    Frame *peekReadyFrame();
+    void ackFrame(Frame *frame, const FrameInfo &info, bool decodable = true);
+    void popReadyFrame();
+private:
+    // Current group and next group and some margin.
+    static const int POOL_FRAMES = ALVR_INTERLEAVED_FEC_FRAMES_MAX * 2 + 2;
+
+    VideoFeedback *mFeedback;
+    int m_depth = 0;
+
+    std::vector<Frame> m_pool;
+    uint64_t m_nextReleaseFrame;
+    uint64_t m_newestFrame;
+    bool mIDRProcessed;
+
+    struct Group {
+        uint64_t startVideoFrameIndex;
+        VideoInterleavedParity header;
+        std::vector<char> parity;
+        std::vector<unsigned char> parityMarks;
+        size_t receivedParityShards;
+        bool resolved;
+    };
+    Group m_group;
+
+    Frame *findFrame(uint64_t videoFrameIndex);
+    Frame *allocateFrame(uint64_t videoFrameIndex);
+    void onNewFrame(uint64_t videoFrameIndex);
+    void expirePendingFrames();
+    void frameLost(Frame *frame);
+
+    void tryRecover();
+    bool isShardAvailable(const Frame *frame, size_t shard);
+};
+
+#endif //ALVRCLIENT_FEC_INTERLEAVE_H
@@ -0,0 +1,168 @@
+/// Frame pacing analyzer
+// Display cadence of submitted frames against vsync of the refresh rate, and cause of stutters.
+////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <string.h>
+#include <initializer_list>
+#include "frame_pacing.h"
+
+constexpr double FramePacingAnalyzer::AVERAGE_WEIGHT;
+
+FramePacingAnalyzer::FramePacingAnalyzer() : m_vsyncInterval(0) {
+    reset();
+}
+
+void FramePacingAnalyzer::setRefreshRate(int refreshRate) {
+    m_vsyncInterval = refreshRate > 0 ? 1000 * 1000 / refreshRate : 0;
+}
+
+void FramePacingAnalyzer::reset() {
+    m_prevFrameIndex = UINT64_MAX;
+    m_prevDisplayTime = 0;
+    m_averageNetwork = 0;
+    m_averageDecode = 0;
+    m_averageRender = 0;
+    memset(&m_totalAccumulator, 0, sizeof(m_totalAccumulator));
+    memset(&m_secondAccumulator, 0, sizeof(m_secondAccumulator));
+    memset(&m_previous, 0, sizeof(m_previous));
+}
+
+uint32_t FramePacingAnalyzer::onFrame(const Frame &frame) {
+    bool stutter = false;
+    uint64_t interval = 0;
+    uint64_t missedVsyncs = 0;
+    bool jitterSample = false;
+    double deviation = 0;
+    if (m_prevDisplayTime != 0 && frame.displayTime > m_prevDisplayTime && m_vsyncInterval > 0) {
+        interval = frame.displayTime - m_prevDisplayTime;
+        uint64_t vsyncs = (interval + m_vsyncInterval / 2) / m_vsyncInterval;
+        if (vsyncs >= 2) {
+            missedVsyncs = vsyncs - 1;
+            stutter = true;
+        } else {
+            jitterSample = true;
+            deviation = static_cast<double>(interval) - static_cast<double>(m_vsyncInterval);
+        }
+    }
+    uint64_t dropped = 0;
+    if (m_prevFrameIndex != UINT64_MAX && frame.frameIndex > m_prevFrameIndex + 1) {
+        dropped = frame.frameIndex - m_prevFrameIndex - 1;
+        stutter = true;
+    }
+
+    // Classified before the frame is averaged, so that the spike is measured against usual latency.
+    uint32_t cause = stutter ? classify(frame) : static_cast<uint32_t>(PACING_CAUSE_COUNT);
+
+    for (Accumulator *accumulator : {&m_totalAccumulator, &m_secondAccumulator}) {
+        Statistics &statistics = accumulator->statistics;
+        statistics.frames++;
+        statistics.droppedFrames += dropped;
+        statistics.repeatedFrames += missedVsyncs;
+        if (missedVsyncs > 0) {
+            statistics.vsyncMisses++;
+        }
+        if (interval > statistics.maxIntervalUs) {
+            statistics.maxIntervalUs = interval;
+        }
+        if (jitterSample) {
+            accumulator->jitterSquareSum += deviation * deviation;
+            accumulator->jitterSamples++;
+        }
+        if (stutter) {
+            statistics.stutters[cause]++;
+        }
+    }
+
+    updateAverage(&m_averageNetwork, frame.networkLatency);
+    updateAverage(&m_averageDecode, frame.decodeLatency);
+    updateAverage(&m_averageRender, frame.renderLatency);
+    if (frame.frameIndex >= m_prevFrameIndex || m_prevFrameIndex == UINT64_MAX) {
+        m_prevFrameIndex = frame.frameIndex;
+    }
+    m_prevDisplayTime = frame.displayTime;
+    return cause;
+}
+
+void FramePacingAnalyzer::onResubmit() {
+    m_totalAccumulator.statistics.resubmittedFrames++;
+    m_secondAccumulator.statistics.resubmittedFrames++;
+}
+
+void FramePacingAnalyzer::resetSecond() {
+    m_previous = getStatistics(m_secondAccumulator);
+    memset(&m_secondAccumulator, 0, sizeof(m_secondAccumulator));
+}
+
+FramePacingAnalyzer::Statistics FramePacingAnalyzer::getStatisticsTotal() const {
+    return getStatistics(m_totalAccumulator);
+}
+
+const char *FramePacingAnalyzer::getCauseName(uint32_t cause) {
+    switch (cause) {
+        case PACING_CAUSE_NETWORK_LATE:
+            return "network";
+        case PACING_CAUSE_FEC_FAILURE:
+            return "fec";
+        case PACING_CAUSE_DECODE_LATE:
+            return "decode";
+        case PACING_CAUSE_RENDER_LATE:
+            return "render";
+        default:
+            return "unknown";
+    }
+}
+
+// FEC failure and decode queue drop explain the stutter by themselves. Otherwise the stage group
+// which took the longest time over its average is blamed.
+uint32_t FramePacingAnalyzer::classify(const Frame &frame) const {
+    if (frame.fecFailed) {
+        return PACING_CAUSE_FEC_FAILURE;
+    }
+    if (frame.decodeQueueDropped) {
+        return PACING_CAUSE_DECODE_LATE;
+    }
+    struct {
+        uint32_t cause;
+        uint64_t latency;
+        double average;
+    } groups[] = {
+            {PACING_CAUSE_NETWORK_LATE, frame.networkLatency, m_averageNetwork},
+            {PACING_CAUSE_DECODE_LATE,  frame.decodeLatency,  m_averageDecode},
+            {PACING_CAUSE_RENDER_LATE,  frame.renderLatency,  m_averageRender},
+    };
+    uint32_t cause = PACING_CAUSE_UNKNOWN;
+    double maxExcess = 0;
+    for (auto &group : groups) {
+        if (group.latency == 0) {
+            continue;
+        }
+        double excess = static_cast<double>(group.latency) - group.average;
+        if (excess > maxExcess) {
+            maxExcess = excess;
+            cause = group.cause;
+        }
+    }
+    return cause;
+}
+
+// Stage which the frame skipped is not averaged.
+void FramePacingAnalyzer::updateAverage(double *average, uint64_t latency) {
+    if (latency == 0) {
+        return;
+    }
+    if (*average == 0) {
+        *average = latency;
+    } else {
+        *average += (latency - *average) * AVERAGE_WEIGHT;
+    }
+}
+
+FramePacingAnalyzer::Statistics FramePacingAnalyzer::getStatistics(const Accumulator &accumulator) {
+    Statistics statistics = accumulator.statistics;
+    if (accumulator.jitterSamples > 0) {
+        statistics.jitterUs = static_cast<uint64_t>(
+                sqrt(accumulator.jitterSquareSum / accumulator.jitterSamples));
+    }
+    return statistics;
+}
@@ -0,0 +1,97 @@
+#ifndef ALVRCLIENT_FRAME_PACING_H
+#define ALVRCLIENT_FRAME_PACING_H
+
+#include <stdint.h>
+
+enum PACING_CAUSE {
+    // No stage was slower than usual.
+    PACING_CAUSE_UNKNOWN,
+    PACING_CAUSE_NETWORK_LATE,
+    PACING_CAUSE_FEC_FAILURE,
+    PACING_CAUSE_DECODE_LATE,
+    PACING_CAUSE_RENDER_LATE,
+    PACING_CAUSE_COUNT
+};
+
+// Checks that submitted frames are displayed on consecutive vsyncs of the refresh rate.
+// A stutter is a frame which was displayed one or more vsyncs late (vsync miss, the previous frame
+// was repeated by the compositor) or which came after frames that were never displayed (dropped).
+// Its cause is the pipeline stage group which exceeded its usual latency the most.
+class FramePacingAnalyzer {
+public:
+    // Submitted frame in the clock of getTimestampUs().
+    struct Frame {
+        uint64_t frameIndex;
+        // Predicted display time, or submit time if unknown.
+        uint64_t displayTime;
+        // Estimated sent to FEC done.
+        uint64_t networkLatency;
+        // NAL pushed to decoder output.
+        uint64_t decodeLatency;
+        // Decoder output to submit.
+        uint64_t renderLatency;
+        // Events since previous frame.
+        bool fecFailed;
+        bool decodeQueueDropped;
+    };
+    struct Statistics {
+        uint64_t frames;
+        // Vsyncs on which the previous frame was shown again.
+        uint64_t repeatedFrames;
+        // Frames submitted more than once.
+        uint64_t resubmittedFrames;
+        uint64_t droppedFrames;
+        uint64_t vsyncMisses;
+        uint64_t stutters[PACING_CAUSE_COUNT];
+        // RMS of display interval minus vsync interval for frames not counted as stutter.
+        uint64_t jitterUs;
+        uint64_t maxIntervalUs;
+    };
+
+    FramePacingAnalyzer();
+
+    void setRefreshRate(int refreshRate);
+    void reset();
+
+    // Frames must be passed in submit order. Returns the cause if the frame was a stutter, or
+    // PACING_CAUSE_COUNT.
+    uint32_t onFrame(const Frame &frame);
+    void onResubmit();
+    // Close the second window.
+    void resetSecond();
+
+    Statistics getStatisticsTotal() const;
+    // Last completed second.
+    Statistics getStatisticsInSecond() const {
+        return m_previous;
+    }
+
+    static const char *getCauseName(uint32_t cause);
+private:
+    // Weight of new sample in usual latency of stage groups.
+    static constexpr double AVERAGE_WEIGHT = 1.0 / 32;
+
+    struct Accumulator {
+        Statistics statistics;
+        double jitterSquareSum;
+        uint64_t jitterSamples;
+    };
+
+    uint32_t classify(const Frame &frame) const;
+    static void updateAverage(double *average, uint64_t latency);
+    static Statistics getStatistics(const Accumulator &accumulator);
+
+    uint64_t m_vsyncInterval;
+    uint64_t m_prevFrameIndex;
+    uint64_t m_prevDisplayTime;
+
+    double m_averageNetwork;
+    double m_averageDecode;
+    double m_averageRender;
+
+    Accumulator m_totalAccumulator;
+    Accumulator m_secondAccumulator;
+    Statistics m_previous;
+};
+
+#endif //ALVRCLIENT_FRAME_PACING_H
@@ -0,0 +1,169 @@
+/// Frame trace
+// Binary ring of pipeline stage events and its export to Chrome JSON trace format.
+////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include "frame_trace.h"
+#include "exception.h"
+#ifdef __ANDROID__
+#include <jni.h>
+#include "android_utils.h"
+#endif
+
+FrameTrace FrameTrace::m_Instance;
+thread_local uint32_t FrameTrace::m_threadId = 0;
+
+namespace {
+    const char *STAGE_NAMES[TRACE_STAGE_COUNT] = {
+            "packet",
+            "fec",
+            "nal",
+            "decodeQueue",
+            "decoderFeed",
+            "decode",
+            "tracking",
+            "render",
+            "submit",
+            "stutter",
+            "networkStall",
+    };
+    const char PHASE_NAMES[] = {'B', 'E', 'i', 'b', 'e'};
+}
+
+FrameTrace::FrameTrace() : m_events(CAPACITY), m_next(0), m_start(0) {
+    for (Event &event : m_events) {
+        event.sequence.store(0, std::memory_order_relaxed);
+    }
+}
+
+FrameTrace &FrameTrace::Instance() {
+    return m_Instance;
+}
+
+uint32_t FrameTrace::getThreadId() {
+    if (m_threadId == 0) {
+        m_threadId = static_cast<uint32_t>(syscall(SYS_gettid));
+        char name[17] = {};
+        prctl(PR_GET_NAME, name);
+
+        MutexLock lock(m_threadMutex);
+        m_threads.push_back({m_threadId, name});
+    }
+    return m_threadId;
+}
+
+// Slot is marked as being written while fields are updated, so that export skips torn events.
+void FrameTrace::recordEvent(uint32_t stage, uint32_t phase, uint64_t frameIndex,
+                             uint64_t videoFrameIndex, uint64_t arg) {
+    uint32_t tid = getThreadId();
+    uint64_t position = m_next.fetch_add(1, std::memory_order_relaxed);
+    Event &event = m_events[position & (CAPACITY - 1)];
+    event.sequence.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.timestamp = getTimestampUs();
+    event.frameIndex = frameIndex;
+    event.videoFrameIndex = videoFrameIndex;
+    event.arg = arg;
+    event.tid = tid;
+    event.stage = static_cast<uint16_t>(stage);
+    event.phase = static_cast<uint8_t>(phase);
+    event.sequence.store(2 * position + 2, std::memory_order_release);
+}
+
+void FrameTrace::clear() {
+    m_start.store(m_next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void FrameTrace::exportChromeJson(const std::string &path) {
+    FILE *fp = fopen(path.c_str(), "w");
+    if (fp == nullptr) {
+        throw FormatException("Cannot open trace file. path=%s", path.c_str());
+    }
+
+    uint64_t end = m_next.load(std::memory_order_acquire);
+    uint64_t start = std::max(m_start.load(std::memory_order_relaxed),
+                              end > CAPACITY ? end - CAPACITY : 0);
+    int pid = getpid();
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    {
+        MutexLock lock(m_threadMutex);
+        for (const ThreadName &thread : m_threads) {
+            fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,"
+                        "\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", pid, thread.tid,
+                    thread.name.c_str());
+            first = false;
+        }
+    }
+
+    uint64_t exported = 0;
+    for (uint64_t position = start; position < end; position++) {
+        Event &slot = m_events[position & (CAPACITY - 1)];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * position + 2) {
+            // Being written, or already overwritten.
+            continue;
+        }
+        uint64_t timestamp = slot.timestamp;
+        uint64_t frameIndex = slot.frameIndex;
+        uint64_t videoFrameIndex = slot.videoFrameIndex;
+        uint64_t arg = slot.arg;
+        uint32_t tid = slot.tid;
+        uint16_t stage = slot.stage;
+        uint8_t phase = slot.phase;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence ||
+            stage >= TRACE_STAGE_COUNT || phase >= sizeof(PHASE_NAMES)) {
+            continue;
+        }
+
+        fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":%d,"
+                    "\"tid\":%u", first ? "" : ",\n", STAGE_NAMES[stage], PHASE_NAMES[phase],
+                (unsigned long long) timestamp, pid, tid);
+        if (phase == TRACE_PHASE_ASYNC_BEGIN || phase == TRACE_PHASE_ASYNC_END) {
+            fprintf(fp, ",\"id\":\"0x%llx\"", (unsigned long long) frameIndex);
+        } else if (phase == TRACE_PHASE_INSTANT) {
+            fprintf(fp, ",\"s\":\"t\"");
+        }
+        fprintf(fp, ",\"args\":{\"frame\":%llu", (unsigned long long) frameIndex);
+        if (videoFrameIndex != UINT64_MAX) {
+            fprintf(fp, ",\"videoFrame\":%llu", (unsigned long long) videoFrameIndex);
+        }
+        if (stage == TRACE_STAGE_NETWORK_STALL) {
+            fprintf(fp, ",\"durationUs\":%llu,\"packetType\":%u,\"watchdogStage\":%u",
+                    (unsigned long long) (arg >> 16), static_cast<uint32_t>((arg >> 8) & 0xFF),
+                    static_cast<uint32_t>(arg & 0xFF));
+        } else if (arg != 0) {
+            fprintf(fp, ",\"arg\":%llu", (unsigned long long) arg);
+        }
+        fprintf(fp, "}}");
+        first = false;
+        exported++;
+    }
+    fprintf(fp, "\n]}\n");
+
+    bool failed = ferror(fp) != 0;
+    if (fclose(fp) != 0 || failed) {
+        throw FormatException("Failed to write trace file. path=%s", path.c_str());
+    }
+    LOGI("Exported trace. path=%s events=%llu", path.c_str(), (unsigned long long) exported);
+}
+
+#ifdef __ANDROID__
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_com_polygraphene_alvr_Utils_exportTrace(JNIEnv *env, jclass type, jstring path) {
+    try {
+        FrameTrace::Instance().exportChromeJson(GetStringFromJNIString(env, path));
+    } catch (Exception &e) {
+        LOGE("Failed to export trace. e=%ls", e.what());
+        return static_cast<jboolean>(false);
+    }
+    return static_cast<jboolean>(true);
+}
+#endif
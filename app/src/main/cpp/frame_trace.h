@@ -0,0 +1,116 @@
+#ifndef ALVRCLIENT_FRAME_TRACE_H
+#define ALVRCLIENT_FRAME_TRACE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "utils.h"
+
+enum TRACE_STAGE {
+    // Network thread
+    TRACE_STAGE_PACKET,
+    TRACE_STAGE_FEC,
+    TRACE_STAGE_NAL,
+    // Frame from push to decode queue until it is taken by decoder feeder.
+    TRACE_STAGE_DECODE_QUEUE,
+    // Decoder feeder thread
+    TRACE_STAGE_DECODER_FEED,
+    // Frame from decoder input to output.
+    TRACE_STAGE_DECODE,
+    // Render thread
+    TRACE_STAGE_TRACKING,
+    TRACE_STAGE_RENDER,
+    TRACE_STAGE_SUBMIT,
+    // Frame displayed late or after dropped frames. arg: PACING_CAUSE.
+    TRACE_STAGE_STUTTER,
+    // Network loop stage over budget.
+    // arg: duration in us << 16 | packet type << 8 | WATCHDOG_STAGE.
+    TRACE_STAGE_NETWORK_STALL,
+    TRACE_STAGE_COUNT
+};
+
+enum TRACE_PHASE {
+    // Span on the recording thread.
+    TRACE_PHASE_BEGIN,
+    TRACE_PHASE_END,
+    TRACE_PHASE_INSTANT,
+    // Span of a frame which may end on another thread. Matched by frame index.
+    TRACE_PHASE_ASYNC_BEGIN,
+    TRACE_PHASE_ASYNC_END,
+};
+
+// Ring of binary trace events. Recording is a few stores into a slot reserved by atomic
+// increment, so it can be left on in production. Oldest events are overwritten.
+// Exported in Chrome JSON trace format, which Perfetto UI and chrome://tracing open.
+class FrameTrace {
+public:
+    static FrameTrace &Instance();
+
+    // videoFrameIndex: UINT64_MAX if unknown. arg: Stage specific value shown in args.
+    void record(uint32_t stage, uint32_t phase, uint64_t frameIndex,
+                uint64_t videoFrameIndex = UINT64_MAX, uint64_t arg = 0) {
+        if (gEnableTrace) {
+            recordEvent(stage, phase, frameIndex, videoFrameIndex, arg);
+        }
+    }
+
+    void clear();
+    // Write events in the ring. Throws FormatException when the file cannot be written.
+    void exportChromeJson(const std::string &path);
+private:
+    FrameTrace();
+
+    // Power of 2. About a minute of streaming.
+    static const uint32_t CAPACITY = 1 << 16;
+
+    struct Event {
+        // 2 * position + 2 when written, odd while being written.
+        std::atomic<uint64_t> sequence;
+        uint64_t timestamp;
+        uint64_t frameIndex;
+        uint64_t videoFrameIndex;
+        uint64_t arg;
+        uint32_t tid;
+        uint16_t stage;
+        uint8_t phase;
+    };
+    struct ThreadName {
+        uint32_t tid;
+        std::string name;
+    };
+
+    void recordEvent(uint32_t stage, uint32_t phase, uint64_t frameIndex,
+                     uint64_t videoFrameIndex, uint64_t arg);
+    uint32_t getThreadId();
+
+    static FrameTrace m_Instance;
+    static thread_local uint32_t m_threadId;
+
+    std::vector<Event> m_events;
+    std::atomic<uint64_t> m_next;
+    // Events before this position are cleared.
+    std::atomic<uint64_t> m_start;
+
+    Mutex m_threadMutex;
+    std::vector<ThreadName> m_threads;
+};
+
+// Records begin/end of a stage for the scope.
+class TraceScope {
+public:
+    TraceScope(uint32_t stage, uint64_t frameIndex, uint64_t videoFrameIndex = UINT64_MAX,
+               uint64_t arg = 0)
+            : m_stage(stage), m_frameIndex(frameIndex), m_videoFrameIndex(videoFrameIndex) {
+        FrameTrace::Instance().record(stage, TRACE_PHASE_BEGIN, frameIndex, videoFrameIndex, arg);
+    }
+    ~TraceScope() {
+        FrameTrace::Instance().record(m_stage, TRACE_PHASE_END, m_frameIndex, m_videoFrameIndex);
+    }
+private:
+    uint32_t m_stage;
+    uint64_t m_frameIndex;
+    uint64_t m_videoFrameIndex;
+};
+
+#endif //ALVRCLIENT_FRAME_TRACE_H
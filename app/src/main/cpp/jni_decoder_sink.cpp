@@ -0,0 +1,71 @@
+#include "jni_decoder_sink.h"
+#include "utils.h"
+
+JNIDecoderSink::JNIDecoderSink(JNIEnv *env, jobject udpReceiverThread) {
+    env->GetJavaVM(&m_vm);
+    m_env = env;
+    mUdpReceiverThread = env->NewGlobalRef(udpReceiverThread);
+
+    jclass udpReceiverThreadClazz = env->FindClass("com/polygraphene/alvr/UdpReceiverThread");
+    mRegisterNALBufferMethodID = env->GetMethodID(udpReceiverThreadClazz, "registerNALBuffer", "(ILjava/nio/ByteBuffer;)V");
+    mPushFrameMethodID = env->GetMethodID(udpReceiverThreadClazz, "pushFrame", "(IIIIJIZ)V");
+    env->DeleteLocalRef(udpReceiverThreadClazz);
+}
+
+JNIDecoderSink::~JNIDecoderSink() {
+    JNIEnv *env;
+    if (m_vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) == JNI_OK) {
+        env->DeleteGlobalRef(mUdpReceiverThread);
+    }
+}
+
+// frameBuffer is exchanged with a free buffer of the pool unless keepBuffer is set.
+void JNIDecoderSink::pushFrame(std::vector<char> &frameBuffer, int offset, int configLength, int length,
+                               uint64_t frameIndex, uint8_t frameType, bool partial, bool keepBuffer) {
+    bool needRegistration;
+    // Java side holds a reference for each of config and frame.
+    int references = (configLength > 0 ? 1 : 0) + (length - offset > configLength ? 1 : 0);
+    int bufferId;
+    if (keepBuffer) {
+        bufferId = m_bufferPool.publishCopy(frameBuffer.data(), length, references, &needRegistration);
+    } else {
+        bufferId = m_bufferPool.publish(frameBuffer, references, &needRegistration);
+    }
+    if (bufferId < 0) {
+        LOGE("NAL Queue is full.");
+        return;
+    }
+
+    if (needRegistration) {
+        // New allocation. Java side keeps ByteBuffer for the id, so this happens rarely.
+        jobject byteBuffer = m_env->NewDirectByteBuffer(m_bufferPool.getData(bufferId),
+                                                        static_cast<jlong>(m_bufferPool.getCapacity(bufferId)));
+        m_env->CallVoidMethod(mUdpReceiverThread, mRegisterNALBufferMethodID, bufferId, byteBuffer);
+        m_env->DeleteLocalRef(byteBuffer);
+    }
+
+    m_env->CallVoidMethod(mUdpReceiverThread, mPushFrameMethodID, bufferId, offset, configLength, length,
+                          static_cast<jlong>(frameIndex), static_cast<jint>(frameType),
+                          static_cast<jboolean>(partial));
+}
+
+void JNIDecoderSink::pushEndOfFrame(uint64_t frameIndex) {
+    m_env->CallVoidMethod(mUdpReceiverThread, mPushFrameMethodID, -1, 0, 0, 0,
+                          static_cast<jlong>(frameIndex), 0, static_cast<jboolean>(false));
+}
+
+void JNIDecoderSink::attachThread() {
+    m_vm->AttachCurrentThread(&m_env, nullptr);
+}
+
+void JNIDecoderSink::detachThread() {
+    m_vm->DetachCurrentThread();
+}
+
+bool JNIDecoderSink::waitReady(int64_t timeoutUs) {
+    return m_bufferPool.waitPublishedBelow(MAX_IN_FLIGHT_BUFFERS, timeoutUs);
+}
+
+void JNIDecoderSink::releaseBuffer(int bufferId) {
+    m_bufferPool.release(bufferId);
+}
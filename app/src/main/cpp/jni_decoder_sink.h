@@ -0,0 +1,40 @@
+#ifndef ALVRCLIENT_JNI_DECODER_SINK_H
+#define ALVRCLIENT_JNI_DECODER_SINK_H
+
+#include <jni.h>
+#include "decoder_sink.h"
+#include "nal_buffer_pool.h"
+
+// Hand frames to Java DecoderThread through UdpReceiverThread.pushFrame.
+// Frame buffers are shared by NALBufferPool and released from decoder thread by id.
+// Only a few buffers are handed at once, so that frames wait in DecodeQueue instead of Java queue.
+class JNIDecoderSink : public DecoderSink {
+public:
+    JNIDecoderSink(JNIEnv *env, jobject udpReceiverThread);
+    ~JNIDecoderSink() override;
+
+    void pushFrame(std::vector<char> &frameBuffer, int offset, int configLength, int length,
+                   uint64_t frameIndex, uint8_t frameType, bool partial, bool keepBuffer) override;
+    void pushEndOfFrame(uint64_t frameIndex) override;
+    void attachThread() override;
+    void detachThread() override;
+    bool waitReady(int64_t timeoutUs) override;
+
+    // Called from decoder thread when NAL has been fed to decoder.
+    void releaseBuffer(int bufferId);
+private:
+    // Buffers waiting in Java queue or being copied to decoder input.
+    static const int MAX_IN_FLIGHT_BUFFERS = 4;
+
+    NALBufferPool m_bufferPool;
+
+    JavaVM *m_vm;
+    // Env of the thread which pushes frames.
+    JNIEnv *m_env;
+    jobject mUdpReceiverThread;
+
+    jmethodID mRegisterNALBufferMethodID;
+    jmethodID mPushFrameMethodID;
+};
+
+#endif //ALVRCLIENT_JNI_DECODER_SINK_H
@@ -1,11 +1,296 @@
-#include <jni.h>
+#include <algorithm>
 #include "latency_collector.h"
+#include "frame_trace.h"
+#include "async_log.h"
 #include "utils.h"
+#ifdef __ANDROID__
+#include <jni.h>
+#endif
 
 LatencyCollector LatencyCollector::m_Instance;
 
-LatencyCollector::LatencyCollector(){
-    m_StatisticsTime = getTimestampUs();
+const LatencyCollector::StageBoundary LatencyCollector::STAGES[ALVR_LATENCY_STAGE_COUNT] = {
+        {"total", &FrameTimestamp::tracking, &FrameTimestamp::submit, false},
+        {"transport", &FrameTimestamp::estimatedSent, &FrameTimestamp::receivedLast, false},
+        {"decode", &FrameTimestamp::decoderInput, &FrameTimestamp::decoderOutput, true},
+        {"server", &FrameTimestamp::tracking, &FrameTimestamp::estimatedSent, true},
+        {"network", &FrameTimestamp::estimatedSent, &FrameTimestamp::receivedFirst, true},
+        {"receive", &FrameTimestamp::receivedFirst, &FrameTimestamp::fecStart, true},
+        {"fec", &FrameTimestamp::fecStart, &FrameTimestamp::fecDone, true},
+        {"nal", &FrameTimestamp::fecDone, &FrameTimestamp::nalPushed, true},
+        {"decodeQueue", &FrameTimestamp::nalPushed, &FrameTimestamp::decodeQueueDequeued, true},
+        {"renderWait", &FrameTimestamp::decoderOutput, &FrameTimestamp::rendered1, true},
+        {"render", &FrameTimestamp::rendered1, &FrameTimestamp::rendered2, true},
+        {"submit", &FrameTimestamp::rendered2, &FrameTimestamp::submit, true},
+        {"display", &FrameTimestamp::submit, &FrameTimestamp::displayed, true},
+        {"motionToPhoton", &FrameTimestamp::tracking, &FrameTimestamp::displayed, false},
+        {"decoderHandoff", &FrameTimestamp::decodeQueueDequeued, &FrameTimestamp::decoderInput,
+                true},
+};
+
+// Events of one thread. Owner thread is the only producer and aggregator is the only consumer, so
+// head and tail are enough to hand over events without lock.
+struct LatencyCollector::Shard {
+    // Power of 2. Aggregator runs every 10 ms on network thread. Busiest producer is render thread
+    // with 5 events per frame, which is 600 events per second at 120 Hz, so this covers a stall
+    // of network thread for more than 10 seconds. Nothing bounds the stall (the process may be
+    // suspended), so events beyond it are dropped and counted against the window.
+    static const uint32_t CAPACITY = 8192;
+
+    Event events[CAPACITY];
+    // Free running indices. Written by producer and consumer respectively.
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<uint64_t> dropped;
+    std::atomic<bool> owned;
+    Shard *next;
+};
+
+// Releases the shard on thread exit. Remaining events are still drained.
+struct LatencyCollector::ShardOwner {
+    Shard *shard = nullptr;
+
+    ~ShardOwner() {
+        if (shard != nullptr) {
+            shard->owned.store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local LatencyCollector::ShardOwner LatencyCollector::m_shardOwner;
+
+LatencyCollector::LatencyCollector() : m_shards(nullptr) {
+    m_StatisticsTime = getTimestampUs() / USECS_IN_SEC;
+}
+
+LatencyCollector::Shard *LatencyCollector::getShard() {
+    if (m_shardOwner.shard != nullptr) {
+        return m_shardOwner.shard;
+    }
+    for (Shard *shard = m_shards.load(std::memory_order_acquire); shard != nullptr;
+         shard = shard->next) {
+        bool owned = false;
+        if (shard->owned.compare_exchange_strong(owned, true, std::memory_order_acquire)) {
+            m_shardOwner.shard = shard;
+            return shard;
+        }
+    }
+    Shard *shard = createShard();
+    shard->owned.store(true, std::memory_order_relaxed);
+    shard->next = m_shards.load(std::memory_order_relaxed);
+    while (!m_shards.compare_exchange_weak(shard->next, shard, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+    }
+    m_shardOwner.shard = shard;
+    return shard;
+}
+
+LatencyCollector::Shard *LatencyCollector::createShard() {
+    Shard *shard = new Shard();
+    shard->head.store(0, std::memory_order_relaxed);
+    shard->tail.store(0, std::memory_order_relaxed);
+    shard->dropped.store(0, std::memory_order_relaxed);
+    shard->owned.store(false, std::memory_order_relaxed);
+    return shard;
+}
+
+void LatencyCollector::registerThread() {
+    getShard();
+}
+
+void LatencyCollector::reserveShard() {
+    for (Shard *shard = m_shards.load(std::memory_order_acquire); shard != nullptr;
+         shard = shard->next) {
+        if (!shard->owned.load(std::memory_order_relaxed)) {
+            return;
+        }
+    }
+    Shard *shard = createShard();
+    shard->next = m_shards.load(std::memory_order_relaxed);
+    while (!m_shards.compare_exchange_weak(shard->next, shard, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyCollector::record(uint32_t type, uint64_t frameIndex, uint64_t value) {
+    Shard *shard = getShard();
+    uint32_t head = shard->head.load(std::memory_order_relaxed);
+    if (head - shard->tail.load(std::memory_order_acquire) >= Shard::CAPACITY) {
+        shard->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Event &event = shard->events[head & (Shard::CAPACITY - 1)];
+    event.frameIndex = frameIndex;
+    event.timestamp = getTimestampUs();
+    event.value = value;
+    event.type = type;
+    shard->head.store(head + 1, std::memory_order_release);
+}
+
+void LatencyCollector::drain(std::vector<Event> &events) {
+    for (Shard *shard = m_shards.load(std::memory_order_acquire); shard != nullptr;
+         shard = shard->next) {
+        uint32_t tail = shard->tail.load(std::memory_order_relaxed);
+        uint32_t head = shard->head.load(std::memory_order_acquire);
+        for (; tail != head; tail++) {
+            events.push_back(shard->events[tail & (Shard::CAPACITY - 1)]);
+        }
+        shard->tail.store(tail, std::memory_order_release);
+        uint64_t dropped = shard->dropped.exchange(0, std::memory_order_relaxed);
+        m_droppedEvents += dropped;
+        m_DroppedEventsCurrent += dropped;
+    }
+}
+
+void LatencyCollector::aggregate() {
+    MutexLock lock(m_mutex);
+
+    m_events.clear();
+    drain(m_events);
+    std::stable_sort(m_events.begin(), m_events.end(), [](const Event &a, const Event &b) {
+        return a.timestamp < b.timestamp;
+    });
+    for (const Event &event : m_events) {
+        apply(event);
+    }
+
+    // All events before these submits have been merged by now.
+    for (const Event &event : m_submitted) {
+        finishFrame(event.frameIndex, event.timestamp);
+    }
+    m_submitted.swap(m_nextSubmitted);
+    m_nextSubmitted.clear();
+
+    checkAndResetSecond(getTimestampUs());
+}
+
+void LatencyCollector::apply(const Event &event) {
+    checkAndResetSecond(event.timestamp);
+
+    switch (event.type) {
+        case EVENT_TRACKING: {
+            FrameTimestamp &frame = getFrame(event.frameIndex);
+            frame.tracking = event.timestamp;
+            frame.predictedDisplay = event.value;
+            break;
+        }
+        case EVENT_ESTIMATED_SENT:
+            getFrame(event.frameIndex).estimatedSent = event.value;
+            break;
+        case EVENT_RECEIVED_FIRST:
+            getFrame(event.frameIndex).receivedFirst = event.timestamp;
+            break;
+        case EVENT_RECEIVED_LAST:
+            getFrame(event.frameIndex).receivedLast = event.timestamp;
+            break;
+        case EVENT_DECODER_INPUT:
+            getFrame(event.frameIndex).decoderInput = event.timestamp;
+            break;
+        case EVENT_DECODER_OUTPUT:
+            getFrame(event.frameIndex).decoderOutput = event.timestamp;
+            break;
+        case EVENT_RENDERED1:
+            getFrame(event.frameIndex).rendered1 = event.timestamp;
+            break;
+        case EVENT_RENDERED2:
+            getFrame(event.frameIndex).rendered2 = event.timestamp;
+            break;
+        case EVENT_SUBMIT:
+            getFrame(event.frameIndex).submit = event.timestamp;
+            m_nextSubmitted.push_back(event);
+            break;
+        case EVENT_FEC_DONE: {
+            FrameTimestamp &frame = getFrame(event.frameIndex);
+            frame.fecStart = event.value;
+            frame.fecDone = event.timestamp;
+            break;
+        }
+        case EVENT_NAL_PUSHED:
+            getFrame(event.frameIndex).nalPushed = event.timestamp;
+            break;
+        case EVENT_DECODE_QUEUE_DEQUEUED:
+            getFrame(event.frameIndex).decodeQueueDequeued = event.timestamp;
+            break;
+        case EVENT_DISPLAYED:
+            getFrame(event.frameIndex).displayed = event.value;
+            break;
+        case EVENT_PACKET_LOSS:
+            m_PacketsLostTotal += event.value;
+            m_PacketsLostInSecond += event.value;
+            break;
+        case EVENT_FEC_FAILURE:
+            m_FecFailureTotal++;
+            m_FecFailureInSecond++;
+            break;
+        case EVENT_SLICE_LOSS:
+            m_SliceLossTotal += event.value;
+            m_SliceLossInSecond += event.value;
+            break;
+        case EVENT_CONCEALED_FRAME:
+            m_ConcealedFramesTotal++;
+            m_ConcealedFramesInSecond++;
+            break;
+        case EVENT_CORRUPT_REFERENCE_FRAME:
+            m_CorruptReferenceFramesTotal++;
+            m_CorruptReferenceFramesInSecond++;
+            break;
+        case EVENT_UNDECODABLE_FRAME:
+            m_UndecodableFramesTotal++;
+            m_UndecodableFramesInSecond++;
+            break;
+        case EVENT_DECODE_QUEUE_DROP:
+            m_DecodeQueueDropTotal++;
+            m_DecodeQueueDropInSecond++;
+            break;
+        case EVENT_DECODE_QUEUE_FRAMES:
+            m_DecodeQueueMaxFramesInSecond = std::max(m_DecodeQueueMaxFramesInSecond,
+                                                      static_cast<uint32_t>(event.value));
+            break;
+        case EVENT_FEC_RESULT: {
+            uint32_t frameType = static_cast<uint32_t>(event.value & 0xFF);
+            if (frameType >= ALVR_VIDEO_FRAME_TYPE_COUNT) {
+                frameType = ALVR_VIDEO_FRAME_TYPE_UNKNOWN;
+            }
+            bool recovered = (event.value & (1 << 8)) != 0;
+            bool parityUsed = (event.value & (1 << 9)) != 0;
+            for (FecStatistics *statistics : {&m_FecStatisticsTotal[frameType], &m_FecStatisticsInSecond[frameType]}) {
+                statistics->frames++;
+                if (!recovered) {
+                    statistics->failure++;
+                } else if (parityUsed) {
+                    statistics->recovered++;
+                }
+            }
+            break;
+        }
+        case EVENT_AUDIO_FRAME:
+            m_AudioFramesTotal++;
+            break;
+        case EVENT_AUDIO_OVERFLOW:
+            m_AudioOverflowTotal++;
+            break;
+        case EVENT_AUDIO_UNDERRUN:
+            m_AudioUnderrunTotal++;
+            break;
+        case EVENT_NETWORK_STALL: {
+            uint32_t stage = static_cast<uint32_t>(event.value & 0xFF);
+            if (stage >= WATCHDOG_STAGE_COUNT) {
+                break;
+            }
+            uint32_t packetType = static_cast<uint32_t>((event.value >> 8) & 0xFF);
+            uint64_t duration = event.value >> 16;
+            for (NetworkStallStatistics *statistics : {&m_NetworkStallTotal[stage], &m_NetworkStallInSecond[stage]}) {
+                statistics->stalls++;
+                if (duration > statistics->worstUs) {
+                    statistics->worstUs = duration;
+                    statistics->worstPacketType = packetType;
+                }
+            }
+            break;
+        }
+        default:
+            break;
+    }
 }
 
 LatencyCollector::FrameTimestamp &LatencyCollector::getFrame(uint64_t frameIndex) {
@@ -17,34 +302,53 @@ LatencyCollector::FrameTimestamp &LatencyCollector::getFrame(uint64_t frameIndex
     return frame;
 }
 
-void LatencyCollector::tracking(uint64_t frameIndex) {
-    getFrame(frameIndex).tracking = getTimestampUs();
+void LatencyCollector::tracking(uint64_t frameIndex, uint64_t predictedDisplayTime) {
+    record(EVENT_TRACKING, frameIndex, predictedDisplayTime);
 }
 void LatencyCollector::estimatedSent(uint64_t frameIndex, uint64_t offset) {
-    getFrame(frameIndex).estimatedSent = getTimestampUs() + offset;
+    record(EVENT_ESTIMATED_SENT, frameIndex, getTimestampUs() + offset);
 }
 void LatencyCollector::receivedFirst(uint64_t frameIndex) {
-    getFrame(frameIndex).receivedFirst = getTimestampUs();
+    record(EVENT_RECEIVED_FIRST, frameIndex);
 }
 void LatencyCollector::receivedLast(uint64_t frameIndex) {
-    getFrame(frameIndex).receivedLast = getTimestampUs();
+    record(EVENT_RECEIVED_LAST, frameIndex);
 }
 void LatencyCollector::decoderInput(uint64_t frameIndex) {
-    getFrame(frameIndex).decoderInput = getTimestampUs();
+    record(EVENT_DECODER_INPUT, frameIndex);
 }
 void LatencyCollector::decoderOutput(uint64_t frameIndex) {
-    getFrame(frameIndex).decoderOutput = getTimestampUs();
+    record(EVENT_DECODER_OUTPUT, frameIndex);
 }
 void LatencyCollector::rendered1(uint64_t frameIndex) {
-    getFrame(frameIndex).rendered1 = getTimestampUs();
+    record(EVENT_RENDERED1, frameIndex);
 }
 void LatencyCollector::rendered2(uint64_t frameIndex) {
-    getFrame(frameIndex).rendered2 = getTimestampUs();
+    record(EVENT_RENDERED2, frameIndex);
 }
-
 void LatencyCollector::submit(uint64_t frameIndex) {
-    FrameTimestamp timestamp = getFrame(frameIndex);
-    timestamp.submit = getTimestampUs();
+    record(EVENT_SUBMIT, frameIndex);
+}
+void LatencyCollector::fecDone(uint64_t frameIndex, uint64_t lastPacketTime) {
+    record(EVENT_FEC_DONE, frameIndex, lastPacketTime);
+}
+void LatencyCollector::nalPushed(uint64_t frameIndex) {
+    record(EVENT_NAL_PUSHED, frameIndex);
+}
+void LatencyCollector::decodeQueueDequeued(uint64_t frameIndex) {
+    record(EVENT_DECODE_QUEUE_DEQUEUED, frameIndex);
+}
+void LatencyCollector::displayed(uint64_t frameIndex, uint64_t displayTime) {
+    record(EVENT_DISPLAYED, frameIndex, displayTime);
+}
+
+void LatencyCollector::finishFrame(uint64_t frameIndex, uint64_t submitTime) {
+    FrameTimestamp &timestamp = getFrame(frameIndex);
+    if (timestamp.submit != submitTime) {
+        // Frame was submitted again.
+        m_Pacing.onResubmit();
+        return;
+    }
 
     uint64_t latency[3];
     latency[0] = timestamp.submit - timestamp.tracking;
@@ -54,16 +358,40 @@ void LatencyCollector::submit(uint64_t frameIndex) {
     updateLatency(latency);
 
     submitNewFrame();
+    analyzePacing(timestamp);
+    updateScheduleSlip(timestamp);
 
-    FrameLog(frameIndex, "totalLatency=%.1f transportLatency=%.1f decodeLatency=%.1f renderLatency1=%.1f renderLatency2=%.1f"
-            , latency[0] / 1000.0, latency[1] / 1000.0, latency[2] / 1000.0
-            , (timestamp.rendered2 - timestamp.decoderOutput) / 1000.0
-            , (timestamp.submit - timestamp.rendered2) / 1000.0);
+    // Stages of the frame in ms. Stage which the frame skipped is printed as -.
+    char timeline[512] = "";
+    int written = 0;
+    int bottleneck = -1;
+    uint64_t bottleneckLatency = 0;
+    for (int stage = 0; stage < ALVR_LATENCY_STAGE_COUNT; stage++) {
+        uint64_t start = timestamp.*STAGES[stage].start;
+        uint64_t end = timestamp.*STAGES[stage].end;
+        bool measured = start != 0 && end != 0 && end >= start;
+        if (measured) {
+            recordLatency(stage, start, end);
+            if (STAGES[stage].hop && end - start >= bottleneckLatency) {
+                bottleneck = stage;
+                bottleneckLatency = end - start;
+            }
+        }
+        if (gEnableFrameLog && written < static_cast<int>(sizeof(timeline))) {
+            written += measured ?
+                       snprintf(timeline + written, sizeof(timeline) - written, " %s=%.1f",
+                                STAGES[stage].name, (end - start) / 1000.0) :
+                       snprintf(timeline + written, sizeof(timeline) - written, " %s=-",
+                                STAGES[stage].name);
+        }
+    }
+    FrameLog(frameIndex, "Timeline%s bottleneck=%s scheduleSlip=%.1f", timeline,
+             bottleneck >= 0 ? STAGES[bottleneck].name : "-",
+             timestamp.predictedDisplay != 0 && timestamp.displayed != 0 ?
+             (static_cast<int64_t>(timestamp.displayed - timestamp.predictedDisplay)) / 1000.0 : 0.0);
 }
 
 void LatencyCollector::updateLatency(uint64_t *latency) {
-    checkAndResetSecond();
-
     for(int i = 0; i < 3; i++) {
         // Total
         m_Latency[i][0] += latency[i];
@@ -76,7 +404,99 @@ void LatencyCollector::updateLatency(uint64_t *latency) {
     }
 }
 
+namespace {
+    uint64_t getDuration(uint64_t start, uint64_t end) {
+        return start != 0 && end != 0 && end >= start ? end - start : 0;
+    }
+}
+
+void LatencyCollector::analyzePacing(const FrameTimestamp &timestamp) {
+    FramePacingAnalyzer::Frame frame;
+    frame.frameIndex = timestamp.frameIndex;
+    frame.displayTime = timestamp.displayed != 0 ? timestamp.displayed : timestamp.submit;
+    frame.networkLatency = getDuration(timestamp.estimatedSent, timestamp.fecDone);
+    frame.decodeLatency = getDuration(timestamp.nalPushed, timestamp.decoderOutput);
+    frame.renderLatency = getDuration(timestamp.decoderOutput, timestamp.submit);
+    frame.fecFailed = m_FecFailureTotal != m_PacingFecFailures;
+    frame.decodeQueueDropped = m_DecodeQueueDropTotal != m_PacingDecodeQueueDrops;
+    m_PacingFecFailures = m_FecFailureTotal;
+    m_PacingDecodeQueueDrops = m_DecodeQueueDropTotal;
+
+    uint32_t cause = m_Pacing.onFrame(frame);
+    if (cause != PACING_CAUSE_COUNT) {
+        FrameTrace::Instance().record(TRACE_STAGE_STUTTER, TRACE_PHASE_INSTANT, frame.frameIndex,
+                                      UINT64_MAX, cause);
+        LOGI_LIMITED(5, "Stutter. frame=%llu cause=%s network=%.1f decode=%.1f render=%.1f ms",
+                     (unsigned long long) frame.frameIndex, FramePacingAnalyzer::getCauseName(cause),
+                     frame.networkLatency / 1000.0, frame.decodeLatency / 1000.0,
+                     frame.renderLatency / 1000.0);
+    }
+}
+
+void LatencyCollector::updateScheduleSlip(const FrameTimestamp &timestamp) {
+    if (timestamp.predictedDisplay == 0 || timestamp.displayed == 0) {
+        return;
+    }
+    int64_t slip = static_cast<int64_t>(timestamp.displayed - timestamp.predictedDisplay);
+    for (ScheduleSlipAccumulator *accumulator : {&m_ScheduleSlipTotal, &m_ScheduleSlipInSecond}) {
+        if (accumulator->frames == 0) {
+            accumulator->min = slip;
+            accumulator->max = slip;
+        } else {
+            accumulator->min = std::min(accumulator->min, slip);
+            accumulator->max = std::max(accumulator->max, slip);
+        }
+        accumulator->frames++;
+        accumulator->sum += slip;
+    }
+}
+
+LatencyCollector::ScheduleSlip LatencyCollector::getScheduleSlip(
+        const ScheduleSlipAccumulator &accumulator) {
+    ScheduleSlip slip = {};
+    if (accumulator.frames > 0) {
+        slip.frames = accumulator.frames;
+        slip.averageUs = accumulator.sum / static_cast<int64_t>(accumulator.frames);
+        slip.minUs = accumulator.min;
+        slip.maxUs = accumulator.max;
+    }
+    return slip;
+}
+
+void LatencyCollector::recordLatency(uint32_t stage, uint64_t start, uint64_t end) {
+    m_Histograms[stage].current.record(end - start);
+    m_Histograms[stage].session.record(end - start);
+}
+
+void LatencyCollector::rollHistograms(uint64_t seconds) {
+    // Seconds without frame are empty.
+    seconds = std::min<uint64_t>(seconds, HISTOGRAM_SECONDS);
+    for (uint64_t i = 0; i < seconds; i++) {
+        m_HistogramSecond = (m_HistogramSecond + 1) % HISTOGRAM_SECONDS;
+        m_DroppedEventsSeconds[m_HistogramSecond] = i == 0 ? m_DroppedEventsCurrent : 0;
+        for (StageHistograms &histograms : m_Histograms) {
+            if (i == 0) {
+                histograms.seconds[m_HistogramSecond] = histograms.current;
+                histograms.current.clear();
+            } else {
+                histograms.seconds[m_HistogramSecond].clear();
+            }
+        }
+    }
+    if (seconds > 0) {
+        m_DroppedEventsCurrent = 0;
+    }
+}
+
 void LatencyCollector::resetAll() {
+    MutexLock lock(m_mutex);
+
+    // Events of previous connection.
+    m_events.clear();
+    drain(m_events);
+    m_submitted.clear();
+    m_nextSubmitted.clear();
+
     m_PacketsLostTotal = 0;
     m_PacketsLostInSecond = 0;
     m_PacketsLostPrevious = 0;
@@ -84,12 +504,57 @@ void LatencyCollector::resetAll() {
     m_FecFailureTotal = 0;
     m_FecFailureInSecond = 0;
     m_FecFailurePrevious = 0;
+    m_SliceLossTotal = 0;
+    m_SliceLossInSecond = 0;
+    m_SliceLossPrevious = 0;
+    m_ConcealedFramesTotal = 0;
+    m_ConcealedFramesInSecond = 0;
+    m_ConcealedFramesPrevious = 0;
+    m_CorruptReferenceFramesTotal = 0;
+    m_CorruptReferenceFramesInSecond = 0;
+    m_CorruptReferenceFramesPrevious = 0;
+    m_UndecodableFramesTotal = 0;
+    m_UndecodableFramesInSecond = 0;
+    m_UndecodableFramesPrevious = 0;
+    m_DecodeQueueDropTotal = 0;
+    m_DecodeQueueDropInSecond = 0;
+    m_DecodeQueueDropPrevious = 0;
+    m_DecodeQueueMaxFramesInSecond = 0;
+    m_DecodeQueueMaxFramesPrevious = 0;
+    m_AudioFramesTotal = 0;
+    m_AudioOverflowTotal = 0;
+    m_AudioUnderrunTotal = 0;
+    memset(m_NetworkStallTotal, 0, sizeof(m_NetworkStallTotal));
+    memset(m_NetworkStallInSecond, 0, sizeof(m_NetworkStallInSecond));
+    memset(m_NetworkStallPrevious, 0, sizeof(m_NetworkStallPrevious));
 
     m_framesInSecond = 0;
     m_framesPrevious = 0;
 
+    memset(m_FecStatisticsTotal, 0, sizeof(m_FecStatisticsTotal));
+    memset(m_FecStatisticsInSecond, 0, sizeof(m_FecStatisticsInSecond));
+    memset(m_FecStatisticsPrevious, 0, sizeof(m_FecStatisticsPrevious));
+
     m_StatisticsTime = getTimestampUs() / USECS_IN_SEC;
 
+    m_Pacing.reset();
+    m_PacingFecFailures = 0;
+    m_ScheduleSlipTotal = {};
+    m_ScheduleSlipInSecond = {};
+    m_ScheduleSlipPrevious = {};
+    m_PacingDecodeQueueDrops = 0;
+
+    for (StageHistograms &histograms : m_Histograms) {
+        histograms.current.clear();
+        for (LatencyHistogram &histogram : histograms.seconds) {
+            histogram.clear();
+        }
+        histograms.session.clear();
+    }
+    m_droppedEvents = 0;
+    m_DroppedEventsCurrent = 0;
+    memset(m_DroppedEventsSeconds, 0, sizeof(m_DroppedEventsSeconds));
+
     for(int i = 0; i < 3; i++) {
         for(int j = 0; j < 4; j++) {
             m_Latency[i][j] = 0;
@@ -108,39 +573,108 @@ void LatencyCollector::resetSecond(){
     m_FecFailurePrevious = m_FecFailureInSecond;
     m_FecFailureInSecond = 0;
 
+    m_SliceLossPrevious = m_SliceLossInSecond;
+    m_SliceLossInSecond = 0;
+
+    m_ConcealedFramesPrevious = m_ConcealedFramesInSecond;
+    m_ConcealedFramesInSecond = 0;
+    m_CorruptReferenceFramesPrevious = m_CorruptReferenceFramesInSecond;
+    m_CorruptReferenceFramesInSecond = 0;
+    m_UndecodableFramesPrevious = m_UndecodableFramesInSecond;
+    m_UndecodableFramesInSecond = 0;
+    m_DecodeQueueDropPrevious = m_DecodeQueueDropInSecond;
+    m_DecodeQueueDropInSecond = 0;
+    m_DecodeQueueMaxFramesPrevious = m_DecodeQueueMaxFramesInSecond;
+    m_DecodeQueueMaxFramesInSecond = 0;
+
     m_framesPrevious = m_framesInSecond;
     m_framesInSecond = 0;
+
+    memcpy(m_FecStatisticsPrevious, m_FecStatisticsInSecond, sizeof(m_FecStatisticsInSecond));
+    memset(m_FecStatisticsInSecond, 0, sizeof(m_FecStatisticsInSecond));
+
+    m_Pacing.resetSecond();
+
+    m_ScheduleSlipPrevious = m_ScheduleSlipInSecond;
+    m_ScheduleSlipInSecond = {};
+
+    memcpy(m_NetworkStallPrevious, m_NetworkStallInSecond, sizeof(m_NetworkStallInSecond));
+    memset(m_NetworkStallInSecond, 0, sizeof(m_NetworkStallInSecond));
 }
 
-void LatencyCollector::checkAndResetSecond() {
-    uint64_t current = getTimestampUs() / USECS_IN_SEC;
-    if(m_StatisticsTime != current){
-        m_StatisticsTime = current;
+// Event of a second which has been closed is counted in current second.
+void LatencyCollector::checkAndResetSecond(uint64_t timestamp) {
+    uint64_t current = timestamp / USECS_IN_SEC;
+    if(current > m_StatisticsTime){
         resetSecond();
+        if (current > m_StatisticsTime + 1) {
+            // No event in the last second.
+            resetSecond();
+        }
+        rollHistograms(current - m_StatisticsTime);
+        m_StatisticsTime = current;
     }
 }
 
 void LatencyCollector::packetLoss(int64_t lost) {
-    checkAndResetSecond();
-
-    m_PacketsLostTotal += lost;
-    m_PacketsLostInSecond += lost;
+    record(EVENT_PACKET_LOSS, 0, static_cast<uint64_t>(lost));
 }
 
 void LatencyCollector::fecFailure() {
-    checkAndResetSecond();
+    record(EVENT_FEC_FAILURE, 0);
+}
 
-    m_FecFailureTotal++;
-    m_FecFailureInSecond++;
+void LatencyCollector::sliceLoss(uint32_t lostSlices) {
+    record(EVENT_SLICE_LOSS, 0, lostSlices);
 }
 
-void LatencyCollector::submitNewFrame() {
-    checkAndResetSecond();
+void LatencyCollector::concealedFrame() {
+    record(EVENT_CONCEALED_FRAME, 0);
+}
+
+void LatencyCollector::corruptReferenceFrame() {
+    record(EVENT_CORRUPT_REFERENCE_FRAME, 0);
+}
+
+void LatencyCollector::undecodableFrame() {
+    record(EVENT_UNDECODABLE_FRAME, 0);
+}
+
+void LatencyCollector::decodeQueueDrop() {
+    record(EVENT_DECODE_QUEUE_DROP, 0);
+}
+
+void LatencyCollector::decodeQueueFrames(uint32_t frames) {
+    record(EVENT_DECODE_QUEUE_FRAMES, 0, frames);
+}
+
+void LatencyCollector::fecResult(uint32_t frameType, bool recovered, bool parityUsed) {
+    record(EVENT_FEC_RESULT, 0, (frameType & 0xFF) | (recovered ? 1 << 8 : 0) |
+                                (parityUsed ? 1 << 9 : 0));
+}
+
+void LatencyCollector::audioFrame() {
+    record(EVENT_AUDIO_FRAME, 0);
+}
+
+void LatencyCollector::audioOverflow() {
+    record(EVENT_AUDIO_OVERFLOW, 0);
+}
+
+void LatencyCollector::audioUnderrun() {
+    record(EVENT_AUDIO_UNDERRUN, 0);
+}
+
+void LatencyCollector::networkStall(uint32_t stage, uint32_t packetType, uint64_t durationUs) {
+    record(EVENT_NETWORK_STALL, 0, (durationUs << 16) | ((packetType & 0xFF) << 8) | (stage & 0xFF));
+}
 
+void LatencyCollector::submitNewFrame() {
     m_framesInSecond++;
 }
 
 uint64_t LatencyCollector::getLatency(uint32_t i, uint32_t j) {
+    MutexLock lock(m_mutex);
     if(j == 1 || j == 2) {
         // Min/Max
         return m_PreviousLatency[i][j];
@@ -151,25 +685,366 @@ uint64_t LatencyCollector::getLatency(uint32_t i, uint32_t j) {
     return m_PreviousLatency[i][0] / m_PreviousLatency[i][3];
 }
 uint64_t LatencyCollector::getPacketsLostTotal() {
+    MutexLock lock(m_mutex);
     return m_PacketsLostTotal;
 }
 uint64_t LatencyCollector::getPacketsLostInSecond() {
+    MutexLock lock(m_mutex);
     return m_PacketsLostPrevious;
 }
 uint64_t LatencyCollector::getFecFailureTotal() {
+    MutexLock lock(m_mutex);
     return m_FecFailureTotal;
 }
 uint64_t LatencyCollector::getFecFailureInSecond() {
+    MutexLock lock(m_mutex);
     return m_FecFailurePrevious;
 }
+uint64_t LatencyCollector::getSliceLossTotal() {
+    MutexLock lock(m_mutex);
+    return m_SliceLossTotal;
+}
+uint64_t LatencyCollector::getSliceLossInSecond() {
+    MutexLock lock(m_mutex);
+    return m_SliceLossPrevious;
+}
+uint64_t LatencyCollector::getConcealedFramesTotal() {
+    MutexLock lock(m_mutex);
+    return m_ConcealedFramesTotal;
+}
+uint64_t LatencyCollector::getConcealedFramesInSecond() {
+    MutexLock lock(m_mutex);
+    return m_ConcealedFramesPrevious;
+}
+uint64_t LatencyCollector::getCorruptReferenceFramesTotal() {
+    MutexLock lock(m_mutex);
+    return m_CorruptReferenceFramesTotal;
+}
+uint64_t LatencyCollector::getCorruptReferenceFramesInSecond() {
+    MutexLock lock(m_mutex);
+    return m_CorruptReferenceFramesPrevious;
+}
+uint64_t LatencyCollector::getUndecodableFramesTotal() {
+    MutexLock lock(m_mutex);
+    return m_UndecodableFramesTotal;
+}
+uint64_t LatencyCollector::getUndecodableFramesInSecond() {
+    MutexLock lock(m_mutex);
+    return m_UndecodableFramesPrevious;
+}
+uint64_t LatencyCollector::getDecodeQueueDropTotal() {
+    MutexLock lock(m_mutex);
+    return m_DecodeQueueDropTotal;
+}
+uint64_t LatencyCollector::getDecodeQueueDropInSecond() {
+    MutexLock lock(m_mutex);
+    return m_DecodeQueueDropPrevious;
+}
+uint32_t LatencyCollector::getDecodeQueueMaxFrames() {
+    MutexLock lock(m_mutex);
+    return m_DecodeQueueMaxFramesPrevious;
+}
 uint32_t LatencyCollector::getFramesInSecond() {
+    MutexLock lock(m_mutex);
     return m_framesPrevious;
 }
+LatencyCollector::FecStatistics LatencyCollector::getFecStatisticsTotal(uint32_t frameType) {
+    MutexLock lock(m_mutex);
+    return m_FecStatisticsTotal[frameType < ALVR_VIDEO_FRAME_TYPE_COUNT ? frameType : 0];
+}
+LatencyCollector::FecStatistics LatencyCollector::getFecStatisticsInSecond(uint32_t frameType) {
+    MutexLock lock(m_mutex);
+    return m_FecStatisticsPrevious[frameType < ALVR_VIDEO_FRAME_TYPE_COUNT ? frameType : 0];
+}
+
+LatencyPercentiles LatencyCollector::getLatencyPercentiles(uint32_t stage, uint32_t window) {
+    LatencyPercentiles percentiles = {};
+    if (stage >= ALVR_LATENCY_STAGE_COUNT) {
+        return percentiles;
+    }
+    MutexLock lock(m_mutex);
+    const StageHistograms &histograms = m_Histograms[stage];
+    if (window == ALVR_LATENCY_WINDOW_SECOND) {
+        histograms.seconds[m_HistogramSecond].getPercentiles(&percentiles);
+    } else if (window == ALVR_LATENCY_WINDOW_TEN_SECONDS) {
+        LatencyHistogram merged;
+        for (const LatencyHistogram &histogram : histograms.seconds) {
+            merged.merge(histogram);
+        }
+        merged.getPercentiles(&percentiles);
+    } else if (window == ALVR_LATENCY_WINDOW_SESSION) {
+        histograms.session.getPercentiles(&percentiles);
+    }
+    return percentiles;
+}
+
+void LatencyCollector::setRefreshRate(int refreshRate) {
+    MutexLock lock(m_mutex);
+    m_Pacing.setRefreshRate(refreshRate);
+}
+FramePacingAnalyzer::Statistics LatencyCollector::getPacingStatisticsTotal() {
+    MutexLock lock(m_mutex);
+    return m_Pacing.getStatisticsTotal();
+}
+FramePacingAnalyzer::Statistics LatencyCollector::getPacingStatisticsInSecond() {
+    MutexLock lock(m_mutex);
+    return m_Pacing.getStatisticsInSecond();
+}
+
+const char *LatencyCollector::getStageName(uint32_t stage) {
+    return stage < ALVR_LATENCY_STAGE_COUNT ? STAGES[stage].name : "unknown";
+}
+
+void LatencyCollector::writeMetrics(MetricsWriter &writer) {
+    static const char *FRAME_TYPE_NAMES[ALVR_VIDEO_FRAME_TYPE_COUNT] = {"unknown", "idr", "p",
+                                                                        "recovery"};
+    static const char *WINDOW_NAMES[] = {"1s", "10s", "session"};
+    char labels[128];
+
+    MutexLock lock(m_mutex);
+
+    writer.write(METRIC_TYPE_COUNTER, "alvr_packets_lost_total", "Video packets lost in network.",
+                 m_PacketsLostTotal);
+
+    writer.write(METRIC_TYPE_COUNTER, "alvr_fec_failures_total",
+                 "Frames which could not be reconstructed by FEC.", m_FecFailureTotal);
+    for (int type = 0; type < ALVR_VIDEO_FRAME_TYPE_COUNT; type++) {
+        snprintf(labels, sizeof(labels), "frame_type=\"%s\"", FRAME_TYPE_NAMES[type]);
+        writer.write(METRIC_TYPE_COUNTER, "alvr_fec_frames_total", "Frames passed FEC.",
+                     m_FecStatisticsTotal[type].frames, labels);
+    }
+    for (int type = 0; type < ALVR_VIDEO_FRAME_TYPE_COUNT; type++) {
+        snprintf(labels, sizeof(labels), "frame_type=\"%s\"", FRAME_TYPE_NAMES[type]);
+        writer.write(METRIC_TYPE_COUNTER, "alvr_fec_recovered_total",
+                     "Frames rebuilt with parity.", m_FecStatisticsTotal[type].recovered, labels);
+    }
+    for (int type = 0; type < ALVR_VIDEO_FRAME_TYPE_COUNT; type++) {
+        snprintf(labels, sizeof(labels), "frame_type=\"%s\"", FRAME_TYPE_NAMES[type]);
+        writer.write(METRIC_TYPE_COUNTER, "alvr_fec_unrecovered_total",
+                     "Frames which FEC could not rebuild.", m_FecStatisticsTotal[type].failure,
+                     labels);
+    }
+
+    writer.write(METRIC_TYPE_COUNTER, "alvr_nal_slices_lost_total",
+                 "Slices lost before decoder.", m_SliceLossTotal);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_nal_concealed_frames_total",
+                 "Partially decoded frames handed to decoder.", m_ConcealedFramesTotal);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_nal_corrupt_reference_frames_total",
+                 "Frames decoded on top of concealed reference.", m_CorruptReferenceFramesTotal);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_nal_undecodable_frames_total",
+                 "Frames dropped because references were lost.", m_UndecodableFramesTotal);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_decode_queue_drops_total",
+                 "Frames dropped from decode queue.", m_DecodeQueueDropTotal);
+    writer.write(METRIC_TYPE_GAUGE, "alvr_decode_queue_max_frames",
+                 "Max frames waiting in decode queue in last second.",
+                 m_DecodeQueueMaxFramesPrevious);
+
+    writer.write(METRIC_TYPE_COUNTER, "alvr_audio_frames_total",
+                 "Audio buffers received from server.", m_AudioFramesTotal);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_audio_overflows_total",
+                 "Audio buffers discarded because playback buffer was full.", m_AudioOverflowTotal);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_audio_underruns_total",
+                 "Playback callbacks which played silence.", m_AudioUnderrunTotal);
+
+    FramePacingAnalyzer::Statistics pacing = m_Pacing.getStatisticsTotal();
+    writer.write(METRIC_TYPE_GAUGE, "alvr_render_fps", "Frames submitted in last second.",
+                 m_framesPrevious);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_render_frames_total", "Frames submitted.",
+                 pacing.frames);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_render_repeated_frames_total",
+                 "Vsyncs which showed previous frame again.", pacing.repeatedFrames);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_render_resubmitted_frames_total",
+                 "Frames submitted more than once.", pacing.resubmittedFrames);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_render_dropped_frames_total",
+                 "Frames never submitted.", pacing.droppedFrames);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_render_vsync_misses_total",
+                 "Frame intervals longer than one vsync.", pacing.vsyncMisses);
+    for (int cause = 0; cause < PACING_CAUSE_COUNT; cause++) {
+        snprintf(labels, sizeof(labels), "cause=\"%s\"", FramePacingAnalyzer::getCauseName(cause));
+        writer.write(METRIC_TYPE_COUNTER, "alvr_render_stutters_total", "Stutters by cause.",
+                     pacing.stutters[cause], labels);
+    }
+    FramePacingAnalyzer::Statistics pacingSecond = m_Pacing.getStatisticsInSecond();
+    writer.write(METRIC_TYPE_GAUGE, "alvr_render_jitter_microseconds",
+                 "Deviation of frame interval from vsync in last second.", pacingSecond.jitterUs);
+    writer.write(METRIC_TYPE_GAUGE, "alvr_render_max_interval_microseconds",
+                 "Longest frame interval in last second.", pacingSecond.maxIntervalUs);
+
+    ScheduleSlip scheduleSlip = getScheduleSlip(m_ScheduleSlipTotal);
+    ScheduleSlip scheduleSlipSecond = getScheduleSlip(m_ScheduleSlipPrevious);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_schedule_slip_frames_total",
+                 "Frames of which display vsync was compared with prediction.",
+                 scheduleSlip.frames);
+    writer.write(METRIC_TYPE_GAUGE, "alvr_schedule_slip_microseconds",
+                 "Display vsync minus predicted display time.", scheduleSlip.averageUs,
+                 "window=\"session\",stat=\"average\"");
+    writer.write(METRIC_TYPE_GAUGE, "alvr_schedule_slip_microseconds",
+                 "Display vsync minus predicted display time.", scheduleSlipSecond.averageUs,
+                 "window=\"1s\",stat=\"average\"");
+    writer.write(METRIC_TYPE_GAUGE, "alvr_schedule_slip_microseconds",
+                 "Display vsync minus predicted display time.", scheduleSlipSecond.minUs,
+                 "window=\"1s\",stat=\"min\"");
+    writer.write(METRIC_TYPE_GAUGE, "alvr_schedule_slip_microseconds",
+                 "Display vsync minus predicted display time.", scheduleSlipSecond.maxUs,
+                 "window=\"1s\",stat=\"max\"");
+
+    for (int stage = 0; stage < ALVR_LATENCY_STAGE_COUNT; stage++) {
+        const StageHistograms &histograms = m_Histograms[stage];
+        LatencyHistogram tenSeconds;
+        for (const LatencyHistogram &histogram : histograms.seconds) {
+            tenSeconds.merge(histogram);
+        }
+        const LatencyHistogram *windows[] = {&histograms.seconds[m_HistogramSecond], &tenSeconds,
+                                             &histograms.session};
+        for (int window = 0; window < ALVR_LATENCY_WINDOW_COUNT; window++) {
+            LatencyPercentiles percentiles;
+            windows[window]->getPercentiles(&percentiles);
+            snprintf(labels, sizeof(labels), "stage=\"%s\",window=\"%s\"", STAGES[stage].name,
+                     WINDOW_NAMES[window]);
+            writer.writeSummary("alvr_latency_microseconds", "Latency of frame stage.",
+                                percentiles, windows[window]->getSum(),
+                                windows[window]->getCount(), labels);
+        }
+    }
+    for (int window = 0; window < ALVR_LATENCY_WINDOW_COUNT; window++) {
+        snprintf(labels, sizeof(labels), "window=\"%s\"", WINDOW_NAMES[window]);
+        writer.write(METRIC_TYPE_GAUGE, "alvr_latency_dropped_events",
+                     "Statistics events lost in the window. Latency of the window is not exact "
+                     "when non-zero.", getDroppedEventsLocked(window), labels);
+    }
+
+    for (int stage = 0; stage < WATCHDOG_STAGE_COUNT; stage++) {
+        snprintf(labels, sizeof(labels), "stage=\"%s\"", NetworkWatchdog::getStageName(stage));
+        writer.write(METRIC_TYPE_COUNTER, "alvr_network_stalls_total",
+                     "Network loop stages over budget.", m_NetworkStallTotal[stage].stalls, labels);
+    }
+    for (int stage = 0; stage < WATCHDOG_STAGE_COUNT; stage++) {
+        snprintf(labels, sizeof(labels), "stage=\"%s\"", NetworkWatchdog::getStageName(stage));
+        writer.write(METRIC_TYPE_GAUGE, "alvr_network_stall_budget_microseconds",
+                     "Budget of network loop stage.", NetworkWatchdog::getBudget(stage), labels);
+    }
+    for (int stage = 0; stage < WATCHDOG_STAGE_COUNT; stage++) {
+        const NetworkStallStatistics &stall = m_NetworkStallTotal[stage];
+        snprintf(labels, sizeof(labels), "stage=\"%s\",packet_type=\"%d\"",
+                 NetworkWatchdog::getStageName(stage),
+                 stall.stalls == 0 || stall.worstPacketType == NetworkWatchdog::NO_PACKET ?
+                 -1 : static_cast<int>(stall.worstPacketType));
+        writer.write(METRIC_TYPE_GAUGE, "alvr_network_stall_worst_microseconds",
+                     "Longest network loop stall in session.", stall.worstUs, labels);
+    }
+
+    std::vector<std::string> threadLabels;
+    for (const ThreadSampler::ThreadStatistics &thread : m_ThreadStatistics) {
+        snprintf(labels, sizeof(labels), "thread=\"%s\",tid=\"%d\"", thread.name.c_str(),
+                 thread.tid);
+        threadLabels.push_back(labels);
+    }
+    const struct {
+        uint32_t type;
+        const char *name;
+        const char *help;
+        double (*value)(const ThreadSampler::ThreadStatistics &thread);
+    } threadMetrics[] = {
+            {METRIC_TYPE_COUNTER, "alvr_thread_cpu_microseconds_total",
+                    "CPU time of pipeline thread.",
+                    [](const ThreadSampler::ThreadStatistics &thread) -> double {
+                        return thread.cpuTimeUs;
+                    }},
+            {METRIC_TYPE_GAUGE, "alvr_thread_cpu_usage_ratio",
+                    "CPU time of pipeline thread per wall time in last interval.",
+                    [](const ThreadSampler::ThreadStatistics &thread) -> double {
+                        return thread.intervalUs > 0 ?
+                               static_cast<double>(thread.cpuTimeInIntervalUs) / thread.intervalUs : 0;
+                    }},
+            {METRIC_TYPE_COUNTER, "alvr_thread_run_delay_microseconds_total",
+                    "Time pipeline thread was runnable but waited on run queue.",
+                    [](const ThreadSampler::ThreadStatistics &thread) -> double {
+                        return thread.runDelayUs;
+                    }},
+            {METRIC_TYPE_COUNTER, "alvr_thread_voluntary_switches_total",
+                    "Context switches of pipeline thread which blocked.",
+                    [](const ThreadSampler::ThreadStatistics &thread) -> double {
+                        return thread.voluntarySwitches;
+                    }},
+            {METRIC_TYPE_COUNTER, "alvr_thread_involuntary_switches_total",
+                    "Context switches of pipeline thread which was preempted.",
+                    [](const ThreadSampler::ThreadStatistics &thread) -> double {
+                        return thread.involuntarySwitches;
+                    }},
+    };
+    for (auto &metric : threadMetrics) {
+        for (size_t i = 0; i < m_ThreadStatistics.size(); i++) {
+            writer.write(metric.type, metric.name, metric.help, metric.value(m_ThreadStatistics[i]),
+                         threadLabels[i].c_str());
+        }
+    }
+
+    writer.write(METRIC_TYPE_COUNTER, "alvr_collector_dropped_events_total",
+                 "Statistics events lost because recording thread was ahead.", m_droppedEvents);
+    writer.write(METRIC_TYPE_COUNTER, "alvr_log_dropped_lines_total",
+                 "Log lines dropped by asynchronous logger.",
+                 AsyncLogger::Instance().getDroppedLines());
+}
+
+LatencyCollector::ScheduleSlip LatencyCollector::getScheduleSlipTotal() {
+    MutexLock lock(m_mutex);
+    return getScheduleSlip(m_ScheduleSlipTotal);
+}
+LatencyCollector::ScheduleSlip LatencyCollector::getScheduleSlipInSecond() {
+    MutexLock lock(m_mutex);
+    return getScheduleSlip(m_ScheduleSlipPrevious);
+}
+
+LatencyCollector::NetworkStallStatistics LatencyCollector::getNetworkStallStatisticsTotal(
+        uint32_t stage) {
+    MutexLock lock(m_mutex);
+    return m_NetworkStallTotal[stage < WATCHDOG_STAGE_COUNT ? stage : 0];
+}
+LatencyCollector::NetworkStallStatistics LatencyCollector::getNetworkStallStatisticsInSecond(
+        uint32_t stage) {
+    MutexLock lock(m_mutex);
+    return m_NetworkStallPrevious[stage < WATCHDOG_STAGE_COUNT ? stage : 0];
+}
+
+void LatencyCollector::setThreadStatistics(
+        const std::vector<ThreadSampler::ThreadStatistics> &threads) {
+    MutexLock lock(m_mutex);
+    m_ThreadStatistics = threads;
+}
+std::vector<ThreadSampler::ThreadStatistics> LatencyCollector::getThreadStatistics() {
+    MutexLock lock(m_mutex);
+    return m_ThreadStatistics;
+}
+
+uint64_t LatencyCollector::getDroppedEvents(uint32_t window) {
+    MutexLock lock(m_mutex);
+    return getDroppedEventsLocked(window);
+}
+
+uint64_t LatencyCollector::getDroppedEventsLocked(uint32_t window) {
+    if (window == ALVR_LATENCY_WINDOW_SECOND) {
+        return m_DroppedEventsSeconds[m_HistogramSecond];
+    } else if (window == ALVR_LATENCY_WINDOW_TEN_SECONDS) {
+        uint64_t dropped = 0;
+        for (uint64_t seconds : m_DroppedEventsSeconds) {
+            dropped += seconds;
+        }
+        return dropped;
+    }
+    return m_droppedEvents;
+}
 
 LatencyCollector &LatencyCollector::Instance() {
     return m_Instance;
 }
 
+#ifdef __ANDROID__
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_polygraphene_alvr_LatencyCollector_RegisterThread(JNIEnv *env, jclass type) {
+    LatencyCollector::Instance().registerThread();
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_polygraphene_alvr_LatencyCollector_DecoderInput(JNIEnv *env, jclass type,
@@ -188,4 +1063,5 @@ extern "C"
 JNIEXPORT void JNICALL
 Java_com_polygraphene_alvr_LatencyCollector_Submit(JNIEnv *env, jclass type, jlong frameIndex) {
     LatencyCollector::Instance().submit((uint64_t)frameIndex);
-}
\ No newline at end of file
+}
+#endif
@@ -1,24 +1,127 @@
 #ifndef ALVRCLIENT_LATENCY_COLLECTOR_H
 #define ALVRCLIENT_LATENCY_COLLECTOR_H
 
+#include <atomic>
 #include <memory>
 #include <vector>
+#include "packet_types.h"
+#include "latency_histogram.h"
+#include "frame_pacing.h"
+#include "metrics.h"
+#include "thread_sampler.h"
+#include "network_watchdog.h"
+#include "utils.h"
 
+// Statistics of the stream written from network, decoder and render threads.
+// Each thread appends events to its own ring buffer (shard) without lock, so recording never
+// waits. aggregate() merges events of all shards in timestamp order on one thread and getters
+// return the merged values.
 class LatencyCollector {
 public:
     static LatencyCollector &Instance();
 
+    // Merge recorded events. Called periodically from network thread.
+    void aggregate();
+    // Events lost in ALVR_LATENCY_WINDOW because the shard of the recording thread was full.
+    // Losses are counted when the aggregator finds them, so they are attributed to the second
+    // the aggregator caught up in. Statistics of a window with losses miss samples and are not
+    // exact.
+    uint64_t getDroppedEvents(uint32_t window);
+
     uint64_t getLatency(uint32_t i, uint32_t j);
     uint64_t getPacketsLostTotal();
     uint64_t getPacketsLostInSecond();
     uint64_t getFecFailureTotal();
     uint64_t getFecFailureInSecond();
+    uint64_t getSliceLossTotal();
+    uint64_t getSliceLossInSecond();
+    uint64_t getConcealedFramesTotal();
+    uint64_t getConcealedFramesInSecond();
+    uint64_t getCorruptReferenceFramesTotal();
+    uint64_t getCorruptReferenceFramesInSecond();
+    uint64_t getUndecodableFramesTotal();
+    uint64_t getUndecodableFramesInSecond();
+    uint64_t getDecodeQueueDropTotal();
+    uint64_t getDecodeQueueDropInSecond();
+    uint32_t getDecodeQueueMaxFrames();
     uint32_t getFramesInSecond();
 
+    // FEC result statistics split by ALVR_VIDEO_FRAME_TYPE.
+    struct FecStatistics {
+        uint64_t frames;
+        // Frames which needed parity to be rebuilt.
+        uint64_t recovered;
+        uint64_t failure;
+    };
+    FecStatistics getFecStatisticsTotal(uint32_t frameType);
+    FecStatistics getFecStatisticsInSecond(uint32_t frameType);
+
+    // Latency percentiles of ALVR_LATENCY_STAGE over ALVR_LATENCY_WINDOW. Second window is the
+    // last completed second, ten seconds window includes it.
+    LatencyPercentiles getLatencyPercentiles(uint32_t stage, uint32_t window);
+
+    // Refresh rate negotiated for the connection. Set after resetAll().
+    void setRefreshRate(int refreshRate);
+    FramePacingAnalyzer::Statistics getPacingStatisticsTotal();
+    FramePacingAnalyzer::Statistics getPacingStatisticsInSecond();
+
+    // Display vsync of frames minus display time predicted when their tracking was sampled.
+    // Positive slip means the frame missed the vsync which the pose was predicted for, by whole
+    // refresh periods.
+    struct ScheduleSlip {
+        uint64_t frames;
+        int64_t averageUs;
+        int64_t minUs;
+        int64_t maxUs;
+    };
+    ScheduleSlip getScheduleSlipTotal();
+    ScheduleSlip getScheduleSlipInSecond();
+
+    // Stages of network loop over budget, by WATCHDOG_STAGE.
+    struct NetworkStallStatistics {
+        uint64_t stalls;
+        uint64_t worstUs;
+        // Packet type handled in the worst stall, or NetworkWatchdog::NO_PACKET.
+        uint32_t worstPacketType;
+    };
+    NetworkStallStatistics getNetworkStallStatisticsTotal(uint32_t stage);
+    NetworkStallStatistics getNetworkStallStatisticsInSecond(uint32_t stage);
+
+    // Latest sample of pipeline threads. Sampled by network thread outside of the collector.
+    void setThreadStatistics(const std::vector<ThreadSampler::ThreadStatistics> &threads);
+    std::vector<ThreadSampler::ThreadStatistics> getThreadStatistics();
+
+    // Name of ALVR_LATENCY_STAGE.
+    static const char *getStageName(uint32_t stage);
+    // All statistics as one consistent snapshot for MetricsServer.
+    void writeMetrics(MetricsWriter &writer);
+
     void packetLoss(int64_t lost);
     void fecFailure();
+    void sliceLoss(uint32_t lostSlices);
+    // Partially decoded frame was handed to decoder.
+    void concealedFrame();
+    // Frame decoded on top of concealed reference.
+    void corruptReferenceFrame();
+    // Frame was dropped because its references were lost.
+    void undecodableFrame();
+    // Frame was dropped from decode queue.
+    void decodeQueueDrop();
+    // Frames waiting in decode queue.
+    void decodeQueueFrames(uint32_t frames);
+    void fecResult(uint32_t frameType, bool recovered, bool parityUsed);
+    // Audio buffer was received from server.
+    void audioFrame();
+    // Received audio was discarded because playback buffer was full.
+    void audioOverflow();
+    // Playback ran out of received audio and silence was played. Once per starvation.
+    void audioUnderrun();
+    // Stage of network loop took durationUs over its budget.
+    void networkStall(uint32_t stage, uint32_t packetType, uint64_t durationUs);
 
-    void tracking(uint64_t frameIndex);
+    // predictedDisplayTime: Display time which the pose was predicted for in the clock of
+    // getTimestampUs(), or 0 if the runtime does not predict.
+    void tracking(uint64_t frameIndex, uint64_t predictedDisplayTime = 0);
     void estimatedSent(uint64_t frameIndex, uint64_t offset);
     void receivedFirst(uint64_t frameIndex);
     void receivedLast(uint64_t frameIndex);
@@ -27,18 +130,99 @@ public:
     void rendered1(uint64_t frameIndex);
     void rendered2(uint64_t frameIndex);
     void submit(uint64_t frameIndex);
+    // Frame was reconstructed. lastPacketTime: Arrival of the packet which completed it.
+    void fecDone(uint64_t frameIndex, uint64_t lastPacketTime);
+    // NALs of the frame were handed over to decode queue.
+    void nalPushed(uint64_t frameIndex);
+    // Frame was taken from decode queue to be fed to decoder.
+    void decodeQueueDequeued(uint64_t frameIndex);
+    // displayTime: Vsync which submitted frame is expected on in the clock of getTimestampUs().
+    void displayed(uint64_t frameIndex, uint64_t displayTime);
 
     void resetAll();
+
+    // Take the shard of the calling thread now, so that its first record does not allocate.
+    // Called at start of every pipeline thread.
+    void registerThread();
+    // Make sure a free shard exists, so that the next thread which records for the first time
+    // takes it without allocating. Called before callbacks of threads which must not block, like
+    // the audio callback, start.
+    void reserveShard();
 private:
     LatencyCollector();
 
+    enum EventType {
+        EVENT_TRACKING,
+        EVENT_ESTIMATED_SENT,
+        EVENT_RECEIVED_FIRST,
+        EVENT_RECEIVED_LAST,
+        EVENT_DECODER_INPUT,
+        EVENT_DECODER_OUTPUT,
+        EVENT_RENDERED1,
+        EVENT_RENDERED2,
+        EVENT_SUBMIT,
+        EVENT_PACKET_LOSS,
+        EVENT_FEC_FAILURE,
+        EVENT_SLICE_LOSS,
+        EVENT_CONCEALED_FRAME,
+        EVENT_CORRUPT_REFERENCE_FRAME,
+        EVENT_UNDECODABLE_FRAME,
+        EVENT_DECODE_QUEUE_DROP,
+        EVENT_DECODE_QUEUE_FRAMES,
+        EVENT_FEC_RESULT,
+        EVENT_FEC_DONE,
+        EVENT_NAL_PUSHED,
+        EVENT_DECODE_QUEUE_DEQUEUED,
+        EVENT_DISPLAYED,
+        EVENT_AUDIO_FRAME,
+        EVENT_AUDIO_OVERFLOW,
+        EVENT_AUDIO_UNDERRUN,
+        EVENT_NETWORK_STALL,
+    };
+    struct Event {
+        uint64_t frameIndex;
+        // Time of recording.
+        uint64_t timestamp;
+        // Timestamp of tracking/estimatedSent/fecDone/displayed, or count of the event.
+        uint64_t value;
+        uint32_t type;
+    };
+    // Defined in latency_collector.cpp.
+    struct Shard;
+    struct ShardOwner;
+
+    void record(uint32_t type, uint64_t frameIndex, uint64_t value = 0);
+    Shard *getShard();
+    Shard *createShard();
+    void drain(std::vector<Event> &events);
+    void apply(const Event &event);
+    void finishFrame(uint64_t frameIndex, uint64_t submitTime);
+
     void updateLatency(uint64_t *latency);
+    void recordLatency(uint32_t stage, uint64_t start, uint64_t end);
+    void rollHistograms(uint64_t seconds);
+    uint64_t getDroppedEventsLocked(uint32_t window);
     void submitNewFrame();
 
     void resetSecond();
-    void checkAndResetSecond();
+    void checkAndResetSecond(uint64_t timestamp);
 
     static LatencyCollector m_Instance;
+    static thread_local ShardOwner m_shardOwner;
+
+    // Shards of all threads which have recorded. Shard of exited thread is reused.
+    std::atomic<Shard *> m_shards;
+    // Since resetAll().
+    uint64_t m_droppedEvents = 0;
+
+    // Protects merged statistics below.
+    Mutex m_mutex;
+    std::vector<Event> m_events;
+    // Submitted frames merged on last aggregate(). Their latency is calculated on next one,
+    // because events which happened before submit on other threads may be published later than
+    // submit was drained.
+    std::vector<Event> m_submitted;
+    std::vector<Event> m_nextSubmitted;
 
     struct FrameTimestamp {
         uint64_t frameIndex;
@@ -53,7 +237,22 @@ private:
         uint64_t rendered1;
         uint64_t rendered2;
         uint64_t submit;
+        uint64_t fecStart;
+        uint64_t fecDone;
+        uint64_t nalPushed;
+        uint64_t decodeQueueDequeued;
+        uint64_t displayed;
+        uint64_t predictedDisplay;
     };
+    // Stage of ALVR_LATENCY_STAGE is the time from start to end boundary of the frame.
+    struct StageBoundary {
+        const char *name;
+        uint64_t FrameTimestamp::*start;
+        uint64_t FrameTimestamp::*end;
+        // Consecutive hop of the timeline, which can be the bottleneck.
+        bool hop;
+    };
+    static const StageBoundary STAGES[ALVR_LATENCY_STAGE_COUNT];
     static const int MAX_FRAMES = 1024;
     std::vector<FrameTimestamp> m_Frames = std::vector<FrameTimestamp>(MAX_FRAMES);
 
@@ -64,6 +263,30 @@ private:
     uint64_t m_FecFailureTotal = 0;
     uint64_t m_FecFailureInSecond = 0;
     uint64_t m_FecFailurePrevious = 0;
+    uint64_t m_SliceLossTotal = 0;
+    uint64_t m_SliceLossInSecond = 0;
+    uint64_t m_SliceLossPrevious = 0;
+    uint64_t m_ConcealedFramesTotal = 0;
+    uint64_t m_ConcealedFramesInSecond = 0;
+    uint64_t m_ConcealedFramesPrevious = 0;
+    uint64_t m_CorruptReferenceFramesTotal = 0;
+    uint64_t m_CorruptReferenceFramesInSecond = 0;
+    uint64_t m_CorruptReferenceFramesPrevious = 0;
+    uint64_t m_UndecodableFramesTotal = 0;
+    uint64_t m_UndecodableFramesInSecond = 0;
+    uint64_t m_UndecodableFramesPrevious = 0;
+    uint64_t m_DecodeQueueDropTotal = 0;
+    uint64_t m_DecodeQueueDropInSecond = 0;
+    uint64_t m_DecodeQueueDropPrevious = 0;
+    uint32_t m_DecodeQueueMaxFramesInSecond = 0;
+    uint32_t m_DecodeQueueMaxFramesPrevious = 0;
+    uint64_t m_AudioFramesTotal = 0;
+    uint64_t m_AudioOverflowTotal = 0;
+    uint64_t m_AudioUnderrunTotal = 0;
+
+    NetworkStallStatistics m_NetworkStallTotal[WATCHDOG_STAGE_COUNT] = {};
+    NetworkStallStatistics m_NetworkStallInSecond[WATCHDOG_STAGE_COUNT] = {};
+    NetworkStallStatistics m_NetworkStallPrevious[WATCHDOG_STAGE_COUNT] = {};
 
     // Total/Transport/Decode latency
     // Total/Max/Min/Count
@@ -71,10 +294,48 @@ private:
 
     uint64_t m_PreviousLatency[3][4];
 
+    static const int HISTOGRAM_SECONDS = 10;
+    struct StageHistograms {
+        LatencyHistogram current;
+        // Completed seconds. m_HistogramSecond points the latest.
+        LatencyHistogram seconds[HISTOGRAM_SECONDS];
+        LatencyHistogram session;
+    };
+    StageHistograms m_Histograms[ALVR_LATENCY_STAGE_COUNT];
+    int m_HistogramSecond = 0;
+    // Events lost while current and seconds of m_Histograms were filled.
+    uint64_t m_DroppedEventsCurrent = 0;
+    uint64_t m_DroppedEventsSeconds[HISTOGRAM_SECONDS] = {};
+
+    FramePacingAnalyzer m_Pacing;
+    // Totals when previous frame was analyzed.
+    uint64_t m_PacingFecFailures = 0;
+    uint64_t m_PacingDecodeQueueDrops = 0;
+
     uint32_t m_framesInSecond = 0;
     uint32_t m_framesPrevious = 0;
 
+    FecStatistics m_FecStatisticsTotal[ALVR_VIDEO_FRAME_TYPE_COUNT] = {};
+    FecStatistics m_FecStatisticsInSecond[ALVR_VIDEO_FRAME_TYPE_COUNT] = {};
+    FecStatistics m_FecStatisticsPrevious[ALVR_VIDEO_FRAME_TYPE_COUNT] = {};
+
     FrameTimestamp & getFrame(uint64_t frameIndex);
+    void analyzePacing(const FrameTimestamp &timestamp);
+
+    struct ScheduleSlipAccumulator {
+        uint64_t frames;
+        int64_t sum;
+        int64_t min;
+        int64_t max;
+    };
+    ScheduleSlipAccumulator m_ScheduleSlipTotal = {};
+    ScheduleSlipAccumulator m_ScheduleSlipInSecond = {};
+    ScheduleSlipAccumulator m_ScheduleSlipPrevious = {};
+
+    std::vector<ThreadSampler::ThreadStatistics> m_ThreadStatistics;
+
+    void updateScheduleSlip(const FrameTimestamp &timestamp);
+    static ScheduleSlip getScheduleSlip(const ScheduleSlipAccumulator &accumulator);
 };
 
 #endif //ALVRCLIENT_LATENCY_COLLECTOR_H
@@ -0,0 +1,85 @@
+/// Latency histogram
+// Bucket b < SUB_BUCKETS holds value b. Above it, value v with highest bit m goes to bucket
+// (m - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + (top SUB_BUCKET_BITS + 1 bits of v) - SUB_BUCKETS.
+////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <algorithm>
+#include "latency_histogram.h"
+
+const uint64_t LatencyHistogram::MAX_VALUE;
+
+LatencyHistogram::LatencyHistogram() {
+    clear();
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    value = std::min(value, MAX_VALUE);
+    m_buckets[getBucket(value)]++;
+    m_count++;
+    m_sum += value;
+    m_max = std::max(m_max, value);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+    if (other.m_count == 0) {
+        return;
+    }
+    for (int i = 0; i < BUCKETS; i++) {
+        m_buckets[i] += other.m_buckets[i];
+    }
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_max = std::max(m_max, other.m_max);
+}
+
+void LatencyHistogram::clear() {
+    memset(m_buckets, 0, sizeof(m_buckets));
+    m_count = 0;
+    m_sum = 0;
+    m_max = 0;
+}
+
+uint64_t LatencyHistogram::getValueAtPercentile(double percentile) const {
+    if (m_count == 0) {
+        return 0;
+    }
+    // Rank of the percentile. At least the first value.
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * m_count + 0.5);
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t accumulated = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        accumulated += m_buckets[i];
+        if (accumulated >= rank) {
+            return std::min(getBucketUpperBound(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+void LatencyHistogram::getPercentiles(LatencyPercentiles *percentiles) const {
+    percentiles->count = static_cast<uint32_t>(std::min<uint64_t>(m_count, UINT32_MAX));
+    percentiles->p50 = static_cast<uint32_t>(getValueAtPercentile(50.0));
+    percentiles->p90 = static_cast<uint32_t>(getValueAtPercentile(90.0));
+    percentiles->p99 = static_cast<uint32_t>(getValueAtPercentile(99.0));
+    percentiles->p999 = static_cast<uint32_t>(getValueAtPercentile(99.9));
+    percentiles->max = static_cast<uint32_t>(m_max);
+}
+
+int LatencyHistogram::getBucket(uint64_t value) {
+    if (value < static_cast<uint64_t>(SUB_BUCKETS)) {
+        return static_cast<int>(value);
+    }
+    int highestBit = 63 - __builtin_clzll(value);
+    int shift = highestBit - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS + static_cast<int>(value >> shift) - SUB_BUCKETS;
+}
+
+uint64_t LatencyHistogram::getBucketUpperBound(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return static_cast<uint64_t>(bucket);
+    }
+    int shift = bucket / SUB_BUCKETS - 1;
+    uint64_t top = static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS);
+    return ((top + 1) << shift) - 1;
+}
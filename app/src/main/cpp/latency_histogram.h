@@ -0,0 +1,48 @@
+#ifndef ALVRCLIENT_LATENCY_HISTOGRAM_H
+#define ALVRCLIENT_LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include "packet_types.h"
+
+// Log-linear (HDR) histogram of latency in microseconds. Values below SUB_BUCKETS are counted
+// exactly. Each larger power of 2 range is split into SUB_BUCKETS linear buckets, so relative
+// error is below 1 / SUB_BUCKETS. Histograms of the same layout are merged by adding counts.
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAX_VALUE_BITS = 26;
+    // Larger values (over 67 seconds) are counted as this.
+    static const uint64_t MAX_VALUE = (1ULL << MAX_VALUE_BITS) - 1;
+    static const int BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    LatencyHistogram();
+
+    void record(uint64_t value);
+    void merge(const LatencyHistogram &other);
+    void clear();
+
+    uint64_t getCount() const {
+        return m_count;
+    }
+    uint64_t getMax() const {
+        return m_max;
+    }
+    // Sum of recorded values, for the mean.
+    uint64_t getSum() const {
+        return m_sum;
+    }
+    // Upper bound of the bucket which contains the percentile (0-100). 0 if empty.
+    uint64_t getValueAtPercentile(double percentile) const;
+    void getPercentiles(LatencyPercentiles *percentiles) const;
+private:
+    static int getBucket(uint64_t value);
+    static uint64_t getBucketUpperBound(int bucket);
+
+    uint32_t m_buckets[BUCKETS];
+    uint64_t m_count;
+    uint64_t m_sum;
+    uint64_t m_max;
+};
+
+#endif //ALVRCLIENT_LATENCY_HISTOGRAM_H
@@ -0,0 +1,259 @@
+#include <string.h>
+#include <jni.h>
+#include <media/NdkMediaFormat.h>
+#include <android/native_window_jni.h>
+#include "media_codec_decoder_sink.h"
+#include "packet_types.h"
+#include "latency_collector.h"
+#include "frame_trace.h"
+#include "utils.h"
+#include "exception.h"
+
+// Same value as MediaCodec.BUFFER_FLAG_PARTIAL_FRAME. Not defined in older NDK headers.
+static const uint32_t BUFFER_FLAG_PARTIAL_FRAME = 8;
+
+MediaCodecDecoderSink::MediaCodecDecoderSink(int codec, int width, int height,
+                                             ANativeWindow *window) : m_stopped(false) {
+    const char *mime = codec == ALVR_CODEC_AV1 ? "video/av01" :
+                       codec == ALVR_CODEC_H265 ? "video/hevc" : "video/avc";
+
+    m_window = window;
+    ANativeWindow_acquire(m_window);
+
+    m_codec = AMediaCodec_createDecoderByType(mime);
+    if (m_codec == nullptr) {
+        ANativeWindow_release(m_window);
+        throw FormatException("Failed to create decoder. mime=%s", mime);
+    }
+
+    AMediaFormat *format = AMediaFormat_new();
+    AMediaFormat_setString(format, AMEDIAFORMAT_KEY_MIME, mime);
+    AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_WIDTH, width);
+    AMediaFormat_setInt32(format, AMEDIAFORMAT_KEY_HEIGHT, height);
+    // Realtime priority. Some decoders keep less frames in flight.
+    AMediaFormat_setInt32(format, "priority", 0);
+
+    media_status_t status = AMediaCodec_configure(m_codec, format, m_window, nullptr, 0);
+    AMediaFormat_delete(format);
+    if (status == AMEDIA_OK) {
+        status = AMediaCodec_start(m_codec);
+    }
+    if (status != AMEDIA_OK) {
+        AMediaCodec_delete(m_codec);
+        ANativeWindow_release(m_window);
+        throw FormatException("Failed to start decoder. mime=%s status=%d", mime, status);
+    }
+
+    pthread_create(&m_outputThread, nullptr, outputThread, this);
+    LOGI("MediaCodecDecoderSink started. mime=%s %dx%d", mime, width, height);
+}
+
+MediaCodecDecoderSink::~MediaCodecDecoderSink() {
+    m_stopped = true;
+    pthread_join(m_outputThread, nullptr);
+
+    if (m_pendingOutput >= 0) {
+        AMediaCodec_releaseOutputBuffer(m_codec, static_cast<size_t>(m_pendingOutput), false);
+    }
+    AMediaCodec_stop(m_codec);
+    AMediaCodec_delete(m_codec);
+    ANativeWindow_release(m_window);
+    LOGI("MediaCodecDecoderSink stopped.");
+}
+
+void MediaCodecDecoderSink::pushFrame(std::vector<char> &frameBuffer, int offset, int configLength, int length,
+                                      uint64_t frameIndex, uint8_t /*frameType*/, bool partial,
+                                      bool /*keepBuffer*/) {
+    const char *data = frameBuffer.data() + offset;
+    length -= offset;
+    if (configLength > 0) {
+        if (!queue(data, configLength, 0, AMEDIACODEC_BUFFER_FLAG_CODEC_CONFIG)) {
+            return;
+        }
+        data += configLength;
+        length -= configLength;
+    }
+    if (length == 0) {
+        return;
+    }
+
+    if (m_partialFrame != frameIndex) {
+        LatencyCollector::Instance().decoderInput(frameIndex);
+        FrameTrace::Instance().record(TRACE_STAGE_DECODE, TRACE_PHASE_ASYNC_BEGIN, frameIndex);
+    }
+    if (queue(data, length, frameIndex, partial ? BUFFER_FLAG_PARTIAL_FRAME : 0)) {
+        m_partialFrame = partial ? frameIndex : UINT64_MAX;
+    }
+}
+
+void MediaCodecDecoderSink::pushEndOfFrame(uint64_t frameIndex) {
+    // Empty input without partial flag terminates the frame.
+    queue(nullptr, 0, frameIndex, 0);
+    m_partialFrame = UINT64_MAX;
+}
+
+bool MediaCodecDecoderSink::waitReady(int64_t timeoutUs) {
+    if (m_inputIndex < 0) {
+        m_inputIndex = AMediaCodec_dequeueInputBuffer(m_codec, timeoutUs);
+    }
+    return m_inputIndex >= 0;
+}
+
+void MediaCodecDecoderSink::onFrameAvailable() {
+    MutexLock lock(m_outputMutex);
+    if (m_surfaceState == SURFACE_RENDERING) {
+        m_surfaceState = SURFACE_AVAILABLE;
+    }
+}
+
+int64_t MediaCodecDecoderSink::getAvailableFrame() {
+    MutexLock lock(m_outputMutex);
+    if (m_surfaceState != SURFACE_AVAILABLE) {
+        return -1;
+    }
+    return static_cast<int64_t>(m_surfaceFrame);
+}
+
+void MediaCodecDecoderSink::releaseAvailableFrame() {
+    MutexLock lock(m_outputMutex);
+    if (m_surfaceState != SURFACE_AVAILABLE) {
+        return;
+    }
+    m_surfaceState = SURFACE_IDLE;
+    renderPendingLocked();
+}
+
+bool MediaCodecDecoderSink::queue(const char *data, int length, uint64_t frameIndex,
+                                  uint32_t flags) {
+    ssize_t index = m_inputIndex;
+    m_inputIndex = -1;
+    if (index < 0) {
+        index = AMediaCodec_dequeueInputBuffer(m_codec, INPUT_TIMEOUT_US);
+    }
+    if (index < 0) {
+        FrameLog(frameIndex, "Decoder input buffer is not available. Dropping frame.");
+        return false;
+    }
+    size_t capacity;
+    uint8_t *buffer = AMediaCodec_getInputBuffer(m_codec, static_cast<size_t>(index), &capacity);
+    if (buffer == nullptr || static_cast<size_t>(length) > capacity) {
+        LOGE("Decoder input buffer is too small. length=%d capacity=%zu", length, capacity);
+        AMediaCodec_queueInputBuffer(m_codec, static_cast<size_t>(index), 0, 0, frameIndex, 0);
+        return false;
+    }
+    if (length > 0) {
+        memcpy(buffer, data, static_cast<size_t>(length));
+    }
+    AMediaCodec_queueInputBuffer(m_codec, static_cast<size_t>(index), 0,
+                                 static_cast<size_t>(length), frameIndex, flags);
+    return true;
+}
+
+void MediaCodecDecoderSink::renderPendingLocked() {
+    if (m_surfaceState != SURFACE_IDLE || m_pendingOutput < 0) {
+        return;
+    }
+    FrameLog(m_pendingFrame, "Rendering decoder output.");
+    AMediaCodec_releaseOutputBuffer(m_codec, static_cast<size_t>(m_pendingOutput), true);
+    m_surfaceState = SURFACE_RENDERING;
+    m_surfaceFrame = m_pendingFrame;
+    m_pendingOutput = -1;
+}
+
+void *MediaCodecDecoderSink::outputThread(void *arg) {
+    pthread_setname_np(pthread_self(), "DecoderOutput");
+    LatencyCollector::Instance().registerThread();
+    static_cast<MediaCodecDecoderSink *>(arg)->outputLoop();
+    return nullptr;
+}
+
+void MediaCodecDecoderSink::outputLoop() {
+    while (!m_stopped) {
+        AMediaCodecBufferInfo info;
+        ssize_t index = AMediaCodec_dequeueOutputBuffer(m_codec, &info, OUTPUT_TIMEOUT_US);
+        if (index == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
+            AMediaFormat *format = AMediaCodec_getOutputFormat(m_codec);
+            LOGI("Decoder output format changed. %s", AMediaFormat_toString(format));
+            AMediaFormat_delete(format);
+            continue;
+        }
+        if (index < 0) {
+            continue;
+        }
+        uint64_t frameIndex = static_cast<uint64_t>(info.presentationTimeUs);
+        LatencyCollector::Instance().decoderOutput(frameIndex);
+        FrameTrace::Instance().record(TRACE_STAGE_DECODE, TRACE_PHASE_ASYNC_END, frameIndex);
+        FrameLog(frameIndex, "Decoder output. size=%d", info.size);
+
+        MutexLock lock(m_outputMutex);
+        if (m_pendingOutput >= 0) {
+            FrameLog(m_pendingFrame, "Surface is busy. Dropping older decoder output.");
+            AMediaCodec_releaseOutputBuffer(m_codec, static_cast<size_t>(m_pendingOutput), false);
+        }
+        m_pendingOutput = index;
+        m_pendingFrame = frameIndex;
+        renderPendingLocked();
+    }
+}
+
+int64_t MediaCodecDecoderSink::createHandle(const std::shared_ptr<MediaCodecDecoderSink> &sink) {
+    return reinterpret_cast<int64_t>(new std::shared_ptr<MediaCodecDecoderSink>(sink));
+}
+
+std::shared_ptr<MediaCodecDecoderSink> MediaCodecDecoderSink::fromHandle(int64_t handle) {
+    if (handle == 0) {
+        return nullptr;
+    }
+    return *reinterpret_cast<std::shared_ptr<MediaCodecDecoderSink> *>(handle);
+}
+
+void MediaCodecDecoderSink::destroyHandle(int64_t handle) {
+    delete reinterpret_cast<std::shared_ptr<MediaCodecDecoderSink> *>(handle);
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_polygraphene_alvr_NativeDecoder_createNative(JNIEnv *env, jclass type, jobject surface,
+                                                      jint codec, jint width, jint height) {
+    ANativeWindow *window = ANativeWindow_fromSurface(env, surface);
+    if (window == nullptr) {
+        LOGE("Failed to get window of decoder surface.");
+        return 0;
+    }
+    jlong handle = 0;
+    try {
+        handle = MediaCodecDecoderSink::createHandle(
+                std::make_shared<MediaCodecDecoderSink>(codec, width, height, window));
+    } catch (Exception &e) {
+        LOGE("Failed to create native decoder. e=%ls", e.what());
+    }
+    ANativeWindow_release(window);
+    return handle;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_polygraphene_alvr_NativeDecoder_destroyNative(JNIEnv *env, jclass type, jlong handle) {
+    MediaCodecDecoderSink::destroyHandle(handle);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_polygraphene_alvr_NativeDecoder_onFrameAvailableNative(JNIEnv *env, jclass type,
+                                                                jlong handle) {
+    MediaCodecDecoderSink::fromHandle(handle)->onFrameAvailable();
+}
+
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_polygraphene_alvr_NativeDecoder_getAvailableFrameNative(JNIEnv *env, jclass type,
+                                                                 jlong handle) {
+    return MediaCodecDecoderSink::fromHandle(handle)->getAvailableFrame();
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_polygraphene_alvr_NativeDecoder_releaseAvailableFrameNative(JNIEnv *env, jclass type,
+                                                                     jlong handle) {
+    MediaCodecDecoderSink::fromHandle(handle)->releaseAvailableFrame();
+}
@@ -0,0 +1,78 @@
+#ifndef ALVRCLIENT_MEDIA_CODEC_DECODER_SINK_H
+#define ALVRCLIENT_MEDIA_CODEC_DECODER_SINK_H
+
+#include <pthread.h>
+#include <atomic>
+#include <memory>
+#include <media/NdkMediaCodec.h>
+#include <android/native_window.h>
+#include "decoder_sink.h"
+#include "utils.h"
+
+// Feed frames to NDK AMediaCodec directly from DecodeQueue. Java DecoderThread is not used.
+// Tracking frame index is used as presentation time, so output frames can be matched with
+// tracking info without a lookup queue.
+// Output is rendered to the window one frame at a time as OutputFrameQueue does. Next output is
+// rendered after the renderer has latched the previous one, and older waiting output is dropped.
+// Owned by Java NativeDecoder, which hands it to UdpManager as the sink of the stream.
+class MediaCodecDecoderSink : public DecoderSink {
+public:
+    // Throws FormatException when the decoder cannot be created.
+    MediaCodecDecoderSink(int codec, int width, int height, ANativeWindow *window);
+    ~MediaCodecDecoderSink() override;
+
+    void pushFrame(std::vector<char> &frameBuffer, int offset, int configLength, int length,
+                   uint64_t frameIndex, uint8_t frameType, bool partial, bool keepBuffer) override;
+    void pushEndOfFrame(uint64_t frameIndex) override;
+    bool waitReady(int64_t timeoutUs) override;
+
+    // Called from SurfaceTexture.OnFrameAvailableListener.
+    void onFrameAvailable();
+    // Frame index of the frame available on the surface texture. -1 if none.
+    int64_t getAvailableFrame();
+    // Called after the renderer has latched the available frame by updateTexImage.
+    void releaseAvailableFrame();
+
+    // Handle of Java NativeDecoder holds a reference to the sink.
+    static int64_t createHandle(const std::shared_ptr<MediaCodecDecoderSink> &sink);
+    static std::shared_ptr<MediaCodecDecoderSink> fromHandle(int64_t handle);
+    static void destroyHandle(int64_t handle);
+private:
+    // Timeout for dequeueing input buffer. Frame is dropped when decoder is stalled.
+    static const int64_t INPUT_TIMEOUT_US = 10 * 1000;
+    static const int64_t OUTPUT_TIMEOUT_US = 100 * 1000;
+
+    enum SurfaceState {
+        SURFACE_IDLE,
+        // Output has been released to the window and is on its way to the surface texture.
+        SURFACE_RENDERING,
+        SURFACE_AVAILABLE,
+    };
+
+    bool queue(const char *data, int length, uint64_t frameIndex, uint32_t flags);
+    void renderPendingLocked();
+
+    static void *outputThread(void *arg);
+    void outputLoop();
+
+    AMediaCodec *m_codec = nullptr;
+    ANativeWindow *m_window;
+
+    pthread_t m_outputThread;
+    std::atomic<bool> m_stopped;
+
+    // Input buffer dequeued by waitReady. -1 if none. Used only by DecodeQueue worker.
+    ssize_t m_inputIndex = -1;
+    // Frame index of partially queued frame. UINT64_MAX if none.
+    uint64_t m_partialFrame = UINT64_MAX;
+
+    // Guards output state below. Output thread and render thread use it.
+    Mutex m_outputMutex;
+    SurfaceState m_surfaceState = SURFACE_IDLE;
+    uint64_t m_surfaceFrame = 0;
+    // Decoded output waiting for the surface. -1 if none.
+    ssize_t m_pendingOutput = -1;
+    uint64_t m_pendingFrame = 0;
+};
+
+#endif //ALVRCLIENT_MEDIA_CODEC_DECODER_SINK_H
@@ -0,0 +1,93 @@
+/// Metrics
+// Prometheus text and binary snapshot serialization of client statistics.
+////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "metrics.h"
+
+void MetricsWriter::writeSummary(const char *name, const char *help,
+                                 const LatencyPercentiles &percentiles, uint64_t sum,
+                                 uint64_t count, const std::string &labels) {
+    std::string prefix = labels.empty() ? "" : labels + ",";
+    const struct {
+        const char *quantile;
+        uint32_t value;
+    } quantiles[] = {
+            {"0.5",   percentiles.p50},
+            {"0.9",   percentiles.p90},
+            {"0.99",  percentiles.p99},
+            {"0.999", percentiles.p999},
+            {"1",     percentiles.max},
+    };
+    for (auto &quantile : quantiles) {
+        std::string quantileLabels = prefix + "quantile=\"" + quantile.quantile + "\"";
+        write(METRIC_TYPE_SUMMARY, name, help, quantile.value, quantileLabels.c_str());
+    }
+    write(METRIC_TYPE_SUMMARY, (std::string(name) + "_sum").c_str(), help,
+          static_cast<double>(sum), labels.c_str());
+    write(METRIC_TYPE_SUMMARY, (std::string(name) + "_count").c_str(), help,
+          static_cast<double>(count), labels.c_str());
+}
+
+void PrometheusMetricsWriter::write(uint32_t type, const char *name, const char *help,
+                                    double value, const char *labels) {
+    char line[512];
+    std::string family = name;
+    if (type == METRIC_TYPE_SUMMARY) {
+        for (const char *suffix : {"_sum", "_count"}) {
+            size_t length = strlen(suffix);
+            if (family.size() > length &&
+                family.compare(family.size() - length, length, suffix) == 0) {
+                family.resize(family.size() - length);
+                break;
+            }
+        }
+    }
+    if (m_lastFamily != family) {
+        snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", family.c_str(), help,
+                 family.c_str(), type == METRIC_TYPE_COUNTER ? "counter" :
+                                 type == METRIC_TYPE_SUMMARY ? "summary" : "gauge");
+        m_buffer += line;
+        m_lastFamily = family;
+    }
+    if (labels != nullptr && labels[0] != '\0') {
+        snprintf(line, sizeof(line), "%s{%s} %.17g\n", name, labels, value);
+    } else {
+        snprintf(line, sizeof(line), "%s %.17g\n", name, value);
+    }
+    m_buffer += line;
+}
+
+BinaryMetricsWriter::BinaryMetricsWriter(uint64_t timestamp) : m_count(0) {
+    uint32_t magic = MAGIC;
+    uint32_t version = VERSION;
+    append(&magic, sizeof(magic));
+    append(&version, sizeof(version));
+    append(&timestamp, sizeof(timestamp));
+    append(&m_count, sizeof(m_count));
+}
+
+void BinaryMetricsWriter::write(uint32_t type, const char *name, const char * /*help*/,
+                                double value, const char *labels) {
+    uint8_t type8 = static_cast<uint8_t>(type);
+    append(&type8, sizeof(type8));
+    appendString(name);
+    appendString(labels != nullptr ? labels : "");
+    append(&value, sizeof(value));
+
+    m_count++;
+    memcpy(&m_buffer[HEADER_SIZE - sizeof(m_count)], &m_count, sizeof(m_count));
+}
+
+void BinaryMetricsWriter::append(const void *data, size_t length) {
+    m_buffer.append(static_cast<const char *>(data), length);
+}
+
+// Length prefixed. Longer strings are truncated to 255 bytes.
+void BinaryMetricsWriter::appendString(const char *string) {
+    uint8_t length = static_cast<uint8_t>(std::min<size_t>(strlen(string), UINT8_MAX));
+    append(&length, sizeof(length));
+    append(string, length);
+}
@@ -0,0 +1,66 @@
+#ifndef ALVRCLIENT_METRICS_H
+#define ALVRCLIENT_METRICS_H
+
+#include <stdint.h>
+#include <string>
+#include "packet_types.h"
+
+enum METRIC_TYPE {
+    METRIC_TYPE_COUNTER = 0,
+    METRIC_TYPE_GAUGE = 1,
+    // Samples of name (with quantile label), name_sum and name_count.
+    METRIC_TYPE_SUMMARY = 2,
+};
+
+// Serializes client statistics. Samples of the same name must be written consecutively.
+// labels: Prometheus label list without braces (e.g. stage="decode"), or nullptr.
+class MetricsWriter {
+public:
+    virtual ~MetricsWriter() {}
+
+    virtual void write(uint32_t type, const char *name, const char *help, double value,
+                       const char *labels = nullptr) = 0;
+
+    // Percentiles in microseconds as a summary of name. Max is written as quantile 1.
+    void writeSummary(const char *name, const char *help, const LatencyPercentiles &percentiles,
+                      uint64_t sum, uint64_t count, const std::string &labels);
+
+    const std::string &getBuffer() const {
+        return m_buffer;
+    }
+protected:
+    std::string m_buffer;
+};
+
+// Prometheus text exposition format 0.0.4.
+class PrometheusMetricsWriter : public MetricsWriter {
+public:
+    void write(uint32_t type, const char *name, const char *help, double value,
+               const char *labels) override;
+private:
+    // Name without _sum and _count suffixes of summaries.
+    std::string m_lastFamily;
+};
+
+// Compact snapshot for tools which do not parse text:
+// Header: "ALMS", uint32_t version, uint64_t timestamp (us), uint32_t sample count
+// Sample: uint8_t type, uint8_t name length, name, uint8_t labels length, labels, double value
+// Integers and double are little endian. Help strings are not included.
+class BinaryMetricsWriter : public MetricsWriter {
+public:
+    static const uint32_t MAGIC = 0x534D4C41; // "ALMS"
+    static const uint32_t VERSION = 1;
+    static const size_t HEADER_SIZE = 20;
+
+    BinaryMetricsWriter(uint64_t timestamp);
+
+    void write(uint32_t type, const char *name, const char *help, double value,
+               const char *labels) override;
+private:
+    void append(const void *data, size_t length);
+    void appendString(const char *string);
+
+    uint32_t m_count;
+};
+
+#endif //ALVRCLIENT_METRICS_H
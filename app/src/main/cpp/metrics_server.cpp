@@ -0,0 +1,145 @@
+/// Metrics server
+// Minimal HTTP/1.0 server on loopback which answers scrapes of client statistics.
+////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "metrics_server.h"
+#include "exception.h"
+#include "utils.h"
+
+MetricsServer::MetricsServer(int port, const std::function<void(MetricsWriter &writer)> &collector)
+        : m_port(port), m_collector(collector) {
+    m_listenSocket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_listenSocket < 0) {
+        throw FormatException("Failed to create metrics socket. errno=%d %s", errno, strerror(errno));
+    }
+    int val = 1;
+    setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    // Statistics are not exposed to the network.
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(m_listenSocket, (sockaddr *) &addr, sizeof(addr)) < 0 ||
+        listen(m_listenSocket, 4) < 0) {
+        int error = errno;
+        close(m_listenSocket);
+        throw FormatException("Failed to listen metrics port. port=%d errno=%d %s", port, error,
+                              strerror(error));
+    }
+    if (port == 0) {
+        socklen_t length = sizeof(addr);
+        getsockname(m_listenSocket, (sockaddr *) &addr, &length);
+        m_port = ntohs(addr.sin_port);
+    }
+
+    if (pipe2(m_stopPipe, O_CLOEXEC) < 0 ||
+        pthread_create(&m_thread, nullptr, serverThread, this) != 0) {
+        close(m_listenSocket);
+        if (m_stopPipe[0] >= 0) {
+            close(m_stopPipe[0]);
+            close(m_stopPipe[1]);
+        }
+        throw FormatException("Failed to start metrics server thread.");
+    }
+    LOGI("Metrics server started. port=%d", m_port);
+}
+
+MetricsServer::~MetricsServer() {
+    write(m_stopPipe[1], "", 1);
+    pthread_join(m_thread, nullptr);
+    close(m_stopPipe[0]);
+    close(m_stopPipe[1]);
+    close(m_listenSocket);
+}
+
+void *MetricsServer::serverThread(void *arg) {
+    pthread_setname_np(pthread_self(), "MetricsServer");
+    static_cast<MetricsServer *>(arg)->serverLoop();
+    return nullptr;
+}
+
+void MetricsServer::serverLoop() {
+    while (true) {
+        pollfd fds[2] = {{m_listenSocket, POLLIN, 0}, {m_stopPipe[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOGE("Metrics server poll failed. errno=%d %s", errno, strerror(errno));
+            break;
+        }
+        if (fds[1].revents != 0) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            int client = accept4(m_listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client >= 0) {
+                handleClient(client);
+                close(client);
+            }
+        }
+    }
+}
+
+void MetricsServer::handleClient(int client) {
+    timeval timeout = {REQUEST_TIMEOUT_MS / 1000, (REQUEST_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // Only the request line is needed. Headers are read to keep clients from getting reset.
+    char request[1024];
+    size_t length = 0;
+    while (length < sizeof(request) - 1) {
+        pollfd fd = {client, POLLIN, 0};
+        if (poll(&fd, 1, REQUEST_TIMEOUT_MS) <= 0) {
+            return;
+        }
+        ssize_t ret = recv(client, request + length, sizeof(request) - 1 - length, 0);
+        if (ret <= 0) {
+            return;
+        }
+        length += ret;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n") != nullptr || strstr(request, "\n\n") != nullptr) {
+            break;
+        }
+    }
+    request[length] = '\0';
+
+    std::string body;
+    const char *status = "200 OK";
+    const char *contentType = "text/plain; version=0.0.4";
+    if (strncmp(request, "GET /metrics ", 13) == 0) {
+        PrometheusMetricsWriter writer;
+        m_collector(writer);
+        body = writer.getBuffer();
+    } else if (strncmp(request, "GET /snapshot ", 14) == 0) {
+        BinaryMetricsWriter writer(getTimestampUs());
+        m_collector(writer);
+        body = writer.getBuffer();
+        contentType = "application/octet-stream";
+    } else {
+        status = "404 Not Found";
+        body = "Not found\n";
+    }
+
+    std::string response = std::string("HTTP/1.0 ") + status + "\r\nContent-Type: " + contentType +
+                           "\r\nContent-Length: " + std::to_string(body.size()) +
+                           "\r\nConnection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t ret = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (ret <= 0) {
+            return;
+        }
+        sent += ret;
+    }
+}
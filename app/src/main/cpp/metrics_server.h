@@ -0,0 +1,39 @@
+#ifndef ALVRCLIENT_METRICS_SERVER_H
+#define ALVRCLIENT_METRICS_SERVER_H
+
+#include <pthread.h>
+#include <functional>
+#include "metrics.h"
+
+// Serves client statistics over HTTP on loopback, so that a scraper on the device (or through
+// adb forward) can collect them without the server.
+//   GET /metrics  Prometheus text format
+//   GET /snapshot BinaryMetricsWriter snapshot
+// Requests are handled one by one on its own thread. Statistics are collected per request.
+class MetricsServer {
+public:
+    static const int DEFAULT_PORT = 9944;
+
+    // Throws FormatException when the port cannot be listened.
+    MetricsServer(int port, const std::function<void(MetricsWriter &writer)> &collector);
+    ~MetricsServer();
+
+    int getPort() const {
+        return m_port;
+    }
+private:
+    // A client which does not send request in time is closed.
+    static const int REQUEST_TIMEOUT_MS = 1000;
+
+    static void *serverThread(void *arg);
+    void serverLoop();
+    void handleClient(int client);
+
+    int m_port;
+    std::function<void(MetricsWriter &writer)> m_collector;
+    int m_listenSocket = -1;
+    int m_stopPipe[2] = {-1, -1};
+    pthread_t m_thread;
+};
+
+#endif //ALVRCLIENT_METRICS_SERVER_H
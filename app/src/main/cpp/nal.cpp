@@ -4,133 +4,333 @@
 
 #include <string>
 #include <stdlib.h>
-#include <android/log.h>
+#include <string.h>
 #include <pthread.h>
 #include "nal.h"
 #include "packet_types.h"
+#include "latency_collector.h"
+#include "frame_trace.h"
+#include "video_feedback.h"
 
-static const int NAL_TYPE_SPS = 7;
-
-static const int H265_NAL_TYPE_VPS = 32;
-
-
-NALParser::NALParser(JNIEnv *env, jobject udpManager, UdpManager *udpManager_C) : m_queue(udpManager_C) {
+NALParser::NALParser(VideoFeedback *feedback)
+        : m_feedback(feedback), m_queue(feedback), m_interleavedQueue(feedback) {
     LOGE("NALParser initialized %p", this);
+}
 
-    m_env = env;
-    mUdpManager = env->NewGlobalRef(udpManager);
-
-    jclass NAL_clazz = env->FindClass("com/polygraphene/alvr/NAL");
-    NAL_length = env->GetFieldID(NAL_clazz, "length", "I");
-    NAL_frameIndex = env->GetFieldID(NAL_clazz, "frameIndex", "J");
-    NAL_buf = env->GetFieldID(NAL_clazz, "buf", "[B");
-    env->DeleteLocalRef(NAL_clazz);
+NALParser::~NALParser() {
+}
 
-    jclass udpManagerClazz = env->FindClass("com/polygraphene/alvr/UdpReceiverThread");
-    mObtainNALMethodID = env->GetMethodID(udpManagerClazz, "obtainNAL", "(I)Lcom/polygraphene/alvr/NAL;");
-    mPushNALMethodID = env->GetMethodID(udpManagerClazz, "pushNAL", "(Lcom/polygraphene/alvr/NAL;)V");
-    env->DeleteLocalRef(udpManagerClazz);
+void NALParser::setSink(const std::shared_ptr<DecoderSink> &sink) {
+    m_decodeQueue.setSink(sink);
 }
 
-NALParser::~NALParser() {
-    m_env->DeleteGlobalRef(mUdpManager);
+void NALParser::configureDecodeQueue(int depth, int refreshRate) {
+    m_decodeQueue.configure(depth, refreshRate);
 }
 
 void NALParser::reset() {
     m_queue.reset();
+    m_interleavedQueue.reset();
+    m_partialVideoFrame = UINT64_MAX;
+    m_decodability.reset();
+    // Frames of previous stream.
+    m_decodeQueue.clear();
+
+    // Decoder may have been recreated.
+    m_parameterSets.invalidate();
+    pushParameterSets();
 }
 
 void NALParser::setCodec(int codec) {
     m_codec = codec;
+    m_scanner.setCodec(codec);
+    m_sliceParser.setCodec(codec);
+}
+
+void NALParser::setParameterSetCachePath(const std::string &path) {
+    m_parameterSetCachePath = path;
+    if (path.empty()) {
+        m_parameterSets.clear();
+    } else {
+        m_parameterSets.load(path, m_codec);
+    }
+}
+
+// Prepare decoder with cached parameter sets without waiting for IDR frame.
+void NALParser::pushParameterSets() {
+    if (!m_parameterSets.hasData()) {
+        return;
+    }
+    std::vector<char> &data = m_parameterSets.getData();
+    m_parameterSets.markSignalled();
+    // Slices of next frames may refer to them.
+    m_scanner.scan(data.data(), static_cast<int>(data.size()));
+    m_sliceParser.parse(data.data(), m_scanner.getNALs(), &m_frameInfo);
+    LOGI("Prewarming decoder with cached parameter sets. size=%zu", data.size());
+    push(data, 0, static_cast<int>(data.size()), static_cast<int>(data.size()), UINT64_MAX, 0,
+         ALVR_VIDEO_FRAME_TYPE_UNKNOWN, false, false, true);
+}
+
+void NALParser::setInterleavedFecDepth(int depth) {
+    m_interleavedQueue.setDepth(depth);
+    m_queue.setInterleavedQueue(m_interleavedQueue.isEnabled() ? &m_interleavedQueue : nullptr);
+}
+
+void NALParser::setSliceLossReport(bool enabled) {
+    m_queue.setSliceLossReport(enabled);
+}
+
+void NALParser::setStreamRecorder(const std::shared_ptr<CaptureWriter> &recorder) {
+    m_streamRecorder = recorder;
 }
 
 bool NALParser::processPacket(VideoFrame *packet, int packetSize) {
+    m_packetTime = getTimestampUs();
     m_queue.addVideoPacket(packet, packetSize);
 
-    bool result = m_queue.reconstruct();
+    if (m_partialVideoFrame != UINT64_MAX &&
+        (m_queue.isFrameBroken() || m_queue.getCurrentFrame().videoFrameIndex != m_partialVideoFrame)) {
+        // Remaining slices of the frame never come.
+        closePartialFrame();
+    }
+
+    std::vector<char> &concealedFrame = m_queue.getConcealedFrameBuffer();
+    int concealedFrameByteSize;
+    uint64_t concealedVideoFrameIndex;
+    uint64_t concealedFrameIndex;
+    if (m_queue.popConcealedFrame(&concealedFrameByteSize, &concealedVideoFrameIndex,
+                                  &concealedFrameIndex)) {
+        processConcealedFrame(concealedFrame, concealedFrameByteSize, concealedVideoFrameIndex,
+                              concealedFrameIndex);
+    }
+
+    bool result;
+    {
+        TraceScope trace(TRACE_STAGE_FEC, packet->trackingFrameIndex, packet->videoFrameIndex);
+        result = m_queue.reconstruct();
+    }
+    if (m_interleavedQueue.isEnabled()) {
+        // Frames are passed through interleaved FEC queue to keep decode order.
+        pushReadyFrames();
+        return result;
+    }
     if (!result) {
         return false;
     }
 
-    // Reconstructed
-    const char *frameBuffer = m_queue.getFrameBuffer();
-    int frameByteSize = m_queue.getFrameByteSize();
-
-    int NALType;
-    if (m_codec == ALVR_CODEC_H264) {
-        NALType = frameBuffer[4] & 0x1F;
+    bool ret;
+    if (m_queue.getCurrentFrame().sliceCount > 1) {
+        ret = processSlice();
     } else {
-        NALType = (frameBuffer[4] >> 1) & 0x3F;
+        // Reconstructed
+        const VideoFrame &frame = m_queue.getCurrentFrame();
+        ret = processFrame(m_queue.getFrameBuffer(), m_queue.getFrameByteSize(),
+                           frame.videoFrameIndex, packet->trackingFrameIndex, frame.frameType,
+                           false, false);
+        m_firstSliceInfo = m_frameInfo;
+        m_firstSliceDecodable = m_frameDecodable;
     }
+    m_queue.ackFrame(m_firstSliceInfo, m_firstSliceDecodable);
+    return ret;
+}
 
-    if ((m_codec == ALVR_CODEC_H264 && NALType == NAL_TYPE_SPS) ||
-        (m_codec == ALVR_CODEC_H265 && NALType == H265_NAL_TYPE_VPS)) {
-        // This frame contains (VPS + )SPS + PPS + IDR on NVENC H.264 (H.265) stream.
-        // (VPS + )SPS + PPS has short size (8bytes + 28bytes in some environment), so we can assume SPS + PPS is contained in first fragment.
-
-        int end = findVPSSPS(frameBuffer, frameByteSize);
-        if (end == -1) {
-            // Invalid frame.
-            LOG("Got invalid frame. Too large SPS or PPS?");
-            return false;
-        }
-        LOGI("Got frame=%d %d, Codec=%d", NALType, end, m_codec);
-        push(&frameBuffer[0], end, packet->trackingFrameIndex);
-        push(&frameBuffer[end], frameByteSize - end, packet->trackingFrameIndex);
+// Push recovered slice without waiting for the rest of frame.
+// Returns true when the last slice of the frame has been pushed.
+bool NALParser::processSlice() {
+    const VideoFrame &slice = m_queue.getCurrentFrame();
+    if (m_queue.isFrameBroken()) {
+        closePartialFrame();
+        return false;
+    }
+    bool last = slice.sliceIndex + 1 >= slice.sliceCount;
 
-        m_queue.OnIDRProcessed();
+    // First slice may contain parameter sets.
+    bool ret = processFrame(m_queue.getFrameBuffer(), m_queue.getFrameByteSize(),
+                            slice.videoFrameIndex, slice.trackingFrameIndex, slice.frameType,
+                            !last, false);
+    if (slice.sliceIndex == 0) {
+        m_firstSliceInfo = m_frameInfo;
+        m_firstSliceDecodable = m_frameDecodable;
+    }
+    if (!ret) {
+        closePartialFrame();
+        return false;
+    }
+    if (last || !m_frameDecodable) {
+        m_partialVideoFrame = UINT64_MAX;
     } else {
-        push(&frameBuffer[0], frameByteSize, packet->trackingFrameIndex);
+        m_partialVideoFrame = slice.videoFrameIndex;
+        m_partialTrackingFrame = slice.trackingFrameIndex;
     }
-    return true;
+    return last;
 }
 
-void NALParser::push(const char *buffer, int length, uint64_t frameIndex) {
-    jobject nal;
-    jbyteArray buf;
+// Push intact prefix of unrecoverable frame. Last NAL in the prefix may be truncated, so the prefix
+// is cut at the start of it.
+void NALParser::processConcealedFrame(std::vector<char> &concealedFrame, int frameByteSize,
+                                      uint64_t videoFrameIndex, uint64_t frameIndex) {
+    if (m_codec == ALVR_CODEC_AV1) {
+        // AV1 decoder rejects frame with missing tiles.
+        return;
+    }
+    if (m_decodability.isBroken()) {
+        // Its references are already gone.
+        FrameLog(frameIndex, "Concealed frame is not decodable.");
+        return;
+    }
+    int NALs = m_scanner.scan(concealedFrame.data(), frameByteSize);
+    if (m_scanner.hasParameterSet()) {
+        // Never feed broken IDR frame.
+        return;
+    }
+    if (NALs < 2) {
+        FrameLog(frameIndex, "No complete NAL in intact prefix. size=%d", frameByteSize);
+        return;
+    }
+    int cut = m_scanner.getNALs().back().start;
+    FrameLog(frameIndex, "Push concealed frame. intact=%d cut=%d", frameByteSize, cut);
+    LatencyCollector::Instance().concealedFrame();
+    m_decodability.onConcealedFrame(videoFrameIndex);
+    push(concealedFrame, 0, 0, cut, videoFrameIndex, frameIndex, m_scanner.getFrameType(), true,
+         false, false);
+}
 
-    nal = m_env->CallObjectMethod(mUdpManager, mObtainNALMethodID, static_cast<jint>(length));
-    if (nal == nullptr) {
-        LOGE("NAL Queue is full.");
+// Terminate partially pushed frame by empty NAL, so that decoder does not wait for remaining slices.
+void NALParser::closePartialFrame() {
+    if (m_partialVideoFrame == UINT64_MAX) {
         return;
     }
+    LOGI("Closing partial frame. videoFrame=%llu", (unsigned long long) m_partialVideoFrame);
+    pushEndOfFrame(m_partialVideoFrame, m_partialTrackingFrame);
+    m_partialVideoFrame = UINT64_MAX;
+}
+
+void NALParser::processInterleavedParity(VideoInterleavedParity *packet, int packetSize) {
+    m_packetTime = getTimestampUs();
+    m_interleavedQueue.addParityPacket(packet, packetSize);
+    pushReadyFrames();
+}
 
-    m_env->SetIntField(nal, NAL_length, length);
-    m_env->SetLongField(nal, NAL_frameIndex, frameIndex);
+void NALParser::pushReadyFrames() {
+    InterleavedFECQueue::Frame *frame;
+    while ((frame = m_interleavedQueue.peekReadyFrame()) != nullptr) {
+        // Frame can still be referenced by parity of current group, so it is copied.
+        processFrame(frame->frameBuffer, frame->frameByteSize, frame->videoFrameIndex,
+                     frame->trackingFrameIndex, frame->frameType, false, true);
+        m_interleavedQueue.ackFrame(frame, m_frameInfo, m_frameDecodable);
+        m_interleavedQueue.popReadyFrame();
+    }
+}
 
-    buf = (jbyteArray) m_env->GetObjectField(nal, NAL_buf);
-    char *cbuf = (char *) m_env->GetByteArrayElements(buf, NULL);
+bool NALParser::processFrame(std::vector<char> &frame, int frameByteSize,
+                             uint64_t videoFrameIndex, uint64_t frameIndex,
+                             uint8_t signalledFrameType, bool partial, bool copy) {
+    // Slices overwrite it, so the last slice is measured.
+    LatencyCollector::Instance().fecDone(frameIndex, m_packetTime);
+    TraceScope trace(TRACE_STAGE_NAL, frameIndex, videoFrameIndex, static_cast<uint64_t>(frameByteSize));
+    memset(&m_frameInfo, 0, sizeof(m_frameInfo));
+    m_frameDecodable = false;
+    if (m_scanner.scan(frame.data(), frameByteSize) == 0) {
+        LOG("Got invalid frame. No start code.");
+        return false;
+    }
+    int configLength = m_scanner.getConfigLength();
+    uint8_t frameType = m_scanner.getFrameType();
+    // Must be parsed before push because the buffer may be taken by the sink.
+    if (m_sliceParser.parse(frame.data(), m_scanner.getNALs(), &m_frameInfo)) {
+        frameType = m_frameInfo.idr ? ALVR_VIDEO_FRAME_TYPE_IDR : ALVR_VIDEO_FRAME_TYPE_P;
+        FrameLog(frameIndex, "Slice header. type=%d idr=%d ref=%d frameNum=%u poc=%d recovery=%d",
+                 m_frameInfo.sliceType, m_frameInfo.idr, m_frameInfo.reference,
+                 m_frameInfo.frameNum, m_frameInfo.pictureOrderCount, m_frameInfo.recoveryPoint);
+    }
+    // Frames after IDR or recovery point are decodable. Without parsable slice header (and on AV1),
+    // IDR (key frame) or parameter sets are taken as a sign of it. Server marks the frame which
+    // refers only to ACKed frames.
+    bool recovery = m_frameInfo.valid ? m_frameInfo.idr || m_frameInfo.recoveryPoint :
+                    configLength != 0 || frameType == ALVR_VIDEO_FRAME_TYPE_IDR;
+    recovery = recovery || signalledFrameType == ALVR_VIDEO_FRAME_TYPE_RECOVERY;
+    // Frames referring to a lost frame only waste decoder time until recovery. Frames dropped by
+    // the push of this frame are found on the next frame.
+    bool dropped = checkDroppedReferences(videoFrameIndex);
+    m_frameDecodable = m_decodability.onFrame(videoFrameIndex, frameIndex, recovery, m_frameInfo) &&
+                       !dropped;
+    // Without slice header, frame is assumed to be referenced.
+    bool reference = !m_frameInfo.valid || m_frameInfo.reference;
 
-    memcpy(cbuf, buffer, length);
-    m_env->ReleaseByteArrayElements(buf, (jbyte *) cbuf, 0);
-    m_env->DeleteLocalRef(buf);
+    if (configLength != 0) {
+        // This frame contains (VPS + )SPS + PPS + IDR on NVENC H.264 (H.265) stream.
+        // (VPS + )SPS + PPS has short size (8bytes + 28bytes in some environment), so we can assume SPS + PPS is contained in first fragment.
+        if (configLength == -1) {
+            // Invalid frame.
+            LOG("Got invalid frame. No slice after parameter sets.");
+            return false;
+        }
+        if (m_parameterSets.update(frame.data(), configLength)) {
+            LOGI("Got new parameter sets. type=%d size=%d, Codec=%d", m_scanner.getNALs()[0].type,
+                 configLength, m_codec);
+            if (!m_parameterSetCachePath.empty()) {
+                m_parameterSets.save(m_parameterSetCachePath, m_codec);
+            }
+            // Parameter sets are passed even if the slices are dropped. AV1 decoders take sequence
+            // header in frame data, so it is not split as codec config.
+            int pushConfigLength = m_codec == ALVR_CODEC_AV1 && m_frameDecodable ? 0 : configLength;
+            push(frame, 0, pushConfigLength, m_frameDecodable ? frameByteSize : configLength,
+                 videoFrameIndex, frameIndex, frameType, reference, partial && m_frameDecodable,
+                 copy);
+        } else if (m_frameDecodable) {
+            // Decoder already has the same parameter sets.
+            push(frame, configLength, 0, frameByteSize, videoFrameIndex, frameIndex, frameType,
+                 reference, partial, copy);
+        }
+    } else if (m_frameDecodable) {
+        push(frame, 0, 0, frameByteSize, videoFrameIndex, frameIndex, frameType, reference,
+             partial, copy);
+    }
+    if (recovery) {
+        m_queue.OnIDRProcessed();
+        m_interleavedQueue.OnIDRProcessed();
+    }
+    return true;
+}
 
-    m_env->CallVoidMethod(mUdpManager, mPushNALMethodID, nal);
+// Data is [offset, length) of frameBuffer and leading configLength bytes of it are parameter sets.
+// frameBuffer may be exchanged by the decode queue unless copy is set, because frames from
+// interleaved FEC queue are still referenced by parity.
+// partial: Following slices of the same frame will be pushed separately.
+void NALParser::push(std::vector<char> &frameBuffer, int offset, int configLength, int length,
+                     uint64_t videoFrameIndex, uint64_t frameIndex, uint8_t frameType,
+                     bool reference, bool partial, bool copy) {
+    if (m_streamRecorder) {
+        // Parameter sets alone are not indexed as a frame.
+        m_streamRecorder->writeFrame(frameBuffer.data() + offset, length - offset, configLength,
+                                     videoFrameIndex != UINT64_MAX ? frameIndex : UINT64_MAX,
+                                     frameType, partial);
+    }
+    m_decodeQueue.push(frameBuffer, offset, configLength, length, videoFrameIndex, frameIndex,
+                       frameType, reference, partial, copy);
+    if (videoFrameIndex != UINT64_MAX) {
+        LatencyCollector::Instance().nalPushed(frameIndex);
+    }
+}
 
-    m_env->DeleteLocalRef(nal);
+void NALParser::pushEndOfFrame(uint64_t videoFrameIndex, uint64_t frameIndex) {
+    if (m_streamRecorder) {
+        m_streamRecorder->writeEndOfFrame(frameIndex);
+    }
+    m_decodeQueue.pushEndOfFrame(videoFrameIndex, frameIndex);
 }
 
-int NALParser::findVPSSPS(const char *frameBuffer, int frameByteSize) {
-    int zeroes = 0;
-    int foundNals = 0;
-    for (int i = 0; i < frameByteSize; i++) {
-        if (frameBuffer[i] == 0) {
-            zeroes++;
-        } else if (frameBuffer[i] == 1) {
-            if (zeroes == 3) {
-                foundNals++;
-                if (m_codec == ALVR_CODEC_H264 && foundNals >= 3) {
-                    // Find end of SPS+PPS on H.264.
-                    return i - 3;
-                } else if (m_codec == ALVR_CODEC_H265 && foundNals >= 4) {
-                    // Find end of VPS+SPS+PPS on H.264.
-                    return i - 3;
-                }
-            }
-            zeroes = 0;
-        } else {
-            zeroes = 0;
-        }
+// Decode queue dropped frames which later frames refer to. They are NACKed, so that the server
+// sends a frame which does not refer to them, and frames until then are not decoded.
+// Returns true if videoFrameIndex is in the dropped range.
+bool NALParser::checkDroppedReferences(uint64_t videoFrameIndex) {
+    uint64_t start, end;
+    if (!m_decodeQueue.takeDroppedReferences(&start, &end)) {
+        return false;
     }
-    return -1;
+    LOGI("Decode queue dropped reference frames. videoFrame=%llu-%llu",
+         (unsigned long long) start, (unsigned long long) end);
+    m_decodability.invalidate();
+    m_feedback->sendVideoFrameAck(false, false, start, end);
+    return start <= videoFrameIndex && videoFrameIndex <= end;
 }
@@ -1,39 +1,86 @@
 #ifndef ALVRCLIENT_NAL_H
 #define ALVRCLIENT_NAL_H
 
-#include <jni.h>
 #include <list>
+#include <memory>
 #include "utils.h"
 #include "fec.h"
+#include "fec_interleave.h"
+#include "decoder_sink.h"
+#include "annexb.h"
+#include "parameter_set_cache.h"
+#include "slice_header.h"
+#include "decodability_tracker.h"
+#include "decode_queue.h"
+#include "capture_file.h"
 
 
 class NALParser {
 public:
-    NALParser(JNIEnv *env, jobject udpManager, UdpManager *udpManager_C);
+    NALParser(VideoFeedback *feedback);
     ~NALParser();
 
     void reset();
 
+    // Frames are dropped while no sink is set.
+    void setSink(const std::shared_ptr<DecoderSink> &sink);
+
+    // depth: frameQueueSize of ConnectionMessage/ChangeSettings.
+    void configureDecodeQueue(int depth, int refreshRate);
     void setCodec(int codec);
+    // Parameter sets of the stream are saved to path and sent to decoder on reset() before the
+    // first IDR frame. Empty path disables persistence. Call after setCodec.
+    void setParameterSetCachePath(const std::string &path);
+    void setInterleavedFecDepth(int depth);
+    void setSliceLossReport(bool enabled);
+    // Frames pushed to decode queue are recorded. nullptr stops recording.
+    void setStreamRecorder(const std::shared_ptr<CaptureWriter> &recorder);
     bool processPacket(VideoFrame *packet, int packetSize);
+    void processInterleavedParity(VideoInterleavedParity *packet, int packetSize);
 private:
-    void push(const char *buffer, int length, uint64_t frameIndex);
-    int findVPSSPS(const char *frameBuffer, int frameByteSize);
+    bool processFrame(std::vector<char> &frameBuffer, int frameByteSize, uint64_t videoFrameIndex,
+                      uint64_t frameIndex, uint8_t signalledFrameType, bool partial, bool copy);
+    bool processSlice();
+    void processConcealedFrame(std::vector<char> &frameBuffer, int frameByteSize,
+                               uint64_t videoFrameIndex, uint64_t frameIndex);
+    void closePartialFrame();
+    void pushReadyFrames();
+    void push(std::vector<char> &frameBuffer, int offset, int configLength, int length,
+              uint64_t videoFrameIndex, uint64_t frameIndex, uint8_t frameType, bool reference,
+              bool partial, bool copy);
+    void pushParameterSets();
+    void pushEndOfFrame(uint64_t videoFrameIndex, uint64_t frameIndex);
+    bool checkDroppedReferences(uint64_t videoFrameIndex);
 
+    VideoFeedback *m_feedback;
     FECQueue m_queue;
+    InterleavedFECQueue m_interleavedQueue;
+    DecodeQueue m_decodeQueue;
+    std::shared_ptr<CaptureWriter> m_streamRecorder;
+    // NAL index of the frame being processed.
+    AnnexBScanner m_scanner;
+    ParameterSetCache m_parameterSets;
+    SliceHeaderParser m_sliceParser;
+    // Slice header of the last processed frame (or slice).
+    FrameInfo m_frameInfo = {};
+    // Slice header of the first slice of current frame. Reported by ACK.
+    FrameInfo m_firstSliceInfo = {};
+    DecodabilityTracker m_decodability;
+    // Last processed frame (or slice) was handed to decoder. false if it was dropped because its
+    // references are broken.
+    bool m_frameDecodable = false;
+    bool m_firstSliceDecodable = false;
+    std::string m_parameterSetCachePath;
 
     int m_codec = 1;
 
-    JNIEnv *m_env;
-    jobject mUdpManager;
-
-    jfieldID NAL_length;
-    jfieldID NAL_frameIndex;
-    jfieldID NAL_buf;
+    bool mIDRProcessed = false;
 
-    jmethodID mObtainNALMethodID;
-    jmethodID mPushNALMethodID;
+    // Frame whose leading slices have been pushed to decoder. UINT64_MAX if none.
+    uint64_t m_partialVideoFrame = UINT64_MAX;
+    uint64_t m_partialTrackingFrame = 0;
 
-    bool mIDRProcessed = false;
+    // Arrival of the packet being processed. Start of FEC stage of the frame it completes.
+    uint64_t m_packetTime = 0;
 };
 #endif //ALVRCLIENT_NAL_H
@@ -0,0 +1,139 @@
+#include <string.h>
+#include <time.h>
+#include "nal_buffer_pool.h"
+
+NALBufferPool::NALBufferPool() {
+    pthread_cond_init(&m_releasedCond, nullptr);
+}
+
+NALBufferPool::~NALBufferPool() {
+    pthread_cond_destroy(&m_releasedCond);
+}
+
+int NALBufferPool::publish(std::vector<char> &frameBuffer, int references, bool *needRegistration) {
+    MutexLock lock(m_mutex);
+
+    if (m_publishedCount >= MAX_PUBLISHED_BUFFERS || frameBuffer.empty()) {
+        return -1;
+    }
+
+    const char *data = frameBuffer.data();
+    size_t capacity = frameBuffer.capacity();
+
+    int id = -1;
+    auto it = m_ids.find(data);
+    if (it != m_ids.end() && m_buffers[it->second].references == 0) {
+        id = it->second;
+    } else {
+        // New allocation. (Or reallocated by resize)
+        // Allocation of an unused slot may have been freed by reallocation, so the slot is taken
+        // over instead of growing. Decoder replaces its ByteBuffer of the id on registration.
+        for (size_t i = 0; i < m_buffers.size(); i++) {
+            if (m_buffers[i].references == 0) {
+                id = static_cast<int>(i);
+                break;
+            }
+        }
+        if (id >= 0) {
+            m_ids.erase(m_buffers[id].registeredData);
+        } else {
+            id = static_cast<int>(m_buffers.size());
+            m_buffers.push_back(Buffer{{}, nullptr, 0, 0});
+        }
+        if (it != m_ids.end()) {
+            // Same address is still registered by a busy slot of a freed allocation.
+            m_buffers[it->second].registeredData = nullptr;
+            m_ids.erase(it);
+        }
+        m_ids[data] = id;
+    }
+
+    Buffer &buffer = m_buffers[id];
+    buffer.buffer.swap(frameBuffer);
+    if (!m_free.empty()) {
+        frameBuffer.swap(m_free.back());
+        m_free.pop_back();
+    }
+    buffer.references = references;
+    m_publishedCount++;
+
+    *needRegistration = buffer.registeredData != data || buffer.registeredCapacity != capacity;
+    buffer.registeredData = data;
+    buffer.registeredCapacity = capacity;
+    return id;
+}
+
+int NALBufferPool::publishCopy(const char *buffer, int length, int references,
+                               bool *needRegistration) {
+    std::vector<char> copy;
+    {
+        MutexLock lock(m_mutex);
+        if (!m_free.empty()) {
+            copy.swap(m_free.back());
+            m_free.pop_back();
+        }
+    }
+    if (copy.size() < static_cast<size_t>(length)) {
+        copy.resize(static_cast<size_t>(length));
+    }
+    memcpy(copy.data(), buffer, static_cast<size_t>(length));
+
+    int id = publish(copy, references, needRegistration);
+
+    if (copy.capacity() > 0) {
+        MutexLock lock(m_mutex);
+        m_free.push_back(std::move(copy));
+    }
+    return id;
+}
+
+void NALBufferPool::release(int id) {
+    MutexLock lock(m_mutex);
+
+    if (id < 0 || id >= static_cast<int>(m_buffers.size()) || m_buffers[id].references <= 0) {
+        LOGE("Invalid NAL buffer release. id=%d", id);
+        return;
+    }
+    Buffer &buffer = m_buffers[id];
+    buffer.references--;
+    if (buffer.references == 0) {
+        m_free.emplace_back();
+        m_free.back().swap(buffer.buffer);
+        m_publishedCount--;
+        pthread_cond_signal(&m_releasedCond);
+    }
+}
+
+char *NALBufferPool::getData(int id) {
+    MutexLock lock(m_mutex);
+    return m_buffers[id].buffer.data();
+}
+
+size_t NALBufferPool::getCapacity(int id) {
+    MutexLock lock(m_mutex);
+    return m_buffers[id].buffer.capacity();
+}
+
+int NALBufferPool::getPublishedCount() {
+    MutexLock lock(m_mutex);
+    return m_publishedCount;
+}
+
+bool NALBufferPool::waitPublishedBelow(int count, int64_t timeoutUs) {
+    timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutUs / 1000000;
+    deadline.tv_nsec += (timeoutUs % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    MutexLock lock(m_mutex);
+    while (m_publishedCount >= count) {
+        if (!m_mutex.CondTimedWait(&m_releasedCond, &deadline)) {
+            return m_publishedCount < count;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef ALVRCLIENT_NAL_BUFFER_POOL_H
+#define ALVRCLIENT_NAL_BUFFER_POOL_H
+
+#include <vector>
+#include <unordered_map>
+#include "utils.h"
+
+// Frame buffers shared with decoder thread without copy.
+// FEC output buffer is moved into the pool by swap and a free buffer is given back in exchange.
+// Each allocation gets an id and is wrapped by direct ByteBuffer only once, so steady state needs
+// no registration. Buffers are returned to the pool by release() from decoder thread.
+class NALBufferPool {
+public:
+    // Same as queue size of Java side.
+    static const int MAX_PUBLISHED_BUFFERS = 100;
+
+    NALBufferPool();
+    ~NALBufferPool();
+
+    // Move frameBuffer to the pool. frameBuffer is replaced with free buffer (or empty vector).
+    // Returns buffer id, or -1 when too many buffers are held by decoder.
+    // needRegistration is set when the allocation is not known by decoder yet.
+    int publish(std::vector<char> &frameBuffer, int references, bool *needRegistration);
+    // For buffers which must be kept by caller. (e.g. still referenced by interleaved parity group)
+    int publishCopy(const char *buffer, int length, int references, bool *needRegistration);
+    void release(int id);
+
+    char *getData(int id);
+    size_t getCapacity(int id);
+    int getPublishedCount();
+    // Wait until less than count buffers are held by decoder. Returns false on timeout.
+    bool waitPublishedBelow(int count, int64_t timeoutUs);
+private:
+    struct Buffer {
+        std::vector<char> buffer;
+        const char *registeredData;
+        size_t registeredCapacity;
+        int references;
+    };
+
+    Mutex m_mutex;
+    pthread_cond_t m_releasedCond;
+    std::vector<Buffer> m_buffers;
+    std::vector<std::vector<char>> m_free;
+    std::unordered_map<const char *, int> m_ids;
+    int m_publishedCount = 0;
+};
+
+#endif //ALVRCLIENT_NAL_BUFFER_POOL_H
@@ -0,0 +1,77 @@
+/// Network watchdog
+// Budget check of network loop stages and packet handlers.
+////////////////////////////////////////////////////////////////////
+
+#include "network_watchdog.h"
+#include "latency_collector.h"
+#include "frame_trace.h"
+#include "utils.h"
+
+// Select times out every 10 ms. At 90 Hz with sliced FEC a frame arrives every 11 ms in dozens of
+// packets, so a few ms of blocking already delays the next frame.
+const uint64_t NetworkWatchdog::BUDGET_US[WATCHDOG_STAGE_COUNT] = {
+        5000, // Iteration
+        2000, // Send queue
+        4000, // Receive
+        2000, // Packet
+        2000, // Periodic
+};
+
+NetworkWatchdog::NetworkWatchdog() : m_iterationStart(0), m_slowestPacketUs(0),
+                                     m_slowestPacketType(NO_PACKET) {
+}
+
+void NetworkWatchdog::beginIteration() {
+    m_iterationStart = getTimestampUs();
+    m_slowestPacketUs = 0;
+    m_slowestPacketType = NO_PACKET;
+}
+
+void NetworkWatchdog::endIteration(uint64_t frameIndex) {
+    check(WATCHDOG_STAGE_ITERATION, m_iterationStart, frameIndex, m_slowestPacketType);
+}
+
+uint64_t NetworkWatchdog::check(uint32_t stage, uint64_t start, uint64_t frameIndex,
+                                uint32_t packetType) {
+    uint64_t end = getTimestampUs();
+    uint64_t duration = end > start ? end - start : 0;
+    if (stage == WATCHDOG_STAGE_PACKET && duration > m_slowestPacketUs) {
+        m_slowestPacketUs = duration;
+        m_slowestPacketType = packetType;
+    } else if (stage == WATCHDOG_STAGE_RECEIVE) {
+        packetType = m_slowestPacketType;
+    }
+    if (duration <= BUDGET_US[stage]) {
+        return end;
+    }
+
+    packetType &= NO_PACKET;
+    FrameTrace::Instance().record(TRACE_STAGE_NETWORK_STALL, TRACE_PHASE_INSTANT, frameIndex,
+                                  UINT64_MAX, (duration << 16) | (packetType << 8) | stage);
+    LatencyCollector::Instance().networkStall(stage, packetType, duration);
+    LOGE_LIMITED(5, "Network loop stalled. stage=%s packetType=%d duration=%.1f ms budget=%.1f ms",
+                 getStageName(stage), packetType == NO_PACKET ? -1 : static_cast<int>(packetType),
+                 duration / 1000.0, BUDGET_US[stage] / 1000.0);
+    return end;
+}
+
+const char *NetworkWatchdog::getStageName(uint32_t stage) {
+    switch (stage) {
+        case WATCHDOG_STAGE_ITERATION:
+            return "iteration";
+        case WATCHDOG_STAGE_SEND_QUEUE:
+            return "sendQueue";
+        case WATCHDOG_STAGE_RECEIVE:
+            return "receive";
+        case WATCHDOG_STAGE_PACKET:
+            return "packet";
+        case WATCHDOG_STAGE_PERIODIC:
+            return "periodic";
+        default:
+            return "unknown";
+    }
+}
+
+uint64_t NetworkWatchdog::getBudget(uint32_t stage) {
+    return stage < WATCHDOG_STAGE_COUNT ? BUDGET_US[stage] : 0;
+}
@@ -0,0 +1,51 @@
+#ifndef ALVRCLIENT_NETWORK_WATCHDOG_H
+#define ALVRCLIENT_NETWORK_WATCHDOG_H
+
+#include <stdint.h>
+
+// Parts of UdpManager::runLoop measured by NetworkWatchdog.
+enum WATCHDOG_STAGE {
+    // Whole iteration except waiting in select.
+    WATCHDOG_STAGE_ITERATION,
+    // Sending packets queued by other threads.
+    WATCHDOG_STAGE_SEND_QUEUE,
+    // Draining the socket. Includes handlers of all packets received.
+    WATCHDOG_STAGE_RECEIVE,
+    // Handler of one packet, including JNI callbacks it makes.
+    WATCHDOG_STAGE_PACKET,
+    // Statistics aggregation and periodic sends.
+    WATCHDOG_STAGE_PERIODIC,
+    WATCHDOG_STAGE_COUNT
+};
+
+// Measures the network loop against a latency budget per stage. The socket is not drained while
+// the loop is blocked, so a stall turns into packet loss once the receive buffer is full.
+// A stage over its budget is recorded into FrameTrace and counted by LatencyCollector.
+// Used only from the network thread.
+class NetworkWatchdog {
+public:
+    // No packet was handled, or the stage is not a packet handler.
+    static const uint32_t NO_PACKET = 0xFF;
+
+    NetworkWatchdog();
+
+    void beginIteration();
+    // frameIndex: Latest tracking frame index received, to locate the stall in the trace.
+    void endIteration(uint64_t frameIndex);
+
+    // start: getTimestampUs() when the stage started. Returns end of the stage.
+    uint64_t check(uint32_t stage, uint64_t start, uint64_t frameIndex,
+                   uint32_t packetType = NO_PACKET);
+
+    static const char *getStageName(uint32_t stage);
+    static uint64_t getBudget(uint32_t stage);
+private:
+    static const uint64_t BUDGET_US[WATCHDOG_STAGE_COUNT];
+
+    uint64_t m_iterationStart;
+    // Slowest packet handler of the iteration, to blame for iteration and receive stalls.
+    uint64_t m_slowestPacketUs;
+    uint32_t m_slowestPacketType;
+};
+
+#endif //ALVRCLIENT_NETWORK_WATCHDOG_H
@@ -18,6 +18,7 @@
 #include "render.h"
 #include "ovr_context.h"
 #include "latency_collector.h"
+#include "frame_trace.h"
 #include "packet_types.h"
 #include "udp.h"
 #include "asset.h"
@@ -27,6 +28,9 @@ void OvrContext::initialize(JNIEnv *env, jobject activity, jobject assetManager,
                             bool ARMode, int initialRefreshRate) {
     LOG("Initializing EGL.");
 
+    // Render thread.
+    LatencyCollector::Instance().registerThread();
+
     setAssetManager(env, assetManager);
 
     this->env = env;
@@ -433,6 +437,10 @@ void OvrContext::sendTrackingInfo(TrackingInfo *packet, double displayTime, ovrT
     FrameLog(FrameIndex, "Sending tracking info.");
 }
 
+uint64_t OvrContext::getTimestampUsFromVrapiTime(double time) {
+    return getTimestampUs() + static_cast<int64_t>((time - vrapi_GetTimeInSeconds()) * 1e6);
+}
+
 // Called TrackingThread. So, we can't use this->env.
 void OvrContext::fetchTrackingInfo(JNIEnv *env_, jobject udpReceiverThread, ovrVector3f *position,
                                    ovrQuatf *orientation) {
@@ -483,7 +491,9 @@ void OvrContext::fetchTrackingInfo(JNIEnv *env_, jobject udpReceiverThread, ovrV
         // Non AR
         sendTrackingInfo(&info, frame->displayTime, &frame->tracking, nullptr, nullptr);
     }
-    LatencyCollector::Instance().tracking(frame->frameIndex);
+    LatencyCollector::Instance().tracking(frame->frameIndex,
+                                          getTimestampUsFromVrapiTime(frame->displayTime));
+    FrameTrace::Instance().record(TRACE_STAGE_TRACKING, TRACE_PHASE_INSTANT, frame->frameIndex);
 
     env_->CallVoidMethod(udpReceiverThread, mUdpReceiverThread_send, reinterpret_cast<jlong>(&info),
                          static_cast<jint>(sizeof(info)));
@@ -545,6 +555,7 @@ void OvrContext::onPause() {
 
 void OvrContext::render(uint64_t renderedFrameIndex) {
     LatencyCollector::Instance().rendered1(renderedFrameIndex);
+    TraceScope trace(TRACE_STAGE_RENDER, renderedFrameIndex);
     FrameLog(renderedFrameIndex, "Got frame for render.");
 
     updateHapticsState();
@@ -598,9 +609,26 @@ void OvrContext::render(uint64_t renderedFrameIndex) {
     frameDesc.LayerCount = 1;
     frameDesc.Layers = layers2;
 
-    ovrResult res = vrapi_SubmitFrame2(Ovr, &frameDesc);
+    ovrResult res;
+    {
+        TraceScope submitTrace(TRACE_STAGE_SUBMIT, renderedFrameIndex);
+        res = vrapi_SubmitFrame2(Ovr, &frameDesc);
+    }
 
     LatencyCollector::Instance().submit(renderedFrameIndex);
+    // vrapi does not report when a frame was scanned out, and predicted display time of the frame
+    // index is still the one which tracking was predicted for. A frame submitted after that vsync
+    // is shown on a later one, so take the first vsync not earlier than now, counting whole
+    // refresh periods from the predicted one.
+    double displayTime = vrapi_GetPredictedDisplayTime(Ovr, renderedFrameIndex);
+    double now = vrapi_GetTimeInSeconds();
+    float refreshRate = vrapi_GetSystemPropertyFloat(&java, VRAPI_SYS_PROP_DISPLAY_REFRESH_RATE);
+    if (now > displayTime && refreshRate > 0) {
+        double period = 1.0 / refreshRate;
+        displayTime += ceil((now - displayTime) / period) * period;
+    }
+    LatencyCollector::Instance().displayed(renderedFrameIndex,
+                                           getTimestampUsFromVrapiTime(displayTime));
 
     FrameLog(renderedFrameIndex, "vrapi_SubmitFrame2 Orientation=(%f, %f, %f, %f)",
              frame->tracking.HeadPose.Pose.Orientation.x,
@@ -114,6 +114,9 @@ private:
     // Previous trigger button state.
     bool mButtonPressed;
 
+    // Converts time in the clock of vrapi to the clock of getTimestampUs().
+    uint64_t getTimestampUsFromVrapiTime(double time);
+
     void setControllerInfo(TrackingInfo *packet, double displayTime);
     uint64_t mapButtons(ovrInputTrackedRemoteCapabilities *remoteCapabilities, ovrInputStateTrackedRemote *remoteInputState);
 
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <string.h>
+#include "parameter_set_cache.h"
+#include "utils.h"
+
+static const uint32_t PARAMETER_SET_FILE_MAGIC = 0x53504C41; // "ALPS"
+// Parameter sets are much smaller. Larger file is broken.
+static const uint32_t MAX_PARAMETER_SET_SIZE = 4096;
+
+struct ParameterSetFileHeader {
+    uint32_t magic;
+    uint32_t codec;
+    uint64_t hash;
+    uint32_t length;
+};
+
+bool ParameterSetCache::update(const char *data, int length) {
+    uint64_t h = hash(data, length);
+    if (m_signalled && h == m_hash && m_data.size() == static_cast<size_t>(length)) {
+        return false;
+    }
+    m_data.assign(data, data + length);
+    m_hash = h;
+    m_signalled = true;
+    return true;
+}
+
+void ParameterSetCache::invalidate() {
+    m_signalled = false;
+}
+
+void ParameterSetCache::markSignalled() {
+    m_signalled = true;
+}
+
+void ParameterSetCache::clear() {
+    m_data.clear();
+    m_hash = 0;
+    m_signalled = false;
+}
+
+bool ParameterSetCache::load(const std::string &path, int codec) {
+    clear();
+
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr) {
+        return false;
+    }
+    ParameterSetFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, fp) == 1 &&
+              header.magic == PARAMETER_SET_FILE_MAGIC &&
+              header.codec == static_cast<uint32_t>(codec) &&
+              header.length > 0 && header.length <= MAX_PARAMETER_SET_SIZE;
+    if (ok) {
+        m_data.resize(header.length);
+        ok = fread(m_data.data(), header.length, 1, fp) == 1 &&
+             hash(m_data.data(), header.length) == header.hash;
+    }
+    fclose(fp);
+
+    if (!ok) {
+        LOGI("Ignoring broken parameter set cache. path=%s", path.c_str());
+        clear();
+        return false;
+    }
+    m_hash = header.hash;
+    LOGI("Loaded parameter sets. path=%s size=%u", path.c_str(), header.length);
+    return true;
+}
+
+void ParameterSetCache::save(const std::string &path, int codec) const {
+    if (m_data.empty()) {
+        return;
+    }
+    // Write to temporary file and rename, so that the cache is never left half written.
+    std::string tmpPath = path + ".tmp";
+    FILE *fp = fopen(tmpPath.c_str(), "wb");
+    if (fp == nullptr) {
+        LOGE("Failed to save parameter sets. path=%s", tmpPath.c_str());
+        return;
+    }
+    ParameterSetFileHeader header;
+    header.magic = PARAMETER_SET_FILE_MAGIC;
+    header.codec = static_cast<uint32_t>(codec);
+    header.hash = m_hash;
+    header.length = static_cast<uint32_t>(m_data.size());
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              fwrite(m_data.data(), m_data.size(), 1, fp) == 1;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        LOGE("Failed to save parameter sets. path=%s", path.c_str());
+        remove(tmpPath.c_str());
+    }
+}
+
+// FNV-1a
+uint64_t ParameterSetCache::hash(const char *data, int length) {
+    uint64_t h = 14695981039346656037ULL;
+    for (int i = 0; i < length; i++) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
@@ -0,0 +1,39 @@
+#ifndef ALVRCLIENT_PARAMETER_SET_CACHE_H
+#define ALVRCLIENT_PARAMETER_SET_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Last (VPS + )SPS + PPS of the stream. Parameter sets are compared by hash, so the decoder is
+// signalled only when they change. Saved per server to configure the decoder before the first
+// IDR frame on reconnect.
+class ParameterSetCache {
+public:
+    // Returns true if data differs from cached parameter sets or they have not been signalled
+    // since last invalidate(). Cache is updated.
+    bool update(const char *data, int length);
+    // Cached parameter sets have to be signalled to a new decoder again.
+    void invalidate();
+    void markSignalled();
+    void clear();
+
+    bool hasData() const {
+        return !m_data.empty();
+    }
+    std::vector<char> &getData() {
+        return m_data;
+    }
+
+    // Returns false if file does not exist or is for another codec.
+    bool load(const std::string &path, int codec);
+    void save(const std::string &path, int codec) const;
+private:
+    static uint64_t hash(const char *data, int length);
+
+    std::vector<char> m_data;
+    uint64_t m_hash = 0;
+    bool m_signalled = false;
+};
+
+#endif //ALVRCLIENT_PARAMETER_SET_CACHE_H
@@ -0,0 +1,418 @@
+/// H.264/H.265 slice header parser
+// Reads slice type, frame_num, picture order count and reference flag of the first slice of a
+// frame, which are needed for acknowledgement and reference tracking. Parameter sets are parsed
+// only as far as needed to locate those fields.
+////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "slice_header.h"
+#include "bit_reader.h"
+#include "packet_types.h"
+#include "utils.h"
+
+static const int H264_NAL_TYPE_SLICE = 1;
+static const int H264_NAL_TYPE_IDR = 5;
+static const int H264_NAL_TYPE_SEI = 6;
+static const int H264_NAL_TYPE_SPS = 7;
+static const int H264_NAL_TYPE_PPS = 8;
+
+static const int H265_NAL_TYPE_RSV_VCL_N14 = 14;
+static const int H265_NAL_TYPE_BLA_W_LP = 16;
+static const int H265_NAL_TYPE_IDR_W_RADL = 19;
+static const int H265_NAL_TYPE_IDR_N_LP = 20;
+static const int H265_NAL_TYPE_RSV_IRAP_23 = 23;
+static const int H265_NAL_TYPE_VCL_MAX = 31;
+static const int H265_NAL_TYPE_SPS = 33;
+static const int H265_NAL_TYPE_PPS = 34;
+static const int H265_NAL_TYPE_PREFIX_SEI = 39;
+
+static const int SEI_PAYLOAD_TYPE_RECOVERY_POINT = 6;
+
+void SliceHeaderParser::setCodec(int codec) {
+    if (m_codec != codec) {
+        reset();
+    }
+    m_codec = codec;
+}
+
+void SliceHeaderParser::reset() {
+    for (SPS &sps : m_sps) {
+        sps = SPS();
+    }
+    for (PPS &pps : m_pps) {
+        pps = PPS();
+    }
+    m_lastSliceType = ALVR_SLICE_TYPE_UNKNOWN;
+}
+
+bool SliceHeaderParser::parse(const char *frameBuffer, const std::vector<NALUnit> &nals,
+                              FrameInfo *info) {
+    memset(info, 0, sizeof(*info));
+    if (m_codec == ALVR_CODEC_AV1) {
+        // AV1 has no slice header. Key frame is detected by AnnexBScanner.
+        return false;
+    }
+
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(frameBuffer);
+    int headerSize = m_codec == ALVR_CODEC_H264 ? 1 : 2;
+    for (const NALUnit &nal : nals) {
+        if (nal.length <= headerSize) {
+            continue;
+        }
+        const uint8_t *payload = data + nal.offset + headerSize;
+        int length = nal.length - headerSize;
+        if (m_codec == ALVR_CODEC_H264) {
+            if (nal.type == H264_NAL_TYPE_SPS) {
+                parseH264SPS(payload, length);
+            } else if (nal.type == H264_NAL_TYPE_PPS) {
+                parseH264PPS(payload, length);
+            } else if (nal.type == H264_NAL_TYPE_SEI) {
+                parseSEI(payload, length, info);
+            } else if (nal.type >= H264_NAL_TYPE_SLICE && nal.type <= H264_NAL_TYPE_IDR) {
+                int nalRefIdc = (data[nal.offset] >> 5) & 3;
+                info->valid = parseH264Slice(payload, length, nal.type, nalRefIdc, info);
+                break;
+            }
+        } else {
+            if (nal.type == H265_NAL_TYPE_SPS) {
+                parseH265SPS(payload, length);
+            } else if (nal.type == H265_NAL_TYPE_PPS) {
+                parseH265PPS(payload, length);
+            } else if (nal.type == H265_NAL_TYPE_PREFIX_SEI) {
+                parseSEI(payload, length, info);
+            } else if (nal.type <= H265_NAL_TYPE_VCL_MAX) {
+                info->valid = parseH265Slice(payload, length, nal.type, info);
+                break;
+            }
+        }
+    }
+    return info->valid;
+}
+
+//
+// H.264
+//
+
+static bool isH264HighProfile(uint32_t profileIdc) {
+    switch (profileIdc) {
+        case 100: case 110: case 122: case 244: case 44: case 83: case 86: case 118: case 128:
+        case 138: case 139: case 134: case 135:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void skipH264ScalingList(BitReader &reader, int size) {
+    int32_t lastScale = 8;
+    int32_t nextScale = 8;
+    for (int j = 0; j < size; j++) {
+        if (nextScale != 0) {
+            int32_t delta = reader.readSE();
+            nextScale = (lastScale + delta + 256) % 256;
+        }
+        lastScale = nextScale == 0 ? lastScale : nextScale;
+    }
+}
+
+void SliceHeaderParser::parseH264SPS(const uint8_t *payload, int length) {
+    BitReader reader(payload, length);
+    uint32_t profileIdc = reader.readBits(8);
+    reader.skipBits(16); // constraint flags, level_idc
+    uint32_t spsId = reader.readUE();
+    if (spsId >= MAX_SPS) {
+        return;
+    }
+    SPS sps;
+    if (isH264HighProfile(profileIdc)) {
+        uint32_t chromaFormatIdc = reader.readUE();
+        if (chromaFormatIdc == 3) {
+            sps.separateColourPlane = reader.readBit() != 0;
+        }
+        reader.readUE(); // bit_depth_luma_minus8
+        reader.readUE(); // bit_depth_chroma_minus8
+        reader.readBit(); // qpprime_y_zero_transform_bypass_flag
+        if (reader.readBit()) { // seq_scaling_matrix_present_flag
+            for (int i = 0; i < (chromaFormatIdc != 3 ? 8 : 12); i++) {
+                if (reader.readBit()) {
+                    skipH264ScalingList(reader, i < 6 ? 16 : 64);
+                }
+            }
+        }
+    }
+    sps.log2MaxFrameNum = reader.readUE() + 4;
+    sps.picOrderCntType = reader.readUE();
+    if (sps.picOrderCntType == 0) {
+        sps.log2MaxPicOrderCntLsb = reader.readUE() + 4;
+    } else if (sps.picOrderCntType == 1) {
+        reader.readBit(); // delta_pic_order_always_zero_flag
+        reader.readSE(); // offset_for_non_ref_pic
+        reader.readSE(); // offset_for_top_to_bottom_field
+        uint32_t cycle = reader.readUE();
+        for (uint32_t i = 0; i < cycle && !reader.hasError(); i++) {
+            reader.readSE();
+        }
+    }
+    reader.readUE(); // max_num_ref_frames
+    reader.readBit(); // gaps_in_frame_num_value_allowed_flag
+    reader.readUE(); // pic_width_in_mbs_minus1
+    reader.readUE(); // pic_height_in_map_units_minus1
+    sps.frameMbsOnly = reader.readBit() != 0;
+
+    if (reader.hasError() || sps.log2MaxFrameNum > 16 || sps.log2MaxPicOrderCntLsb > 16) {
+        LOGE("Failed to parse H.264 SPS. id=%u", spsId);
+        return;
+    }
+    sps.valid = true;
+    m_sps[spsId] = sps;
+}
+
+void SliceHeaderParser::parseH264PPS(const uint8_t *payload, int length) {
+    BitReader reader(payload, length);
+    uint32_t ppsId = reader.readUE();
+    uint32_t spsId = reader.readUE();
+    if (reader.hasError() || ppsId >= MAX_PPS || spsId >= MAX_SPS) {
+        return;
+    }
+    m_pps[ppsId].valid = true;
+    m_pps[ppsId].spsId = spsId;
+}
+
+bool SliceHeaderParser::parseH264Slice(const uint8_t *payload, int length, int nalType,
+                                       int nalRefIdc, FrameInfo *info) {
+    BitReader reader(payload, length);
+    reader.readUE(); // first_mb_in_slice
+    uint32_t sliceType = reader.readUE() % 5;
+    uint32_t ppsId = reader.readUE();
+    if (reader.hasError() || ppsId >= MAX_PPS || !m_pps[ppsId].valid ||
+        !m_sps[m_pps[ppsId].spsId].valid) {
+        return false;
+    }
+    const SPS &sps = m_sps[m_pps[ppsId].spsId];
+
+    switch (sliceType) {
+        case 0: case 3: // P, SP
+            info->sliceType = ALVR_SLICE_TYPE_P;
+            break;
+        case 1:
+            info->sliceType = ALVR_SLICE_TYPE_B;
+            break;
+        default: // I, SI
+            info->sliceType = ALVR_SLICE_TYPE_I;
+            break;
+    }
+    info->idr = nalType == H264_NAL_TYPE_IDR;
+    info->reference = nalRefIdc != 0;
+
+    if (sps.separateColourPlane) {
+        reader.skipBits(2); // colour_plane_id
+    }
+    info->frameNum = reader.readBits(sps.log2MaxFrameNum);
+    info->maxFrameNum = 1u << sps.log2MaxFrameNum;
+    if (!sps.frameMbsOnly && reader.readBit()) { // field_pic_flag
+        reader.readBit(); // bottom_field_flag
+    }
+    if (info->idr) {
+        reader.readUE(); // idr_pic_id
+    }
+    if (sps.picOrderCntType == 0) {
+        info->pictureOrderCount = reader.readBits(sps.log2MaxPicOrderCntLsb);
+    }
+    return !reader.hasError();
+}
+
+//
+// H.265
+//
+
+static void skipH265ProfileTierLevel(BitReader &reader, uint32_t maxSubLayersMinus1) {
+    // general_profile_space .. general_level_idc
+    reader.skipBits(96);
+    bool profilePresent[8];
+    bool levelPresent[8];
+    for (uint32_t i = 0; i < maxSubLayersMinus1; i++) {
+        profilePresent[i] = reader.readBit() != 0;
+        levelPresent[i] = reader.readBit() != 0;
+    }
+    if (maxSubLayersMinus1 > 0) {
+        for (uint32_t i = maxSubLayersMinus1; i < 8; i++) {
+            reader.skipBits(2); // reserved_zero_2bits
+        }
+    }
+    for (uint32_t i = 0; i < maxSubLayersMinus1; i++) {
+        if (profilePresent[i]) {
+            reader.skipBits(88);
+        }
+        if (levelPresent[i]) {
+            reader.skipBits(8);
+        }
+    }
+}
+
+void SliceHeaderParser::parseH265SPS(const uint8_t *payload, int length) {
+    BitReader reader(payload, length);
+    reader.skipBits(4); // sps_video_parameter_set_id
+    uint32_t maxSubLayersMinus1 = reader.readBits(3);
+    reader.readBit(); // sps_temporal_id_nesting_flag
+    skipH265ProfileTierLevel(reader, maxSubLayersMinus1);
+    uint32_t spsId = reader.readUE();
+    if (spsId >= MAX_SPS) {
+        return;
+    }
+    SPS sps;
+    if (reader.readUE() == 3) { // chroma_format_idc
+        sps.separateColourPlane = reader.readBit() != 0;
+    }
+    uint32_t width = reader.readUE();
+    uint32_t height = reader.readUE();
+    if (reader.readBit()) { // conformance_window_flag
+        for (int i = 0; i < 4; i++) {
+            reader.readUE();
+        }
+    }
+    reader.readUE(); // bit_depth_luma_minus8
+    reader.readUE(); // bit_depth_chroma_minus8
+    sps.log2MaxPicOrderCntLsb = reader.readUE() + 4;
+    bool subLayerOrderingInfoPresent = reader.readBit() != 0;
+    for (uint32_t i = subLayerOrderingInfoPresent ? 0 : maxSubLayersMinus1;
+         i <= maxSubLayersMinus1; i++) {
+        reader.readUE(); // sps_max_dec_pic_buffering_minus1
+        reader.readUE(); // sps_max_num_reorder_pics
+        reader.readUE(); // sps_max_latency_increase_plus1
+    }
+    uint32_t log2MinCbSize = reader.readUE() + 3;
+    uint32_t log2CtbSize = log2MinCbSize + reader.readUE();
+
+    if (reader.hasError() || sps.log2MaxPicOrderCntLsb > 16 || log2CtbSize > 6) {
+        LOGE("Failed to parse H.265 SPS. id=%u", spsId);
+        return;
+    }
+    uint32_t ctbSize = 1u << log2CtbSize;
+    sps.picSizeInCtbsY = ((width + ctbSize - 1) / ctbSize) * ((height + ctbSize - 1) / ctbSize);
+    sps.valid = true;
+    m_sps[spsId] = sps;
+}
+
+void SliceHeaderParser::parseH265PPS(const uint8_t *payload, int length) {
+    BitReader reader(payload, length);
+    uint32_t ppsId = reader.readUE();
+    PPS pps;
+    pps.spsId = reader.readUE();
+    pps.dependentSliceSegmentsEnabled = reader.readBit() != 0;
+    pps.outputFlagPresent = reader.readBit() != 0;
+    pps.numExtraSliceHeaderBits = reader.readBits(3);
+    if (reader.hasError() || ppsId >= MAX_PPS || pps.spsId >= MAX_SPS) {
+        return;
+    }
+    pps.valid = true;
+    m_pps[ppsId] = pps;
+}
+
+bool SliceHeaderParser::parseH265Slice(const uint8_t *payload, int length, int nalType,
+                                       FrameInfo *info) {
+    BitReader reader(payload, length);
+    bool firstSliceSegment = reader.readBit() != 0;
+    if (nalType >= H265_NAL_TYPE_BLA_W_LP && nalType <= H265_NAL_TYPE_RSV_IRAP_23) {
+        reader.readBit(); // no_output_of_prior_pics_flag
+    }
+    uint32_t ppsId = reader.readUE();
+    if (reader.hasError() || ppsId >= MAX_PPS || !m_pps[ppsId].valid ||
+        !m_sps[m_pps[ppsId].spsId].valid) {
+        return false;
+    }
+    const PPS &pps = m_pps[ppsId];
+    const SPS &sps = m_sps[pps.spsId];
+
+    info->idr = nalType == H265_NAL_TYPE_IDR_W_RADL || nalType == H265_NAL_TYPE_IDR_N_LP;
+    // Even types up to RSV_VCL_N14 are sub-layer non-reference pictures.
+    info->reference = nalType > H265_NAL_TYPE_RSV_VCL_N14 || (nalType & 1) != 0;
+
+    bool dependentSliceSegment = false;
+    if (!firstSliceSegment) {
+        if (pps.dependentSliceSegmentsEnabled) {
+            dependentSliceSegment = reader.readBit() != 0;
+        }
+        int addressBits = 0;
+        while ((1u << addressBits) < sps.picSizeInCtbsY) {
+            addressBits++;
+        }
+        reader.skipBits(addressBits); // slice_segment_address
+    }
+    if (dependentSliceSegment) {
+        // Remaining header is shared with preceding independent slice segment.
+        info->sliceType = m_lastSliceType;
+        return !reader.hasError() && m_lastSliceType != ALVR_SLICE_TYPE_UNKNOWN;
+    }
+    reader.skipBits(pps.numExtraSliceHeaderBits); // slice_reserved_flag
+    switch (reader.readUE()) {
+        case 0:
+            info->sliceType = ALVR_SLICE_TYPE_B;
+            break;
+        case 1:
+            info->sliceType = ALVR_SLICE_TYPE_P;
+            break;
+        default:
+            info->sliceType = ALVR_SLICE_TYPE_I;
+            break;
+    }
+    m_lastSliceType = info->sliceType;
+    if (pps.outputFlagPresent) {
+        reader.readBit(); // pic_output_flag
+    }
+    if (sps.separateColourPlane) {
+        reader.skipBits(2); // colour_plane_id
+    }
+    if (!info->idr) {
+        info->pictureOrderCount = reader.readBits(sps.log2MaxPicOrderCntLsb);
+    }
+    return !reader.hasError();
+}
+
+//
+// SEI
+//
+
+void SliceHeaderParser::parseSEI(const uint8_t *payload, int length, FrameInfo *info) {
+    BitReader reader(payload, length);
+    // Each sei_message has at least 2 bytes. Last byte is rbsp_trailing_bits.
+    while (reader.hasMoreData()) {
+        uint32_t payloadType = 0;
+        uint32_t byte;
+        while ((byte = reader.readBits(8)) == 0xFF) {
+            payloadType += 255;
+        }
+        payloadType += byte;
+        if (reader.hasError() || payloadType == 0x80) {
+            // rbsp_trailing_bits
+            return;
+        }
+        uint32_t payloadSize = 0;
+        while ((byte = reader.readBits(8)) == 0xFF) {
+            payloadSize += 255;
+        }
+        payloadSize += byte;
+        if (reader.hasError()) {
+            return;
+        }
+
+        if (payloadType == SEI_PAYLOAD_TYPE_RECOVERY_POINT) {
+            // Payload is small, so it is read into temporary buffer to keep byte alignment.
+            uint8_t buffer[16];
+            uint32_t size = payloadSize < sizeof(buffer) ? payloadSize : sizeof(buffer);
+            for (uint32_t i = 0; i < size; i++) {
+                buffer[i] = static_cast<uint8_t>(reader.readBits(8));
+            }
+            reader.skipBits(8 * (payloadSize - size));
+
+            BitReader recovery(buffer, static_cast<int>(size), false);
+            if (m_codec == ALVR_CODEC_H264) {
+                info->recoveryFrameCount = static_cast<int32_t>(recovery.readUE());
+            } else {
+                info->recoveryFrameCount = recovery.readSE(); // recovery_poc_cnt
+            }
+            info->recoveryPoint = !recovery.hasError();
+        } else {
+            reader.skipBits(8 * payloadSize);
+        }
+    }
+}
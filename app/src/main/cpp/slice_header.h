@@ -0,0 +1,81 @@
+#ifndef ALVRCLIENT_SLICE_HEADER_H
+#define ALVRCLIENT_SLICE_HEADER_H
+
+#include <stdint.h>
+#include <vector>
+#include "annexb.h"
+
+// Picture information parsed from slice header of the first slice in a frame (or a pushed slice).
+struct FrameInfo {
+    // false if no slice header could be parsed. e.g. parameter sets were not received yet.
+    bool valid;
+    // enum ALVR_SLICE_TYPE
+    uint8_t sliceType;
+    bool idr;
+    // Used as reference by later frames. nal_ref_idc != 0 on H.264, not a sub-layer
+    // non-reference picture on H.265.
+    bool reference;
+    // Frame is preceded by recovery point SEI. Output is correct after recoveryFrameCount frames.
+    bool recoveryPoint;
+    int32_t recoveryFrameCount;
+    // frame_num on H.264. 0 on H.265.
+    uint32_t frameNum;
+    // MaxFrameNum of active SPS on H.264. frame_num wraps at it. 0 on H.265.
+    uint32_t maxFrameNum;
+    // pic_order_cnt_lsb (slice_pic_order_cnt_lsb). 0 on IDR and H.264 POC type 1 and 2.
+    int32_t pictureOrderCount;
+};
+
+// Lightweight H.264/H.265 slice header parser. Only fields up to picture order count are read.
+// Parameter sets are kept by id, so they can come in a different frame from slices.
+class SliceHeaderParser {
+public:
+    void setCodec(int codec);
+    // Forget parameter sets.
+    void reset();
+
+    // Parse parameter sets, recovery point SEI and the first slice header in NAL units indexed by
+    // AnnexBScanner. Returns info.valid.
+    bool parse(const char *frameBuffer, const std::vector<NALUnit> &nals, FrameInfo *info);
+private:
+    struct SPS {
+        bool valid = false;
+        // H.264
+        uint32_t log2MaxFrameNum = 0;
+        uint32_t picOrderCntType = 0;
+        bool frameMbsOnly = true;
+        // Both
+        uint32_t log2MaxPicOrderCntLsb = 0;
+        bool separateColourPlane = false;
+        // H.265
+        uint32_t picSizeInCtbsY = 0;
+    };
+    struct PPS {
+        bool valid = false;
+        uint32_t spsId = 0;
+        // H.265
+        bool dependentSliceSegmentsEnabled = false;
+        bool outputFlagPresent = false;
+        uint32_t numExtraSliceHeaderBits = 0;
+    };
+
+    static const int MAX_SPS = 32;
+    static const int MAX_PPS = 256;
+
+    void parseH264SPS(const uint8_t *payload, int length);
+    void parseH264PPS(const uint8_t *payload, int length);
+    bool parseH264Slice(const uint8_t *payload, int length, int nalType, int nalRefIdc,
+                        FrameInfo *info);
+    void parseH265SPS(const uint8_t *payload, int length);
+    void parseH265PPS(const uint8_t *payload, int length);
+    bool parseH265Slice(const uint8_t *payload, int length, int nalType, FrameInfo *info);
+    void parseSEI(const uint8_t *payload, int length, FrameInfo *info);
+
+    int m_codec = 1;
+    SPS m_sps[MAX_SPS];
+    PPS m_pps[MAX_PPS];
+    // Slice type of last independent slice segment. Dependent slice segments inherit it.
+    uint8_t m_lastSliceType = 0;
+};
+
+#endif //ALVRCLIENT_SLICE_HEADER_H
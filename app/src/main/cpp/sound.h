@@ -5,6 +5,7 @@
 #include <SLES/OpenSLES_Android.h>
 
 #include "utils.h"
+#include "latency_collector.h"
 
 class SoundPlayer {
     static const int DST_BUF_SAMPLE = 512;
@@ -142,6 +143,8 @@ public:
         }
 
         audio_frame_count = 0;
+        // Shard of the callback thread, which must not allocate on its first record.
+        LatencyCollector::Instance().reserveShard();
 
         return 0;
     }
@@ -168,6 +171,7 @@ public:
 
     int putData(uint8_t *buf, int len) {
         audio_frame_count++;
+        LatencyCollector::Instance().audioFrame();
 
         if (discard_frame > 0) {
             discard_frame--;
@@ -179,6 +183,7 @@ public:
             if (dst_tail - dst_head >= BUF_COUNT) {
                 // full
                 LOGSOUND("SoundPlayer: Buffer is full.");
+                LatencyCollector::Instance().audioOverflow();
                 break;
             }
             uint8_t *dst_data = dst_data_list[dst_tail % BUF_COUNT];
@@ -219,6 +224,7 @@ public:
     void Stop(){
         LOGSOUNDI("Stopping.");
         dst_head = dst_tail = 0;
+        playing_data = false;
         (*bqPlayerPlay)->SetPlayState(bqPlayerPlay,
                                       SL_PLAYSTATE_STOPPED);
     }
@@ -249,6 +255,11 @@ private:
         //         start_threshold);
 
         if (dst_head == dst_tail) {
+            // Silence before the first data and while starving is not counted again.
+            if (playing_data) {
+                LatencyCollector::Instance().audioUnderrun();
+                playing_data = false;
+            }
             fillSilent();
             return;
         }
@@ -263,11 +274,14 @@ private:
             LOGSOUND("Error on Enqueue. Code=%d", res);
         }
         dst_head++;
+        playing_data = true;
         return;
     }
 
     int start_threshold = START_THRESHOLD;
     int discard_frame = 0;
+    // Received audio has been played since the start or last underrun.
+    bool playing_data = false;
 
     SLObjectItf engineObject = NULL;
     SLEngineItf engineEngine = NULL;
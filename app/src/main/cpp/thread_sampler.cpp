@@ -0,0 +1,182 @@
+/// Thread sampler
+// Per-thread CPU time, context switches and run queue delay from procfs.
+////////////////////////////////////////////////////////////////////
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include "thread_sampler.h"
+
+std::vector<std::string> ThreadSampler::getPipelineThreads() {
+    return {
+            // Java threads. UdpReceiverThread is truncated.
+            "UdpReceiverThre",
+            "TrackingThread",
+            "DecoderThread",
+            "OvrThread",
+            // Native threads.
+            "DecodeQueue",
+            "DecoderOutput",
+    };
+}
+
+ThreadSampler::ThreadSampler(const std::string &procRoot,
+                             const std::vector<std::string> &threadNames)
+        : m_procRoot(procRoot), m_threadNames(threadNames), m_rescan(true), m_allMatched(false),
+          m_lastScan(0) {
+    m_clockTicks = sysconf(_SC_CLK_TCK);
+    if (m_clockTicks <= 0) {
+        m_clockTicks = 100;
+    }
+}
+
+std::vector<ThreadSampler::ThreadStatistics> ThreadSampler::sample(uint64_t timestamp) {
+    std::vector<ThreadStatistics> threads;
+    std::map<int, Previous> current;
+
+    if (m_rescan || (!m_allMatched && timestamp - m_lastScan >= RESCAN_INTERVAL_US)) {
+        scan(timestamp);
+    }
+    for (int tid : m_tids) {
+        ThreadStatistics statistics = {};
+        statistics.tid = tid;
+        if (!readThread(statistics.tid, &statistics)) {
+            // Exited, or the id was reused by another thread.
+            m_rescan = true;
+            continue;
+        }
+
+        auto it = m_previous.find(statistics.tid);
+        // Thread id may have been reused by a new thread.
+        if (it != m_previous.end() && it->second.statistics.name == statistics.name &&
+            statistics.cpuTimeUs >= it->second.statistics.cpuTimeUs) {
+            const ThreadStatistics &previous = it->second.statistics;
+            statistics.cpuTimeInIntervalUs = statistics.cpuTimeUs - previous.cpuTimeUs;
+            statistics.runDelayInIntervalUs = statistics.runDelayUs - previous.runDelayUs;
+            statistics.voluntarySwitchesInInterval =
+                    statistics.voluntarySwitches - previous.voluntarySwitches;
+            statistics.involuntarySwitchesInInterval =
+                    statistics.involuntarySwitches - previous.involuntarySwitches;
+            statistics.intervalUs = timestamp - it->second.timestamp;
+        }
+        current[statistics.tid] = {statistics, timestamp};
+        threads.push_back(statistics);
+    }
+
+    // Exited threads are forgotten.
+    m_previous.swap(current);
+
+    std::sort(threads.begin(), threads.end(), [](const ThreadStatistics &a, const ThreadStatistics &b) {
+        return a.name != b.name ? a.name < b.name : a.tid < b.tid;
+    });
+    return threads;
+}
+
+void ThreadSampler::scan(uint64_t timestamp) {
+    m_tids.clear();
+    m_rescan = false;
+    m_lastScan = timestamp;
+
+    DIR *dir = opendir((m_procRoot + "/task").c_str());
+    if (dir == nullptr) {
+        m_allMatched = false;
+        return;
+    }
+    std::vector<std::string> matched;
+    while (dirent *entry = readdir(dir)) {
+        char *end;
+        long tid = strtol(entry->d_name, &end, 10);
+        if (entry->d_name[0] == '.' || *end != '\0') {
+            continue;
+        }
+        std::string name;
+        std::string stat;
+        if (readName(static_cast<int>(tid), &name, &stat)) {
+            m_tids.push_back(static_cast<int>(tid));
+            matched.push_back(name);
+        }
+    }
+    closedir(dir);
+
+    // With no names given, new threads can appear any time.
+    m_allMatched = !m_threadNames.empty();
+    for (const std::string &name : m_threadNames) {
+        if (std::find(matched.begin(), matched.end(), name) == matched.end()) {
+            m_allMatched = false;
+        }
+    }
+}
+
+// Name of the thread if it is one to sample. stat receives content of task/<tid>/stat.
+bool ThreadSampler::readName(int tid, std::string *name, std::string *stat) {
+    // pid (comm) state ppid ... utime(14) stime(15). comm can contain spaces and parentheses.
+    if (!readFile(m_procRoot + "/task/" + std::to_string(tid) + "/stat", stat)) {
+        return false;
+    }
+    size_t open = stat->find('(');
+    size_t close = stat->rfind(')');
+    if (open == std::string::npos || close == std::string::npos || close < open) {
+        return false;
+    }
+    *name = stat->substr(open + 1, close - open - 1);
+    return m_threadNames.empty() ||
+           std::find(m_threadNames.begin(), m_threadNames.end(), *name) != m_threadNames.end();
+}
+
+bool ThreadSampler::readThread(int tid, ThreadStatistics *statistics) {
+    std::string taskDir = m_procRoot + "/task/" + std::to_string(tid);
+    std::string content;
+
+    if (!readName(tid, &statistics->name, &content)) {
+        return false;
+    }
+    size_t close = content.rfind(')');
+    unsigned long long utime = 0;
+    unsigned long long stime = 0;
+    if (sscanf(content.c_str() + close + 1,
+               " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2) {
+        return false;
+    }
+    statistics->cpuTimeUs = (utime + stime) * 1000000 / m_clockTicks;
+
+    // More precise than stat. Missing when the kernel is built without schedstats.
+    unsigned long long runTime = 0;
+    unsigned long long waitTime = 0;
+    if (readFile(taskDir + "/schedstat", &content) &&
+        sscanf(content.c_str(), "%llu %llu", &runTime, &waitTime) == 2) {
+        statistics->cpuTimeUs = runTime / 1000;
+        statistics->runDelayUs = waitTime / 1000;
+    }
+
+    if (readFile(taskDir + "/status", &content)) {
+        const char *line = content.c_str();
+        while (line != nullptr && *line != '\0') {
+            unsigned long long value;
+            if (sscanf(line, "voluntary_ctxt_switches: %llu", &value) == 1) {
+                statistics->voluntarySwitches = value;
+            } else if (sscanf(line, "nonvoluntary_ctxt_switches: %llu", &value) == 1) {
+                statistics->involuntarySwitches = value;
+            }
+            line = strchr(line, '\n');
+            if (line != nullptr) {
+                line++;
+            }
+        }
+    }
+    return true;
+}
+
+bool ThreadSampler::readFile(const std::string &path, std::string *content) {
+    FILE *fp = fopen(path.c_str(), "re");
+    if (fp == nullptr) {
+        return false;
+    }
+    char buffer[4096];
+    size_t length = fread(buffer, 1, sizeof(buffer), fp);
+    fclose(fp);
+    content->assign(buffer, length);
+    return length > 0;
+}
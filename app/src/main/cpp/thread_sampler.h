@@ -0,0 +1,70 @@
+#ifndef ALVRCLIENT_THREAD_SAMPLER_H
+#define ALVRCLIENT_THREAD_SAMPLER_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// CPU time and scheduling of pipeline threads read from procfs, to tell latency spikes caused by
+// CPU starvation from the ones caused by the pipeline itself.
+//   task/<tid>/stat      Thread name, and CPU time if schedstat is not available.
+//   task/<tid>/schedstat Time on CPU and waiting on run queue in ns (CONFIG_SCHEDSTATS).
+//   task/<tid>/status    Voluntary and involuntary context switches.
+class ThreadSampler {
+public:
+    struct ThreadStatistics {
+        int tid;
+        std::string name;
+        // Since the thread started.
+        uint64_t cpuTimeUs;
+        uint64_t runDelayUs;
+        uint64_t voluntarySwitches;
+        uint64_t involuntarySwitches;
+        // Since previous sample. Zero on the first sample of the thread.
+        uint64_t cpuTimeInIntervalUs;
+        uint64_t runDelayInIntervalUs;
+        uint64_t voluntarySwitchesInInterval;
+        uint64_t involuntarySwitchesInInterval;
+        uint64_t intervalUs;
+    };
+
+    // Thread names as in task/<tid>/comm, which the kernel truncates to 15 characters.
+    static std::vector<std::string> getPipelineThreads();
+
+    // procRoot: Directory which contains task/ of this process.
+    // threadNames: Threads to sample. All threads if empty.
+    ThreadSampler(const std::string &procRoot = "/proc/self",
+                  const std::vector<std::string> &threadNames = getPipelineThreads());
+
+    // Threads which exited or cannot be read are skipped.
+    std::vector<ThreadStatistics> sample(uint64_t timestamp);
+private:
+    // Threads which are not found yet are looked for at this interval.
+    static const uint64_t RESCAN_INTERVAL_US = 10 * 1000 * 1000;
+
+    void scan(uint64_t timestamp);
+    bool readName(int tid, std::string *name, std::string *stat);
+    bool readThread(int tid, ThreadStatistics *statistics);
+    bool readFile(const std::string &path, std::string *content);
+
+    std::string m_procRoot;
+    std::vector<std::string> m_threadNames;
+    long m_clockTicks;
+
+    // Matched threads found by the last scan of task/. Listing task/ and reading stat of every
+    // thread of the process is much more costly than sampling the few matched ones, so task/ is
+    // scanned again only when one of them is gone or some names are not matched yet.
+    std::vector<int> m_tids;
+    bool m_rescan;
+    bool m_allMatched;
+    uint64_t m_lastScan;
+
+    struct Previous {
+        ThreadStatistics statistics;
+        uint64_t timestamp;
+    };
+    std::map<int, Previous> m_previous;
+};
+
+#endif //ALVRCLIENT_THREAD_SAMPLER_H
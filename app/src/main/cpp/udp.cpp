@@ -11,8 +11,12 @@
 #include <sys/ioctl.h>
 #include "utils.h"
 #include "latency_collector.h"
+#include "frame_trace.h"
 #include "udp.h"
+#include "android_utils.h"
+#include "media_codec_decoder_sink.h"
 #include "exception.h"
+#include "capture_replay.h"
 
 Socket::Socket() {
 }
@@ -116,6 +120,9 @@ void Socket::recv() {
             return;
         }
         LOGSOCKET("recvfrom Ok. calling parse(). ret=%d", packetSize);
+        if (m_packetRecorder) {
+            m_packetRecorder->writePacket(packet, packetSize);
+        }
         parse(packet, packetSize, addr);
     }
 }
@@ -126,13 +133,20 @@ void Socket::disconnect() {
 }
 
 jstring Socket::getServerAddress(JNIEnv *env) {
+    if (m_hasServerAddress) {
+        return env->NewStringUTF(getServerAddressString().c_str());
+    }
+    return NULL;
+}
+
+std::string Socket::getServerAddressString() {
     if (m_hasServerAddress) {
         char serverAddress[100];
         inet_ntop(m_serverAddr.sin_family, &m_serverAddr.sin_addr, serverAddress,
                   sizeof(serverAddress));
-        return env->NewStringUTF(serverAddress);
+        return serverAddress;
     }
-    return NULL;
+    return "";
 }
 
 int Socket::getServerPort() {
@@ -160,8 +174,8 @@ void Socket::parse(char *packet, int packetSize, const sockaddr_in &addr) {
             char str[1000];
             // Invalid source address. Ignore.
             inet_ntop(addr.sin_family, &addr.sin_addr, str, sizeof(str));
-            LOGE("Received packet from invalid source address. Address=%s:%d", str,
-                 htons(addr.sin_port));
+            LOGE_LIMITED(1, "Received packet from invalid source address. Address=%s:%d", str,
+                         htons(addr.sin_port));
             return;
         }
         m_onPacketRecv(packet, packetSize);
@@ -217,12 +231,15 @@ UdpManager::UdpManager() {
 }
 
 UdpManager::~UdpManager() {
+    m_metricsServer.reset();
     if (m_notifyPipe[0] >= 0) {
         close(m_notifyPipe[0]);
         close(m_notifyPipe[1]);
     }
 
+    stopCapture();
     m_nalParser.reset();
+    m_jniDecoderSink.reset();
     m_sendQueue.clear();
 }
 
@@ -238,13 +255,19 @@ void UdpManager::initialize(JNIEnv *env, jobject instance, jint helloPort, jint
     m_lastReceived = 0;
     m_prevSentSync = 0;
     m_prevSentBroadcast = 0;
+    m_prevSentFecFeedback = 0;
+    m_prevSentLatencyReport = 0;
+    m_prevSampledThreads = 0;
+    m_latencyReportSequence = 0;
     m_prevVideoSequence = 0;
     m_prevSoundSequence = 0;
     m_timeDiff = 0;
 
     initializeJNICallbacks(env, instance);
 
-    m_nalParser = std::make_shared<NALParser>(env, instance, this);
+    m_nalParser = std::make_shared<NALParser>(this);
+    m_jniDecoderSink = std::make_shared<JNIDecoderSink>(env, instance);
+    m_nalParser->setSink(m_jniDecoderSink);
 
     //
     // Fill hello message
@@ -272,6 +295,11 @@ void UdpManager::initialize(JNIEnv *env, jobject instance, jint helloPort, jint
     mHelloMessage.deviceSubType = static_cast<uint8_t>(deviceSubType);
     mHelloMessage.deviceCapabilityFlags = static_cast<uint32_t>(deviceCapabilityFlags);
     mHelloMessage.controllerCapabilityFlags = static_cast<uint32_t>(controllerCapabilityFlags);
+    mHelloMessage.streamCapabilityFlags = ALVR_STREAM_FLAG_INTERLEAVED_FEC |
+                                          ALVR_STREAM_FLAG_UNEQUAL_ERROR_PROTECTION |
+                                          ALVR_STREAM_FLAG_SLICED_FEC |
+                                          ALVR_STREAM_FLAG_SLICE_LOSS_REPORT |
+                                          ALVR_STREAM_FLAG_LATENCY_REPORT;
 
     //
     // Socket
@@ -302,6 +330,21 @@ void UdpManager::initialize(JNIEnv *env, jobject instance, jint helloPort, jint
         throw FormatException("pipe2 error : %d %s", errno, strerror(errno));
     }
 
+    //
+    // Metrics
+    //
+
+    if (gEnableMetrics && !m_metricsServer) {
+        try {
+            m_metricsServer.reset(new MetricsServer(MetricsServer::DEFAULT_PORT,
+                                                    [](MetricsWriter &writer) {
+                LatencyCollector::Instance().writeMetrics(writer);
+            }));
+        } catch (Exception &e) {
+            LOGE("Failed to start metrics server. e=%ls", e.what());
+        }
+    }
+
     LOGI("UdpManager initialized.");
 }
 
@@ -315,8 +358,8 @@ void UdpManager::processVideoSequence(uint32_t sequence) {
         }
         LatencyCollector::Instance().packetLoss(lost);
 
-        LOGE("VideoPacket loss %d (%d -> %d)", lost, m_prevVideoSequence + 1,
-             sequence - 1);
+        LOGE_LIMITED(10, "VideoPacket loss %d (%d -> %d)", lost, m_prevVideoSequence + 1,
+                     sequence - 1);
     }
     m_prevVideoSequence = sequence;
 }
@@ -331,8 +374,8 @@ void UdpManager::processSoundSequence(uint32_t sequence) {
         }
         LatencyCollector::Instance().packetLoss(lost);
 
-        LOGE("SoundPacket loss %d (%d -> %d)", lost, m_prevSoundSequence + 1,
-             sequence - 1);
+        LOGE_LIMITED(10, "SoundPacket loss %d (%d -> %d)", lost, m_prevSoundSequence + 1,
+                     sequence - 1);
     }
     m_prevSoundSequence = sequence;
 }
@@ -346,6 +389,8 @@ void UdpManager::processReadPipe(int pipefd) {
         return;
     }
 
+    applyPendingSink();
+
     SendBuffer sendBuffer;
     while (1) {
         {
@@ -400,6 +445,10 @@ void UdpManager::sendTimeSyncLocked() {
 
         timeSync.fps = LatencyCollector::Instance().getFramesInSecond();
 
+        timeSync.decodeQueueDropTotal = LatencyCollector::Instance().getDecodeQueueDropTotal();
+        timeSync.decodeQueueDropInSecond = LatencyCollector::Instance().getDecodeQueueDropInSecond();
+        timeSync.decodeQueueMaxFrames = LatencyCollector::Instance().getDecodeQueueMaxFrames();
+
         m_socket.send(&timeSync, sizeof(timeSync));
     }
     m_prevSentSync = current;
@@ -414,9 +463,66 @@ void UdpManager::sendBroadcastLocked() {
     m_prevSentBroadcast = current;
 }
 
+void UdpManager::sendFecFeedbackLocked() {
+    time_t current = time(nullptr);
+    if (m_prevSentFecFeedback != current && m_socket.isConnected()) {
+        FecFeedback feedback = {};
+        m_fecController.fillFeedback(&feedback);
+        if (feedback.frames > 0) {
+            m_socket.send(&feedback, sizeof(feedback));
+        }
+    }
+    m_prevSentFecFeedback = current;
+}
+
+void UdpManager::sampleThreadsLocked() {
+    time_t current = time(nullptr);
+    if (m_prevSampledThreads != current && m_socket.isConnected()) {
+        auto threads = m_threadSampler.sample(getTimestampUs());
+        for (const auto &thread : threads) {
+            // Runnable but not running for 10% of the interval.
+            if (thread.intervalUs > 0 && thread.runDelayInIntervalUs * 10 > thread.intervalUs) {
+                LOGI_LIMITED(1, "Thread is starved. name=%s tid=%d runDelay=%.1f cpu=%.1f ms "
+                                "involuntarySwitches=%llu", thread.name.c_str(), thread.tid,
+                             thread.runDelayInIntervalUs / 1000.0,
+                             thread.cpuTimeInIntervalUs / 1000.0,
+                             (unsigned long long) thread.involuntarySwitchesInInterval);
+            }
+        }
+        LatencyCollector::Instance().setThreadStatistics(threads);
+    }
+    m_prevSampledThreads = current;
+}
+
+void UdpManager::sendLatencyReportLocked() {
+    time_t current = time(nullptr);
+    if (m_prevSentLatencyReport != current && m_socket.isConnected() &&
+        (m_connectionMessage.streamFlags & ALVR_STREAM_FLAG_LATENCY_REPORT)) {
+        LatencyReport report = {};
+        report.type = ALVR_PACKET_TYPE_LATENCY_REPORT;
+        report.sequence = m_latencyReportSequence++;
+        report.stageCount = ALVR_LATENCY_STAGE_COUNT;
+        for (int stage = 0; stage < ALVR_LATENCY_STAGE_COUNT; stage++) {
+            for (int window = 0; window < ALVR_LATENCY_WINDOW_COUNT; window++) {
+                report.percentiles[stage][window] =
+                        LatencyCollector::Instance().getLatencyPercentiles(stage, window);
+            }
+        }
+        for (int window = 0; window < ALVR_LATENCY_WINDOW_COUNT; window++) {
+            report.droppedEvents[window] = LatencyCollector::Instance().getDroppedEvents(window);
+        }
+        m_socket.send(&report, sizeof(report));
+    }
+    m_prevSentLatencyReport = current;
+}
+
 void UdpManager::doPeriodicWork() {
+    LatencyCollector::Instance().aggregate();
     sendTimeSyncLocked();
     sendBroadcastLocked();
+    sendFecFeedbackLocked();
+    sendLatencyReportLocked();
+    sampleThreadsLocked();
     checkConnection();
 }
 
@@ -451,6 +557,11 @@ void UdpManager::runLoop(JNIEnv *env, jobject instance, jstring serverAddress, i
 
     m_env = env;
     m_instance = instance;
+    LatencyCollector::Instance().registerThread();
+
+    if (!m_replayCapturePath.empty()) {
+        replayCapture();
+    }
 
     if (serverAddress != NULL) {
         recoverConnection(GetStringFromJNIString(env, serverAddress), serverPort);
@@ -463,22 +574,24 @@ void UdpManager::runLoop(JNIEnv *env, jobject instance, jstring serverAddress, i
         memcpy(&fds, &fds_org, sizeof(fds));
         int ret = select(nfds, &fds, NULL, NULL, &timeout);
 
-        if (ret == 0) {
-            doPeriodicWork();
-
-            // timeout
-            continue;
-        }
+        m_watchdog.beginIteration();
+        uint64_t start = getTimestampUs();
 
-        if (FD_ISSET(m_notifyPipe[0], &fds)) {
-            //LOG("select pipe");
-            processReadPipe(m_notifyPipe[0]);
-        }
+        if (ret != 0) {
+            if (FD_ISSET(m_notifyPipe[0], &fds)) {
+                //LOG("select pipe");
+                processReadPipe(m_notifyPipe[0]);
+                start = m_watchdog.check(WATCHDOG_STAGE_SEND_QUEUE, start, m_lastFrameIndex);
+            }
 
-        if (FD_ISSET(m_socket.getSocket(), &fds)) {
-            m_socket.recv();
+            if (FD_ISSET(m_socket.getSocket(), &fds)) {
+                m_socket.recv();
+                start = m_watchdog.check(WATCHDOG_STAGE_RECEIVE, start, m_lastFrameIndex);
+            }
         }
         doPeriodicWork();
+        m_watchdog.check(WATCHDOG_STAGE_PERIODIC, start, m_lastFrameIndex);
+        m_watchdog.endIteration(m_lastFrameIndex);
     }
 
     LOGI("Exited select loop.");
@@ -530,15 +643,38 @@ int UdpManager::getServerPort() {
     return m_socket.getServerPort();
 }
 
-void UdpManager::sendVideoFrameAck(bool result, bool isIDR, uint64_t startFrame, uint64_t endFrame) {
-    VideoFrameAck packet;
+void UdpManager::sendVideoFrameAck(bool result, bool isIDR, uint64_t startFrame, uint64_t endFrame,
+                                   const FrameInfo *info) {
+    VideoFrameAck packet = {};
     packet.type = ALVR_PACKET_TYPE_VIDEO_FRAME_ACK;
     packet.ackType = result ? ALVR_FRAME_ACK_TYPE_ACK : ALVR_FRAME_ACK_TYPE_NACK;
     packet.frameType = isIDR ? ALVR_FRAME_ACK_VIDEO_FRAME_TYPE_IDR : ALVR_FRAME_ACK_VIDEO_FRAME_TYPE_P;
     packet.startFrame = startFrame;
     packet.endFrame = endFrame;
+    packet.isReference = 1;
+    if (info != nullptr && info->valid) {
+        packet.sliceType = info->sliceType;
+        packet.isReference = static_cast<uint8_t>(info->reference);
+        packet.recoveryPoint = static_cast<uint8_t>(info->recoveryPoint);
+        packet.recoveryFrameCount = info->recoveryFrameCount;
+        packet.frameNum = info->frameNum;
+        packet.pictureOrderCount = info->pictureOrderCount;
+    }
     int ret = m_socket.send(&packet, sizeof(packet));
-    LOGI("Sent frame ack. ret=%d result=%d isIDR=%d", ret, result, isIDR);
+    LOGI_LIMITED(1, "Sent frame ack. ret=%d result=%d isIDR=%d sliceType=%d ref=%d frameNum=%u poc=%d",
+                 ret, result, isIDR, packet.sliceType, packet.isReference, packet.frameNum,
+                 packet.pictureOrderCount);
+}
+
+void UdpManager::sendVideoSliceLoss(uint64_t videoFrameIndex, uint8_t sliceCount, uint64_t lostSlices) {
+    VideoSliceLoss packet;
+    packet.type = ALVR_PACKET_TYPE_VIDEO_SLICE_LOSS;
+    packet.videoFrameIndex = videoFrameIndex;
+    packet.sliceCount = sliceCount;
+    packet.lostSlices = lostSlices;
+    int ret = m_socket.send(&packet, sizeof(packet));
+    LOGI("Sent slice loss. ret=%d videoFrame=%llu sliceCount=%d lostSlices=%016llx", ret,
+         (unsigned long long) videoFrameIndex, sliceCount, (unsigned long long) lostSlices);
 }
 
 void UdpManager::onConnect(const ConnectionMessage &connectionMessage) {
@@ -550,7 +686,28 @@ void UdpManager::onConnect(const ConnectionMessage &connectionMessage) {
     m_prevSoundSequence = 0;
     m_timeDiff = 0;
     LatencyCollector::Instance().resetAll();
+    LatencyCollector::Instance().setRefreshRate(m_connectionMessage.refreshRate);
+    m_fecController.reset();
+    m_fecController.setUnequalErrorProtection(
+            (m_connectionMessage.streamFlags & ALVR_STREAM_FLAG_UNEQUAL_ERROR_PROTECTION) != 0);
     m_nalParser->setCodec(m_connectionMessage.codec);
+    if (!m_cacheDir.empty()) {
+        m_nalParser->setParameterSetCachePath(
+                m_cacheDir + "/parameter_sets_" + m_socket.getServerAddressString() + "_" +
+                std::to_string(m_connectionMessage.codec) + ".bin");
+    }
+    m_nalParser->configureDecodeQueue(m_connectionMessage.frameQueueSize,
+                                      m_connectionMessage.refreshRate);
+    m_nalParser->setSliceLossReport(
+            (m_connectionMessage.streamFlags & ALVR_STREAM_FLAG_SLICED_FEC) &&
+            (m_connectionMessage.streamFlags & ALVR_STREAM_FLAG_SLICE_LOSS_REPORT));
+    // Interleaved parity covers whole frames, so it can not be combined with sliced FEC.
+    m_nalParser->setInterleavedFecDepth(
+            (m_connectionMessage.streamFlags & ALVR_STREAM_FLAG_INTERLEAVED_FEC) &&
+            !(m_connectionMessage.streamFlags & ALVR_STREAM_FLAG_SLICED_FEC) ?
+            m_connectionMessage.interleavedFecDepth : 0);
+    startCapture();
+    FrameTrace::Instance().clear();
 
     m_env->CallVoidMethod(m_instance, mOnConnectMethodID, m_connectionMessage.videoWidth
             , m_connectionMessage.videoHeight, m_connectionMessage.codec
@@ -563,17 +720,142 @@ void UdpManager::onConnect(const ConnectionMessage &connectionMessage) {
     }
 }
 
+// Recording of previous connection is closed here, so that each capture has one connection.
+void UdpManager::startCapture() {
+    stopCapture();
+    if (m_cacheDir.empty() || m_replaying) {
+        return;
+    }
+    std::string suffix = m_socket.getServerAddressString() + "_" + std::to_string(time(nullptr)) +
+                         ".alcp";
+    try {
+        if (gEnablePacketCapture) {
+            auto recorder = std::make_shared<CaptureWriter>(m_cacheDir + "/capture_packets_" + suffix,
+                                                            CAPTURE_KIND_PACKETS);
+            recorder->writeConnection(m_connectionMessage);
+            m_socket.setPacketRecorder(recorder);
+        }
+        if (gEnableStreamCapture) {
+            auto recorder = std::make_shared<CaptureWriter>(m_cacheDir + "/capture_stream_" + suffix,
+                                                            CAPTURE_KIND_ELEMENTARY_STREAM);
+            recorder->writeConnection(m_connectionMessage);
+            m_nalParser->setStreamRecorder(recorder);
+        }
+    } catch (Exception &e) {
+        LOGE("Failed to start capture. e=%ls", e.what());
+    }
+}
+
+void UdpManager::exportTrace() {
+    if (!gEnableTrace || m_cacheDir.empty()) {
+        return;
+    }
+    try {
+        FrameTrace::Instance().exportChromeJson(
+                m_cacheDir + "/trace_" + std::to_string(time(nullptr)) + ".json");
+    } catch (Exception &e) {
+        LOGE("Failed to export trace. e=%ls", e.what());
+    }
+}
+
+void UdpManager::stopCapture() {
+    m_socket.setPacketRecorder(nullptr);
+    if (m_nalParser) {
+        m_nalParser->setStreamRecorder(nullptr);
+    }
+}
+
+// Feed packet capture as if it is received from server. Packets sent during replay go nowhere
+// because the socket is not connected.
+void UdpManager::replayCapture() {
+    LOGI("Replaying capture. path=%s realtime=%d", m_replayCapturePath.c_str(), m_replayRealtime);
+    try {
+        CaptureReplayer replayer(m_replayCapturePath);
+        const ConnectionMessage *connectionMessage = replayer.getReader().getConnectionMessage();
+        if (connectionMessage == nullptr) {
+            LOGE("Capture can not be replayed. It has no connection record.");
+            return;
+        }
+        m_replaying = true;
+        onConnect(*connectionMessage);
+        replayer.replay(m_replayRealtime, UINT64_MAX, [this](const CaptureRecord &record) {
+            if (record.type == CAPTURE_RECORD_PACKET && record.length >= sizeof(uint32_t)) {
+                onPacketRecv(record.data, record.length);
+            }
+            return !m_stopped;
+        });
+    } catch (Exception &e) {
+        LOGE("Failed to replay capture. e=%ls", e.what());
+    }
+    if (m_replaying) {
+        m_replaying = false;
+        m_env->CallVoidMethod(m_instance, mOnDisconnectedMethodID);
+        if (m_soundPlayer) {
+            m_soundPlayer->Stop();
+        }
+    }
+}
+
+void UdpManager::releaseNALBuffer(int bufferId) {
+    m_jniDecoderSink->releaseBuffer(bufferId);
+}
+
+void UdpManager::setDecoderSink(const std::shared_ptr<DecoderSink> &sink) {
+    if (m_stopped) {
+        return;
+    }
+    {
+        MutexLock lock(pipeMutex);
+        m_pendingSink = sink;
+        m_hasPendingSink = true;
+    }
+    // Notify to loop thread. Stream start packet requested after this is sent after the swap.
+    write(m_notifyPipe[1], "", 1);
+}
+
+void UdpManager::applyPendingSink() {
+    std::shared_ptr<DecoderSink> sink;
+    {
+        MutexLock lock(pipeMutex);
+        if (!m_hasPendingSink) {
+            return;
+        }
+        sink = std::move(m_pendingSink);
+        m_hasPendingSink = false;
+    }
+    LOGI("Decoder sink is changed. sink=%p", sink.get());
+    m_nalParser->setSink(sink);
+    // New decoder needs parameter sets and starts from IDR frame.
+    m_nalParser->reset();
+}
+
+void UdpManager::setCacheDir(const std::string &cacheDir) {
+    m_cacheDir = cacheDir;
+}
+
+void UdpManager::setReplayCapture(const std::string &path, bool realtime) {
+    m_replayCapturePath = path;
+    m_replayRealtime = realtime;
+}
+
 void UdpManager::onBroadcastRequest() {
     // Respond with hello message.
     m_socket.send(&mHelloMessage, sizeof(mHelloMessage));
 }
 
 void UdpManager::onPacketRecv(const char *packet, size_t packetSize) {
+    uint64_t start = getTimestampUs();
+    processPacket(packet, packetSize);
+    m_watchdog.check(WATCHDOG_STAGE_PACKET, start, m_lastFrameIndex, *(uint32_t *) packet);
+}
+
+void UdpManager::processPacket(const char *packet, size_t packetSize) {
     updateTimeout();
 
     uint32_t type = *(uint32_t *) packet;
     if (type == ALVR_PACKET_TYPE_VIDEO_FRAME) {
         VideoFrame *header = (VideoFrame *) packet;
+        TraceScope trace(TRACE_STAGE_PACKET, header->trackingFrameIndex, header->videoFrameIndex);
 
         if (m_lastFrameIndex != header->trackingFrameIndex) {
             LatencyCollector::Instance().receivedFirst(header->trackingFrameIndex);
@@ -593,6 +875,15 @@ void UdpManager::onPacketRecv(const char *packet, size_t packetSize) {
         if (ret2) {
             LatencyCollector::Instance().receivedLast(header->trackingFrameIndex);
         }
+    } else if (type == ALVR_PACKET_TYPE_VIDEO_INTERLEAVED_PARITY) {
+        if (packetSize < sizeof(VideoInterleavedParity)) {
+            return;
+        }
+        auto header = (VideoInterleavedParity *) packet;
+
+        processVideoSequence(header->packetCounter);
+
+        m_nalParser->processInterleavedParity(header, packetSize);
     } else if (type == ALVR_PACKET_TYPE_TIME_SYNC) {
         // Time sync packet
         if (packetSize < sizeof(TimeSync)) {
@@ -617,6 +908,7 @@ void UdpManager::onPacketRecv(const char *packet, size_t packetSize) {
         }
         ChangeSettings *settings = (ChangeSettings *) packet;
 
+        m_nalParser->configureDecodeQueue(settings->frameQueueSize, m_connectionMessage.refreshRate);
         m_env->CallVoidMethod(m_instance, mOnChangeSettingsMethodID, settings->debugFlags, settings->suspend, settings->frameQueueSize);
     } else if (type == ALVR_PACKET_TYPE_AUDIO_FRAME_START) {
         // Change settings
@@ -666,6 +958,8 @@ void UdpManager::checkConnection() {
             // Timeout
             LOGE("Connection timeout.");
             m_socket.disconnect();
+            stopCapture();
+            exportTrace();
 
             m_env->CallVoidMethod(m_instance, mOnDisconnectedMethodID);
 
@@ -790,3 +1084,29 @@ JNIEXPORT void JNICALL
 Java_com_polygraphene_alvr_UdpReceiverThread_setSinkPreparedNative(JNIEnv *env, jobject instance, jlong nativeHandle, jboolean prepared) {
     reinterpret_cast<UdpManager *>(nativeHandle)->setSinkPrepared(static_cast<bool>(prepared));
 }
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_polygraphene_alvr_UdpReceiverThread_releaseNALBufferNative(JNIEnv *env, jobject instance, jlong nativeHandle, jint bufferId) {
+    reinterpret_cast<UdpManager *>(nativeHandle)->releaseNALBuffer(bufferId);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_polygraphene_alvr_UdpReceiverThread_setDecoderSinkNative(JNIEnv *env, jobject instance, jlong nativeHandle, jlong decoderHandle) {
+    reinterpret_cast<UdpManager *>(nativeHandle)->setDecoderSink(
+            MediaCodecDecoderSink::fromHandle(decoderHandle));
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_polygraphene_alvr_UdpReceiverThread_setCacheDirNative(JNIEnv *env, jobject instance, jlong nativeHandle, jstring cacheDir) {
+    reinterpret_cast<UdpManager *>(nativeHandle)->setCacheDir(GetStringFromJNIString(env, cacheDir));
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_com_polygraphene_alvr_UdpReceiverThread_setReplayCaptureNative(JNIEnv *env, jobject instance, jlong nativeHandle, jstring path, jboolean realtime) {
+    reinterpret_cast<UdpManager *>(nativeHandle)->setReplayCapture(GetStringFromJNIString(env, path),
+                                                                   static_cast<bool>(realtime));
+}
@@ -12,7 +12,14 @@
 
 #include "packet_types.h"
 #include "nal.h"
+#include "jni_decoder_sink.h"
 #include "sound.h"
+#include "fec_controller.h"
+#include "video_feedback.h"
+#include "capture_file.h"
+#include "metrics_server.h"
+#include "thread_sampler.h"
+#include "network_watchdog.h"
 
 // Maximum UDP packet size
 static const int MAX_PACKET_SIZE = 2000;
@@ -46,6 +53,10 @@ public:
     void setOnPacketRecv(std::function<void(const char *buf, size_t len)> onPacketRecv) {
         m_onPacketRecv = onPacketRecv;
     }
+    // All received datagrams are recorded. nullptr stops recording.
+    void setPacketRecorder(const std::shared_ptr<CaptureWriter> &recorder) {
+        m_packetRecorder = recorder;
+    }
 
     //
     // Getter
@@ -55,6 +66,7 @@ public:
         return m_connected;
     }
     jstring getServerAddress(JNIEnv *env);
+    std::string getServerAddressString();
     int getServerPort();
     int getSocket();
 private:
@@ -69,13 +81,14 @@ private:
     std::function<void(const ConnectionMessage &connectionMessage)> m_onConnect;
     std::function<void()> m_onBroadcastRequest;
     std::function<void(const char *buf, size_t len)> m_onPacketRecv;
+    std::shared_ptr<CaptureWriter> m_packetRecorder;
 
     void parse(char *packet, int packetSize, const sockaddr_in &addr);
 
     void setBroadcastAddrList(JNIEnv *env, int helloPort, int port, jobjectArray broadcastAddrList_);
 };
 
-class UdpManager {
+class UdpManager : public VideoFeedback {
 public:
     UdpManager();
     ~UdpManager();
@@ -88,6 +101,22 @@ public:
         return *m_nalParser;
     }
 
+    FECController &getFecController() override {
+        return m_fecController;
+    }
+
+    // Called from decoder thread when NAL has been fed to decoder.
+    void releaseNALBuffer(int bufferId);
+    // Feed frames to the sink instead of Java decoder, e.g. MediaCodecDecoderSink. The sink is
+    // swapped on the loop thread. nullptr drops frames until next sink is set.
+    void setDecoderSink(const std::shared_ptr<DecoderSink> &sink);
+    // Parameter sets are saved per server in the directory.
+    void setCacheDir(const std::string &cacheDir);
+    // Packet capture is fed through onPacketRecv at the start of runLoop, before the socket is
+    // used. realtime: Keep recorded packet intervals. Otherwise packets are fed as fast as
+    // possible.
+    void setReplayCapture(const std::string &path, bool realtime);
+
     void send(const void *packet, int length);
 
     void runLoop(JNIEnv *env, jobject instance, jstring serverAddress, int serverPort);
@@ -99,7 +128,11 @@ public:
     jstring getServerAddress(JNIEnv *env);
     int getServerPort();
 
-    void sendVideoFrameAck(bool result, bool isIDR, uint64_t startFrame, uint64_t endFrame);
+    // info: Slice header of endFrame on ACK.
+    void sendVideoFrameAck(bool result, bool isIDR, uint64_t startFrame, uint64_t endFrame,
+                           const FrameInfo *info = nullptr) override;
+    void sendVideoSliceLoss(uint64_t videoFrameIndex, uint8_t sliceCount,
+                            uint64_t lostSlices) override;
 private:
 // Connection has lost when elapsed 3 seconds from last packet.
     static const uint64_t CONNECTION_TIMEOUT = 3 * 1000 * 1000;
@@ -112,6 +145,10 @@ private:
     Socket m_socket;
     time_t m_prevSentSync = 0;
     time_t m_prevSentBroadcast = 0;
+    time_t m_prevSentFecFeedback = 0;
+    time_t m_prevSentLatencyReport = 0;
+    time_t m_prevSampledThreads = 0;
+    uint64_t m_latencyReportSequence = 0;
     int64_t m_timeDiff = 0;
     uint64_t timeSyncSequence = (uint64_t) -1;
     uint64_t m_lastReceived = 0;
@@ -122,6 +159,16 @@ private:
     uint32_t m_prevSoundSequence = 0;
     std::shared_ptr<SoundPlayer> m_soundPlayer;
     std::shared_ptr<NALParser> m_nalParser;
+    std::shared_ptr<JNIDecoderSink> m_jniDecoderSink;
+    std::string m_cacheDir;
+    std::unique_ptr<MetricsServer> m_metricsServer;
+    ThreadSampler m_threadSampler;
+    NetworkWatchdog m_watchdog;
+    FECController m_fecController;
+
+    std::string m_replayCapturePath;
+    bool m_replayRealtime = true;
+    bool m_replaying = false;
 
     HelloMessage mHelloMessage;
 
@@ -143,6 +190,9 @@ private:
     int m_notifyPipe[2] = {-1, -1};
     Mutex pipeMutex;
     std::list<SendBuffer> m_sendQueue;
+    // Set by setDecoderSink and applied on the loop thread. Guarded by pipeMutex.
+    std::shared_ptr<DecoderSink> m_pendingSink;
+    bool m_hasPendingSink = false;
 
     void initializeJNICallbacks(JNIEnv *env, jobject instance);
 
@@ -152,9 +202,13 @@ private:
     void processSoundSequence(uint32_t sequence);
 
     void processReadPipe(int pipefd);
+    void applyPendingSink();
 
     void sendTimeSyncLocked();
     void sendBroadcastLocked();
+    void sendFecFeedbackLocked();
+    void sendLatencyReportLocked();
+    void sampleThreadsLocked();
     void doPeriodicWork();
 
     void recoverConnection(std::string serverAddress, int serverPort);
@@ -163,8 +217,14 @@ private:
     void updateTimeout();
 
     void onConnect(const ConnectionMessage &connectionMessage);
+    void startCapture();
+    void stopCapture();
+    // Write frame trace of the connection to the cache directory.
+    void exportTrace();
+    void replayCapture();
     void onBroadcastRequest();
     void onPacketRecv(const char *packet, size_t packetSize);
+    void processPacket(const char *packet, size_t packetSize);
 
     void loadRefreshRates(JNIEnv *refreshRates, jintArray pArray);
     void loadFov(JNIEnv *env, jfloatArray fov_);
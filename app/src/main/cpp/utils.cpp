@@ -1,10 +1,17 @@
 #include "utils.h"
+#ifdef __ANDROID__
 #include <jni.h>
+#endif
 
 int gGeneralLogLevel = ANDROID_LOG_INFO;
 int gSoundLogLevel = ANDROID_LOG_INFO;
 int gSocketLogLevel = ANDROID_LOG_INFO;
 bool gDisableExtraLatencyMode = false;
+bool gEnableErrorConcealment = false;
+bool gEnablePacketCapture = false;
+bool gEnableStreamCapture = false;
+bool gEnableTrace = false;
+bool gEnableMetrics = false;
 
 enum DEBUG_FLAGS {
     DEBUG_FLAGS_ENABLE_FRAME_LOG = 1 << 0,
@@ -12,11 +19,26 @@ enum DEBUG_FLAGS {
     DEBUG_FLAGS_ENABLE_SOUND_LOG = 1 << 2,
     DEBUG_FLAGS_ENABLE_SOCKET_LOG = 1 << 3,
     DEBUG_FLAGS_DISABLE_EXTRA_LATENCY_MODE = 1 << 4,
+    DEBUG_FLAGS_ENABLE_ERROR_CONCEALMENT = 1 << 5,
+    DEBUG_FLAGS_ENABLE_PACKET_CAPTURE = 1 << 6,
+    DEBUG_FLAGS_ENABLE_STREAM_CAPTURE = 1 << 7,
+    DEBUG_FLAGS_ENABLE_TRACE = 1 << 8,
+    DEBUG_FLAGS_ENABLE_METRICS = 1 << 9,
+    // Checked by Java NativeDecoder.
+    DEBUG_FLAGS_ENABLE_NATIVE_DECODER = 1 << 10,
 };
 
 
 bool gEnableFrameLog = false;
 
+#ifdef __ANDROID__
+extern "C"
+JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM *vm, void *reserved) {
+    AsyncLogger::Instance().start();
+    return JNI_VERSION_1_6;
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_polygraphene_alvr_Utils_setFrameLogEnabled(JNIEnv *env, jclass type, jlong debugFlags) {
@@ -29,4 +51,10 @@ Java_com_polygraphene_alvr_Utils_setFrameLogEnabled(JNIEnv *env, jclass type, jl
     gSocketLogLevel = (debugFlags & DEBUG_FLAGS_ENABLE_SOCKET_LOG) ?
                        ANDROID_LOG_VERBOSE : ANDROID_LOG_INFO ;
     gDisableExtraLatencyMode = (debugFlags & DEBUG_FLAGS_DISABLE_EXTRA_LATENCY_MODE) != 0;
-}
\ No newline at end of file
+    gEnableErrorConcealment = (debugFlags & DEBUG_FLAGS_ENABLE_ERROR_CONCEALMENT) != 0;
+    gEnablePacketCapture = (debugFlags & DEBUG_FLAGS_ENABLE_PACKET_CAPTURE) != 0;
+    gEnableStreamCapture = (debugFlags & DEBUG_FLAGS_ENABLE_STREAM_CAPTURE) != 0;
+    gEnableTrace = (debugFlags & DEBUG_FLAGS_ENABLE_TRACE) != 0;
+    gEnableMetrics = (debugFlags & DEBUG_FLAGS_ENABLE_METRICS) != 0;
+}
+#endif
@@ -2,13 +2,15 @@
 #define ALVRCLIENT_UTILS_H
 
 #include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <time.h>
+#include <sys/time.h>
 #include <pthread.h>
-#include <android/log.h>
 #include <string>
-#include <VrApi_Types.h>
-#include <GLES3/gl3.h>
+#include "async_log.h"
 
 //
 // Logging
@@ -19,18 +21,32 @@ extern int gGeneralLogLevel;
 extern int gSoundLogLevel;
 extern int gSocketLogLevel;
 extern bool gDisableExtraLatencyMode;
-
-#define LOG(...) if(gGeneralLogLevel <= ANDROID_LOG_VERBOSE){__android_log_print(ANDROID_LOG_VERBOSE, "ALVR Native", __VA_ARGS__);}
-#define LOGI(...) if(gGeneralLogLevel <= ANDROID_LOG_INFO){__android_log_print(ANDROID_LOG_INFO, "ALVR Native", __VA_ARGS__);}
-#define LOGE(...) if(gGeneralLogLevel <= ANDROID_LOG_ERROR){__android_log_print(ANDROID_LOG_ERROR, "ALVR Native", __VA_ARGS__);}
-
-#define LOGSOUND(...) if(gSoundLogLevel <= ANDROID_LOG_VERBOSE){__android_log_print(ANDROID_LOG_VERBOSE, "ALVR Sound", __VA_ARGS__);}
-#define LOGSOUNDI(...) if(gSoundLogLevel <= ANDROID_LOG_INFO){__android_log_print(ANDROID_LOG_INFO, "ALVR Sound", __VA_ARGS__);}
-#define LOGSOUNDE(...) if(gSoundLogLevel <= ANDROID_LOG_ERROR){__android_log_print(ANDROID_LOG_ERROR, "ALVR Sound", __VA_ARGS__);}
-
-#define LOGSOCKET(...) if(gSocketLogLevel <= ANDROID_LOG_VERBOSE){__android_log_print(ANDROID_LOG_VERBOSE, "ALVR Socket", __VA_ARGS__);}
-#define LOGSOCKETI(...) if(gSocketLogLevel <= ANDROID_LOG_INFO){__android_log_print(ANDROID_LOG_INFO, "ALVR Socket", __VA_ARGS__);}
-#define LOGSOCKETE(...) if(gSocketLogLevel <= ANDROID_LOG_ERROR){__android_log_print(ANDROID_LOG_ERROR, "ALVR Socket", __VA_ARGS__);}
+extern bool gEnableErrorConcealment;
+// Record received datagrams / elementary stream of each connection to the cache directory.
+extern bool gEnablePacketCapture;
+extern bool gEnableStreamCapture;
+// Record pipeline stages into FrameTrace and export it to the cache directory on disconnect.
+extern bool gEnableTrace;
+// Serve statistics on loopback by MetricsServer.
+extern bool gEnableMetrics;
+
+// Written to logcat by AsyncLogger. Levels below ALVR_LOG_MIN_LEVEL are compiled out.
+#define LOG(...) ALVR_LOG(ANDROID_LOG_VERBOSE, "ALVR Native", gGeneralLogLevel, __VA_ARGS__)
+#define LOGI(...) ALVR_LOG(ANDROID_LOG_INFO, "ALVR Native", gGeneralLogLevel, __VA_ARGS__)
+#define LOGE(...) ALVR_LOG(ANDROID_LOG_ERROR, "ALVR Native", gGeneralLogLevel, __VA_ARGS__)
+
+#define LOGSOUND(...) ALVR_LOG(ANDROID_LOG_VERBOSE, "ALVR Sound", gSoundLogLevel, __VA_ARGS__)
+#define LOGSOUNDI(...) ALVR_LOG(ANDROID_LOG_INFO, "ALVR Sound", gSoundLogLevel, __VA_ARGS__)
+#define LOGSOUNDE(...) ALVR_LOG(ANDROID_LOG_ERROR, "ALVR Sound", gSoundLogLevel, __VA_ARGS__)
+
+#define LOGSOCKET(...) ALVR_LOG(ANDROID_LOG_VERBOSE, "ALVR Socket", gSocketLogLevel, __VA_ARGS__)
+#define LOGSOCKETI(...) ALVR_LOG(ANDROID_LOG_INFO, "ALVR Socket", gSocketLogLevel, __VA_ARGS__)
+#define LOGSOCKETE(...) ALVR_LOG(ANDROID_LOG_ERROR, "ALVR Socket", gSocketLogLevel, __VA_ARGS__)
+
+// For lines which can be logged on every packet or frame. At most perSecond lines per second
+// from each call site are written, and the number of suppressed lines is logged.
+#define LOGI_LIMITED(perSecond, ...) ALVR_LOG_LIMITED(ANDROID_LOG_INFO, "ALVR Native", gGeneralLogLevel, perSecond, __VA_ARGS__)
+#define LOGE_LIMITED(perSecond, ...) ALVR_LOG_LIMITED(ANDROID_LOG_ERROR, "ALVR Native", gGeneralLogLevel, perSecond, __VA_ARGS__)
 
 static const int64_t USECS_IN_SEC = 1000 * 1000;
 
@@ -43,56 +59,15 @@ inline void FrameLog(uint64_t frameIndex, const char *format, ...)
         return;
     }
 
+    int length = snprintf(buf, sizeof(buf), "[Frame %lu] ", frameIndex);
     va_list args;
     va_start(args, format);
-    vsnprintf(buf, sizeof(buf), format, args);
+    vsnprintf(buf + length, sizeof(buf) - length, format, args);
     va_end(args);
 
-    __android_log_print(ANDROID_LOG_VERBOSE, "FrameTracking", "[Frame %lu] %s", frameIndex, buf);
-}
-
-//
-// GL Logging
-//
-
-#define CHECK_GL_ERRORS 1
-#ifdef CHECK_GL_ERRORS
-
-static const char *GlErrorString(GLenum error) {
-    switch (error) {
-        case GL_NO_ERROR:
-            return "GL_NO_ERROR";
-        case GL_INVALID_ENUM:
-            return "GL_INVALID_ENUM";
-        case GL_INVALID_VALUE:
-            return "GL_INVALID_VALUE";
-        case GL_INVALID_OPERATION:
-            return "GL_INVALID_OPERATION";
-        case GL_INVALID_FRAMEBUFFER_OPERATION:
-            return "GL_INVALID_FRAMEBUFFER_OPERATION";
-        case GL_OUT_OF_MEMORY:
-            return "GL_OUT_OF_MEMORY";
-        default:
-            return "unknown";
-    }
-}
-
-static void GLCheckErrors(const char* file, int line) {
-    for (int i = 0; i < 10; i++) {
-        const GLenum error = glGetError();
-        if (error == GL_NO_ERROR) {
-            break;
-        }
-        LOGE("GL error on %s : %d: %s", file, line, GlErrorString(error));
-        abort();
-    }
+    AsyncLogger::writeLine(ANDROID_LOG_VERBOSE, "FrameTracking", buf);
 }
 
-#define GL(func)        func; GLCheckErrors(__FILE__, __LINE__ );
-#else // CHECK_GL_ERRORS
-#define GL(func)        func;
-#endif // CHECK_GL_ERRORS
-
 //
 // Utility
 //
@@ -126,6 +101,11 @@ public:
     void CondWait(pthread_cond_t *cond){
         pthread_cond_wait(cond, &mutex);
     }
+
+    // Returns false on timeout. abstime is CLOCK_REALTIME.
+    bool CondTimedWait(pthread_cond_t *cond, const timespec *abstime){
+        return pthread_cond_timedwait(cond, &mutex, abstime) == 0;
+    }
 };
 
 class MutexLock {
@@ -144,49 +124,10 @@ public:
 // Utility
 //
 
-/// Integer version of ovrRectf
-typedef struct Recti_
-{
-    int x;
-    int y;
-    int width;
-    int height;
-} Recti;
-
-inline std::string GetStringFromJNIString(JNIEnv *env, jstring string){
-    const char *buf = env->GetStringUTFChars(string, 0);
-    std::string ret = buf;
-    env->ReleaseStringUTFChars(string, buf);
-
-    return ret;
-}
-
 inline double GetTimeInSeconds() {
     struct timespec now;
     clock_gettime(CLOCK_MONOTONIC, &now);
     return (now.tv_sec * 1e9 + now.tv_nsec) * 0.000000001;
 }
 
-inline std::string DumpMatrix(const ovrMatrix4f *matrix) {
-    char buf[1000];
-    sprintf(buf, "%.5f, %.5f, %.5f, %.5f\n"
-                    "%.5f, %.5f, %.5f, %.5f\n"
-                    "%.5f, %.5f, %.5f, %.5f\n"
-                    "%.5f, %.5f, %.5f, %.5f\n", matrix->M[0][0], matrix->M[0][1], matrix->M[0][2],
-            matrix->M[0][3], matrix->M[1][0], matrix->M[1][1], matrix->M[1][2], matrix->M[1][3],
-            matrix->M[2][0], matrix->M[2][1], matrix->M[2][2], matrix->M[2][3], matrix->M[3][0],
-            matrix->M[3][1], matrix->M[3][2], matrix->M[3][3]
-    );
-    return std::string(buf);
-}
-
-inline ovrQuatf quatMultipy(const ovrQuatf *a, const ovrQuatf *b){
-    ovrQuatf dest;
-    dest.x = a->x * b->w + a->w * b->x + a->y * b->z - a->z * b->y;
-    dest.y = a->y * b->w + a->w * b->y + a->z * b->x - a->x * b->z;
-    dest.z = a->z * b->w + a->w * b->z + a->x * b->y - a->y * b->x;
-    dest.w = a->w * b->w - a->x * b->x - a->y * b->y - a->z * b->z;
-    return dest;
-}
-
 #endif //ALVRCLIENT_UTILS_H
@@ -0,0 +1,23 @@
+#ifndef ALVRCLIENT_VIDEO_FEEDBACK_H
+#define ALVRCLIENT_VIDEO_FEEDBACK_H
+
+#include <stdint.h>
+#include "fec_controller.h"
+#include "slice_header.h"
+
+// Outcome of received video frames reported by FECQueue, InterleavedFECQueue and NALParser.
+// UdpManager sends them to server. Host tools which run the video pipeline without a connection
+// give their own implementation.
+class VideoFeedback {
+public:
+    virtual ~VideoFeedback() {}
+
+    // info: Slice header of endFrame on ACK.
+    virtual void sendVideoFrameAck(bool result, bool isIDR, uint64_t startFrame, uint64_t endFrame,
+                                   const FrameInfo *info = nullptr) = 0;
+    virtual void sendVideoSliceLoss(uint64_t videoFrameIndex, uint8_t sliceCount,
+                                    uint64_t lostSlices) = 0;
+    virtual FECController &getFecController() = 0;
+};
+
+#endif //ALVRCLIENT_VIDEO_FEEDBACK_H
@@ -4,6 +4,7 @@ import android.content.Context;
 import android.graphics.SurfaceTexture;
 import android.media.MediaCodec;
 import android.media.MediaFormat;
+import android.os.Build;
 import android.os.Handler;
 import android.os.Looper;
 import android.os.Message;
@@ -22,10 +23,12 @@ public class DecoderThread extends ThreadBase implements UdpReceiverThread.NALCa
 
     private static final int CODEC_H264 = 0;
     private static final int CODEC_H265 = 1;
+    private static final int CODEC_AV1 = 2;
     private int mCodec = CODEC_H265;
 
     private static final String VIDEO_FORMAT_H264 = "video/avc";
     private static final String VIDEO_FORMAT_H265 = "video/hevc";
+    private static final String VIDEO_FORMAT_AV1 = "video/av01";
     private String mFormat = VIDEO_FORMAT_H265;
 
     private MediaCodec mDecoder = null;
@@ -33,6 +36,10 @@ public class DecoderThread extends ThreadBase implements UdpReceiverThread.NALCa
 
     private boolean mWaitNextIDR = false;
 
+    // Frame which is being fed slice by slice. -1 if none.
+    private long mPartialFrameIndex = -1;
+    private long mPartialPresentationTime = 0;
+
     @SuppressWarnings("unused")
     private Context mContext = null;
 
@@ -57,17 +64,6 @@ public class DecoderThread extends ThreadBase implements UdpReceiverThread.NALCa
 
     private final DecoderCallback mDecoderCallback;
 
-    private static final int NAL_TYPE_SPS = 7;
-    private static final int NAL_TYPE_PPS = 8;
-    private static final int NAL_TYPE_IDR = 5;
-    private static final int NAL_TYPE_P = 1;
-
-    private static final int H265_NAL_TYPE_TRAIL_R = 1;
-    private static final int H265_NAL_TYPE_IDR_W_RADL = 19;
-    private static final int H265_NAL_TYPE_VPS = 32;
-    private static final int H265_NAL_TYPE_SPS = 33;
-    private static final int H265_NAL_TYPE_PPS = 34;
-
     // Dummy SPS/PPS for some decoders which crashes on not set csd-0/csd-1. (e.g. Galaxy S6 Exynos decoder)
     private byte[] DummySPS = new byte[]{(byte) 0x00, (byte) 0x00, (byte) 0x00, (byte) 0x01, (byte) 0x67, (byte) 0x64, (byte) 0x00, (byte) 0x20, (byte) 0xac, (byte) 0x2b, (byte) 0x40, (byte) 0x20,
             0x02, (byte) 0x0d, (byte) 0x80, (byte) 0x88, (byte) 0x00, (byte) 0x00, (byte) 0x1f, (byte) 0x40, (byte) 0x00, (byte) 0x0e, (byte) 0xa6, (byte) 0x04,
@@ -116,7 +112,9 @@ public class DecoderThread extends ThreadBase implements UdpReceiverThread.NALCa
                 Utils.log(TAG, () -> "MESSAGE_PUSH_NAL");
                 NAL nal = (NAL) msg.obj;
 
-                detectNALType(nal);
+                if (nal.length > 0) {
+                    Utils.frameLog(nal.frameIndex, () -> "Got NAL Type=" + nal.type + " Length=" + nal.length + " QueueSize=" + mNalQueue.size());
+                }
                 mNalQueue.add(nal);
                 pushNALInternal();
                 return true;
@@ -168,6 +166,7 @@ public class DecoderThread extends ThreadBase implements UdpReceiverThread.NALCa
 
         Looper.prepare();
         mHandler = new Handler(this);
+        LatencyCollector.RegisterThread();
 
         MediaFormat format = MediaFormat.createVideoFormat(mFormat, DummyWidth, DummyHeight);
         format.setString("KEY_MIME", mFormat);
@@ -175,6 +174,8 @@ public class DecoderThread extends ThreadBase implements UdpReceiverThread.NALCa
         if (mCodec == CODEC_H264) {
             format.setByteBuffer("csd-0", ByteBuffer.wrap(DummySPS, 0, DummySPS.length));
             format.setByteBuffer("csd-1", ByteBuffer.wrap(DummyPPS, 0, DummyPPS.length));
+        } else if (mCodec == CODEC_AV1) {
+            // Sequence header comes in frame data.
         } else {
             format.setByteBuffer("csd-0", ByteBuffer.wrap(DummyCSD_H265, 0, DummyCSD_H265.length));
         }
@@ -205,9 +206,9 @@ public class DecoderThread extends ThreadBase implements UdpReceiverThread.NALCa
             try {
                 String path = mContext.getExternalMediaDirs()[0].getAbsolutePath() + "/" + buf.frameIndex + ".h264";
                 FileOutputStream stream = new FileOutputStream(path);
-                stream.write(spsBuffer.buf, 0, spsBuffer.length);
-                stream.write(ppsBuffer.buf, 0, ppsBuffer.length);
-                stream.write(buf.buf, 0, buf.length);
+                stream.getChannel().write(spsBuffer.slice());
+                stream.getChannel().write(ppsBuffer.slice());
+                stream.getChannel().write(buf.slice());
                 stream.close();
             } catch (IOException e) {
                 e.printStackTrace();
@@ -216,10 +217,21 @@ public class DecoderThread extends ThreadBase implements UdpReceiverThread.NALCa
     }
 
     private boolean pushInputBuffer(NAL nal, long presentationTimeUs, int flags) {
-        if (presentationTimeUs != 0) {
+        if (presentationTimeUs != 0 && mPartialFrameIndex != nal.frameIndex) {
             mQueue.pushInputBuffer(presentationTimeUs, nal.frameIndex);
         }
+        if (nal.partial && Build.VERSION.SDK_INT >= Build.VERSION_CODES.O) {
+            flags |= MediaCodec.BUFFER_FLAG_PARTIAL_FRAME;
+        }
 
+        if (nal.length == 0) {
+            // Terminate partial frame.
+            Integer bufferIndex = mAvailableInputs.poll();
+            if (bufferIndex == null) {
+                return false;
+            }
+            mDecoder.queueInputBuffer(bufferIndex, 0, 0, presentationTimeUs, flags);
+        }
         while (nal.length > 0) {
             Integer bufferIndex = mAvailableInputs.poll();
             if (bufferIndex == null) {
@@ -229,9 +241,12 @@ public class DecoderThread extends ThreadBase implements UdpReceiverThread.NALCa
             ByteBuffer buffer = mDecoder.getInputBuffer(bufferIndex);
 
             int copyLength = Math.min(nal.length, buffer.remaining());
-            buffer.put(nal.buf, 0, copyLength);
+            ByteBuffer data = nal.slice();
+            data.limit(nal.offset + copyLength);
+            buffer.put(data);
 
             mDecoder.queueInputBuffer(bufferIndex, 0, buffer.position(), presentationTimeUs, flags);
+            nal.offset += copyLength;
             nal.length -= copyLength;
 
             if (nal.length > 0) {
@@ -292,6 +307,8 @@ public class DecoderThread extends ThreadBase implements UdpReceiverThread.NALCa
             mCodec = codec;
             if (mCodec == CODEC_H264) {
                 mFormat = VIDEO_FORMAT_H264;
+            } else if (mCodec == CODEC_AV1) {
+                mFormat = VIDEO_FORMAT_AV1;
             } else {
                 mFormat = VIDEO_FORMAT_H265;
             }
@@ -316,27 +333,38 @@ public class DecoderThread extends ThreadBase implements UdpReceiverThread.NALCa
             return;
         }
 
-        long presentationTime = System.nanoTime() / 1000;
+        // Following slices share presentation time with the first slice.
+        boolean continuedSlice = mPartialFrameIndex == nal.frameIndex;
+        long presentationTime = continuedSlice ? mPartialPresentationTime : System.nanoTime() / 1000;
 
         boolean consumed = false;
 
-        if (nal.type == NAL_TYPE_SPS) {
+        if (nal.length == 0) {
+            Utils.frameLog(nal.frameIndex, () -> "Feed end of partial frame.");
+
+            consumed = !continuedSlice || mWaitNextIDR || pushInputBuffer(nal, presentationTime, 0);
+        } else if (nal.type == NAL.TYPE_CONFIG) {
             // (VPS + )SPS + PPS
             Utils.frameLog(nal.frameIndex, () -> "Feed codec config. Size=" + nal.length);
 
-            mWaitNextIDR = false;
-
             consumed = pushInputBuffer(nal, 0, MediaCodec.BUFFER_FLAG_CODEC_CONFIG);
-        } else if (nal.type == NAL_TYPE_IDR) {
+        } else if (nal.type == NAL.TYPE_IDR) {
             // IDR-Frame
             Utils.frameLog(nal.frameIndex, () -> "Feed IDR-Frame. Size=" + nal.length + " PresentationTime=" + presentationTime);
 
-            LatencyCollector.DecoderInput(nal.frameIndex);
+            // Parameter sets are sent only on change, so decoder may have got them long before.
+            mWaitNextIDR = false;
+
+            if (!continuedSlice) {
+                LatencyCollector.DecoderInput(nal.frameIndex);
+            }
 
             consumed = pushInputBuffer(nal, presentationTime, 0);
         } else {
             // PFrame
-            LatencyCollector.DecoderInput(nal.frameIndex);
+            if (!continuedSlice) {
+                LatencyCollector.DecoderInput(nal.frameIndex);
+            }
 
             if (mWaitNextIDR) {
                 // Ignore P-Frame until next I-Frame
@@ -351,37 +379,17 @@ public class DecoderThread extends ThreadBase implements UdpReceiverThread.NALCa
             }
         }
         if (consumed) {
+            if (nal.length == 0 || nal.type != NAL.TYPE_CONFIG) {
+                mPartialFrameIndex = nal.partial ? nal.frameIndex : -1;
+                mPartialPresentationTime = presentationTime;
+            }
             mNalQueue.remove();
         }
     }
 
-    private void detectNALType(NAL nal) {
-        int NALType;
-
-        if (mCodec == CODEC_H264) {
-            NALType = nal.buf[4] & 0x1F;
-        } else {
-            NALType = (nal.buf[4] >> 1) & 0x3F;
-        }
-        Utils.frameLog(nal.frameIndex, () -> "Got NAL Type=" + NALType + " Length=" + nal.length + " QueueSize=" + mNalQueue.size());
-
-        if ((mCodec == CODEC_H264 && NALType == NAL_TYPE_SPS) ||
-                (mCodec == CODEC_H265 && NALType == H265_NAL_TYPE_VPS)) {
-            // (VPS + )SPS + PPS
-            nal.type = NAL_TYPE_SPS;
-        } else if ((mCodec == CODEC_H264 && NALType == NAL_TYPE_IDR) ||
-                (mCodec == CODEC_H265 && NALType == H265_NAL_TYPE_IDR_W_RADL)) {
-            // IDR-Frame
-            nal.type = NAL_TYPE_IDR;
-        } else {
-            // PFrame
-            nal.type = NAL_TYPE_P;
-        }
-    }
-
     @Override
-    public NAL obtainNAL(int length) {
-        return mNalQueue.obtain(length);
+    public NAL obtainNAL() {
+        return mNalQueue.obtain();
     }
 
     @Override
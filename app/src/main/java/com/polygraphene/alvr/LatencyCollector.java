@@ -4,6 +4,8 @@ public class LatencyCollector {
     static {
         System.loadLibrary("native-lib");
     }
+    // Called at start of Java threads which record, so that their first record does not allocate.
+    public static native void RegisterThread();
     public static native void DecoderInput(long frameIndex);
     public static native void DecoderOutput(long frameIndex);
     public static native void Submit(long frameIndex);
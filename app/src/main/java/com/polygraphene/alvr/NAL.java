@@ -1,8 +1,47 @@
 package com.polygraphene.alvr;
 
+import java.nio.ByteBuffer;
+
 public class NAL {
+    // Values of type. Detected on native side, so that decoder thread does not parse the data.
+    public static final int TYPE_P = 1;
+    public static final int TYPE_IDR = 5;
+    // (VPS + )SPS + PPS
+    public static final int TYPE_CONFIG = 7;
+
+    // ALVR_VIDEO_FRAME_TYPE_IDR
+    public static final int FRAME_TYPE_IDR = 1;
+
     public int length;
     public long frameIndex;
-    public byte[] buf;
+    // Data starts from offset. Direct buffer owned by native code when bufferId >= 0.
+    public ByteBuffer buf;
+    public int offset;
     public int type;
+    // More slices of the same frame follow. Empty NAL with partial=false terminates the frame.
+    public boolean partial;
+    public int bufferId = -1;
+    public BufferReleaser releaser;
+
+    public interface BufferReleaser {
+        void releaseNALBuffer(int bufferId);
+    }
+
+    // Return native buffer after the data has been fed to decoder.
+    public void release() {
+        if (releaser != null && bufferId >= 0) {
+            releaser.releaseNALBuffer(bufferId);
+        }
+        releaser = null;
+        bufferId = -1;
+        buf = null;
+    }
+
+    // View of the data for bulk copy.
+    public ByteBuffer slice() {
+        ByteBuffer data = buf.duplicate();
+        data.limit(offset + length);
+        data.position(offset);
+        return data;
+    }
 }
@@ -6,27 +6,17 @@ import java.util.Queue;
 public class NalQueue {
     private Queue<NAL> mUnusedList = new LinkedList<>();
     private Queue<NAL> mNalQueue = new LinkedList<>();
+    // Buffers are owned by native code, so only NAL objects are pooled here.
     private static final int SIZE = 100;
-    private static final int DEFAULT_BUFFER_SIZE = 100 * 1000;
 
     NalQueue() {
         for (int i = 0; i < SIZE; i++) {
-            NAL nal = new NAL();
-            nal.buf = new byte[DEFAULT_BUFFER_SIZE];
-            mUnusedList.add(nal);
+            mUnusedList.add(new NAL());
         }
     }
 
-    synchronized public NAL obtain(int length) {
-        NAL nal = mUnusedList.poll();
-        if (nal == null) {
-            return null;
-        }
-        if (nal.buf.length < length) {
-            nal.buf = new byte[length];
-        }
-        nal.length = length;
-        return nal;
+    synchronized public NAL obtain() {
+        return mUnusedList.poll();
     }
 
     synchronized public void add(NAL nal) {
@@ -39,10 +29,14 @@ public class NalQueue {
 
     synchronized public void remove() {
         NAL nal = mNalQueue.remove();
+        nal.release();
         mUnusedList.add(nal);
     }
 
     synchronized public void clear() {
+        for (NAL nal : mNalQueue) {
+            nal.release();
+        }
         mUnusedList.addAll(mNalQueue);
         mNalQueue.clear();
     }
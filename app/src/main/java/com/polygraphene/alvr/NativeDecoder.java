@@ -0,0 +1,98 @@
+package com.polygraphene.alvr;
+
+import android.graphics.SurfaceTexture;
+import android.view.Surface;
+
+/**
+ * Decode on NDK AMediaCodec which is fed directly by native decode queue, instead of DecoderThread.
+ * Enabled by DEBUG_FLAGS_ENABLE_NATIVE_DECODER. Decoded frames are rendered to the surface one at
+ * a time, so the renderer uses it in the same way as DecoderThread.
+ */
+public class NativeDecoder implements UdpReceiverThread.NALCallback {
+    private static final String TAG = "NativeDecoder";
+
+    // Same value as DEBUG_FLAGS_ENABLE_NATIVE_DECODER of native code.
+    private static final long DEBUG_FLAGS_ENABLE_NATIVE_DECODER = 1L << 10;
+
+    private final Surface mSurface;
+    private long mNativeHandle = 0;
+    private int mCodec;
+    private int mWidth;
+    private int mHeight;
+
+    public static boolean isEnabled() {
+        return (PersistentConfig.sDebugFlags & DEBUG_FLAGS_ENABLE_NATIVE_DECODER) != 0;
+    }
+
+    public NativeDecoder(Surface surface) {
+        mSurface = surface;
+    }
+
+    // Called on connection. Decoder is recreated when the stream format has changed.
+    // Returns false if decoder could not be created.
+    synchronized public boolean onConnect(UdpReceiverThread receiverThread, int codec, int width, int height) {
+        if (mNativeHandle != 0 && codec == mCodec && width == mWidth && height == mHeight) {
+            return true;
+        }
+        release(receiverThread);
+
+        mNativeHandle = createNative(mSurface, codec, width, height);
+        if (mNativeHandle == 0) {
+            Utils.loge(TAG, () -> "Failed to create native decoder. codec=" + codec);
+            return false;
+        }
+        mCodec = codec;
+        mWidth = width;
+        mHeight = height;
+        receiverThread.setDecoderSink(mNativeHandle);
+        Utils.logi(TAG, () -> "Native decoder created. codec=" + codec + " " + width + "x" + height);
+        return true;
+    }
+
+    // Decoder is destroyed when receiver thread has stopped feeding it.
+    synchronized public void release(UdpReceiverThread receiverThread) {
+        if (mNativeHandle == 0) {
+            return;
+        }
+        receiverThread.setDecoderSink(0);
+        destroyNative(mNativeHandle);
+        mNativeHandle = 0;
+    }
+
+    synchronized public void onFrameAvailable() {
+        if (mNativeHandle != 0) {
+            onFrameAvailableNative(mNativeHandle);
+        }
+    }
+
+    // Latch the decoded frame to the surface texture. Returns frame index or -1 if no frame is available.
+    synchronized public long clearAvailable(SurfaceTexture surfaceTexture) {
+        if (mNativeHandle == 0) {
+            return -1;
+        }
+        long frameIndex = getAvailableFrameNative(mNativeHandle);
+        if (frameIndex == -1) {
+            return -1;
+        }
+        surfaceTexture.updateTexImage();
+        // Next decoded frame can be rendered to the surface.
+        releaseAvailableFrameNative(mNativeHandle);
+        return frameIndex;
+    }
+
+    // Frames reach Java only before native decoder is set. They are dropped.
+    @Override
+    public NAL obtainNAL() {
+        return null;
+    }
+
+    @Override
+    public void pushNAL(NAL nal) {
+    }
+
+    private static native long createNative(Surface surface, int codec, int width, int height);
+    private static native void destroyNative(long nativeHandle);
+    private static native void onFrameAvailableNative(long nativeHandle);
+    private static native long getAvailableFrameNative(long nativeHandle);
+    private static native void releaseAvailableFrameNative(long nativeHandle);
+}
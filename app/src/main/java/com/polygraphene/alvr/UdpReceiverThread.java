@@ -3,15 +3,17 @@ package com.polygraphene.alvr;
 import android.app.Activity;
 import android.opengl.EGLContext;
 import android.util.Log;
+import android.util.SparseArray;
 
 import java.net.InterfaceAddress;
 import java.net.NetworkInterface;
 import java.net.SocketException;
+import java.nio.ByteBuffer;
 import java.util.ArrayList;
 import java.util.Enumeration;
 import java.util.List;
 
-class UdpReceiverThread extends ThreadBase implements TrackingThread.TrackingCallback {
+class UdpReceiverThread extends ThreadBase implements TrackingThread.TrackingCallback, NAL.BufferReleaser {
     private static final String TAG = "UdpReceiverThread";
 
     static {
@@ -25,6 +27,11 @@ class UdpReceiverThread extends ThreadBase implements TrackingThread.TrackingCal
     private TrackingThread mTrackingThread;
 
     private DeviceDescriptor mDeviceDescriptor;
+    // Parameter sets of each server are saved here.
+    private String mCacheDir;
+    // Packet capture replayed before connecting to server. null to disable.
+    private String mReplayCapturePath;
+    private boolean mReplayRealtime;
 
     private boolean mInitialized = false;
     private boolean mInitializeFailed = false;
@@ -49,11 +56,13 @@ class UdpReceiverThread extends ThreadBase implements TrackingThread.TrackingCal
     private Callback mCallback;
 
     public interface NALCallback {
-        NAL obtainNAL(int length);
+        NAL obtainNAL();
         void pushNAL(NAL nal);
     }
 
     private NALCallback mNALCallback;
+    // Direct buffers which wrap native frame buffers. Indexed by buffer id.
+    private final SparseArray<ByteBuffer> mNALBuffers = new SparseArray<>();
 
     private long mNativeHandle = 0;
     private final Object mWaiter = new Object();
@@ -86,11 +95,29 @@ class UdpReceiverThread extends ThreadBase implements TrackingThread.TrackingCal
         }
     }
 
+    // Feed frames to native decoder of NativeDecoder instead of NALCallback. 0 drops frames.
+    public void setDecoderSink(long decoderHandle) {
+        synchronized (mWaiter) {
+            if (mNativeHandle == 0) {
+                return;
+            }
+            setDecoderSinkNative(mNativeHandle, decoderHandle);
+        }
+    }
+
+    // Feed the packet capture recorded with DEBUG_FLAGS_ENABLE_PACKET_CAPTURE before connecting to
+    // server. Must be called before start().
+    public void setReplayCapture(String path, boolean realtime) {
+        mReplayCapturePath = path;
+        mReplayRealtime = realtime;
+    }
+
     public boolean start(EGLContext mEGLContext, Activity activity, DeviceDescriptor deviceDescriptor, int cameraTexture, NALCallback nalCallback) {
         mTrackingThread = new TrackingThread();
         mTrackingThread.setCallback(this);
 
         mDeviceDescriptor = deviceDescriptor;
+        mCacheDir = activity.getCacheDir().getAbsolutePath();
 
         mNALCallback = nalCallback;
 
@@ -139,6 +166,10 @@ class UdpReceiverThread extends ThreadBase implements TrackingThread.TrackingCal
                 }
                 return;
             }
+            setCacheDirNative(mNativeHandle, mCacheDir);
+            if (mReplayCapturePath != null) {
+                setReplayCaptureNative(mNativeHandle, mReplayCapturePath, mReplayRealtime);
+            }
             synchronized (this) {
                 mInitialized = true;
                 notifyAll();
@@ -148,8 +179,11 @@ class UdpReceiverThread extends ThreadBase implements TrackingThread.TrackingCal
             runLoop(mNativeHandle, mPreviousServerAddress, mPreviousServerPort);
         } finally {
             mCallback.onShutdown(getServerAddress(mNativeHandle), getServerPort(mNativeHandle));
-            closeSocket(mNativeHandle);
-            mNativeHandle = 0;
+            synchronized (mWaiter) {
+                // Decoder thread may release NAL buffers concurrently.
+                closeSocket(mNativeHandle);
+                mNativeHandle = 0;
+            }
         }
 
         Utils.logi(TAG, () -> "UdpReceiverThread stopped.");
@@ -250,16 +284,61 @@ class UdpReceiverThread extends ThreadBase implements TrackingThread.TrackingCal
         }
     }
 
+    // called from native when new native buffer is shared.
     @SuppressWarnings("unused")
-    public NAL obtainNAL(int length) {
-        return mNALCallback.obtainNAL(length);
+    public void registerNALBuffer(int bufferId, ByteBuffer buffer) {
+        mNALBuffers.put(bufferId, buffer);
     }
 
+    // called from native decode queue thread. Data is [offset, length) of the buffer and starts with
+    // (VPS + )SPS + PPS if configLength > 0. Data may have only parameter sets.
+    // frameType is ALVR_VIDEO_FRAME_TYPE detected by native NAL scanner.
+    // bufferId=-1 terminates partially pushed frame.
     @SuppressWarnings("unused")
-    public void pushNAL(NAL nal) {
+    public void pushFrame(int bufferId, int offset, int configLength, int length, long frameIndex, int frameType, boolean partial) {
+        ByteBuffer buffer = bufferId >= 0 ? mNALBuffers.get(bufferId) : null;
+        if (configLength > 0) {
+            pushNAL(buffer, bufferId, offset, configLength, frameIndex, NAL.TYPE_CONFIG, false);
+        }
+        int frameOffset = offset + configLength;
+        if (bufferId >= 0 && frameOffset == length) {
+            return;
+        }
+        int type = frameType == NAL.FRAME_TYPE_IDR ? NAL.TYPE_IDR : NAL.TYPE_P;
+        pushNAL(buffer, bufferId, frameOffset, length - frameOffset, frameIndex, type, partial);
+    }
+
+    private void pushNAL(ByteBuffer buffer, int bufferId, int offset, int length, long frameIndex, int type, boolean partial) {
+        NAL nal = mNALCallback.obtainNAL();
+        if (nal == null) {
+            Utils.loge(TAG, () -> "NAL Queue is full.");
+            if (bufferId >= 0) {
+                releaseNALBuffer(bufferId);
+            }
+            return;
+        }
+        nal.buf = buffer;
+        nal.offset = offset;
+        nal.length = length;
+        nal.frameIndex = frameIndex;
+        nal.type = type;
+        nal.partial = partial;
+        nal.bufferId = bufferId;
+        nal.releaser = bufferId >= 0 ? this : null;
         mNALCallback.pushNAL(nal);
     }
 
+    // Called from decoder thread.
+    @Override
+    public void releaseNALBuffer(int bufferId) {
+        synchronized (mWaiter) {
+            if (mNativeHandle == 0) {
+                return;
+            }
+            releaseNALBufferNative(mNativeHandle, bufferId);
+        }
+    }
+
     private native long initializeSocket(int helloPort, int port, String deviceName, String[] broadcastAddrList,
                                          int[] refreshRates, int renderWidth, int renderHeight, float[] fov,
                                          int deviceType, int deviceSubType, int deviceCapabilityFlags, int controllerCapabilityFlags);
@@ -274,4 +353,8 @@ class UdpReceiverThread extends ThreadBase implements TrackingThread.TrackingCal
     private native String getServerAddress(long nativeHandle);
     private native int getServerPort(long nativeHandle);
     private native void setSinkPreparedNative(long nativeHandle, boolean prepared);
+    private native void releaseNALBufferNative(long nativeHandle, int bufferId);
+    private native void setDecoderSinkNative(long nativeHandle, long decoderHandle);
+    private native void setCacheDirNative(long nativeHandle, String cacheDir);
+    private native void setReplayCaptureNative(long nativeHandle, String path, boolean realtime);
 }
\ No newline at end of file
@@ -9,6 +9,8 @@ public class Utils {
     public static boolean sEnableLog = false;
 
     public static native void setFrameLogEnabled(long debugFlags);
+    // Write frame trace recorded with DEBUG_FLAGS_ENABLE_TRACE in Chrome JSON trace format.
+    public static native boolean exportTrace(String path);
 
     public interface LogProvider {
         String obtain();
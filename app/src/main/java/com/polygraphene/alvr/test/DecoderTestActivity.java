@@ -13,6 +13,7 @@ import com.polygraphene.alvr.R;
 
 import java.io.FileInputStream;
 import java.io.IOException;
+import java.nio.ByteBuffer;
 import java.util.LinkedList;
 
 public class DecoderTestActivity extends AppCompatActivity {
@@ -112,8 +113,8 @@ public class DecoderTestActivity extends AppCompatActivity {
             byte[] buffer = new byte[87];
             fis.read(buffer, 0, buffer.length);
             nal.frameIndex = frameIndex;
-            nal.buf = buffer;
-            nal.length = nal.buf.length;
+            nal.buf = ByteBuffer.wrap(buffer);
+            nal.length = buffer.length;
 
             String s = "";
             for(int i = 0; i < 8; i++) {
@@ -132,8 +133,8 @@ public class DecoderTestActivity extends AppCompatActivity {
 
                 nal = new NAL();
                 nal.frameIndex = frameIndex++;
-                nal.buf = buffer;
-                nal.length = nal.buf.length;
+                nal.buf = ByteBuffer.wrap(buffer);
+                nal.length = buffer.length;
 
                 mNalList.add(nal);
             }
@@ -0,0 +1,153 @@
+/// Replay benchmark
+// Replay a packet capture through FEC, NAL parser and decode queue on host and report
+// throughput of the receive pipeline.
+////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include "capture_replay.h"
+#include "decoder_sink.h"
+#include "nal.h"
+#include "video_feedback.h"
+#include "exception.h"
+#include "utils.h"
+
+// Counts feedback which UdpManager would send to server.
+class ReplayFeedback : public VideoFeedback {
+public:
+    void sendVideoFrameAck(bool result, bool /*isIDR*/, uint64_t startFrame, uint64_t endFrame,
+                           const FrameInfo * /*info*/) override {
+        if (result) {
+            m_acked++;
+        } else {
+            m_nacked += endFrame - startFrame + 1;
+        }
+    }
+
+    void sendVideoSliceLoss(uint64_t /*videoFrameIndex*/, uint8_t /*sliceCount*/,
+                            uint64_t /*lostSlices*/) override {
+        m_sliceLosses++;
+    }
+
+    FECController &getFecController() override {
+        return m_fecController;
+    }
+
+    uint64_t m_acked = 0;
+    uint64_t m_nacked = 0;
+    uint64_t m_sliceLosses = 0;
+private:
+    FECController m_fecController;
+};
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-r] [-o output.h264] capture\n"
+                    "  -r  Keep recorded packet intervals.\n"
+                    "  -o  Write elementary stream instead of discarding frames.\n", name);
+}
+
+int main(int argc, char **argv) {
+    bool realtime = false;
+    const char *output = nullptr;
+    int opt;
+    while ((opt = getopt(argc, argv, "ro:")) != -1) {
+        if (opt == 'r') {
+            realtime = true;
+        } else if (opt == 'o') {
+            output = optarg;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+    AsyncLogger::Instance().start();
+
+    try {
+        CaptureReplayer replayer(argv[optind]);
+        const ConnectionMessage *connectionMessage = replayer.getReader().getConnectionMessage();
+        if (connectionMessage == nullptr) {
+            fprintf(stderr, "Capture has no connection record. path=%s\n", argv[optind]);
+            return 1;
+        }
+
+        std::shared_ptr<NullDecoderSink> nullSink;
+        std::shared_ptr<DecoderSink> sink;
+        if (output != nullptr) {
+            sink = std::make_shared<FileDecoderSink>(output);
+        } else {
+            nullSink = std::make_shared<NullDecoderSink>();
+            sink = nullSink;
+        }
+
+        // Same configuration as UdpManager::onConnect.
+        ReplayFeedback feedback;
+        feedback.getFecController().setUnequalErrorProtection(
+                (connectionMessage->streamFlags & ALVR_STREAM_FLAG_UNEQUAL_ERROR_PROTECTION) != 0);
+        NALParser parser(&feedback);
+        parser.setCodec(connectionMessage->codec);
+        parser.configureDecodeQueue(connectionMessage->frameQueueSize,
+                                    connectionMessage->refreshRate);
+        parser.setSliceLossReport(
+                (connectionMessage->streamFlags & ALVR_STREAM_FLAG_SLICED_FEC) &&
+                (connectionMessage->streamFlags & ALVR_STREAM_FLAG_SLICE_LOSS_REPORT));
+        parser.setInterleavedFecDepth(
+                (connectionMessage->streamFlags & ALVR_STREAM_FLAG_INTERLEAVED_FEC) &&
+                !(connectionMessage->streamFlags & ALVR_STREAM_FLAG_SLICED_FEC) ?
+                connectionMessage->interleavedFecDepth : 0);
+        parser.setSink(sink);
+        parser.reset();
+
+        uint64_t videoPackets = 0;
+        CaptureReplayer::Statistics statistics = replayer.replay(
+                realtime, UINT64_MAX, [&](const CaptureRecord &record) {
+                    if (record.type != CAPTURE_RECORD_PACKET || record.length < sizeof(uint32_t)) {
+                        return true;
+                    }
+                    uint32_t type = *(const uint32_t *) record.data;
+                    if (type == ALVR_PACKET_TYPE_VIDEO_FRAME && record.length >= sizeof(VideoFrame)) {
+                        parser.processPacket((VideoFrame *) record.data, record.length);
+                        videoPackets++;
+                    } else if (type == ALVR_PACKET_TYPE_VIDEO_INTERLEAVED_PARITY &&
+                               record.length >= sizeof(VideoInterleavedParity)) {
+                        parser.processInterleavedParity((VideoInterleavedParity *) record.data,
+                                                        record.length);
+                        videoPackets++;
+                    }
+                    return true;
+                });
+
+        // Let the decode queue hand the last frames to the sink before stopping it.
+        usleep(100 * 1000);
+        parser.setSink(nullptr);
+
+        double elapsed = statistics.elapsedUs > 0 ? statistics.elapsedUs / 1e6 : 0.0;
+        printf("records=%llu videoPackets=%llu bytes=%llu elapsed=%.3f s captured=%.3f s late=%llu\n",
+               (unsigned long long) statistics.records, (unsigned long long) videoPackets,
+               (unsigned long long) statistics.bytes, elapsed, statistics.capturedUs / 1e6,
+               (unsigned long long) statistics.lateRecords);
+        printf("throughput=%.1f Mbps %.0f packets/s\n",
+               elapsed > 0 ? statistics.bytes * 8.0 / 1e6 / elapsed : 0.0,
+               elapsed > 0 ? videoPackets / elapsed : 0.0);
+        printf("acked=%llu nacked=%llu sliceLosses=%llu\n", (unsigned long long) feedback.m_acked,
+               (unsigned long long) feedback.m_nacked, (unsigned long long) feedback.m_sliceLosses);
+        if (nullSink) {
+            printf("sink frames=%llu bytes=%llu %.1f fps\n",
+                   (unsigned long long) nullSink->getFrames(),
+                   (unsigned long long) nullSink->getBytes(),
+                   elapsed > 0 ? nullSink->getFrames() / elapsed : 0.0);
+        }
+    } catch (Exception &e) {
+        fprintf(stderr, "Replay failed. e=%ls\n", e.what());
+        return 1;
+    }
+    AsyncLogger::Instance().flush();
+    return 0;
+}
@@ -0,0 +1,146 @@
+/// Annex-B scanner test
+// SIMD start code search against the scalar one, on buffers built to hit block boundaries.
+////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <vector>
+#include "annexb.h"
+#include "packet_types.h"
+#include "test.h"
+
+// Bytes compared by one SIMD step.
+static const int BLOCK = 16;
+static const uint8_t FILLER = 0x55;
+
+// Compare both searches from every offset of the buffer.
+static void checkAllOffsets(const std::vector<uint8_t> &buffer) {
+    const uint8_t *end = buffer.data() + buffer.size();
+    for (size_t offset = 0; offset <= buffer.size(); offset++) {
+        const uint8_t *begin = buffer.data() + offset;
+        const uint8_t *expected = findZeroPairScalar(begin, end);
+        const uint8_t *actual = findZeroPair(begin, end);
+        if (expected != actual) {
+            fprintf(stderr, "size=%zu offset=%zu expected=%td actual=%td\n", buffer.size(),
+                    offset, expected - buffer.data(), actual - buffer.data());
+        }
+        CHECK(expected == actual);
+    }
+}
+
+static void testZeroPairAtEveryPosition() {
+    for (int size = 0; size <= 3 * BLOCK + 2; size++) {
+        for (int position = 0; position + 2 <= size; position++) {
+            std::vector<uint8_t> buffer(size, FILLER);
+            buffer[position] = 0;
+            buffer[position + 1] = 0;
+            checkAllOffsets(buffer);
+        }
+    }
+}
+
+static void testLoneZeroes() {
+    // Zeroes at both sides of a block boundary without being a pair.
+    for (int size = 1; size <= 3 * BLOCK + 2; size++) {
+        for (int position = 0; position < size; position++) {
+            std::vector<uint8_t> buffer(size, FILLER);
+            buffer[position] = 0;
+            if (position + 2 < size) {
+                buffer[position + 2] = 0;
+            }
+            checkAllOffsets(buffer);
+            CHECK(findZeroPair(buffer.data(), buffer.data() + size) == buffer.data() + size);
+        }
+    }
+}
+
+static void testRandom() {
+    srand(1);
+    for (int i = 0; i < 2000; i++) {
+        std::vector<uint8_t> buffer(rand() % (4 * BLOCK) + 1);
+        // Sparse zeroes, so that pairs are sometimes missing from whole blocks.
+        for (uint8_t &byte : buffer) {
+            byte = rand() % 6 == 0 ? 0 : static_cast<uint8_t>(rand() % 255 + 1);
+        }
+        checkAllOffsets(buffer);
+    }
+}
+
+static void appendStartCode(std::vector<uint8_t> &buffer, bool longStartCode) {
+    if (longStartCode) {
+        buffer.push_back(0);
+    }
+    buffer.push_back(0);
+    buffer.push_back(0);
+    buffer.push_back(1);
+}
+
+// Two NALs, second of which has its start code at every position around block boundaries.
+static void testStartCodeAcrossBoundary() {
+    AnnexBScanner scanner;
+    scanner.setCodec(ALVR_CODEC_H264);
+    for (int longStartCode = 0; longStartCode < 2; longStartCode++) {
+        for (int position = 5; position <= 3 * BLOCK + 1; position++) {
+            std::vector<uint8_t> buffer;
+            appendStartCode(buffer, true);
+            buffer.push_back(0x65);
+            buffer.resize(position, FILLER);
+            appendStartCode(buffer, longStartCode != 0);
+            buffer.push_back(0x41);
+            buffer.resize(buffer.size() + 7, FILLER);
+
+            CHECK_EQ(2, scanner.scan(reinterpret_cast<const char *>(buffer.data()),
+                                     static_cast<int>(buffer.size())));
+            if (scanner.getNALs().size() != 2) {
+                continue;
+            }
+            const NALUnit &first = scanner.getNALs()[0];
+            const NALUnit &second = scanner.getNALs()[1];
+            int startCodeLength = longStartCode ? 4 : 3;
+            CHECK_EQ(0, first.start);
+            CHECK_EQ(4, first.offset);
+            CHECK_EQ(5, first.type);
+            CHECK_EQ(position - 4, first.length);
+            CHECK_EQ(position, second.start);
+            CHECK_EQ(position + startCodeLength, second.offset);
+            CHECK_EQ(1, second.type);
+            CHECK_EQ(8, second.length);
+        }
+    }
+}
+
+static void testStartCodeAtEnd() {
+    AnnexBScanner scanner;
+    scanner.setCodec(ALVR_CODEC_H265);
+    for (int longStartCode = 0; longStartCode < 2; longStartCode++) {
+        for (int size = 8; size <= 3 * BLOCK + 2; size++) {
+            int startCodeLength = longStartCode ? 4 : 3;
+            std::vector<uint8_t> buffer;
+            appendStartCode(buffer, false);
+            // IDR_W_RADL
+            buffer.push_back(19 << 1);
+            buffer.push_back(1);
+            buffer.resize(size - startCodeLength, FILLER);
+            // Start code without NAL after it is not a NAL, but ends the previous one.
+            appendStartCode(buffer, longStartCode != 0);
+
+            CHECK_EQ(1, scanner.scan(reinterpret_cast<const char *>(buffer.data()),
+                                     static_cast<int>(buffer.size())));
+            if (scanner.getNALs().size() != 1) {
+                continue;
+            }
+            CHECK_EQ(19, scanner.getNALs()[0].type);
+            CHECK_EQ(3, scanner.getNALs()[0].offset);
+            CHECK_EQ(size - startCodeLength - 3, scanner.getNALs()[0].length);
+            checkAllOffsets(buffer);
+        }
+    }
+}
+
+int main() {
+    RUN_TEST(testZeroPairAtEveryPosition);
+    RUN_TEST(testLoneZeroes);
+    RUN_TEST(testRandom);
+    RUN_TEST(testStartCodeAcrossBoundary);
+    RUN_TEST(testStartCodeAtEnd);
+    return TEST_RESULT();
+}
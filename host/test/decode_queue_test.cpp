@@ -0,0 +1,219 @@
+/// Decode queue test
+// Drop policy of DecodeQueue in front of a decoder which is stalled by the test.
+////////////////////////////////////////////////////////////////////
+
+#include <unistd.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "decode_queue.h"
+#include "packet_types.h"
+#include "test.h"
+
+static std::atomic<uint64_t> gClock(1000000);
+
+static uint64_t fakeClock() {
+    return gClock;
+}
+
+// Decoder which takes nothing while stalled and records frames pushed after that.
+class FakeDecoderSink : public DecoderSink {
+public:
+    struct Frame {
+        uint64_t frameIndex;
+        int configLength;
+        // Bytes after parameter sets.
+        int sliceLength;
+    };
+
+    void pushFrame(std::vector<char> &/*frameBuffer*/, int offset, int configLength, int length,
+                   uint64_t frameIndex, uint8_t /*frameType*/, bool /*partial*/,
+                   bool /*keepBuffer*/) override {
+        MutexLock lock(m_mutex);
+        m_frames.push_back({frameIndex, configLength, length - offset - configLength});
+    }
+
+    void pushEndOfFrame(uint64_t /*frameIndex*/) override {
+    }
+
+    bool waitReady(int64_t timeoutUs) override {
+        for (int64_t waited = 0; m_stalled && waited < timeoutUs; waited += 1000) {
+            usleep(1000);
+        }
+        return !m_stalled;
+    }
+
+    void setStalled(bool stalled) {
+        m_stalled = stalled;
+    }
+
+    std::vector<Frame> getFrames() {
+        MutexLock lock(m_mutex);
+        return m_frames;
+    }
+private:
+    std::atomic<bool> m_stalled{true};
+    Mutex m_mutex;
+    std::vector<Frame> m_frames;
+};
+
+// Frame index is video frame index + FRAME_INDEX_OFFSET.
+static const uint64_t FRAME_INDEX_OFFSET = 100;
+static const int CONFIG_LENGTH = 8;
+static const int SLICE_LENGTH = 32;
+
+static void pushFrame(DecodeQueue &queue, uint64_t videoFrame, uint8_t frameType, bool reference,
+                      bool config = false) {
+    int configLength = config ? CONFIG_LENGTH : 0;
+    std::vector<char> buffer(static_cast<size_t>(configLength + SLICE_LENGTH));
+    queue.push(buffer, 0, configLength, static_cast<int>(buffer.size()), videoFrame,
+               videoFrame + FRAME_INDEX_OFFSET, frameType, reference, false, false);
+}
+
+// Frame indices the sink has received, after waiting for count of them.
+static std::vector<uint64_t> waitFrames(FakeDecoderSink &sink, size_t count) {
+    for (int i = 0; i < 1000 && sink.getFrames().size() < count; i++) {
+        usleep(1000);
+    }
+    // Nothing more is expected.
+    usleep(20 * 1000);
+    std::vector<uint64_t> frames;
+    for (const auto &frame : sink.getFrames()) {
+        frames.push_back(frame.frameIndex - FRAME_INDEX_OFFSET);
+    }
+    return frames;
+}
+
+static bool waitDroppedReferences(DecodeQueue &queue, uint64_t *start, uint64_t *end) {
+    for (int i = 0; i < 1000; i++) {
+        if (queue.takeDroppedReferences(start, end)) {
+            return true;
+        }
+        usleep(1000);
+    }
+    return false;
+}
+
+static void testNonReferenceDroppedFirst() {
+    auto sink = std::make_shared<FakeDecoderSink>();
+    DecodeQueue queue(fakeClock);
+    queue.configure(2, 0);
+    queue.setSink(sink);
+
+    pushFrame(queue, 1, ALVR_VIDEO_FRAME_TYPE_IDR, true, true);
+    pushFrame(queue, 2, ALVR_VIDEO_FRAME_TYPE_P, false);
+    pushFrame(queue, 3, ALVR_VIDEO_FRAME_TYPE_P, true);
+    // Non-reference frame is dropped even if a reference frame is older.
+    pushFrame(queue, 4, ALVR_VIDEO_FRAME_TYPE_P, false);
+    uint64_t start, end;
+    CHECK(!queue.takeDroppedReferences(&start, &end));
+
+    sink->setStalled(false);
+    std::vector<uint64_t> frames = waitFrames(*sink, 2);
+    CHECK_EQ(2, frames.size());
+    if (frames.size() == 2) {
+        CHECK_EQ(1, frames[0]);
+        CHECK_EQ(3, frames[1]);
+    }
+    queue.setSink(nullptr);
+}
+
+static void testJumpToNewestIDR() {
+    auto sink = std::make_shared<FakeDecoderSink>();
+    DecodeQueue queue(fakeClock);
+    queue.configure(2, 0);
+    queue.setSink(sink);
+
+    pushFrame(queue, 1, ALVR_VIDEO_FRAME_TYPE_IDR, true, true);
+    pushFrame(queue, 2, ALVR_VIDEO_FRAME_TYPE_P, true);
+    // Frames before the newer IDR are dropped, including the older IDR.
+    pushFrame(queue, 3, ALVR_VIDEO_FRAME_TYPE_IDR, true, true);
+    uint64_t start, end;
+    CHECK(!queue.takeDroppedReferences(&start, &end));
+    pushFrame(queue, 4, ALVR_VIDEO_FRAME_TYPE_P, true);
+
+    sink->setStalled(false);
+    std::vector<uint64_t> frames = waitFrames(*sink, 3);
+    // Parameter sets of the dropped IDR are still fed.
+    CHECK_EQ(3, frames.size());
+    if (frames.size() == 3) {
+        std::vector<FakeDecoderSink::Frame> pushed = sink->getFrames();
+        CHECK_EQ(1, frames[0]);
+        CHECK_EQ(CONFIG_LENGTH, pushed[0].configLength);
+        CHECK_EQ(0, pushed[0].sliceLength);
+        CHECK_EQ(3, frames[1]);
+        CHECK_EQ(SLICE_LENGTH, pushed[1].sliceLength);
+        CHECK_EQ(4, frames[2]);
+    }
+    queue.setSink(nullptr);
+}
+
+static void testDropAllReportsRange() {
+    auto sink = std::make_shared<FakeDecoderSink>();
+    DecodeQueue queue(fakeClock);
+    queue.configure(2, 0);
+    queue.setSink(sink);
+
+    pushFrame(queue, 5, ALVR_VIDEO_FRAME_TYPE_P, true);
+    pushFrame(queue, 6, ALVR_VIDEO_FRAME_TYPE_P, false);
+    pushFrame(queue, 7, ALVR_VIDEO_FRAME_TYPE_P, true);
+    // Non-reference frame 6 went first. No IDR to jump to, so everything goes.
+    pushFrame(queue, 8, ALVR_VIDEO_FRAME_TYPE_P, true);
+    uint64_t start = 0, end = 0;
+    CHECK(queue.takeDroppedReferences(&start, &end));
+    CHECK_EQ(5, start);
+    CHECK_EQ(8, end);
+    CHECK(!queue.takeDroppedReferences(&start, &end));
+
+    sink->setStalled(false);
+    CHECK_EQ(0, waitFrames(*sink, 0).size());
+    queue.setSink(nullptr);
+}
+
+static void testLatencyBudget() {
+    auto sink = std::make_shared<FakeDecoderSink>();
+    DecodeQueue queue(fakeClock);
+    // 2 frame intervals per queued frame at 100 Hz.
+    queue.configure(4, 100);
+    const uint64_t budget = 2 * 4 * 10000;
+    queue.setSink(sink);
+
+    pushFrame(queue, 1, ALVR_VIDEO_FRAME_TYPE_P, true);
+    pushFrame(queue, 2, ALVR_VIDEO_FRAME_TYPE_P, true);
+    gClock += budget;
+    uint64_t start, end;
+    usleep(30 * 1000);
+    CHECK(!queue.takeDroppedReferences(&start, &end));
+
+    // Over budget without IDR. All frames are dropped and reported.
+    gClock += 1;
+    CHECK(waitDroppedReferences(queue, &start, &end));
+    CHECK_EQ(1, start);
+    CHECK_EQ(2, end);
+
+    // With IDR queued, frames before it are dropped without report.
+    pushFrame(queue, 3, ALVR_VIDEO_FRAME_TYPE_P, true);
+    gClock += budget;
+    pushFrame(queue, 4, ALVR_VIDEO_FRAME_TYPE_IDR, true, true);
+    pushFrame(queue, 5, ALVR_VIDEO_FRAME_TYPE_P, true);
+    gClock += 1;
+    usleep(30 * 1000);
+    CHECK(!queue.takeDroppedReferences(&start, &end));
+
+    sink->setStalled(false);
+    std::vector<uint64_t> frames = waitFrames(*sink, 2);
+    CHECK_EQ(2, frames.size());
+    if (frames.size() == 2) {
+        CHECK_EQ(4, frames[0]);
+        CHECK_EQ(5, frames[1]);
+    }
+    queue.setSink(nullptr);
+}
+
+int main() {
+    RUN_TEST(testNonReferenceDroppedFirst);
+    RUN_TEST(testJumpToNewestIDR);
+    RUN_TEST(testDropAllReportsRange);
+    RUN_TEST(testLatencyBudget);
+    return TEST_RESULT();
+}
@@ -0,0 +1,110 @@
+/// FEC controller test
+// Recommendation of FECController under synthetic loss patterns.
+////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include "fec_controller.h"
+#include "test.h"
+
+static const uint32_t DATA_SHARDS = 20;
+static const uint32_t PARITY_SHARDS = 2;
+static const uint32_t TOTAL_SHARDS = DATA_SHARDS + PARITY_SHARDS;
+
+static void finishFrame(FECController &controller, uint32_t maxMissingShards) {
+    bool recovered = maxMissingShards <= PARITY_SHARDS;
+    controller.onFrameFinished(DATA_SHARDS, TOTAL_SHARDS, maxMissingShards, PARITY_SHARDS,
+                               recovered ? maxMissingShards : 0, recovered, 10,
+                               ALVR_VIDEO_FRAME_TYPE_P);
+}
+
+static void cleanFrames(FECController &controller, int count) {
+    for (int i = 0; i < count; i++) {
+        finishFrame(controller, 0);
+    }
+}
+
+static FecFeedback feedback(FECController &controller) {
+    FecFeedback feedback = {};
+    controller.fillFeedback(&feedback);
+    return feedback;
+}
+
+static void testCleanLink() {
+    FECController controller;
+    cleanFrames(controller, 600);
+    FecFeedback result = feedback(controller);
+    CHECK_EQ(1, result.recommendedFecPercentage);
+    CHECK_EQ(600, result.frames);
+    CHECK_EQ(0, result.framesLost);
+}
+
+static void testRandomLoss() {
+    FECController controller;
+    srand(1);
+    // One shard of a column is lost on about 5% of frames.
+    for (int i = 0; i < 600; i++) {
+        finishFrame(controller, rand() % 20 == 0 ? 1 : 0);
+    }
+    FecFeedback result = feedback(controller);
+    // One missing shard of 22 needs one parity shard, which is 5% of 20 data shards.
+    CHECK_EQ(5, result.recommendedFecPercentage);
+    CHECK_EQ(0, result.burstFramesLost);
+    CHECK(result.framesRecovered > 0);
+}
+
+static void testBurst() {
+    FECController controller;
+    cleanFrames(controller, 600);
+    feedback(controller);
+    // A short burst takes whole columns of some frames.
+    for (int i = 0; i < 5; i++) {
+        finishFrame(controller, TOTAL_SHARDS);
+    }
+    cleanFrames(controller, 67);
+    FecFeedback result = feedback(controller);
+    CHECK_EQ(1, result.recommendedFecPercentage);
+    CHECK_EQ(5, result.framesLost);
+    CHECK_EQ(5, result.burstFramesLost);
+}
+
+static void testFullFrameLost() {
+    FECController controller;
+    cleanFrames(controller, 600);
+    feedback(controller);
+    controller.onFramesLost(3);
+    cleanFrames(controller, 69);
+    FecFeedback result = feedback(controller);
+    CHECK_EQ(1, result.recommendedFecPercentage);
+    CHECK_EQ(72, result.frames);
+    CHECK_EQ(3, result.framesLost);
+    CHECK_EQ(3, result.burstFramesLost);
+
+    // Burst losses are counted only in the period they happened in.
+    cleanFrames(controller, 72);
+    result = feedback(controller);
+    CHECK_EQ(0, result.burstFramesLost);
+}
+
+static void testRecoverableLossRaisesImmediately() {
+    FECController controller;
+    cleanFrames(controller, 600);
+    CHECK_EQ(1, feedback(controller).recommendedFecPercentage);
+    // 10 of 600 frames lose 6 shards of a column. That is more than 0.5% of the window.
+    for (int i = 0; i < 10; i++) {
+        finishFrame(controller, 6);
+    }
+    // 6 / 22 loss rate needs ceil(0.273 * 20 / 0.727) = 8 parity shards, which is 40%.
+    CHECK_EQ(40, feedback(controller).recommendedFecPercentage);
+    // Lowered gradually after the loss has left the window.
+    cleanFrames(controller, 600);
+    CHECK_EQ(38, feedback(controller).recommendedFecPercentage);
+}
+
+int main() {
+    RUN_TEST(testCleanLink);
+    RUN_TEST(testRandomLoss);
+    RUN_TEST(testBurst);
+    RUN_TEST(testFullFrameLost);
+    RUN_TEST(testRecoverableLossRaisesImmediately);
+    return TEST_RESULT();
+}
@@ -0,0 +1,211 @@
+/// Latency histogram test
+// Percentiles of LatencyHistogram against sorted samples, and the 1s / 10s / session windows
+// built by merging as LatencyCollector does.
+////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "latency_histogram.h"
+#include "test.h"
+
+static const double PERCENTILES[] = {0.1, 1, 10, 25, 50, 75, 90, 99, 99.9, 100};
+// Seconds kept for the ten seconds window.
+static const int WINDOW_SECONDS = 10;
+
+// Exact value at the rank which getValueAtPercentile() uses.
+static uint64_t getExactPercentile(std::vector<uint64_t> values, double percentile) {
+    std::sort(values.begin(), values.end());
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * values.size() + 0.5);
+    rank = std::max<uint64_t>(rank, 1);
+    return values[rank - 1];
+}
+
+// Reported percentile is the upper bound of the bucket of the exact one, not above max.
+static void checkPercentiles(const LatencyHistogram &histogram,
+                             const std::vector<uint64_t> &values) {
+    uint64_t max = *std::max_element(values.begin(), values.end());
+    for (double percentile : PERCENTILES) {
+        uint64_t expected = getExactPercentile(values, percentile);
+        uint64_t actual = histogram.getValueAtPercentile(percentile);
+        if (actual < expected || actual > expected + expected / LatencyHistogram::SUB_BUCKETS ||
+            actual > max) {
+            fprintf(stderr, "p%g expected=%llu actual=%llu\n", percentile,
+                    (unsigned long long) expected, (unsigned long long) actual);
+        }
+        CHECK(actual >= expected);
+        CHECK(actual <= expected + expected / LatencyHistogram::SUB_BUCKETS);
+        CHECK(actual <= max);
+    }
+}
+
+static void record(LatencyHistogram &histogram, const std::vector<uint64_t> &values) {
+    for (uint64_t value : values) {
+        histogram.record(value);
+    }
+}
+
+static void testEmpty() {
+    LatencyHistogram histogram;
+    CHECK_EQ(0, histogram.getValueAtPercentile(50));
+    LatencyPercentiles percentiles;
+    histogram.getPercentiles(&percentiles);
+    CHECK_EQ(0, percentiles.count);
+    CHECK_EQ(0, percentiles.p50);
+    CHECK_EQ(0, percentiles.max);
+}
+
+static void testExactSmallValues() {
+    LatencyHistogram histogram;
+    std::vector<uint64_t> values;
+    for (uint64_t value = 0; value < LatencyHistogram::SUB_BUCKETS; value++) {
+        values.push_back(value);
+    }
+    record(histogram, values);
+    for (double percentile : PERCENTILES) {
+        CHECK_EQ(getExactPercentile(values, percentile), histogram.getValueAtPercentile(percentile));
+    }
+}
+
+static void testUniform() {
+    LatencyHistogram histogram;
+    std::vector<uint64_t> values;
+    for (uint64_t value = 1; value <= 100000; value++) {
+        values.push_back(value);
+    }
+    record(histogram, values);
+    checkPercentiles(histogram, values);
+    CHECK_EQ(100000, histogram.getCount());
+    CHECK_EQ(100000ULL * 100001 / 2, histogram.getSum());
+    CHECK_EQ(100000, histogram.getMax());
+}
+
+static void testConstant() {
+    // Percentiles of the bucket which holds max are clamped to it.
+    LatencyHistogram histogram;
+    for (int i = 0; i < 1000; i++) {
+        histogram.record(11111);
+    }
+    LatencyPercentiles percentiles;
+    histogram.getPercentiles(&percentiles);
+    CHECK_EQ(1000, percentiles.count);
+    CHECK_EQ(11111, percentiles.p50);
+    CHECK_EQ(11111, percentiles.p999);
+    CHECK_EQ(11111, percentiles.max);
+}
+
+static void testLongTail() {
+    // 99% of frames at 10 ms and 1% at 100 ms. The tail shows from p99.9 on.
+    LatencyHistogram histogram;
+    std::vector<uint64_t> values(9900, 10000);
+    values.insert(values.end(), 100, 100000);
+    record(histogram, values);
+    checkPercentiles(histogram, values);
+    LatencyPercentiles percentiles;
+    histogram.getPercentiles(&percentiles);
+    CHECK(percentiles.p99 < 10000 + 10000 / LatencyHistogram::SUB_BUCKETS);
+    CHECK_EQ(100000, percentiles.p999);
+}
+
+static void testRandom() {
+    srand(1);
+    LatencyHistogram histogram;
+    std::vector<uint64_t> values;
+    for (int i = 0; i < 20000; i++) {
+        // Spread over all magnitudes up to seconds.
+        int bits = rand() % 22;
+        values.push_back(static_cast<uint64_t>(rand()) % (2ULL << bits));
+    }
+    record(histogram, values);
+    checkPercentiles(histogram, values);
+}
+
+static void testMaxValue() {
+    LatencyHistogram histogram;
+    histogram.record(LatencyHistogram::MAX_VALUE + 1000);
+    histogram.record(UINT64_MAX);
+    CHECK_EQ(LatencyHistogram::MAX_VALUE, histogram.getMax());
+    CHECK_EQ(LatencyHistogram::MAX_VALUE, histogram.getValueAtPercentile(50));
+    CHECK_EQ(2 * LatencyHistogram::MAX_VALUE, histogram.getSum());
+}
+
+// Second windows in a ring of WINDOW_SECONDS, merged into ten seconds window on read, and a
+// session histogram which records everything.
+static void testWindows() {
+    srand(2);
+    LatencyHistogram seconds[WINDOW_SECONDS];
+    LatencyHistogram session;
+    std::vector<std::vector<uint64_t>> secondValues;
+    std::vector<uint64_t> sessionValues;
+    for (int second = 0; second < 25; second++) {
+        std::vector<uint64_t> values;
+        // Load changes over the session. Some seconds have no frame.
+        int count = second % 7 == 3 ? 0 : 50 + rand() % 200;
+        uint64_t base = 2000 + static_cast<uint64_t>(second) * 700;
+        for (int i = 0; i < count; i++) {
+            values.push_back(base + static_cast<uint64_t>(rand()) % (base * (second % 4 + 1)));
+        }
+        LatencyHistogram &current = seconds[second % WINDOW_SECONDS];
+        current.clear();
+        record(current, values);
+        record(session, values);
+        secondValues.push_back(values);
+        sessionValues.insert(sessionValues.end(), values.begin(), values.end());
+
+        LatencyHistogram tenSeconds;
+        std::vector<uint64_t> tenSecondsValues;
+        for (int i = 0; i < WINDOW_SECONDS; i++) {
+            tenSeconds.merge(seconds[i]);
+            if (second - i >= 0) {
+                const std::vector<uint64_t> &old = secondValues[second - i];
+                tenSecondsValues.insert(tenSecondsValues.end(), old.begin(), old.end());
+            }
+        }
+        CHECK_EQ(tenSecondsValues.size(), tenSeconds.getCount());
+        if (!values.empty()) {
+            checkPercentiles(current, values);
+        } else {
+            CHECK_EQ(0, current.getValueAtPercentile(99));
+        }
+        if (!tenSecondsValues.empty()) {
+            checkPercentiles(tenSeconds, tenSecondsValues);
+        }
+        checkPercentiles(session, sessionValues);
+
+        // Merged window is the same as one histogram of all its values.
+        LatencyHistogram direct;
+        record(direct, tenSecondsValues);
+        CHECK_EQ(direct.getSum(), tenSeconds.getSum());
+        CHECK_EQ(direct.getMax(), tenSeconds.getMax());
+        for (double percentile : PERCENTILES) {
+            CHECK_EQ(direct.getValueAtPercentile(percentile),
+                     tenSeconds.getValueAtPercentile(percentile));
+        }
+    }
+
+    // Merging everything in any order gives the session.
+    LatencyHistogram merged;
+    for (int second = static_cast<int>(secondValues.size()) - 1; second >= 0; second--) {
+        LatencyHistogram histogram;
+        record(histogram, secondValues[second]);
+        merged.merge(histogram);
+    }
+    CHECK_EQ(session.getCount(), merged.getCount());
+    CHECK_EQ(session.getSum(), merged.getSum());
+    CHECK_EQ(session.getMax(), merged.getMax());
+    for (double percentile : PERCENTILES) {
+        CHECK_EQ(session.getValueAtPercentile(percentile), merged.getValueAtPercentile(percentile));
+    }
+}
+
+int main() {
+    RUN_TEST(testEmpty);
+    RUN_TEST(testExactSmallValues);
+    RUN_TEST(testUniform);
+    RUN_TEST(testConstant);
+    RUN_TEST(testLongTail);
+    RUN_TEST(testRandom);
+    RUN_TEST(testMaxValue);
+    RUN_TEST(testWindows);
+    return TEST_RESULT();
+}
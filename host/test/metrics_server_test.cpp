@@ -0,0 +1,234 @@
+/// Metrics server test
+// Scrapes MetricsServer on an ephemeral loopback port and checks both output formats.
+////////////////////////////////////////////////////////////////////
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "metrics_server.h"
+#include "test.h"
+
+// Samples written by collect(). The summary is 5 quantiles, _sum and _count.
+static const int SAMPLE_COUNT = 11;
+
+static void collect(MetricsWriter &writer) {
+    writer.write(METRIC_TYPE_COUNTER, "alvr_test_frames_total", "Frames.", 1234);
+    writer.write(METRIC_TYPE_GAUGE, "alvr_test_queue_frames", "Frames in queue.", 2,
+                 "queue=\"decode\"");
+    writer.write(METRIC_TYPE_GAUGE, "alvr_test_queue_frames", "Frames in queue.", 0.5,
+                 "queue=\"render\"");
+    LatencyPercentiles percentiles = {};
+    percentiles.count = 100;
+    percentiles.p50 = 1000;
+    percentiles.p90 = 2000;
+    percentiles.p99 = 3000;
+    percentiles.p999 = 4000;
+    percentiles.max = 5000;
+    writer.writeSummary("alvr_test_latency_microseconds", "Latency.", percentiles, 150000, 100,
+                        "stage=\"decode\"");
+    writer.write(METRIC_TYPE_GAUGE, "alvr_test_last", "Last.", -1);
+}
+
+// Status line and body of GET path. False if the response is cut or its length is wrong.
+static bool scrape(int port, const char *path, std::string *status, std::string *body) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr *) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return false;
+    }
+    std::string request = std::string("GET ") + path + " HTTP/1.0\r\nHost: localhost\r\n\r\n";
+    send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+    std::string response;
+    char buffer[4096];
+    ssize_t ret;
+    while ((ret = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, static_cast<size_t>(ret));
+    }
+    close(fd);
+
+    size_t headerEnd = response.find("\r\n\r\n");
+    if (headerEnd == std::string::npos) {
+        return false;
+    }
+    std::string headers = response.substr(0, headerEnd);
+    *status = headers.substr(0, headers.find("\r\n"));
+    *body = response.substr(headerEnd + 4);
+
+    const char *contentLength = strstr(headers.c_str(), "Content-Length: ");
+    return contentLength != nullptr &&
+           strtoul(contentLength + 16, nullptr, 10) == body->size();
+}
+
+static bool isMetricName(const std::string &name) {
+    if (name.empty() || isdigit(name[0])) {
+        return false;
+    }
+    for (char c : name) {
+        if (!isalnum(c) && c != '_' && c != ':') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void testPrometheus() {
+    MetricsServer server(0, collect);
+    CHECK(server.getPort() != 0);
+
+    std::string status;
+    std::string body;
+    CHECK(scrape(server.getPort(), "/metrics", &status, &body));
+    CHECK(status == "HTTP/1.0 200 OK");
+    CHECK(!body.empty() && body.back() == '\n');
+
+    // Family of each sample must be declared once by HELP and TYPE before its samples.
+    std::map<std::string, std::string> types;
+    std::set<std::string> helps;
+    std::map<std::string, double> samples;
+    size_t start = 0;
+    while (start < body.size()) {
+        size_t end = body.find('\n', start);
+        std::string line = body.substr(start, end - start);
+        start = end + 1;
+
+        char family[128];
+        char type[32];
+        if (line.compare(0, 7, "# HELP ") == 0) {
+            CHECK(sscanf(line.c_str(), "# HELP %127s", family) == 1);
+            CHECK(isMetricName(family));
+            CHECK(helps.insert(family).second);
+            CHECK(line.size() > strlen("# HELP  ") + strlen(family));
+            continue;
+        }
+        if (line.compare(0, 7, "# TYPE ") == 0) {
+            CHECK(sscanf(line.c_str(), "# TYPE %127s %31s", family, type) == 2);
+            CHECK(helps.count(family) == 1);
+            CHECK(types.count(family) == 0);
+            CHECK(strcmp(type, "counter") == 0 || strcmp(type, "gauge") == 0 ||
+                  strcmp(type, "summary") == 0);
+            types[family] = type;
+            continue;
+        }
+
+        size_t space = line.rfind(' ');
+        CHECK(space != std::string::npos);
+        std::string series = line.substr(0, space);
+        char *valueEnd;
+        double value = strtod(line.c_str() + space + 1, &valueEnd);
+        CHECK(*valueEnd == '\0');
+        std::string name = series.substr(0, series.find('{'));
+        CHECK(isMetricName(name));
+        if (series.size() > name.size()) {
+            CHECK(series.back() == '}');
+        }
+        std::string familyName = name;
+        for (const char *suffix : {"_sum", "_count"}) {
+            std::string base = name.substr(0, name.size() - std::min(name.size(), strlen(suffix)));
+            if (types.count(base) == 1 && types[base] == "summary" && base + suffix == name) {
+                familyName = base;
+            }
+        }
+        CHECK(types.count(familyName) == 1);
+        samples[series] = value;
+    }
+
+    CHECK_EQ(SAMPLE_COUNT, samples.size());
+    CHECK(types["alvr_test_frames_total"] == "counter");
+    CHECK(types["alvr_test_queue_frames"] == "gauge");
+    CHECK(types["alvr_test_latency_microseconds"] == "summary");
+    CHECK_EQ(4, types.size());
+    CHECK_EQ(1234, samples["alvr_test_frames_total"]);
+    CHECK(samples["alvr_test_queue_frames{queue=\"render\"}"] == 0.5);
+    CHECK_EQ(-1, samples["alvr_test_last"]);
+
+    const char *quantiles[] = {"0.5", "0.9", "0.99", "0.999", "1"};
+    for (int i = 0; i < 5; i++) {
+        std::string series = std::string("alvr_test_latency_microseconds{stage=\"decode\",quantile=\"") +
+                             quantiles[i] + "\"}";
+        CHECK_EQ((i + 1) * 1000, samples[series]);
+    }
+    CHECK_EQ(150000, samples["alvr_test_latency_microseconds_sum{stage=\"decode\"}"]);
+    CHECK_EQ(100, samples["alvr_test_latency_microseconds_count{stage=\"decode\"}"]);
+}
+
+static void testSnapshot() {
+    MetricsServer server(0, collect);
+
+    std::string status;
+    std::string body;
+    CHECK(scrape(server.getPort(), "/snapshot", &status, &body));
+    CHECK(status == "HTTP/1.0 200 OK");
+    CHECK(body.size() > BinaryMetricsWriter::HEADER_SIZE);
+    if (body.size() <= BinaryMetricsWriter::HEADER_SIZE) {
+        return;
+    }
+
+    const char *data = body.data();
+    uint32_t magic;
+    uint32_t version;
+    uint64_t timestamp;
+    uint32_t count;
+    memcpy(&magic, data, sizeof(magic));
+    memcpy(&version, data + 4, sizeof(version));
+    memcpy(&timestamp, data + 8, sizeof(timestamp));
+    memcpy(&count, data + 16, sizeof(count));
+    CHECK(memcmp(data, "ALMS", 4) == 0);
+    CHECK_EQ(BinaryMetricsWriter::MAGIC, magic);
+    CHECK_EQ(BinaryMetricsWriter::VERSION, version);
+    CHECK(timestamp != 0);
+    CHECK_EQ(SAMPLE_COUNT, count);
+
+    // Samples fill the rest of the body exactly.
+    size_t offset = BinaryMetricsWriter::HEADER_SIZE;
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < count && offset < body.size(); i++) {
+        uint8_t type = static_cast<uint8_t>(data[offset++]);
+        CHECK(type <= METRIC_TYPE_SUMMARY);
+        uint8_t nameLength = static_cast<uint8_t>(data[offset++]);
+        names.push_back(body.substr(offset, nameLength));
+        offset += nameLength;
+        uint8_t labelsLength = static_cast<uint8_t>(data[offset++]);
+        offset += labelsLength;
+        double value;
+        memcpy(&value, data + offset, sizeof(value));
+        offset += sizeof(value);
+        if (i == 0) {
+            CHECK(value == 1234);
+        }
+    }
+    CHECK_EQ(body.size(), offset);
+    CHECK_EQ(SAMPLE_COUNT, names.size());
+    if (names.size() == SAMPLE_COUNT) {
+        CHECK(names[0] == "alvr_test_frames_total");
+        CHECK(names[9] == "alvr_test_latency_microseconds_count");
+    }
+}
+
+static void testNotFound() {
+    MetricsServer server(0, collect);
+
+    std::string status;
+    std::string body;
+    CHECK(scrape(server.getPort(), "/", &status, &body));
+    CHECK(status == "HTTP/1.0 404 Not Found");
+}
+
+int main() {
+    RUN_TEST(testPrometheus);
+    RUN_TEST(testSnapshot);
+    RUN_TEST(testNotFound);
+    return TEST_RESULT();
+}
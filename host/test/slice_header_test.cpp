@@ -0,0 +1,239 @@
+/// Slice header parser test
+// SliceHeaderParser and BitReader on parameter sets captured from NVENC streams.
+////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include "annexb.h"
+#include "bit_reader.h"
+#include "slice_header.h"
+#include "packet_types.h"
+#include "test.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+// Parameter sets of NVENC streams, as DecoderThread.java configures the decoder with.
+// H.264 High profile 1024x512: log2_max_frame_num 8, pic_order_cnt_type 2.
+static const Bytes H264_SPS = {0x67, 0x64, 0x00, 0x20, 0xac, 0x2b, 0x40, 0x20, 0x02, 0x0d, 0x80,
+                               0x88, 0x00, 0x00, 0x1f, 0x40, 0x00, 0x0e, 0xa6, 0x04, 0x7a, 0x55};
+static const Bytes H264_PPS = {0x68, 0xee, 0x3c, 0xb0};
+// H.265 Main profile 1024x512: log2_max_pic_order_cnt_lsb 8, 32x32 CTB (512 CTBs).
+// profile_tier_level of VPS and SPS contains emulation prevention bytes.
+static const Bytes H265_VPS = {0x40, 0x01, 0x0c, 0x01, 0xff, 0xff, 0x21, 0x40, 0x00, 0x00, 0x03,
+                               0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x78,
+                               0xac, 0x09};
+static const Bytes H265_SPS = {0x42, 0x01, 0x01, 0x21, 0x40, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03,
+                               0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x78, 0xa0, 0x02, 0x00,
+                               0x80, 0x20, 0x16, 0x5a, 0xd2, 0x90, 0x96, 0x4b, 0x8c, 0x04, 0x04,
+                               0x00, 0x00, 0x03, 0x00, 0x04, 0x00, 0x00, 0x03, 0x00, 0xf0, 0x20};
+static const Bytes H265_PPS = {0x44, 0x01, 0xc0, 0xf7, 0xc0, 0xcc, 0x90};
+
+// Slice headers up to the picture order count, encoded against the parameter sets above.
+// IDR, first_mb_in_slice 0, slice_type 7, frame_num 0, idr_pic_id 0.
+static const Bytes H264_IDR = {0x65, 0x88, 0x80, 0x60};
+// nal_ref_idc 2, slice_type 5, frame_num 1.
+static const Bytes H264_P = {0x41, 0x9a, 0x03};
+// nal_ref_idc 0, frame_num 2.
+static const Bytes H264_P_NON_REFERENCE = {0x01, 0x9a, 0x05};
+// Last frame_num before wrap.
+static const Bytes H264_P_255 = {0x41, 0x9b, 0xff};
+// Second slice of a frame. first_mb_in_slice 1024, frame_num 3.
+static const Bytes H264_P_SECOND_SLICE = {0x41, 0x00, 0x20, 0x09, 0xa0, 0x70};
+// Recovery point SEI. recovery_frame_cnt 0.
+static const Bytes H264_SEI_RECOVERY_POINT = {0x06, 0x06, 0x01, 0x84, 0x80};
+
+// IDR_W_RADL, first_slice_segment_in_pic_flag 1, slice_type I.
+static const Bytes H265_IDR = {0x26, 0x01, 0xae};
+// TRAIL_R, slice_type P, slice_pic_order_cnt_lsb 5.
+static const Bytes H265_TRAIL_R = {0x02, 0x01, 0xd0, 0x2c};
+// TRAIL_N, slice_pic_order_cnt_lsb 6.
+static const Bytes H265_TRAIL_N = {0x00, 0x01, 0xd0, 0x34};
+// TRAIL_R, first_slice_segment_in_pic_flag 0, slice_segment_address 256 (9 bits),
+// slice_pic_order_cnt_lsb 7.
+static const Bytes H265_TRAIL_R_SEGMENT = {0x02, 0x01, 0x60, 0x08, 0x1e};
+
+// Annex-B frame of NALs with 4 bytes start codes.
+static Bytes makeFrame(const std::vector<Bytes> &nals) {
+    Bytes frame;
+    for (const Bytes &nal : nals) {
+        frame.insert(frame.end(), {0, 0, 0, 1});
+        frame.insert(frame.end(), nal.begin(), nal.end());
+    }
+    return frame;
+}
+
+static FrameInfo parse(SliceHeaderParser &parser, int codec, const std::vector<Bytes> &nals) {
+    AnnexBScanner scanner;
+    scanner.setCodec(codec);
+    Bytes frame = makeFrame(nals);
+    scanner.scan(reinterpret_cast<const char *>(frame.data()), static_cast<int>(frame.size()));
+    FrameInfo info;
+    parser.parse(reinterpret_cast<const char *>(frame.data()), scanner.getNALs(), &info);
+    return info;
+}
+
+static void testExpGolomb() {
+    // 1 | 010 | 011 | 00100 | 00111 | 0001000 | 000000011111111 | 1
+    // ue: 0, 1, 2, 3, 6, 7, 254
+    const uint8_t data[] = {0xa6, 0x43, 0x88, 0x01, 0xff};
+    BitReader reader(data, sizeof(data), false);
+    CHECK_EQ(0, reader.readUE());
+    CHECK_EQ(1, reader.readUE());
+    CHECK_EQ(2, reader.readUE());
+    CHECK_EQ(3, reader.readUE());
+    CHECK_EQ(6, reader.readUE());
+    CHECK_EQ(7, reader.readUE());
+    CHECK_EQ(254, reader.readUE());
+    CHECK(!reader.hasError());
+
+    // se: 1 -> 1, 2 -> -1, 3 -> 2, 6 -> -3, 7 -> 4, 254 -> -127
+    BitReader signedReader(data, sizeof(data), false);
+    CHECK_EQ(0, signedReader.readSE());
+    CHECK_EQ(1, signedReader.readSE());
+    CHECK_EQ(-1, signedReader.readSE());
+    CHECK_EQ(2, signedReader.readSE());
+    CHECK_EQ(-3, signedReader.readSE());
+    CHECK_EQ(4, signedReader.readSE());
+    CHECK_EQ(-127, signedReader.readSE());
+
+    // More than 31 leading zeros is not a valid code.
+    const uint8_t zeros[] = {0x00, 0x00, 0x00, 0x00, 0x80};
+    BitReader invalid(zeros, sizeof(zeros), false);
+    invalid.readUE();
+    CHECK(invalid.hasError());
+
+    // Running out of data.
+    const uint8_t truncated[] = {0x00};
+    BitReader past(truncated, sizeof(truncated), false);
+    CHECK_EQ(0, past.readUE());
+    CHECK(past.hasError());
+}
+
+static void testEmulationPrevention() {
+    // 00 00 03 01 is 00 00 01 in RBSP. 03 after a single zero is data.
+    const uint8_t data[] = {0x00, 0x00, 0x03, 0x01, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00};
+    BitReader reader(data, sizeof(data));
+    CHECK_EQ(0x000001, reader.readBits(24));
+    CHECK_EQ(0x0003, reader.readBits(16));
+    CHECK_EQ(0x0000, reader.readBits(16));
+    CHECK_EQ(0x00, reader.readBits(8));
+    CHECK(!reader.hasError());
+    CHECK(!reader.hasMoreData());
+
+    BitReader raw(data, sizeof(data), false);
+    CHECK_EQ(0x000003, raw.readBits(24));
+
+    // Zero count restarts after the removed byte, so 00 00 03 00 00 03 has two of them.
+    const uint8_t twice[] = {0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x80};
+    BitReader twiceReader(twice, sizeof(twice));
+    CHECK_EQ(0, twiceReader.readBits(32));
+    CHECK_EQ(0x80, twiceReader.readBits(8));
+    CHECK(!twiceReader.hasError());
+}
+
+static void testH264FrameNum() {
+    SliceHeaderParser parser;
+    parser.setCodec(ALVR_CODEC_H264);
+
+    FrameInfo info = parse(parser, ALVR_CODEC_H264, {H264_SPS, H264_PPS, H264_IDR});
+    CHECK(info.valid);
+    CHECK(info.idr);
+    CHECK(info.reference);
+    CHECK_EQ(ALVR_SLICE_TYPE_I, info.sliceType);
+    CHECK_EQ(0, info.frameNum);
+    CHECK_EQ(256, info.maxFrameNum);
+    // pic_order_cnt_type 2 has no pic_order_cnt_lsb.
+    CHECK_EQ(0, info.pictureOrderCount);
+
+    // Parameter sets of an earlier frame are used.
+    info = parse(parser, ALVR_CODEC_H264, {H264_P});
+    CHECK(info.valid);
+    CHECK(!info.idr);
+    CHECK(info.reference);
+    CHECK_EQ(ALVR_SLICE_TYPE_P, info.sliceType);
+    CHECK_EQ(1, info.frameNum);
+
+    info = parse(parser, ALVR_CODEC_H264, {H264_P_NON_REFERENCE});
+    CHECK(info.valid);
+    CHECK(!info.reference);
+    CHECK_EQ(2, info.frameNum);
+
+    info = parse(parser, ALVR_CODEC_H264, {H264_P_255});
+    CHECK(info.valid);
+    CHECK_EQ(255, info.frameNum);
+
+    info = parse(parser, ALVR_CODEC_H264, {H264_P_SECOND_SLICE});
+    CHECK(info.valid);
+    CHECK_EQ(ALVR_SLICE_TYPE_P, info.sliceType);
+    CHECK_EQ(3, info.frameNum);
+
+    info = parse(parser, ALVR_CODEC_H264, {H264_SEI_RECOVERY_POINT, H264_P});
+    CHECK(info.valid);
+    CHECK(info.recoveryPoint);
+    CHECK_EQ(0, info.recoveryFrameCount);
+    CHECK_EQ(1, info.frameNum);
+}
+
+static void testH264WithoutParameterSets() {
+    SliceHeaderParser parser;
+    parser.setCodec(ALVR_CODEC_H264);
+    CHECK(!parse(parser, ALVR_CODEC_H264, {H264_P}).valid);
+    // PPS without its SPS is not enough.
+    CHECK(!parse(parser, ALVR_CODEC_H264, {H264_PPS, H264_P}).valid);
+    CHECK(parse(parser, ALVR_CODEC_H264, {H264_SPS, H264_P}).valid);
+
+    parser.reset();
+    CHECK(!parse(parser, ALVR_CODEC_H264, {H264_P}).valid);
+}
+
+static void testH265PictureOrderCount() {
+    SliceHeaderParser parser;
+    parser.setCodec(ALVR_CODEC_H265);
+
+    FrameInfo info = parse(parser, ALVR_CODEC_H265, {H265_VPS, H265_SPS, H265_PPS, H265_IDR});
+    CHECK(info.valid);
+    CHECK(info.idr);
+    CHECK(info.reference);
+    CHECK_EQ(ALVR_SLICE_TYPE_I, info.sliceType);
+    CHECK_EQ(0, info.pictureOrderCount);
+    CHECK_EQ(0, info.frameNum);
+
+    // Wrong SPS position after the emulation prevention bytes would change the POC width.
+    info = parse(parser, ALVR_CODEC_H265, {H265_TRAIL_R});
+    CHECK(info.valid);
+    CHECK(!info.idr);
+    CHECK(info.reference);
+    CHECK_EQ(ALVR_SLICE_TYPE_P, info.sliceType);
+    CHECK_EQ(5, info.pictureOrderCount);
+
+    info = parse(parser, ALVR_CODEC_H265, {H265_TRAIL_N});
+    CHECK(info.valid);
+    CHECK(!info.reference);
+    CHECK_EQ(6, info.pictureOrderCount);
+}
+
+static void testH265SliceSegment() {
+    SliceHeaderParser parser;
+    parser.setCodec(ALVR_CODEC_H265);
+    parse(parser, ALVR_CODEC_H265, {H265_VPS, H265_SPS, H265_PPS, H265_IDR});
+
+    // slice_segment_address is skipped by the width derived from picture size in CTBs.
+    FrameInfo info = parse(parser, ALVR_CODEC_H265, {H265_TRAIL_R_SEGMENT});
+    CHECK(info.valid);
+    CHECK_EQ(ALVR_SLICE_TYPE_P, info.sliceType);
+    CHECK_EQ(7, info.pictureOrderCount);
+
+    // First slice segment of the frame decides the result.
+    info = parse(parser, ALVR_CODEC_H265, {H265_TRAIL_R, H265_TRAIL_R_SEGMENT});
+    CHECK(info.valid);
+    CHECK_EQ(5, info.pictureOrderCount);
+}
+
+int main() {
+    RUN_TEST(testExpGolomb);
+    RUN_TEST(testEmulationPrevention);
+    RUN_TEST(testH264FrameNum);
+    RUN_TEST(testH264WithoutParameterSets);
+    RUN_TEST(testH265PictureOrderCount);
+    RUN_TEST(testH265SliceSegment);
+    return TEST_RESULT();
+}
@@ -0,0 +1,39 @@
+#ifndef ALVRCLIENT_TEST_H
+#define ALVRCLIENT_TEST_H
+
+#include <stdio.h>
+
+// Minimal checks for host tests. Each test is an executable which returns non-zero when any
+// check has failed, so that ctest reports it.
+
+static int gTestFailures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            gTestFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(expected, actual) \
+    do { \
+        long long expected_ = (long long) (expected); \
+        long long actual_ = (long long) (actual); \
+        if (expected_ != actual_) { \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed. expected=%lld actual=%lld\n", \
+                    __FILE__, __LINE__, #expected, #actual, expected_, actual_); \
+            gTestFailures++; \
+        } \
+    } while (0)
+
+#define RUN_TEST(test) \
+    do { \
+        int failures_ = gTestFailures; \
+        test(); \
+        fprintf(stderr, "%s %s\n", gTestFailures == failures_ ? "PASS" : "FAIL", #test); \
+    } while (0)
+
+#define TEST_RESULT() (gTestFailures == 0 ? 0 : 1)
+
+#endif //ALVRCLIENT_TEST_H
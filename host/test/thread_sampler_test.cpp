@@ -0,0 +1,206 @@
+/// Thread sampler test
+// ThreadSampler on a fake procfs tree of task/<tid>/{stat,schedstat,status,comm}.
+////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include "thread_sampler.h"
+#include "test.h"
+
+static const uint64_t SECOND_US = 1000 * 1000;
+
+class FakeProc {
+public:
+    FakeProc() {
+        char path[] = "/tmp/thread_sampler_testXXXXXX";
+        m_root = mkdtemp(path);
+        mkdir((m_root + "/task").c_str(), 0755);
+    }
+
+    ~FakeProc() {
+        for (int tid : m_tids) {
+            removeFiles(tid);
+        }
+        rmdir((m_root + "/task").c_str());
+        rmdir(m_root.c_str());
+    }
+
+    const std::string &getRoot() const {
+        return m_root;
+    }
+
+    // utime, stime: Ticks of stat. runNs, waitNs: schedstat, which is not written if both are 0.
+    void writeThread(int tid, const std::string &name, uint64_t utime, uint64_t stime,
+                     uint64_t runNs, uint64_t waitNs, uint64_t voluntary, uint64_t involuntary) {
+        std::string dir = getDir(tid);
+        if (mkdir(dir.c_str(), 0755) == 0) {
+            m_tids.push_back(tid);
+        }
+        char buffer[512];
+        snprintf(buffer, sizeof(buffer), "%d (%s) S 1 1 1 0 -1 4194368 10 0 0 0 %llu %llu 0 0 20 "
+                                         "0 40 0 100\n", tid, name.c_str(),
+                 (unsigned long long) utime, (unsigned long long) stime);
+        writeFile(dir + "/stat", buffer);
+        writeFile(dir + "/comm", name + "\n");
+        if (runNs != 0 || waitNs != 0) {
+            snprintf(buffer, sizeof(buffer), "%llu %llu 42\n", (unsigned long long) runNs,
+                     (unsigned long long) waitNs);
+            writeFile(dir + "/schedstat", buffer);
+        } else {
+            unlink((dir + "/schedstat").c_str());
+        }
+        snprintf(buffer, sizeof(buffer), "Name:\t%s\nState:\tS (sleeping)\n"
+                                         "voluntary_ctxt_switches:\t%llu\n"
+                                         "nonvoluntary_ctxt_switches:\t%llu\n", name.c_str(),
+                 (unsigned long long) voluntary, (unsigned long long) involuntary);
+        writeFile(dir + "/status", buffer);
+    }
+
+    void removeThread(int tid) {
+        removeFiles(tid);
+    }
+private:
+    std::string getDir(int tid) const {
+        return m_root + "/task/" + std::to_string(tid);
+    }
+
+    void removeFiles(int tid) {
+        std::string dir = getDir(tid);
+        for (const char *file : {"/stat", "/schedstat", "/status", "/comm"}) {
+            unlink((dir + file).c_str());
+        }
+        rmdir(dir.c_str());
+    }
+
+    static void writeFile(const std::string &path, const std::string &content) {
+        FILE *fp = fopen(path.c_str(), "w");
+        fwrite(content.data(), 1, content.size(), fp);
+        fclose(fp);
+    }
+
+    std::string m_root;
+    std::vector<int> m_tids;
+};
+
+static void testDeltas() {
+    FakeProc proc;
+    proc.writeThread(101, "DecodeQueue", 0, 0, 5000000, 1000000, 10, 2);
+    proc.writeThread(102, "Other (thread)", 0, 0, 9000000, 0, 1, 1);
+    ThreadSampler sampler(proc.getRoot(), {"DecodeQueue"});
+
+    auto threads = sampler.sample(SECOND_US);
+    CHECK_EQ(1, threads.size());
+    if (threads.size() != 1) {
+        return;
+    }
+    CHECK_EQ(101, threads[0].tid);
+    CHECK(threads[0].name == "DecodeQueue");
+    CHECK_EQ(5000, threads[0].cpuTimeUs);
+    CHECK_EQ(1000, threads[0].runDelayUs);
+    CHECK_EQ(10, threads[0].voluntarySwitches);
+    CHECK_EQ(2, threads[0].involuntarySwitches);
+    // Nothing to compare with on the first sample.
+    CHECK_EQ(0, threads[0].cpuTimeInIntervalUs);
+    CHECK_EQ(0, threads[0].intervalUs);
+
+    proc.writeThread(101, "DecodeQueue", 0, 0, 8000000, 1500000, 25, 7);
+    threads = sampler.sample(2 * SECOND_US);
+    CHECK_EQ(1, threads.size());
+    if (threads.size() != 1) {
+        return;
+    }
+    CHECK_EQ(3000, threads[0].cpuTimeInIntervalUs);
+    CHECK_EQ(500, threads[0].runDelayInIntervalUs);
+    CHECK_EQ(15, threads[0].voluntarySwitchesInInterval);
+    CHECK_EQ(5, threads[0].involuntarySwitchesInInterval);
+    CHECK_EQ(SECOND_US, threads[0].intervalUs);
+}
+
+static void testStatWithoutSchedstat() {
+    FakeProc proc;
+    long ticks = sysconf(_SC_CLK_TCK);
+    proc.writeThread(101, "DecodeQueue", 30, 20, 0, 0, 0, 0);
+    ThreadSampler sampler(proc.getRoot(), {"DecodeQueue"});
+
+    auto threads = sampler.sample(SECOND_US);
+    CHECK_EQ(1, threads.size());
+    if (threads.size() != 1) {
+        return;
+    }
+    CHECK_EQ(50 * 1000000 / ticks, threads[0].cpuTimeUs);
+    CHECK_EQ(0, threads[0].runDelayUs);
+}
+
+static void testTidReuse() {
+    FakeProc proc;
+    proc.writeThread(101, "DecodeQueue", 0, 0, 5000000, 0, 10, 0);
+    ThreadSampler sampler(proc.getRoot(), {"DecodeQueue"});
+    CHECK_EQ(1, sampler.sample(SECOND_US).size());
+
+    // All names are matched, so task/ is not listed again for a new thread.
+    proc.writeThread(102, "DecodeQueue", 0, 0, 1000000, 0, 1, 0);
+    auto threads = sampler.sample(2 * SECOND_US);
+    CHECK_EQ(1, threads.size());
+
+    // The id is reused by a thread which is not sampled. It is skipped and task/ is scanned again.
+    proc.writeThread(101, "Other", 0, 0, 100000, 0, 1, 0);
+    threads = sampler.sample(3 * SECOND_US);
+    CHECK_EQ(0, threads.size());
+    threads = sampler.sample(4 * SECOND_US);
+    CHECK_EQ(1, threads.size());
+    if (threads.size() != 1) {
+        return;
+    }
+    CHECK_EQ(102, threads[0].tid);
+    CHECK_EQ(0, threads[0].intervalUs);
+
+    // Reused by a thread of the same name. CPU time went back, so it is taken as a new thread.
+    proc.writeThread(102, "DecodeQueue", 0, 0, 200000, 0, 1, 0);
+    threads = sampler.sample(5 * SECOND_US);
+    CHECK_EQ(1, threads.size());
+    if (threads.size() != 1) {
+        return;
+    }
+    CHECK_EQ(200, threads[0].cpuTimeUs);
+    CHECK_EQ(0, threads[0].cpuTimeInIntervalUs);
+    CHECK_EQ(0, threads[0].intervalUs);
+
+    // Exited thread is replaced by a thread of the same name with a new id.
+    proc.removeThread(102);
+    proc.writeThread(103, "DecodeQueue", 0, 0, 300000, 0, 1, 0);
+    CHECK_EQ(0, sampler.sample(6 * SECOND_US).size());
+    threads = sampler.sample(7 * SECOND_US);
+    CHECK_EQ(1, threads.size());
+    if (threads.size() == 1) {
+        CHECK_EQ(103, threads[0].tid);
+    }
+}
+
+static void testRescanUnmatched() {
+    FakeProc proc;
+    proc.writeThread(101, "DecodeQueue", 0, 0, 5000000, 0, 10, 0);
+    ThreadSampler sampler(proc.getRoot(), {"DecodeQueue", "DecoderOutput"});
+    CHECK_EQ(1, sampler.sample(SECOND_US).size());
+
+    // Names not matched yet are looked for at RESCAN_INTERVAL_US.
+    proc.writeThread(102, "DecoderOutput", 0, 0, 1000000, 0, 1, 0);
+    CHECK_EQ(1, sampler.sample(2 * SECOND_US).size());
+    auto threads = sampler.sample(11 * SECOND_US);
+    CHECK_EQ(2, threads.size());
+    if (threads.size() == 2) {
+        CHECK(threads[0].name == "DecodeQueue");
+        CHECK(threads[1].name == "DecoderOutput");
+    }
+}
+
+int main() {
+    RUN_TEST(testDeltas);
+    RUN_TEST(testStatWithoutSchedstat);
+    RUN_TEST(testTidReuse);
+    RUN_TEST(testRescanUnmatched);
+    return TEST_RESULT();
+}